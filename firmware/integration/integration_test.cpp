@@ -1,6 +1,9 @@
 #include <cxxabi.h>
 
+#include <atomic>
 #include <chrono>
+#include <cstring>
+#include <thread>
 #include <unordered_map>
 
 #include "absl/status/status.h"
@@ -8,6 +11,9 @@
 #include "integration/util/fake_state_storage.h"
 #include "integration/util/instrumenting_simavr.h"
 #include "simulator/simulator.h"
+#include "src/usb/shared/protocol.h"
+#include "sync/shortcut_sync.h"
+#include "sync/usb_host_memory_device.h"
 #include "util/gtest_util.h"
 
 namespace threeboard {
@@ -50,6 +56,59 @@ TEST_F(IntegrationTest, BootToEventLoop) {
                               std::chrono::milliseconds(3000)));
 }
 
+TEST_F(IntegrationTest, TimeFromUsbAttachToConfigured) {
+  // The fast firmware binary runs at 160MHz, so one 1ms USB frame is 160000
+  // cycles.
+  constexpr uint64_t kCyclesPerFrame = 160000;
+  // The device attaches to the bus in UsbControllerImpl::Setup.
+  ASSERT_OK(simavr_->RunUntilSymbol("threeboard::usb::UsbControllerImpl::Setup",
+                                    std::chrono::milliseconds(3000)));
+  uint64_t attach_cycle = simavr_->GetCycle();
+  ASSERT_OK(simavr_->RunUntilSymbol(
+      "threeboard::usb::RequestHandler::HandleSetConfiguration",
+      std::chrono::milliseconds(3000)));
+  uint64_t set_configuration_cycle = simavr_->GetCycle();
+  // The firmware displays the boot indicator once it has seen the
+  // configuration.
+  ASSERT_OK(
+      simavr_->RunUntilSymbol("threeboard::Threeboard::DisplayBootIndicator",
+                              std::chrono::milliseconds(3000)));
+  uint64_t configured_cycle = simavr_->GetCycle();
+  RecordProperty("attach_to_configured_ms",
+                 (int)((configured_cycle - attach_cycle) / kCyclesPerFrame));
+
+  // How long the host takes to configure the device depends on how fast the
+  // simulation runs, but it must be within the 2.5 seconds after which the
+  // firmware reports a configuration failure. Once the host has configured
+  // the device, the firmware should stop waiting within a frame, plus some
+  // slack for the timer interrupts that fire while it waits.
+  EXPECT_LT(configured_cycle - attach_cycle, 2500 * kCyclesPerFrame);
+  EXPECT_LE(configured_cycle - set_configuration_cycle, 2 * kCyclesPerFrame);
+}
+
+TEST_F(IntegrationTest, HostEnumerationRequestsAreAnswered) {
+  // After configuring the device, the host gets and sets the keyboard
+  // interface's alternate setting, halts and clears the keyboard endpoint, and
+  // sends the keyboard LED output report. Run the simulation until it has had
+  // an answer to each of them.
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  absl::Status run_status;
+  while (!simulator_->GetUsbHost()->IsEnumerated() && run_status.ok() &&
+         std::chrono::steady_clock::now() < deadline) {
+    run_status = simavr_->RunUntilNextEventLoopIteration();
+  }
+  ASSERT_OK(run_status);
+  EXPECT_TRUE(simulator_->GetUsbHost()->IsEnumerated());
+  // The keyboard endpoint isn't left halted, so keypresses still reach the
+  // host. Key code 4 is "a".
+  for (int i = 0; i < 4; ++i) {
+    ApplyKeypress(Keypress::X);
+  }
+  ApplyKeypress(Keypress::Z);
+  simulator_->WaitForUsbOutput(std::chrono::seconds(3));
+  EXPECT_EQ(simulator_->GetDeviceState().usb_buffer, "a");
+}
+
 TEST_F(IntegrationTest, TimerInterruptsFireAfterBooting) {
   // Verify that after beginning event loop iteration, the timer interrupts
   // continue to fire.
@@ -89,6 +148,51 @@ TEST_F(IntegrationTest, LayerSwitch) {
   ASSERT_EQ(device_state.led_b, false);
 }
 
+TEST_F(IntegrationTest, LatencyReportCoversEveryStageOfKeypress) {
+  // Type "abc" as in DefaultLayerUsbOutput, so every stage is reached.
+  auto keypresses = {Keypress::X, Keypress::X, Keypress::X, Keypress::X,
+                     Keypress::Y, Keypress::Y, Keypress::XYZ, Keypress::Z};
+  for (const Keypress &keypress : keypresses) {
+    ApplyKeypress(keypress);
+  }
+
+  // Read the latency report while the simulation runs, since the control
+  // transfer is answered by the simulated firmware.
+  std::atomic<bool> read_finished = false;
+  absl::StatusOr<std::vector<uint8_t>> data;
+  std::thread read_thread([&]() {
+    data = simulator_->GetUsbHost()->GetFeatureReport(
+        usb::descriptor::kKeyboardInterfaceIndex, sizeof(usb::LatencyReport));
+    read_finished = true;
+  });
+  absl::Status run_status;
+  while (!read_finished && run_status.ok()) {
+    run_status = simavr_->RunUntilNextEventLoopIteration();
+  }
+  read_thread.join();
+  ASSERT_OK(run_status);
+  ASSERT_OK(data.status());
+  ASSERT_EQ(data->size(), sizeof(usb::LatencyReport));
+
+  usb::LatencyReport report;
+  memcpy(&report, data->data(), sizeof(report));
+  EXPECT_EQ(report.tick_microseconds, 4);
+  // Every keypress reaches the event buffer, but only the last one sends
+  // reports to the host.
+  for (const auto &stage : report.stages) {
+    EXPECT_GT(stage.count, 0);
+    EXPECT_LE(stage.min, stage.max);
+  }
+  EXPECT_EQ(report.stages[0].count, keypresses.size());
+  EXPECT_EQ(report.dropped_events, 0);
+  uint16_t histogram_total = 0;
+  for (uint8_t i = 0; i < usb::hid::kLatencyHistogramSize; ++i) {
+    histogram_total += report.histogram[i];
+  }
+  EXPECT_EQ(histogram_total, report.stages[usb::hid::kLatencyStageCount - 1]
+                                 .count);
+}
+
 TEST_F(IntegrationTest, DefaultLayerUsbOutput) {
   // Set B0 = 4, B1 = 2.
   auto keypresses = {Keypress::X, Keypress::X, Keypress::X,
@@ -135,6 +239,22 @@ TEST_F(IntegrationTest, LayerGUsbOutput) {
   ASSERT_EQ(device_state.usb_buffer, "abc");
 }
 
+TEST_F(IntegrationTest, LayerGUsbOutputWithRepeatedCharacters) {
+  // Set Layer = G, PROG, shortcut 0 = {4,4,5,5,6}, DFLT. Repeated characters
+  // have to be released in between, distinct ones don't.
+  auto keypresses = {Keypress::XYZ, Keypress::XYZ, Keypress::XY, Keypress::X,
+                     Keypress::X,   Keypress::X,   Keypress::X,  Keypress::Z,
+                     Keypress::Z,   Keypress::X,   Keypress::Z,  Keypress::Z,
+                     Keypress::X,   Keypress::Z,   Keypress::XYZ};
+  for (const Keypress &keypress : keypresses) {
+    ApplyKeypress(keypress);
+  }
+
+  ApplyKeypress(Keypress::Z);
+  auto device_state = simulator_->GetDeviceState();
+  ASSERT_EQ(device_state.usb_buffer, "aabbc");
+}
+
 TEST_F(IntegrationTest, LayerBUsbOutput) {
   // Set Layer = B, PROG, shortcut 0 = {{11,2},{12,0},{30,2}}, DFLT.
   auto keypresses = {
@@ -156,6 +276,43 @@ TEST_F(IntegrationTest, LayerBUsbOutput) {
   ASSERT_EQ(device_state.led_b, true);
   ASSERT_EQ(device_state.usb_buffer, "Hi!");
 }
+
+TEST_F(IntegrationTest, LayerGUsbOutputOfUploadedShortcut) {
+  ASSERT_OK(simavr_->RunUntilNextEventLoopIteration());
+
+  // Upload shortcut 0 = {4,5,6} over the vendor interface: its characters go
+  // at the start of EEPROM_0, and its length in internal EEPROM at 0x100.
+  sync::UsbHostMemoryDevice device(simulator_->GetUsbHost());
+  sync::ShortcutSync shortcut_sync(&device);
+  sync::MemoryChunk characters = {4, 5, 6};
+  sync::MemoryChunk lengths = {3};
+  // Each command waits on the simulated firmware, so the upload runs on its
+  // own thread while this one runs the simulation.
+  std::atomic<bool> upload_finished = false;
+  absl::Status upload_status;
+  std::thread upload_thread([&]() {
+    upload_status = shortcut_sync.WriteChunk(1, 0, characters);
+    if (upload_status.ok()) {
+      upload_status = shortcut_sync.WriteChunk(0, 0x100, lengths);
+    }
+    upload_finished = true;
+  });
+  absl::Status run_status;
+  while (!upload_finished && run_status.ok()) {
+    run_status = simavr_->RunUntilNextEventLoopIteration();
+  }
+  upload_thread.join();
+  ASSERT_OK(run_status);
+  ASSERT_OK(upload_status);
+
+  // Set Layer = G, then flush shortcut 0.
+  ApplyKeypress(Keypress::XYZ);
+  ApplyKeypress(Keypress::XYZ);
+  ApplyKeypress(Keypress::Z);
+  auto device_state = simulator_->GetDeviceState();
+  ASSERT_EQ(device_state.led_g, true);
+  ASSERT_EQ(device_state.usb_buffer, "abc");
+}
 }  // namespace
 }  // namespace integration
 }  // namespace threeboard
\ No newline at end of file
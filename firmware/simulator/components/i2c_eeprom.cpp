@@ -14,6 +14,9 @@ using namespace std::placeholders;
 // 24LC512 control code.
 constexpr uint8_t kControlCode = 0b10100000;
 
+// Mask of the address bits within a 128-byte 24LC512 page.
+constexpr uint16_t kPageMask = 0x7F;
+
 TwiMessage ParseTwiMessage(uint32_t value) {
   TwiMessageIrq v;
   v.u.v = value;
@@ -46,7 +49,7 @@ bool IsControlByte(const TwiMessage &message) {
 
 I2cEeprom::I2cEeprom(Simavr *simavr, StateStorage *state_storage,
                      Instance instance)
-    : simavr_(simavr), address_((uint8_t)instance) {
+    : simavr_(simavr), address_((uint8_t)instance), address_pointer_(0) {
   i2c_message_callback_ = std::make_unique<I2cMessageCallback>(
       std::bind(&I2cEeprom::HandleI2cMessage, this, _1));
   i2c_message_lifetime_ =
@@ -83,7 +86,6 @@ void I2cEeprom::HandleI2cMessage(uint32_t value) {
   }
 
   if (message.msg & TWI_COND_STOP) {
-    state_ = STOPPED;
     Reset();
   }
   if (message.msg & TWI_COND_START) {
@@ -103,7 +105,9 @@ void I2cEeprom::HandleI2cMessage(uint32_t value) {
     // The address word should only be sent for write operations. Read
     // operations are addressed first by starting a write operation and writing
     // the address word, and then sending a repeated start to switch the device
-    // into read operation mode once it has been addressed.
+    // into read operation mode once it has been addressed. A read control byte
+    // without a preceding address word is a current address read, which starts
+    // from wherever the address pointer was left by the previous operation.
     if (mode_ == WRITE) {
       state_ = ADDRESSING_HIGH;
     } else {
@@ -121,15 +125,18 @@ void I2cEeprom::HandleI2cMessage(uint32_t value) {
     //    operation.
     // Address writing always happens before any write occurs.
     if (state_ == ADDRESSING_HIGH) {
-      operation_address_ |= (message.data << 8);
+      address_pointer_ = message.data << 8;
       state_ = ADDRESSING_LOW;
     } else if (state_ == ADDRESSING_LOW) {
-      operation_address_ |= message.data;
+      address_pointer_ |= message.data;
       state_ = STARTED;
     } else if (state_ == STARTED) {
-      (*buffer_)[operation_address_ + operation_address_counter_] =
-          message.data;
-      operation_address_counter_++;
+      // Like the real device, writes only increment the lower 7 bits of the
+      // address pointer, so a write that runs off the end of a 128-byte page
+      // wraps around to the start of that page.
+      (*buffer_)[address_pointer_] = message.data;
+      address_pointer_ = (address_pointer_ & ~kPageMask) |
+                         ((address_pointer_ + 1) & kPageMask);
     }
 
     // Ack the message.
@@ -139,21 +146,16 @@ void I2cEeprom::HandleI2cMessage(uint32_t value) {
 
   if (message.msg & TWI_COND_READ) {
     // Simple return of selected byte.
-    uint8_t current_byte =
-        (*buffer_)[operation_address_ + operation_address_counter_];
+    uint8_t current_byte = (*buffer_)[address_pointer_];
     LOG("SIM::HandleI2cMessage: Responding to read at addr %d with byte %d",
-        operation_address_ + operation_address_counter_, current_byte);
-    operation_address_counter_++;
+        address_pointer_, current_byte);
+    address_pointer_++;
     simavr_->RaiseI2cIrq(
         TWI_IRQ_INPUT,
         simavr_->TwiIrqMsg(TWI_COND_READ, address_, current_byte));
   }
 }
 
-void I2cEeprom::Reset() {
-  operation_address_ = 0;
-  operation_address_counter_ = 0;
-  state_ = STOPPED;
-}
+void I2cEeprom::Reset() { state_ = STOPPED; }
 }  // namespace simulator
 }  // namespace threeboard
\ No newline at end of file
@@ -29,7 +29,7 @@ class I2cEeprom {
   // Handle a message fragment.
   void HandleI2cMessage(uint32_t value);
 
-  // Reset the state of this device.
+  // Reset the transfer state of this device. The address pointer is retained.
   void Reset();
 
   Simavr *simavr_;
@@ -58,12 +58,11 @@ class I2cEeprom {
   enum EepromMode { WRITE, READ };
   EepromMode mode_;
 
-  // The address of the current operation. This is only fully valid when
-  // state_ == STARTED.
-  uint16_t operation_address_;
-
-  // Maintain the address of the last word accessed.
-  uint8_t operation_address_counter_;
+  // The internal address pointer of the device. Like the real 24LC512 this
+  // persists across STOP conditions and is incremented after every byte read or
+  // written, so current address reads (section 8.1) continue sequentially from
+  // the last accessed word. This is only fully valid when state_ == STARTED.
+  uint16_t address_pointer_;
 
   std::unique_ptr<I2cMessageCallback> i2c_message_callback_;
   std::unique_ptr<Lifetime> i2c_message_lifetime_;
@@ -1,16 +1,34 @@
 #pragma once
 
-#include <iostream>
+#include <cstdint>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
 
 namespace threeboard {
 namespace simulator {
 
-//
+// The USB host that the simulated threeboard is attached to.
 class UsbHost {
  public:
   virtual ~UsbHost() = default;
 
   virtual bool IsAttached() const = 0;
+
+  // Returns true once the device has been configured, and has answered every
+  // other request that the host sends during enumeration.
+  virtual bool IsEnumerated() const = 0;
+
+  // Send a HID feature report to an interface of the device, using a
+  // SET_REPORT control transfer.
+  virtual absl::Status SetFeatureReport(uint8_t interface,
+                                        const std::vector<uint8_t> &report) = 0;
+
+  // Read a HID feature report of `length` bytes from an interface of the
+  // device, using a GET_REPORT control transfer.
+  virtual absl::StatusOr<std::vector<uint8_t>> GetFeatureReport(
+      uint8_t interface, uint16_t length) = 0;
 };
 }  // namespace simulator
 }  // namespace threeboard
@@ -1,18 +1,67 @@
 #include "usb_host_impl.h"
 
+#include <algorithm>
+
 #include "src/usb/shared/constants.h"
 
 namespace threeboard {
 namespace simulator {
+namespace {
 
-using namespace std::placeholders;
 using usb::RequestType;
 
+// The maximum packet size of endpoint 0, as advertised in the device
+// descriptor.
+constexpr uint8_t kControlEndpointMaxPacketSize = 32;
+
+// The number of times a NAKed packet is resent before the transfer fails. The
+// host waits 1ms between attempts, and the simulated device may run much
+// slower than realtime, so this is generous.
+constexpr int kMaxPacketAttempts = 5000;
+
+usb::SetupPacket CreateSetupPacket(RequestType request_type,
+                                   usb::Request request, uint16_t value,
+                                   uint16_t index, uint16_t length) {
+  usb::SetupPacket packet;
+  packet.bmRequestType = request_type;
+  packet.bRequest = request;
+  packet.wValue = value;
+  packet.wIndex = index;
+  packet.wLength = length;
+  return packet;
+}
+
+usb::SetupPacket CreateReportPacket(RequestType::Direction direction,
+                                    usb::Request request,
+                                    usb::ReportType report_type,
+                                    uint8_t interface, uint16_t length) {
+  return CreateSetupPacket(
+      RequestType(direction, RequestType::Type::CLASS,
+                  RequestType::Recipient::INTERFACE),
+      request, (uint16_t)report_type << 8, interface, length);
+}
+
+// Create a standard request without a data stage.
+usb::SetupPacket CreateStandardPacket(RequestType::Recipient recipient,
+                                      usb::Request request, uint16_t value,
+                                      uint16_t index) {
+  return CreateSetupPacket(
+      RequestType(RequestType::Direction::HOST_TO_DEVICE,
+                  RequestType::Type::STANDARD, recipient),
+      request, value, index, 0);
+}
+
+}  // namespace
+
+using namespace std::placeholders;
+
 UsbHostImpl::UsbHostImpl(Simavr *simavr, SimulatorDelegate *simulator_delegate)
     : simavr_(simavr),
       simulator_delegate_(simulator_delegate),
       is_running_(false),
-      is_attached_(false) {
+      is_attached_(false),
+      is_configured_(false),
+      is_enumerated_(false) {
   // Register a callback on USB attach, so we'll know when we try to start the
   // host if the device is ready or not.
   usb_attach_callback_ = std::make_unique<UsbAttachCallback>(
@@ -32,15 +81,184 @@ UsbHostImpl::~UsbHostImpl() {
 
 bool UsbHostImpl::IsAttached() const { return is_attached_; }
 
+absl::Status UsbHostImpl::SetFeatureReport(uint8_t interface,
+                                           const std::vector<uint8_t> &report) {
+  std::lock_guard<std::mutex> lock(usb_mutex_);
+  // The firmware's RETURN_IF_ERROR is visible here through the shared USB
+  // headers, so statuses are checked explicitly.
+  absl::Status status = SendSetupPacket(CreateReportPacket(
+      RequestType::Direction::HOST_TO_DEVICE, usb::Request::HID_SET_REPORT,
+      usb::ReportType::FEATURE, interface, report.size()));
+  for (size_t offset = 0; status.ok() && offset < report.size();
+       offset += kControlEndpointMaxPacketSize) {
+    status = WritePacket(report.data() + offset,
+                         std::min<size_t>(report.size() - offset,
+                                          kControlEndpointMaxPacketSize));
+  }
+  if (!status.ok()) {
+    return status;
+  }
+  // The device acknowledges the report with a zero length packet.
+  return ReadPacket(nullptr, 0).status();
+}
+
+absl::StatusOr<std::vector<uint8_t>> UsbHostImpl::GetFeatureReport(
+    uint8_t interface, uint16_t length) {
+  std::lock_guard<std::mutex> lock(usb_mutex_);
+  absl::Status status = SendSetupPacket(CreateReportPacket(
+      RequestType::Direction::DEVICE_TO_HOST, usb::Request::HID_GET_REPORT,
+      usb::ReportType::FEATURE, interface, length));
+  if (!status.ok()) {
+    return status;
+  }
+  std::vector<uint8_t> report(length);
+  size_t received = 0;
+  // The data stage ends with the first packet that's shorter than the maximum
+  // packet size.
+  while (true) {
+    absl::StatusOr<uint8_t> size =
+        ReadPacket(report.data() + received, length - received);
+    if (!size.ok()) {
+      return size.status();
+    }
+    received += *size;
+    if (*size < kControlEndpointMaxPacketSize || received == length) {
+      break;
+    }
+  }
+  report.resize(received);
+  // Acknowledge the report with a zero length packet.
+  status = WritePacket(nullptr, 0);
+  if (!status.ok()) {
+    return status;
+  }
+  return report;
+}
+
+bool UsbHostImpl::IsEnumerated() const { return is_enumerated_; }
+
+absl::Status UsbHostImpl::SendEnumerationRequests() {
+  // Like a real host, check the interface's alternate setting and select it.
+  absl::Status status = SendSetupPacket(CreateSetupPacket(
+      RequestType(RequestType::Direction::DEVICE_TO_HOST,
+                  RequestType::Type::STANDARD,
+                  RequestType::Recipient::INTERFACE),
+      usb::Request::GET_INTERFACE, 0, usb::descriptor::kKeyboardInterfaceIndex,
+      1));
+  uint8_t alternate_setting = 0xFF;
+  if (status.ok()) {
+    status = ReadPacket(&alternate_setting, 1).status();
+  }
+  if (status.ok()) {
+    status = WritePacket(nullptr, 0);
+  }
+  if (status.ok() && alternate_setting != 0) {
+    status = absl::InternalError("Unexpected alternate setting");
+  }
+  if (status.ok()) {
+    status = SendNoDataRequest(CreateStandardPacket(
+        RequestType::Recipient::INTERFACE, usb::Request::SET_INTERFACE, 0,
+        usb::descriptor::kKeyboardInterfaceIndex));
+  }
+  // Halt the keyboard endpoint and clear the halt again, as a host does to
+  // recover an endpoint after an error.
+  const uint16_t keyboard_endpoint_address =
+      0x80 | usb::descriptor::kKeyboardEndpoint;
+  if (status.ok()) {
+    status = SendNoDataRequest(CreateStandardPacket(
+        RequestType::Recipient::ENDPOINT, usb::Request::SET_FEATURE,
+        (uint16_t)usb::Feature::ENDPOINT_HALT, keyboard_endpoint_address));
+  }
+  if (status.ok()) {
+    status = SendNoDataRequest(CreateStandardPacket(
+        RequestType::Recipient::ENDPOINT, usb::Request::CLEAR_FEATURE,
+        (uint16_t)usb::Feature::ENDPOINT_HALT, keyboard_endpoint_address));
+  }
+  // Send the state of the host's keyboard LEDs, with num lock on.
+  const uint8_t led_state = 0x01;
+  if (status.ok()) {
+    status = SendSetupPacket(CreateReportPacket(
+        RequestType::Direction::HOST_TO_DEVICE, usb::Request::HID_SET_REPORT,
+        usb::ReportType::OUTPUT, usb::descriptor::kKeyboardInterfaceIndex,
+        sizeof(led_state)));
+  }
+  if (status.ok()) {
+    status = WritePacket(&led_state, sizeof(led_state));
+  }
+  if (status.ok()) {
+    status = ReadPacket(nullptr, 0).status();
+  }
+  return status;
+}
+
+absl::Status UsbHostImpl::SendNoDataRequest(const usb::SetupPacket &packet) {
+  absl::Status status = SendSetupPacket(packet);
+  if (!status.ok()) {
+    return status;
+  }
+  // The device acknowledges the request with a zero length packet.
+  return ReadPacket(nullptr, 0).status();
+}
+
+absl::Status UsbHostImpl::SendSetupPacket(const usb::SetupPacket &packet) {
+  UsbPacketBuffer packet_buffer = {.endpoint = 0,
+                                   .size = sizeof(usb::SetupPacket),
+                                   .buffer = (uint8_t *)&packet};
+  if (simavr_->InvokeIoctl(USB_SETUP, &packet_buffer) != 0) {
+    return absl::InternalError("Device rejected SETUP packet");
+  }
+  return absl::OkStatus();
+}
+
+absl::Status UsbHostImpl::WritePacket(const uint8_t *data, uint8_t length) {
+  UsbPacketBuffer packet_buffer = {
+      .endpoint = 0, .size = length, .buffer = (uint8_t *)data};
+  for (int attempt = 0; attempt < kMaxPacketAttempts; ++attempt) {
+    if (simavr_->InvokeIoctl(USB_WRITE, &packet_buffer) == 0) {
+      return absl::OkStatus();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return absl::DeadlineExceededError("Device did not accept OUT packet");
+}
+
+absl::StatusOr<uint8_t> UsbHostImpl::ReadPacket(uint8_t *data,
+                                                size_t length) {
+  uint8_t buffer[kControlEndpointMaxPacketSize];
+  for (int attempt = 0; attempt < kMaxPacketAttempts; ++attempt) {
+    UsbPacketBuffer packet_buffer = {
+        .endpoint = 0, .size = sizeof(buffer), .buffer = buffer};
+    if (simavr_->InvokeIoctl(USB_READ, &packet_buffer) == 0) {
+      uint8_t size = std::min<size_t>(packet_buffer.size, length);
+      std::copy(buffer, buffer + size, data);
+      return size;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return absl::DeadlineExceededError("Device did not send IN packet");
+}
+
 void UsbHostImpl::PollDeviceEndpoints() {
-  // If the device has not configured yet (i.e. it has not yet set its
-  // endpoint number, stored in UENUM, to the keyboard endpoint), configure
-  // its keyboard endpoint here.
-  if (simavr_->GetData(UENUM) != usb::descriptor::kKeyboardEndpoint) {
+  std::lock_guard<std::mutex> lock(usb_mutex_);
+  // The device is configured once it has set its endpoint number, stored in
+  // UENUM, to the keyboard endpoint. UENUM is switched back to endpoint 0 by
+  // later control transfers, so that's only checked until it first happens.
+  if (!is_configured_) {
+    is_configured_ =
+        simavr_->GetData(UENUM) == usb::descriptor::kKeyboardEndpoint;
+    // Once configured, send the remaining requests that hosts make during
+    // enumeration, before polling the keyboard endpoint.
+    if (is_configured_) {
+      is_enumerated_ = SendEnumerationRequests().ok();
+    }
+  }
+  // If the device has not configured yet, configure its keyboard endpoint
+  // here.
+  if (!is_configured_) {
     usb::SetupPacket packet;
-    packet.bmRequestType =
-        RequestType(RequestType::Direction::HOST_TO_DEVICE,
-                    RequestType::Type::CLASS, RequestType::Recipient::ENDPOINT);
+    packet.bmRequestType = RequestType(RequestType::Direction::HOST_TO_DEVICE,
+                                       RequestType::Type::STANDARD,
+                                       RequestType::Recipient::DEVICE);
     packet.bRequest = usb::Request::SET_CONFIGURATION;
     packet.wValue = usb::descriptor::kConfigurationValue;
     UsbPacketBuffer packet_buffer = {.endpoint = 0,
@@ -48,20 +266,30 @@ void UsbHostImpl::PollDeviceEndpoints() {
                                      .buffer = (uint8_t *)&packet};
     simavr_->InvokeIoctl(USB_SETUP, &packet_buffer);
   } else {
-    uint8_t read_buffer[8];
+    uint8_t read_buffer[usb::descriptor::kKeyboardEndpointMaxPacketSize];
     UsbPacketBuffer packet_buffer = {
         .endpoint = usb::descriptor::kKeyboardEndpoint,
-        .size = 8,
+        .size = sizeof(read_buffer),
         .buffer = (uint8_t *)&read_buffer};
     int ret = simavr_->InvokeIoctl(USB_READ, &packet_buffer);
     if (ret == 0) {
       // Keypress changes are sent for two reasons: first when the key is
       // pressed down, and then when the key is released. Right now it doesn't
       // matter when we register the keypress in the simulator so we do it on
-      // key down.
-      if (read_buffer[0] != 0 || read_buffer[2] != 0) {
-        simulator_delegate_->HandleUsbOutput(read_buffer[0], read_buffer[2]);
+      // key down. This host never selects the boot protocol, so reports are a
+      // modifier byte followed by a bitmap of pressed keys. Like a real host,
+      // any key in the report that wasn't in the previous report is a new
+      // keypress, and new keypresses are registered in key code order.
+      uint8_t *key_bitmap = &read_buffer[1];
+      for (uint8_t key = 0; key < usb::hid::kKeyBitmapSize * 8; ++key) {
+        uint8_t mask = 1 << (key % 8);
+        if ((key_bitmap[key / 8] & mask) &&
+            !(previous_key_bitmap_[key / 8] & mask)) {
+          simulator_delegate_->HandleUsbOutput(read_buffer[0], key);
+        }
       }
+      std::copy(key_bitmap, key_bitmap + usb::hid::kKeyBitmapSize,
+                previous_key_bitmap_.begin());
     }
   }
 }
@@ -72,7 +300,12 @@ void UsbHostImpl::DeviceControlLoop() {
 
   // Before properly beginning the device control loop, we need to issue a USB
   // reset to ensure that the threeboard and simavr are configured correctly.
-  simavr_->InvokeIoctl(USB_RESET, nullptr);
+  {
+    std::lock_guard<std::mutex> lock(usb_mutex_);
+    simavr_->InvokeIoctl(USB_RESET, nullptr);
+    is_configured_ = false;
+    is_enumerated_ = false;
+  }
   std::this_thread::sleep_for(std::chrono::milliseconds(50));
 
   // Begin the device control loop and continue until the host is no longer
@@ -1,11 +1,14 @@
 #pragma once
 
+#include <array>
 #include <atomic>
 #include <functional>
+#include <mutex>
 #include <thread>
 
 #include "simulator/simavr/simavr.h"
 #include "simulator/simulator_delegate.h"
+#include "src/usb/shared/constants.h"
 #include "src/usb/shared/protocol.h"
 #include "usb_host.h"
 
@@ -23,8 +26,27 @@ class UsbHostImpl : public UsbHost {
   ~UsbHostImpl() override;
 
   bool IsAttached() const override;
+  bool IsEnumerated() const override;
+  absl::Status SetFeatureReport(uint8_t interface,
+                                const std::vector<uint8_t> &report) override;
+  absl::StatusOr<std::vector<uint8_t>> GetFeatureReport(
+      uint8_t interface, uint16_t length) override;
 
  protected:
+  // Send the requests that a host makes after configuring the device: get and
+  // set the keyboard interface's alternate setting, set and clear the halt
+  // feature of the keyboard endpoint, and send the keyboard LED output report.
+  absl::Status SendEnumerationRequests();
+  // Send a control transfer without a data stage, and read its status stage.
+  absl::Status SendNoDataRequest(const usb::SetupPacket &packet);
+  // Send the SETUP packet of a control transfer to endpoint 0.
+  absl::Status SendSetupPacket(const usb::SetupPacket &packet);
+  // Write a data packet to, or read one from, endpoint 0. The device NAKs the
+  // packet until it's ready, so these retry until it's accepted. ReadPacket
+  // returns the number of bytes read, discarding any beyond `length`.
+  absl::Status WritePacket(const uint8_t *data, uint8_t length);
+  absl::StatusOr<uint8_t> ReadPacket(uint8_t *data, size_t length);
+
   void PollDeviceEndpoints();
   void DeviceControlLoop();
   void InternalUsbAttachCallback(uint32_t status);
@@ -32,8 +54,20 @@ class UsbHostImpl : public UsbHost {
   Simavr *simavr_;
   SimulatorDelegate *simulator_delegate_;
 
+  // The bitmap of keys pressed in the most recent report read from the device.
+  std::array<uint8_t, usb::hid::kKeyBitmapSize> previous_key_bitmap_ = {};
+
   std::atomic<bool> is_running_;
   std::atomic<bool> is_attached_;
+  // Set once the device has configured its keyboard endpoint. Only accessed
+  // with usb_mutex_ held.
+  bool is_configured_;
+  // Set once every request in SendEnumerationRequests has succeeded.
+  std::atomic<bool> is_enumerated_;
+  // Serialises access to the device's endpoints between the device control
+  // thread and callers of the control transfer methods, since a control
+  // transfer spans several ioctls.
+  std::mutex usb_mutex_;
   std::unique_ptr<std::thread> device_control_thread_;
   std::unique_ptr<UsbAttachCallback> usb_attach_callback_;
   std::unique_ptr<Lifetime> usb_attach_lifetime_;
@@ -171,6 +171,8 @@ void Simulator::EnableLogging(UIDelegate *ui_delegate) {
 
 std::string Simulator::GetLogFile() const { return log_file_path_; }
 
+UsbHost *Simulator::GetUsbHost() { return &usb_host_; }
+
 void Simulator::HandleUsbOutput(uint8_t mod_code, uint8_t key_code) {
   last_usb_output_ = std::chrono::system_clock::now();
   char c = FromUsbKeycodes(key_code, mod_code);
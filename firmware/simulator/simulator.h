@@ -38,6 +38,7 @@ class Simulator : public SimulatorDelegate {
   void ToggleGdb(uint16_t port) const;
   void EnableLogging(UIDelegate *ui_delegate);
   std::string GetLogFile() const;
+  UsbHost *GetUsbHost();
 
  private:
   void HandleUsbOutput(uint8_t mod_code, uint8_t key_code) override;
@@ -16,19 +16,55 @@ void RunThreeboardEventLoop() {
   Logging::Init(&native_impl);
   LOG("Native layer initialised");
 
+  // Latency telemetry is recorded by several components as each keypress is
+  // handled, and read by the host through the USB stack.
+  LatencyTelemetry latency_telemetry(&native_impl);
+
   // Similar to how we construct native_impl above, this is the only place where
   // UsbImpl is injected, so as to enable other components to be testable with a
   // mocked USB implementation.
-  auto usb_controller_impl = usb::UsbControllerImpl(&native_impl);
+  auto usb_controller_impl =
+      usb::UsbControllerImpl(&native_impl, &latency_telemetry);
+#ifdef THREEBOARD_USB_CONSOLE
+  // Send log output to the host over the USB console. Output logged before the
+  // host opens the console is buffered until the buffer fills.
+  Logging::SetLogHandlerDelegate(&usb_controller_impl);
+#endif
 
   // Set up the remaining objects to inject into the Threeboard instance. These
   // could be constructed within the instance, but injecting them makes testing
   // easier since we can inject mocks into the Threeboard class for tests.
   storage::StorageController storage_controller(&native_impl,
                                                 &usb_controller_impl);
-  EventBuffer event_buffer;
+  EventBuffer event_buffer(&latency_telemetry);
   LedController led_controller(&native_impl);
-  KeyController key_controller(&native_impl, &event_buffer);
+  KeyController key_controller(&native_impl, &event_buffer,
+                               &latency_telemetry);
+#ifdef THREEBOARD_PIN_CHANGE_KEYS
+  // Handle key edges as soon as they happen, rather than at the next poll.
+  key_controller.EnablePinChangeDetection();
+#endif
+#ifdef THREEBOARD_CHORD_RESOLUTION_MS
+  // Send single key events on press, unless another key joins the chord
+  // within the window.
+  key_controller.SetChordResolutionWindow(THREEBOARD_CHORD_RESOLUTION_MS);
+#endif
+#ifdef THREEBOARD_AUTO_REPEAT_DELAY_MS
+  // Repeat keys that are held down, so values can be counted up quickly.
+  key_controller.SetAutoRepeat(THREEBOARD_AUTO_REPEAT_DELAY_MS,
+                               THREEBOARD_AUTO_REPEAT_INTERVAL_MS);
+#endif
+#ifdef THREEBOARD_LONG_PRESS_MS
+#ifdef THREEBOARD_AUTO_REPEAT_DELAY_MS
+  // A key released between the two is long pressed, and a key held past the
+  // repeat delay repeats, so the long press must come first.
+  static_assert(THREEBOARD_LONG_PRESS_MS < THREEBOARD_AUTO_REPEAT_DELAY_MS,
+                "Long presses must be shorter than the auto-repeat delay");
+#endif
+  // Produce long press events for keys that are held down, which layers use
+  // for quicker navigation.
+  key_controller.SetLongPressThreshold(THREEBOARD_LONG_PRESS_MS);
+#endif
   LayerController layer_controller(led_controller.GetLedState(),
                                    &usb_controller_impl, &storage_controller);
 
@@ -36,7 +72,7 @@ void RunThreeboardEventLoop() {
   // responsible for coordinating all threeboard components composed into it.
   Threeboard threeboard(&native_impl, &event_buffer, &usb_controller_impl,
                         &storage_controller, &led_controller, &key_controller,
-                        &layer_controller);
+                        &layer_controller, &latency_telemetry);
 
   // Run the firmware event loop. This will run forever.
   threeboard.RunEventLoop();
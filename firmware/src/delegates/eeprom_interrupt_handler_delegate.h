@@ -0,0 +1,14 @@
+#pragma once
+
+namespace threeboard {
+
+// An interface that allows the Native code to propagate internal EEPROM ready
+// interrupts to a delegate.
+class EepromInterruptHandlerDelegate {
+ public:
+  virtual void HandleEepromReadyInterrupt() = 0;
+
+ protected:
+  virtual ~EepromInterruptHandlerDelegate() = default;
+};
+}  // namespace threeboard
@@ -8,7 +8,10 @@ namespace threeboard {
 // handling.
 class EventHandlerDelegate {
  public:
-  virtual void HandleKeypress(const Keypress &) = 0;
+  // Handle `keypress`, which was completed by a key edge at
+  // `key_edge_timestamp` (see LatencyTelemetry::GetTimestamp).
+  virtual void HandleKeypress(const Keypress &keypress,
+                              uint32_t key_edge_timestamp) = 0;
 
  protected:
   virtual ~EventHandlerDelegate() = default;
@@ -6,7 +6,8 @@
 namespace threeboard {
 class EventHandlerDelegateMockDefault : public EventHandlerDelegate {
  public:
-  MOCK_METHOD(void, HandleKeypress, (const Keypress &), (override));
+  MOCK_METHOD(void, HandleKeypress, (const Keypress &, uint32_t),
+              (override));
 };
 
 using EventHandlerDelegateMock =
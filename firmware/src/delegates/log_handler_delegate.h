@@ -0,0 +1,16 @@
+#pragma once
+
+namespace threeboard {
+
+// An interface that defines the methods needed to be implemented to receive
+// log output, for example to send it to the host over the USB console.
+class LogHandlerDelegate {
+ public:
+  // Called with each formatted log message, without a trailing line break.
+  // May be called from interrupt handlers.
+  virtual void HandleLogMessage(const char *message) = 0;
+
+ protected:
+  virtual ~LogHandlerDelegate() = default;
+};
+}  // namespace threeboard
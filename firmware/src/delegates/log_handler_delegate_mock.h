@@ -0,0 +1,15 @@
+#pragma once
+
+#include "gmock/gmock.h"
+#include "src/delegates/log_handler_delegate.h"
+
+namespace threeboard {
+class LogHandlerDelegateMockDefault : public LogHandlerDelegate {
+ public:
+  MOCK_METHOD(void, HandleLogMessage, (const char *), (override));
+};
+
+using LogHandlerDelegateMock =
+    ::testing::StrictMock<LogHandlerDelegateMockDefault>;
+
+}  // namespace threeboard
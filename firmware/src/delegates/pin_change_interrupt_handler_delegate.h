@@ -0,0 +1,14 @@
+#pragma once
+
+namespace threeboard {
+
+// An interface that allows the Native code to propagate port B pin change
+// interrupts to a delegate.
+class PinChangeInterruptHandlerDelegate {
+ public:
+  virtual void HandlePinChangeInterrupt() = 0;
+
+ protected:
+  virtual ~PinChangeInterruptHandlerDelegate() = default;
+};
+}  // namespace threeboard
@@ -0,0 +1,14 @@
+#pragma once
+
+namespace threeboard {
+
+// An interface that allows the Native code to propagate TWI (two-wire
+// interface) interrupts to a delegate.
+class TwiInterruptHandlerDelegate {
+ public:
+  virtual void HandleTwiInterrupt() = 0;
+
+ protected:
+  virtual ~TwiInterruptHandlerDelegate() = default;
+};
+}  // namespace threeboard
@@ -1,36 +1,77 @@
 #pragma once
 
 #include "src/delegates/event_handler_delegate.h"
+#include "src/latency_telemetry.h"
 
 namespace threeboard {
 
-// A very basic delegate implementation that allows state to be passed from the
-// key controller to the main keypress polling run loop. Keeping this as a
-// separate class allows decoupling to avoid a dependency cycle.
+// A keypress, the time of the key edge that completed it, and the time at
+// which it was added to the event buffer, in timer ticks (see
+// LatencyTelemetry::GetTimestamp). The run loop records both timestamps when
+// it reads the event, so the telemetry of each queued keypress is kept apart.
+struct KeypressEvent {
+  Keypress keypress;
+  uint32_t key_edge_timestamp;
+  uint32_t buffered_timestamp;
+};
+
+// A fixed-capacity queue that passes keypress events from the key controller
+// to the main keypress polling run loop. Keeping this as a separate class
+// allows decoupling to avoid a dependency cycle.
+//
+// The queue has a single producer (the key controller, which runs inside an
+// ISR) and a single consumer (the run loop). Each index is only written by one
+// side, and single byte accesses are atomic on the AVR, so neither side needs
+// to disable interrupts. Events produced while the queue is full are dropped
+// and counted by the LatencyTelemetry.
 class EventBuffer final : public EventHandlerDelegate {
  public:
+  explicit EventBuffer(LatencyTelemetry *latency_telemetry)
+      : latency_telemetry_(latency_telemetry) {}
   ~EventBuffer() override = default;
 
-  // These functions are NOT interrupt safe; The caller must take responsibility
-  // for this, e.g. by disabling interrupts before calling.
-  bool HasKeypressEvent() const { return has_keypress_; }
-  Keypress GetKeypressEvent() {
-    has_keypress_ = false;
-    return event_;
-  };
+  // Consumer methods, only called by the run loop.
+  bool HasKeypressEvent() const { return head_ != tail_; }
+  // Must only be called when HasKeypressEvent() is true.
+  KeypressEvent GetKeypressEvent() {
+    const volatile KeypressEvent &slot = events_[head_ % kCapacity];
+    KeypressEvent event = {slot.keypress, slot.key_edge_timestamp,
+                           slot.buffered_timestamp};
+    // Only release the slot to the producer once the event has been read.
+    head_ = head_ + 1;
+    return event;
+  }
 
   // Implement the EventHandlerDelegate override. This method is responsible
   // for handling all keypresses and combos. It runs inside an ISR, so to keep
-  // ISR executions as short as possible, it offloads the event to a buffer
-  // variable (pending_keypress_) which is picked up in the main program's
-  // run loop.
-  void HandleKeypress(const Keypress &keypress) override {
-    event_ = keypress;
-    has_keypress_ = true;
+  // ISR executions as short as possible, it offloads the event to the queue
+  // which is picked up in the main program's run loop.
+  void HandleKeypress(const Keypress &keypress,
+                      uint32_t key_edge_timestamp) override {
+    // The indices are free-running, so their difference is the queue length
+    // even after they wrap.
+    if ((uint8_t)(tail_ - head_) == kCapacity) {
+      latency_telemetry_->RecordDroppedEvent();
+      return;
+    }
+    volatile KeypressEvent &slot = events_[tail_ % kCapacity];
+    slot.keypress = keypress;
+    slot.key_edge_timestamp = key_edge_timestamp;
+    slot.buffered_timestamp = latency_telemetry_->GetTimestamp();
+    // Only publish the slot to the consumer once the event has been written.
+    tail_ = tail_ + 1;
   }
 
  private:
-  Keypress event_;
-  bool has_keypress_ = false;
+  // A power of two, so the free-running indices stay consistent when they wrap.
+  static constexpr uint8_t kCapacity = 8;
+
+  LatencyTelemetry *latency_telemetry_;
+
+  volatile KeypressEvent events_[kCapacity];
+  // The index of the next event to read, only written by the consumer.
+  volatile uint8_t head_ = 0;
+  // The index of the next slot to write, only written by the producer.
+  volatile uint8_t tail_ = 0;
 };
 }  // namespace threeboard
@@ -0,0 +1,70 @@
+#include "src/event_buffer.h"
+
+#include "src/latency_telemetry_mock.h"
+
+namespace threeboard {
+namespace {
+
+using ::testing::Return;
+
+class EventBufferTest : public ::testing::Test {
+ public:
+  LatencyTelemetryMock latency_telemetry_mock_;
+  EventBuffer event_buffer_{&latency_telemetry_mock_};
+};
+
+TEST_F(EventBufferTest, EmptyInitially) {
+  EXPECT_FALSE(event_buffer_.HasKeypressEvent());
+}
+
+TEST_F(EventBufferTest, ReturnsEventWithTimestamps) {
+  EXPECT_CALL(latency_telemetry_mock_, GetTimestamp()).WillOnce(Return(1234));
+  event_buffer_.HandleKeypress(Keypress::XZ, 1200);
+  ASSERT_TRUE(event_buffer_.HasKeypressEvent());
+  KeypressEvent event = event_buffer_.GetKeypressEvent();
+  EXPECT_EQ(event.keypress, Keypress::XZ);
+  EXPECT_EQ(event.key_edge_timestamp, 1200);
+  EXPECT_EQ(event.buffered_timestamp, 1234);
+  EXPECT_FALSE(event_buffer_.HasKeypressEvent());
+}
+
+TEST_F(EventBufferTest, QueuesEventsInOrder) {
+  // Events are queued and read in turn many times, so the indices wrap.
+  for (int round = 0; round < 100; ++round) {
+    EXPECT_CALL(latency_telemetry_mock_, GetTimestamp())
+        .WillOnce(Return(round))
+        .WillOnce(Return(round + 1));
+    event_buffer_.HandleKeypress(Keypress::X, round);
+    event_buffer_.HandleKeypress(Keypress::Y, round);
+    KeypressEvent event = event_buffer_.GetKeypressEvent();
+    EXPECT_EQ(event.keypress, Keypress::X);
+    EXPECT_EQ(event.key_edge_timestamp, round);
+    EXPECT_EQ(event.buffered_timestamp, round);
+    event = event_buffer_.GetKeypressEvent();
+    EXPECT_EQ(event.keypress, Keypress::Y);
+    EXPECT_EQ(event.key_edge_timestamp, round);
+    EXPECT_EQ(event.buffered_timestamp, round + 1);
+    EXPECT_FALSE(event_buffer_.HasKeypressEvent());
+  }
+}
+
+TEST_F(EventBufferTest, DropsAndCountsEventsWhenFull) {
+  EXPECT_CALL(latency_telemetry_mock_, GetTimestamp())
+      .Times(8)
+      .WillRepeatedly(Return(0));
+  for (int i = 0; i < 8; ++i) {
+    event_buffer_.HandleKeypress(Keypress::Z, 0);
+  }
+  EXPECT_CALL(latency_telemetry_mock_, RecordDroppedEvent()).Times(2);
+  event_buffer_.HandleKeypress(Keypress::X, 0);
+  event_buffer_.HandleKeypress(Keypress::X, 0);
+  // The queued events are unaffected.
+  for (int i = 0; i < 8; ++i) {
+    ASSERT_TRUE(event_buffer_.HasKeypressEvent());
+    EXPECT_EQ(event_buffer_.GetKeypressEvent().keypress, Keypress::Z);
+  }
+  EXPECT_FALSE(event_buffer_.HasKeypressEvent());
+}
+
+}  // namespace
+}  // namespace threeboard
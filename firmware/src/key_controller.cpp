@@ -10,6 +10,48 @@ constexpr uint8_t kXIndex = 3;
 constexpr uint8_t kYIndex = 4;
 constexpr uint8_t kZIndex = 5;
 
+// Keys X, Y and Z are connected to pins B2, B3 and B1.
+constexpr uint8_t kKeyPins =
+    (1 << native::PB1) | (1 << native::PB2) | (1 << native::PB3);
+
+// The pin, key mask index and keypress of each key. Bitmasks of keys use their
+// position in this array.
+struct Key {
+  uint8_t pin;
+  uint8_t index;
+  Keypress keypress;
+  Keypress repeat;
+  Keypress long_press;
+};
+constexpr Key kKeys[] = {
+    {native::PB2, kXIndex, Keypress::X, Keypress::X_REPEAT, Keypress::X_LONG},
+    {native::PB3, kYIndex, Keypress::Y, Keypress::Y_REPEAT, Keypress::Y_LONG},
+    {native::PB1, kZIndex, Keypress::Z, Keypress::Z_REPEAT, Keypress::Z_LONG}};
+constexpr uint8_t kNumKeys = sizeof(kKeys) / sizeof(Key);
+constexpr uint8_t kAllKeys = (1 << kNumKeys) - 1;
+
+// The next timer 3 interrupt can fire at any time after a key edge, so a
+// lockout of two periods lasts between 5ms and 10ms. This is longer than the
+// bounce time of the key switches.
+constexpr uint8_t kLockoutPeriods = 2;
+
+constexpr uint8_t kTimer3PeriodMs = 5;
+
+// The auto-repeat interval halves after this many repeats.
+constexpr uint8_t kRepeatsPerAcceleration = 4;
+
+// Convert a duration to whole timer 3 periods, rounding up.
+constexpr uint8_t ms_to_periods(const uint16_t ms) {
+  return util::min((ms + kTimer3PeriodMs - 1) / kTimer3PeriodMs, UINT8_MAX);
+}
+
+// Convert a hold duration to timer 3 periods. Holds are counted down from the
+// period in which the key was pressed, so they need one extra period to last
+// at least `ms`. Zero stays zero, which disables the hold.
+constexpr uint8_t hold_ms_to_periods(const uint16_t ms) {
+  return ms ? util::min(ms_to_periods(ms), UINT8_MAX - 1) + 1 : 0;
+}
+
 constexpr bool is_pressed(const uint8_t pin_register, const uint8_t idx) {
   return !(pin_register & (1 << idx));
 }
@@ -21,45 +63,243 @@ constexpr bool was_pressed(const uint8_t state, const uint8_t offset) {
 }  // namespace
 
 KeyController::KeyController(native::Native *native,
-                             EventHandlerDelegate *keypress_handler)
-    : native_(native), keypress_handler_(keypress_handler) {
+                             EventHandlerDelegate *keypress_handler,
+                             LatencyTelemetry *latency_telemetry)
+    : native_(native),
+      keypress_handler_(keypress_handler),
+      latency_telemetry_(latency_telemetry) {
   // Initial state of the key mask is empty.
   key_mask_ = 0;
   // Set pins B1-B3 as input pins.
-  native_->DisableDDRB(0b00001110);
+  native_->DisableDDRB(kKeyPins);
   // Enable internal pullup resistors for B1-B3.
-  native_->EnablePORTB(0b00001110);
+  native_->EnablePORTB(kKeyPins);
+  native_->SetPinChangeInterruptHandlerDelegate(this);
+}
+
+void KeyController::EnablePinChangeDetection() {
+  pin_change_detection_ = true;
+  native_->EnablePinChangeInterrupt(kKeyPins);
+}
+
+void KeyController::SetChordResolutionWindow(uint8_t ms) {
+  chord_resolution_periods_ = ms_to_periods(ms);
+}
+
+void KeyController::SetAutoRepeat(uint16_t delay_ms, uint16_t interval_ms) {
+  repeat_delay_periods_ = hold_ms_to_periods(delay_ms);
+  repeat_interval_periods_ = util::max(ms_to_periods(interval_ms), 1);
+}
+
+void KeyController::SetLongPressThreshold(uint16_t ms) {
+  long_press_periods_ = hold_ms_to_periods(ms);
 }
 
 void KeyController::PollKeyState() {
-  uint8_t pinb = native_->GetPINB();
-  // Key X.
-  if (is_pressed(pinb, native::PB2)) {
-    key_mask_ |= (1 << kXIndex);
-  } else if (was_pressed(key_mask_, kXIndex)) {
-    key_mask_ &= ~(1 << kXIndex);
-    key_mask_ |= (uint8_t)Keypress::X;
-  }
-  // Key Y.
-  if (is_pressed(pinb, native::PB3)) {
-    key_mask_ |= (1 << kYIndex);
-  } else if (was_pressed(key_mask_, kYIndex)) {
-    key_mask_ &= ~(1 << kYIndex);
-    key_mask_ |= (uint8_t)Keypress::Y;
-  }
-  // Key Z.
-  if (is_pressed(pinb, native::PB1)) {
-    key_mask_ |= (1 << kZIndex);
-  } else if (was_pressed(key_mask_, kZIndex)) {
-    key_mask_ &= ~(1 << kZIndex);
-    key_mask_ |= (uint8_t)Keypress::Z;
+  // The window is counted down before the keys are sampled, so a key pressed
+  // at the same time as the window ends is too late to join the chord.
+  if (chord_window_periods_ > 0 && --chord_window_periods_ == 0) {
+    ResolveSingleKeyChord();
+  }
+  SampleKeys();
+  // Holds are counted down after the keys are sampled, so a key that was
+  // released during this period isn't long pressed and doesn't repeat.
+  if (long_press_countdown_periods_ > 0 &&
+      --long_press_countdown_periods_ == 0) {
+    ResolveLongPress();
+  }
+  if (repeat_countdown_periods_ > 0 && --repeat_countdown_periods_ == 0) {
+    RepeatHeldKey();
+  }
+}
+
+void KeyController::SampleKeys() {
+  if (!pin_change_detection_) {
+    UpdateKeyState(native_->GetPINB(), kAllKeys);
+    return;
+  }
+  // Sample each key whose lockout has ended, in case it changed state during
+  // the lockout. If it did, that change is a new edge and starts a new lockout.
+  uint8_t unlocked_keys = 0;
+  for (uint8_t i = 0; i < kNumKeys; ++i) {
+    if (lockout_periods_[i] > 0 && --lockout_periods_[i] == 0) {
+      unlocked_keys |= (1 << i);
+    }
+  }
+  if (unlocked_keys) {
+    LockOutKeys(UpdateKeyState(native_->GetPINB(), unlocked_keys));
+  }
+}
+
+void KeyController::HandlePinChangeInterrupt() {
+  // When keys are polled, the interrupt is only enabled to wake the CPU.
+  if (!pin_change_detection_) {
+    return;
+  }
+  uint8_t keys = 0;
+  for (uint8_t i = 0; i < kNumKeys; ++i) {
+    if (lockout_periods_[i] == 0) {
+      keys |= (1 << i);
+    }
+  }
+  if (keys) {
+    LockOutKeys(UpdateKeyState(native_->GetPINB(), keys));
+  }
+}
+
+void KeyController::EnableWakeOnKeypress() {
+  if (pin_change_detection_) {
+    // The interrupt is already enabled. Timer 3 is stopped, so locking out
+    // every key ignores them until it restarts, and then samples their state.
+    LockOutKeys(kAllKeys);
+    return;
+  }
+  native_->EnablePinChangeInterrupt(kKeyPins);
+}
+
+void KeyController::DisableWakeOnKeypress() {
+  if (!pin_change_detection_) {
+    native_->DisablePinChangeInterrupt();
+  }
+}
+
+bool KeyController::IsAnyKeyPressed() {
+  // The keys are active low.
+  return (native_->GetPINB() & kKeyPins) != kKeyPins;
+}
+
+uint8_t KeyController::UpdateKeyState(uint8_t pinb, uint8_t keys) {
+  // The first key pressed after every key was released starts a new chord.
+  bool new_chord = key_mask_ == 0;
+  uint8_t changed_keys = 0;
+  for (uint8_t i = 0; i < kNumKeys; ++i) {
+    if (!(keys & (1 << i))) {
+      continue;
+    }
+    const Key &key = kKeys[i];
+    if (is_pressed(pinb, key.pin)) {
+      if (!was_pressed(key_mask_, key.index)) {
+        changed_keys |= (1 << i);
+        // A key joining the chord cancels a pending long press.
+        pending_long_press_ = 0;
+      }
+      key_mask_ |= (1 << key.index);
+    } else if (was_pressed(key_mask_, key.index)) {
+      key_mask_ &= ~(1 << key.index);
+      // The keypress of a key that was resolved early has already been sent.
+      if (resolved_keypress_ == (uint8_t)key.keypress) {
+        resolved_keypress_ = 0;
+      } else {
+        key_mask_ |= (uint8_t)key.keypress;
+      }
+      changed_keys |= (1 << i);
+    }
+  }
+  if (changed_keys) {
+    edge_timestamp_ = latency_telemetry_->GetTimestamp();
+  }
+  if (new_chord && key_mask_ != 0) {
+    chord_window_periods_ = chord_resolution_periods_;
+    long_press_countdown_periods_ = long_press_periods_;
+    repeat_countdown_periods_ = repeat_delay_periods_;
+    current_repeat_interval_periods_ = repeat_interval_periods_;
+    repeat_count_ = 0;
   }
 
   // If there are no active keypresses but there were previous keypresses, a
   // keypress event should be registered.
   if ((key_mask_ >> 3) == 0 && key_mask_ > 0) {
-    keypress_handler_->HandleKeypress((Keypress)(key_mask_ & 7));
+    EmitKeypress(pending_long_press_ ? (Keypress)pending_long_press_
+                                     : (Keypress)(key_mask_ & 7));
     key_mask_ = 0;
   }
+  if (key_mask_ == 0) {
+    chord_window_periods_ = 0;
+    long_press_countdown_periods_ = 0;
+    repeat_countdown_periods_ = 0;
+    pending_long_press_ = 0;
+  }
+  return changed_keys;
+}
+
+void KeyController::ResolveSingleKeyChord() {
+  // Only resolve once, and only if no other key has joined the chord, and
+  // therefore no key has been released yet either.
+  if (resolved_keypress_ != 0 || (key_mask_ & 7) != 0) {
+    return;
+  }
+  for (const Key &key : kKeys) {
+    if (key_mask_ == (1 << key.index)) {
+      resolved_keypress_ = (uint8_t)key.keypress;
+      EmitKeypress(key.keypress);
+    }
+  }
+}
+
+void KeyController::ResolveLongPress() {
+  // Like early chord resolution, a long press replaces the key's keypress, so
+  // it's only produced if the chord hasn't been resolved yet and no other key
+  // has joined it.
+  if (resolved_keypress_ != 0 || (key_mask_ & 7) != 0) {
+    return;
+  }
+  for (const Key &key : kKeys) {
+    if (key_mask_ == (1 << key.index)) {
+      // If the key would still start repeating, it's only long pressed if it's
+      // released before the repeat delay, so both can be used.
+      if (repeat_countdown_periods_ > 0) {
+        pending_long_press_ = (uint8_t)key.long_press;
+        return;
+      }
+      resolved_keypress_ = (uint8_t)key.keypress;
+      EmitKeypress(key.long_press);
+    }
+  }
+}
+
+void KeyController::RepeatHeldKey() {
+  // The first event of a held key is its keypress, unless the chord was
+  // already resolved early.
+  if (resolved_keypress_ == 0) {
+    ResolveSingleKeyChord();
+    if (resolved_keypress_ == 0) {
+      return;
+    }
+  } else {
+    bool repeated = false;
+    for (const Key &key : kKeys) {
+      if (key_mask_ == (1 << key.index) &&
+          resolved_keypress_ == (uint8_t)key.keypress) {
+        EmitKeypress(key.repeat);
+        repeated = true;
+      }
+    }
+    if (!repeated) {
+      return;
+    }
+    if (++repeat_count_ == kRepeatsPerAcceleration) {
+      repeat_count_ = 0;
+      current_repeat_interval_periods_ =
+          util::max(current_repeat_interval_periods_ / 2, 1);
+    }
+  }
+  repeat_countdown_periods_ = current_repeat_interval_periods_;
+  // Repeats have no key edge of their own, so each one is timed from the
+  // previous event of the held key.
+  edge_timestamp_ = latency_telemetry_->GetTimestamp();
+}
+
+void KeyController::EmitKeypress(Keypress keypress) {
+  // The keypress is timed from the key edge that produced it, so its latency
+  // includes any chord resolution window, long press or repeat delay.
+  keypress_handler_->HandleKeypress(keypress, edge_timestamp_);
+}
+
+void KeyController::LockOutKeys(uint8_t keys) {
+  for (uint8_t i = 0; i < kNumKeys; ++i) {
+    if (keys & (1 << i)) {
+      lockout_periods_[i] = kLockoutPeriods;
+    }
+  }
 }
 }  // namespace threeboard
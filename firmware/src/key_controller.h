@@ -1,31 +1,153 @@
 #pragma once
 
 #include "src/delegates/event_handler_delegate.h"
+#include "src/delegates/pin_change_interrupt_handler_delegate.h"
+#include "src/latency_telemetry.h"
 #include "src/native/native.h"
 
 namespace threeboard {
 
 // A class to manage keyboard actions and combinations, and offload their
 // handling to a provided delegate.
-class KeyController {
+//
+// By default the keys are polled every 5ms, which debounces them but delays
+// each key edge by up to 5ms before it's seen. With pin change detection
+// enabled, key edges are instead handled by the pin change interrupt as soon
+// as they happen. The first edge of each key is accepted immediately, and the
+// key is then locked out for at least 5ms to ignore its bounces.
+//
+// A keypress event is normally produced once every key of a combo has been
+// released. With a chord resolution window set, a key that's still the only
+// key held when the window ends produces its event right away, and its release
+// is ignored.
+//
+// With auto-repeat enabled, a key held down on its own for the repeat delay
+// produces its keypress event, and then repeat events while it's held. The
+// interval between repeats halves after every few repeats, down to a single
+// timer 3 period, so long holds can quickly count up to large values.
+//
+// With long presses enabled, a key held down on its own past the long press
+// threshold produces a long press event instead of its keypress event, and its
+// release is ignored. Each held key produces a single event first, so a key
+// that was already resolved by the chord resolution window or auto-repeat
+// isn't long pressed. If auto-repeat is also enabled with a longer delay, the
+// long press is instead produced when the key is released before the repeat
+// delay, and a key held past the repeat delay repeats rather than being long
+// pressed.
+class KeyController : public PinChangeInterruptHandlerDelegate {
  public:
-  KeyController(native::Native *native, EventHandlerDelegate *keypress_handler);
+  KeyController(native::Native *native, EventHandlerDelegate *keypress_handler,
+                LatencyTelemetry *latency_telemetry);
   virtual ~KeyController() = default;
 
-  // Called by the timer 3 interrupt handler every 5ms.
+  // Detect key edges with the pin change interrupt instead of polling.
+  virtual void EnablePinChangeDetection();
+
+  // Emit single key events on press if no other key is pressed within `ms`
+  // milliseconds, rounded up to whole timer 3 periods. Zero disables early
+  // resolution, so every event waits for all keys to be released.
+  virtual void SetChordResolutionWindow(uint8_t ms);
+
+  // Start repeating a key held down on its own after `delay_ms`, with
+  // `interval_ms` between the first repeats. Both are rounded up to whole
+  // timer 3 periods, and the delay is at most 1270ms. A zero delay disables
+  // auto-repeat.
+  virtual void SetAutoRepeat(uint16_t delay_ms, uint16_t interval_ms);
+
+  // Produce a long press event for a key held down on its own for `ms`
+  // milliseconds, rounded up to whole timer 3 periods and at most 1270ms. Zero
+  // disables long presses.
+  virtual void SetLongPressThreshold(uint16_t ms);
+
+  // Called by the timer 3 interrupt handler every 5ms. Polls the keys, or ends
+  // the lockout of keys that changed when detecting them by pin change.
   virtual void PollKeyState();
 
+  // Called by the pin change interrupt handler when any key changes state.
+  void HandlePinChangeInterrupt() override;
+
+  // Wake the CPU when any key changes state. Used while timer 3 is stopped,
+  // when the keys aren't being polled.
+  virtual void EnableWakeOnKeypress();
+  virtual void DisableWakeOnKeypress();
+
+  // Returns true if any key is currently held down.
+  virtual bool IsAnyKeyPressed();
+
  protected:
   // A default constructor used by the KeyControllerMock to avoid the
   // Native-dependent public constructor.
   KeyController() = default;
 
  private:
+  // Update the state of the keys in the `keys` bitmask from the port B pin
+  // state, and pass a keypress to the handler once every key is released.
+  // Returns a bitmask of the keys that changed state.
+  uint8_t UpdateKeyState(uint8_t pinb, uint8_t keys);
+
+  // Sample the keys once per timer 3 period: every key when polling, or the
+  // keys whose lockout just ended when detecting them by pin change.
+  void SampleKeys();
+
+  // Emit the keypress for the only key held down, if no other key has been
+  // pressed since it was. Its release is then ignored.
+  void ResolveSingleKeyChord();
+
+  // Emit the long press event for the only key held down, if no other key has
+  // been pressed since it was. Its release is then ignored, unless the key
+  // could still repeat, in which case the long press is left pending until
+  // the release.
+  void ResolveLongPress();
+
+  // Emit a repeat event for the key held down on its own, and schedule the
+  // next repeat. Repeating stops once any other key is pressed.
+  void RepeatHeldKey();
+
+  // Pass a keypress event to the handler, recording its latency.
+  void EmitKeypress(Keypress keypress);
+
+  // Ignore pin changes of the keys in the `keys` bitmask for the next
+  // kLockoutPeriods timer 3 periods, after which their state is sampled again.
+  void LockOutKeys(uint8_t keys);
+
   native::Native *native_;
   EventHandlerDelegate *keypress_handler_;
+  LatencyTelemetry *latency_telemetry_;
 
   // The current and previous state of the keyboard. Used to store combos until
   // ready to pass to the keypress handler.
   uint8_t key_mask_;
+
+  // The length of the chord resolution window in timer 3 periods, the number
+  // of periods left in the current window, and the keypress that was resolved
+  // early and whose release should be ignored.
+  uint8_t chord_resolution_periods_ = 0;
+  uint8_t chord_window_periods_ = 0;
+  uint8_t resolved_keypress_ = 0;
+
+  // The auto-repeat delay and initial interval in timer 3 periods, the number
+  // of periods until the next repeat, the current interval, and the number of
+  // repeats of the held key.
+  uint8_t repeat_delay_periods_ = 0;
+  uint8_t repeat_interval_periods_ = 0;
+  uint8_t repeat_countdown_periods_ = 0;
+  uint8_t current_repeat_interval_periods_ = 0;
+  uint8_t repeat_count_ = 0;
+
+  // The long press threshold in timer 3 periods, and the number of periods
+  // until the held key is long pressed.
+  uint8_t long_press_periods_ = 0;
+  uint8_t long_press_countdown_periods_ = 0;
+  // The long press event to emit on release instead of the keypress, if the
+  // held key passed the long press threshold before the repeat delay.
+  uint8_t pending_long_press_ = 0;
+
+  // The time of the most recent key edge, which the next keypress event is
+  // timed from.
+  uint32_t edge_timestamp_ = 0;
+
+  bool pin_change_detection_ = false;
+  // The number of timer 3 periods remaining in each key's lockout.
+  uint8_t lockout_periods_[3] = {0, 0, 0};
 };
 }  // namespace threeboard
@@ -8,7 +8,15 @@ namespace detail {
 
 class DefaultKeyControllerMock : public KeyController {
  public:
+  MOCK_METHOD(void, EnablePinChangeDetection, (), (override));
+  MOCK_METHOD(void, SetChordResolutionWindow, (uint8_t), (override));
+  MOCK_METHOD(void, SetAutoRepeat, (uint16_t, uint16_t), (override));
+  MOCK_METHOD(void, SetLongPressThreshold, (uint16_t), (override));
   MOCK_METHOD(void, PollKeyState, (), (override));
+  MOCK_METHOD(void, HandlePinChangeInterrupt, (), (override));
+  MOCK_METHOD(void, EnableWakeOnKeypress, (), (override));
+  MOCK_METHOD(void, DisableWakeOnKeypress, (), (override));
+  MOCK_METHOD(bool, IsAnyKeyPressed, (), (override));
 };
 }  // namespace detail
 
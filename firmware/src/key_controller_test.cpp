@@ -1,8 +1,11 @@
 #include "src/key_controller.h"
 
 #include <memory>
+#include <utility>
+#include <vector>
 
 #include "src/delegates/event_handler_delegate_mock.h"
+#include "src/latency_telemetry_mock.h"
 #include "src/native/native_mock.h"
 
 namespace threeboard {
@@ -16,18 +19,25 @@ class KeyControllerTest : public ::testing::Test {
   KeyControllerTest() {
     EXPECT_CALL(native_mock_, DisableDDRB(0b00001110)).Times(1);
     EXPECT_CALL(native_mock_, EnablePORTB(0b00001110)).Times(1);
-    controller_ =
-        std::make_unique<KeyController>(&native_mock_, &delegate_mock_);
+    EXPECT_CALL(native_mock_, SetPinChangeInterruptHandlerDelegate(_))
+        .Times(1);
+    // Key edges are timestamped so that keypress events can be timed from
+    // them.
+    EXPECT_CALL(latency_telemetry_mock_, GetTimestamp())
+        .WillRepeatedly(Return(0));
+    controller_ = std::make_unique<KeyController>(
+        &native_mock_, &delegate_mock_, &latency_telemetry_mock_);
   }
 
   native::NativeMock native_mock_;
   EventHandlerDelegateMock delegate_mock_;
+  LatencyTelemetryMock latency_telemetry_mock_;
   std::unique_ptr<KeyController> controller_;
 };
 
 TEST_F(KeyControllerTest, DontHandleKeypressWhenNoKeysPressed) {
   EXPECT_CALL(native_mock_, GetPINB()).Times(1).WillOnce(Return(0xFF));
-  EXPECT_CALL(delegate_mock_, HandleKeypress(_)).Times(0);
+  EXPECT_CALL(delegate_mock_, HandleKeypress(_, _)).Times(0);
   controller_->PollKeyState();
 }
 
@@ -36,21 +46,47 @@ TEST_F(KeyControllerTest, HandleKeypressImmediatelyAfterKeyup) {
   EXPECT_CALL(native_mock_, GetPINB())
       .Times(10)
       .WillRepeatedly(Return(~(1 << native::PB2)));
-  EXPECT_CALL(delegate_mock_, HandleKeypress(_)).Times(0);
+  EXPECT_CALL(delegate_mock_, HandleKeypress(_, _)).Times(0);
   for (int i = 0; i < 10; i++) {
     controller_->PollKeyState();
   }
   // Release key X and poll keystate.
   EXPECT_CALL(native_mock_, GetPINB()).Times(2).WillRepeatedly(Return(0xFF));
-  EXPECT_CALL(delegate_mock_, HandleKeypress(Keypress::X)).Times(1);
+  EXPECT_CALL(delegate_mock_, HandleKeypress(Keypress::X, _)).Times(1);
   controller_->PollKeyState();
   // Poll again. Remaining polls should have no effect.
   controller_->PollKeyState();
 }
 
+TEST_F(KeyControllerTest, PassKeyEdgeTimestampWithKeypressEvent) {
+  EXPECT_CALL(native_mock_, GetPINB())
+      .WillOnce(Return(~(1 << native::PB2)))
+      .WillOnce(Return(0xFF));
+  EXPECT_CALL(latency_telemetry_mock_, GetTimestamp()).WillOnce(Return(100));
+  controller_->PollKeyState();
+  // The keypress is timed from the release that completes it.
+  EXPECT_CALL(latency_telemetry_mock_, GetTimestamp()).WillOnce(Return(200));
+  EXPECT_CALL(delegate_mock_, HandleKeypress(Keypress::X, 200));
+  controller_->PollKeyState();
+}
+
+TEST_F(KeyControllerTest, PassKeyPressTimestampWithDelayedEvent) {
+  controller_->SetLongPressThreshold(10);
+  EXPECT_CALL(native_mock_, GetPINB())
+      .Times(3)
+      .WillRepeatedly(Return(~(1 << native::PB2)));
+  // Only the press is a key edge, so the long press is timed from it, and its
+  // latency includes the long press threshold.
+  EXPECT_CALL(latency_telemetry_mock_, GetTimestamp()).WillOnce(Return(100));
+  EXPECT_CALL(delegate_mock_, HandleKeypress(Keypress::X_LONG, 100));
+  for (int i = 0; i < 3; i++) {
+    controller_->PollKeyState();
+  }
+}
+
 TEST_F(KeyControllerTest, HandleSubKeypressAsComboAtTotalKeyup) {
   // Press key X for the duration of 10 keystate polls.
-  EXPECT_CALL(delegate_mock_, HandleKeypress(_)).Times(0);
+  EXPECT_CALL(delegate_mock_, HandleKeypress(_, _)).Times(0);
   EXPECT_CALL(native_mock_, GetPINB())
       .Times(10)
       .WillRepeatedly(Return(~(1 << native::PB2)));
@@ -66,19 +102,19 @@ TEST_F(KeyControllerTest, HandleSubKeypressAsComboAtTotalKeyup) {
   EXPECT_CALL(native_mock_, GetPINB())
       .Times(10)
       .WillRepeatedly(Return(~(1 << native::PB2)));
-  EXPECT_CALL(delegate_mock_, HandleKeypress(_)).Times(0);
+  EXPECT_CALL(delegate_mock_, HandleKeypress(_, _)).Times(0);
   for (int i = 0; i < 10; i++) {
     controller_->PollKeyState();
   }
   // Keyup now should register keycombo XY.
   EXPECT_CALL(native_mock_, GetPINB()).Times(1).WillOnce(Return(0xFF));
-  EXPECT_CALL(delegate_mock_, HandleKeypress(Keypress::XY)).Times(1);
+  EXPECT_CALL(delegate_mock_, HandleKeypress(Keypress::XY, _)).Times(1);
   controller_->PollKeyState();
 }
 
 TEST_F(KeyControllerTest, HandleOverlappingKeypressesAsComboAtTotalKeyup) {
   // Press key X for the duration of 10 keystate polls.
-  EXPECT_CALL(delegate_mock_, HandleKeypress(_)).Times(0);
+  EXPECT_CALL(delegate_mock_, HandleKeypress(_, _)).Times(0);
   EXPECT_CALL(native_mock_, GetPINB())
       .Times(10)
       .WillRepeatedly(Return(~(1 << native::PB2)));
@@ -101,13 +137,13 @@ TEST_F(KeyControllerTest, HandleOverlappingKeypressesAsComboAtTotalKeyup) {
   }
   // Release both keys, poll keystate, and check that the combo was registered.
   EXPECT_CALL(native_mock_, GetPINB()).Times(1).WillOnce(Return(0xFF));
-  EXPECT_CALL(delegate_mock_, HandleKeypress(Keypress::XY)).Times(1);
+  EXPECT_CALL(delegate_mock_, HandleKeypress(Keypress::XY, _)).Times(1);
   controller_->PollKeyState();
 }
 
 TEST_F(KeyControllerTest, HandleImmediatelyConsecutiveKeypressesAsCombo) {
   // Press key X for the duration of 10 keystate polls.
-  EXPECT_CALL(delegate_mock_, HandleKeypress(_)).Times(0);
+  EXPECT_CALL(delegate_mock_, HandleKeypress(_, _)).Times(0);
   EXPECT_CALL(native_mock_, GetPINB())
       .Times(10)
       .WillRepeatedly(Return(~(1 << native::PB2)));
@@ -123,13 +159,13 @@ TEST_F(KeyControllerTest, HandleImmediatelyConsecutiveKeypressesAsCombo) {
   }
   // Release key Y.
   EXPECT_CALL(native_mock_, GetPINB()).Times(1).WillOnce(Return(0xFF));
-  EXPECT_CALL(delegate_mock_, HandleKeypress(Keypress::XY)).Times(1);
+  EXPECT_CALL(delegate_mock_, HandleKeypress(Keypress::XY, _)).Times(1);
   controller_->PollKeyState();
 }
 
 TEST_F(KeyControllerTest, HandleConsecutiveKeypressesAsIndependent) {
   // Press key X for the duration of 10 keystate polls.
-  EXPECT_CALL(delegate_mock_, HandleKeypress(_)).Times(0);
+  EXPECT_CALL(delegate_mock_, HandleKeypress(_, _)).Times(0);
   EXPECT_CALL(native_mock_, GetPINB())
       .Times(10)
       .WillRepeatedly(Return(~(1 << native::PB2)));
@@ -138,7 +174,7 @@ TEST_F(KeyControllerTest, HandleConsecutiveKeypressesAsIndependent) {
   }
 
   // Release key X.
-  EXPECT_CALL(delegate_mock_, HandleKeypress(Keypress::X)).Times(1);
+  EXPECT_CALL(delegate_mock_, HandleKeypress(Keypress::X, _)).Times(1);
   EXPECT_CALL(native_mock_, GetPINB()).Times(1).WillOnce(Return(0xFF));
   controller_->PollKeyState();
 
@@ -151,7 +187,7 @@ TEST_F(KeyControllerTest, HandleConsecutiveKeypressesAsIndependent) {
   }
   // Release key Y.
   EXPECT_CALL(native_mock_, GetPINB()).Times(1).WillOnce(Return(0xFF));
-  EXPECT_CALL(delegate_mock_, HandleKeypress(Keypress::Y)).Times(1);
+  EXPECT_CALL(delegate_mock_, HandleKeypress(Keypress::Y, _)).Times(1);
   controller_->PollKeyState();
 
   // Press key Z for the duration of 10 keystate polls.
@@ -163,8 +199,342 @@ TEST_F(KeyControllerTest, HandleConsecutiveKeypressesAsIndependent) {
   }
   // Release key Y.
   EXPECT_CALL(native_mock_, GetPINB()).Times(1).WillOnce(Return(0xFF));
-  EXPECT_CALL(delegate_mock_, HandleKeypress(Keypress::Z)).Times(1);
+  EXPECT_CALL(delegate_mock_, HandleKeypress(Keypress::Z, _)).Times(1);
+  controller_->PollKeyState();
+}
+TEST_F(KeyControllerTest, WakeOnKeypressUsesKeyPinChanges) {
+  EXPECT_CALL(native_mock_, EnablePinChangeInterrupt(0b00001110)).Times(1);
+  controller_->EnableWakeOnKeypress();
+  EXPECT_CALL(native_mock_, DisablePinChangeInterrupt()).Times(1);
+  controller_->DisableWakeOnKeypress();
+}
+
+TEST_F(KeyControllerTest, PinChangeDetectionHandlesEdgesImmediately) {
+  EXPECT_CALL(native_mock_, EnablePinChangeInterrupt(0b00001110)).Times(1);
+  controller_->EnablePinChangeDetection();
+  // Press keys X and Y, and release key X, without any polls in between.
+  EXPECT_CALL(native_mock_, GetPINB())
+      .WillOnce(Return(~(1 << native::PB2)))
+      .WillOnce(Return(~((1 << native::PB2) | (1 << native::PB3))))
+      .WillOnce(Return(~(1 << native::PB3)));
+  EXPECT_CALL(delegate_mock_, HandleKeypress(_, _)).Times(0);
+  controller_->HandlePinChangeInterrupt();
+  controller_->HandlePinChangeInterrupt();
+  // Key X is still locked out, so its release is ignored.
+  controller_->HandlePinChangeInterrupt();
+  // Its lockout ends after two timer 3 periods, when its release is detected.
+  controller_->PollKeyState();
+  EXPECT_CALL(native_mock_, GetPINB()).WillOnce(Return(~(1 << native::PB3)));
+  controller_->PollKeyState();
+  // Releasing key Y completes the combo as soon as its pin changes.
+  EXPECT_CALL(native_mock_, GetPINB()).WillOnce(Return(0xFF));
+  EXPECT_CALL(delegate_mock_, HandleKeypress(Keypress::XY, _)).Times(1);
+  controller_->HandlePinChangeInterrupt();
+}
+
+TEST_F(KeyControllerTest, PinChangeDetectionIgnoresBounces) {
+  EXPECT_CALL(native_mock_, EnablePinChangeInterrupt(0b00001110)).Times(1);
+  controller_->EnablePinChangeDetection();
+  // Key Z bounces while it's pressed.
+  EXPECT_CALL(native_mock_, GetPINB()).WillOnce(Return(~(1 << native::PB1)));
+  controller_->HandlePinChangeInterrupt();
+  EXPECT_CALL(native_mock_, GetPINB())
+      .Times(4)
+      .WillRepeatedly(Return(0xFF))
+      .RetiresOnSaturation();
+  for (int i = 0; i < 4; i++) {
+    controller_->HandlePinChangeInterrupt();
+  }
+  // The key is still pressed when its lockout ends, so nothing changed.
+  controller_->PollKeyState();
+  EXPECT_CALL(native_mock_, GetPINB()).WillOnce(Return(~(1 << native::PB1)));
+  controller_->PollKeyState();
+  // Further polls don't sample the keys.
+  controller_->PollKeyState();
+  // The release is handled immediately, then its bounces are ignored.
+  EXPECT_CALL(delegate_mock_, HandleKeypress(Keypress::Z, _)).Times(1);
+  EXPECT_CALL(native_mock_, GetPINB())
+      .WillOnce(Return(0xFF))
+      .WillOnce(Return(~(1 << native::PB1)));
+  controller_->HandlePinChangeInterrupt();
+  controller_->HandlePinChangeInterrupt();
+}
+
+TEST_F(KeyControllerTest, PinChangeDetectionKeepsInterruptEnabledForWake) {
+  EXPECT_CALL(native_mock_, EnablePinChangeInterrupt(0b00001110)).Times(1);
+  controller_->EnablePinChangeDetection();
+  // Every key is locked out while timer 3 is stopped.
+  controller_->EnableWakeOnKeypress();
+  controller_->HandlePinChangeInterrupt();
+  controller_->DisableWakeOnKeypress();
+  // The keys are sampled once timer 3 has restarted, which finds key X held
+  // down and locks it out again.
+  controller_->PollKeyState();
+  EXPECT_CALL(native_mock_, GetPINB()).WillOnce(Return(~(1 << native::PB2)));
+  controller_->PollKeyState();
+  controller_->PollKeyState();
+  EXPECT_CALL(native_mock_, GetPINB()).WillOnce(Return(0xFF));
+  EXPECT_CALL(delegate_mock_, HandleKeypress(Keypress::X, _)).Times(1);
+  controller_->PollKeyState();
+}
+
+TEST_F(KeyControllerTest, PinChangeIgnoredWhenPolling) {
+  controller_->HandlePinChangeInterrupt();
+}
+
+TEST_F(KeyControllerTest, ChordResolutionEmitsSingleKeyOnPress) {
+  // A 7ms window is rounded up to two timer 3 periods.
+  controller_->SetChordResolutionWindow(7);
+  EXPECT_CALL(native_mock_, GetPINB())
+      .Times(3)
+      .WillRepeatedly(Return(~(1 << native::PB3)));
+  controller_->PollKeyState();
+  controller_->PollKeyState();
+  // Key Y is still the only key held when the window ends.
+  EXPECT_CALL(delegate_mock_, HandleKeypress(Keypress::Y, _)).Times(1);
+  controller_->PollKeyState();
+  // Its release is ignored.
+  EXPECT_CALL(native_mock_, GetPINB()).Times(2).WillRepeatedly(Return(0xFF));
+  controller_->PollKeyState();
+  controller_->PollKeyState();
+}
+
+TEST_F(KeyControllerTest, ChordResolutionKeepsCombosWithinWindow) {
+  controller_->SetChordResolutionWindow(10);
+  EXPECT_CALL(delegate_mock_, HandleKeypress(_, _)).Times(0);
+  EXPECT_CALL(native_mock_, GetPINB())
+      .WillOnce(Return(~(1 << native::PB3)))
+      .WillOnce(Return(~((1 << native::PB1) | (1 << native::PB3))))
+      .WillRepeatedly(Return(~(1 << native::PB1)));
+  for (int i = 0; i < 10; i++) {
+    controller_->PollKeyState();
+  }
+  EXPECT_CALL(native_mock_, GetPINB()).WillOnce(Return(0xFF));
+  EXPECT_CALL(delegate_mock_, HandleKeypress(Keypress::YZ, _)).Times(1);
   controller_->PollKeyState();
 }
+
+TEST_F(KeyControllerTest, ChordResolutionHandlesTapOnRelease) {
+  controller_->SetChordResolutionWindow(10);
+  EXPECT_CALL(native_mock_, GetPINB())
+      .WillOnce(Return(~(1 << native::PB2)))
+      .WillRepeatedly(Return(0xFF));
+  controller_->PollKeyState();
+  // Key X is released before the window ends, so it's handled on release, and
+  // only once.
+  EXPECT_CALL(delegate_mock_, HandleKeypress(Keypress::X, _)).Times(1);
+  for (int i = 0; i < 5; i++) {
+    controller_->PollKeyState();
+  }
+}
+
+TEST_F(KeyControllerTest, ChordResolutionAllowsRollingToNextKey) {
+  controller_->SetChordResolutionWindow(5);
+  EXPECT_CALL(native_mock_, GetPINB())
+      .Times(2)
+      .WillRepeatedly(Return(~(1 << native::PB2)));
+  controller_->PollKeyState();
+  EXPECT_CALL(delegate_mock_, HandleKeypress(Keypress::X, _)).Times(1);
+  controller_->PollKeyState();
+  // Key Z is pressed and released while key X is still held, and is handled
+  // once key X is released.
+  EXPECT_CALL(native_mock_, GetPINB())
+      .WillOnce(Return(~((1 << native::PB1) | (1 << native::PB2))))
+      .WillOnce(Return(~(1 << native::PB2)))
+      .WillOnce(Return(0xFF));
+  EXPECT_CALL(delegate_mock_, HandleKeypress(Keypress::Z, _)).Times(1);
+  for (int i = 0; i < 3; i++) {
+    controller_->PollKeyState();
+  }
+}
+
+TEST_F(KeyControllerTest, AutoRepeatAcceleratesWhileKeyHeld) {
+  controller_->SetAutoRepeat(10, 10);
+  std::vector<std::pair<int, Keypress>> events;
+  int poll = 0;
+  EXPECT_CALL(delegate_mock_, HandleKeypress(_, _))
+      .WillRepeatedly(testing::Invoke([&](const Keypress &keypress, uint32_t) {
+        events.push_back({poll, keypress});
+      }));
+  EXPECT_CALL(native_mock_, GetPINB())
+      .Times(15)
+      .WillRepeatedly(Return(~(1 << native::PB2)));
+  for (poll = 1; poll <= 15; poll++) {
+    controller_->PollKeyState();
+  }
+  // The keypress is sent after the delay, followed by repeats every interval.
+  // The interval halves after every 4 repeats.
+  std::vector<std::pair<int, Keypress>> expected = {
+      {3, Keypress::X},         {5, Keypress::X_REPEAT},
+      {7, Keypress::X_REPEAT},  {9, Keypress::X_REPEAT},
+      {11, Keypress::X_REPEAT}, {12, Keypress::X_REPEAT},
+      {13, Keypress::X_REPEAT}, {14, Keypress::X_REPEAT},
+      {15, Keypress::X_REPEAT}};
+  EXPECT_EQ(events, expected);
+  // The release is ignored.
+  EXPECT_CALL(native_mock_, GetPINB()).WillOnce(Return(0xFF));
+  controller_->PollKeyState();
+  EXPECT_EQ(events.size(), expected.size());
+}
+
+TEST_F(KeyControllerTest, AutoRepeatStopsWhenAnotherKeyIsPressed) {
+  controller_->SetAutoRepeat(5, 5);
+  EXPECT_CALL(native_mock_, GetPINB())
+      .WillOnce(Return(~(1 << native::PB3)))
+      .WillOnce(Return(~(1 << native::PB3)))
+      .WillRepeatedly(Return(~((1 << native::PB1) | (1 << native::PB3))));
+  // Key Y is sent after 5ms, but doesn't repeat once key Z is pressed.
+  EXPECT_CALL(delegate_mock_, HandleKeypress(Keypress::Y, _)).Times(1);
+  for (int i = 0; i < 10; i++) {
+    controller_->PollKeyState();
+  }
+  // Only key Z's keypress is sent once both keys are released.
+  EXPECT_CALL(native_mock_, GetPINB()).WillOnce(Return(0xFF));
+  EXPECT_CALL(delegate_mock_, HandleKeypress(Keypress::Z, _)).Times(1);
+  controller_->PollKeyState();
+}
+
+TEST_F(KeyControllerTest, AutoRepeatIgnoresCombos) {
+  controller_->SetAutoRepeat(5, 5);
+  EXPECT_CALL(native_mock_, GetPINB())
+      .Times(10)
+      .WillRepeatedly(Return(~((1 << native::PB1) | (1 << native::PB2))));
+  EXPECT_CALL(delegate_mock_, HandleKeypress(_, _)).Times(0);
+  for (int i = 0; i < 10; i++) {
+    controller_->PollKeyState();
+  }
+  EXPECT_CALL(native_mock_, GetPINB()).WillOnce(Return(0xFF));
+  EXPECT_CALL(delegate_mock_, HandleKeypress(Keypress::XZ, _)).Times(1);
+  controller_->PollKeyState();
+}
+
+TEST_F(KeyControllerTest, LongPressReplacesKeypress) {
+  controller_->SetLongPressThreshold(10);
+  EXPECT_CALL(native_mock_, GetPINB())
+      .Times(3)
+      .WillRepeatedly(Return(~(1 << native::PB3)));
+  EXPECT_CALL(delegate_mock_, HandleKeypress(_, _)).Times(0);
+  for (int i = 0; i < 2; i++) {
+    controller_->PollKeyState();
+  }
+  // Key Y is long pressed once it has been held for 10ms.
+  EXPECT_CALL(delegate_mock_, HandleKeypress(Keypress::Y_LONG, _)).Times(1);
+  controller_->PollKeyState();
+  // The release is ignored.
+  EXPECT_CALL(native_mock_, GetPINB()).WillOnce(Return(0xFF));
+  controller_->PollKeyState();
+}
+
+TEST_F(KeyControllerTest, ShortPressIsNotLongPressed) {
+  controller_->SetLongPressThreshold(10);
+  EXPECT_CALL(native_mock_, GetPINB())
+      .WillOnce(Return(~(1 << native::PB2)))
+      .WillOnce(Return(~(1 << native::PB2)))
+      .WillRepeatedly(Return(0xFF));
+  EXPECT_CALL(delegate_mock_, HandleKeypress(Keypress::X, _)).Times(1);
+  for (int i = 0; i < 5; i++) {
+    controller_->PollKeyState();
+  }
+}
+
+TEST_F(KeyControllerTest, LongPressIgnoresCombos) {
+  controller_->SetLongPressThreshold(5);
+  EXPECT_CALL(native_mock_, GetPINB())
+      .WillOnce(Return(~(1 << native::PB1)))
+      .WillRepeatedly(Return(~((1 << native::PB1) | (1 << native::PB3))));
+  EXPECT_CALL(delegate_mock_, HandleKeypress(_, _)).Times(0);
+  for (int i = 0; i < 5; i++) {
+    controller_->PollKeyState();
+  }
+  EXPECT_CALL(native_mock_, GetPINB()).WillOnce(Return(0xFF));
+  EXPECT_CALL(delegate_mock_, HandleKeypress(Keypress::YZ, _)).Times(1);
+  controller_->PollKeyState();
+}
+
+TEST_F(KeyControllerTest, LongPressBeforeRepeatDelayIsSentOnRelease) {
+  controller_->SetLongPressThreshold(5);
+  controller_->SetAutoRepeat(10, 5);
+  EXPECT_CALL(native_mock_, GetPINB())
+      .Times(2)
+      .WillRepeatedly(Return(~(1 << native::PB1)));
+  // Key Z passes the long press threshold, but could still repeat.
+  EXPECT_CALL(delegate_mock_, HandleKeypress(_, _)).Times(0);
+  for (int i = 0; i < 2; i++) {
+    controller_->PollKeyState();
+  }
+  // Releasing it before the repeat delay sends the long press.
+  EXPECT_CALL(native_mock_, GetPINB()).WillOnce(Return(0xFF));
+  EXPECT_CALL(delegate_mock_, HandleKeypress(Keypress::Z_LONG, _)).Times(1);
+  controller_->PollKeyState();
+}
+
+TEST_F(KeyControllerTest, KeyHeldPastRepeatDelayIsNotLongPressed) {
+  controller_->SetLongPressThreshold(5);
+  controller_->SetAutoRepeat(10, 5);
+  std::vector<Keypress> events;
+  EXPECT_CALL(delegate_mock_, HandleKeypress(_, _))
+      .WillRepeatedly(testing::Invoke([&](const Keypress &keypress, uint32_t) {
+        events.push_back(keypress);
+      }));
+  EXPECT_CALL(native_mock_, GetPINB())
+      .Times(5)
+      .WillRepeatedly(Return(~(1 << native::PB1)));
+  for (int i = 0; i < 5; i++) {
+    controller_->PollKeyState();
+  }
+  // The release is ignored.
+  EXPECT_CALL(native_mock_, GetPINB()).WillOnce(Return(0xFF));
+  controller_->PollKeyState();
+  std::vector<Keypress> expected = {Keypress::Z, Keypress::Z_REPEAT,
+                                    Keypress::Z_REPEAT};
+  EXPECT_EQ(events, expected);
+}
+
+TEST_F(KeyControllerTest, ComboCancelsPendingLongPress) {
+  controller_->SetLongPressThreshold(5);
+  controller_->SetAutoRepeat(10, 5);
+  EXPECT_CALL(native_mock_, GetPINB())
+      .Times(2)
+      .WillRepeatedly(Return(~(1 << native::PB1)));
+  EXPECT_CALL(delegate_mock_, HandleKeypress(_, _)).Times(0);
+  for (int i = 0; i < 2; i++) {
+    controller_->PollKeyState();
+  }
+  // Key Y joins the chord after Z passed the long press threshold.
+  EXPECT_CALL(native_mock_, GetPINB())
+      .WillOnce(Return(~((1 << native::PB1) | (1 << native::PB3))))
+      .WillOnce(Return(0xFF));
+  EXPECT_CALL(delegate_mock_, HandleKeypress(Keypress::YZ, _)).Times(1);
+  controller_->PollKeyState();
+  controller_->PollKeyState();
+}
+
+TEST_F(KeyControllerTest, RepeatingKeyIsNotLongPressed) {
+  controller_->SetLongPressThreshold(10);
+  controller_->SetAutoRepeat(5, 5);
+  std::vector<Keypress> events;
+  EXPECT_CALL(delegate_mock_, HandleKeypress(_, _))
+      .WillRepeatedly(testing::Invoke([&](const Keypress &keypress, uint32_t) {
+        events.push_back(keypress);
+      }));
+  EXPECT_CALL(native_mock_, GetPINB())
+      .Times(5)
+      .WillRepeatedly(Return(~(1 << native::PB1)));
+  for (int i = 0; i < 5; i++) {
+    controller_->PollKeyState();
+  }
+  std::vector<Keypress> expected = {Keypress::Z, Keypress::Z_REPEAT,
+                                    Keypress::Z_REPEAT, Keypress::Z_REPEAT};
+  EXPECT_EQ(events, expected);
+}
+
+TEST_F(KeyControllerTest, IsAnyKeyPressed) {
+  EXPECT_CALL(native_mock_, GetPINB()).WillOnce(Return(0xFF));
+  EXPECT_FALSE(controller_->IsAnyKeyPressed());
+  // Key Y pulls pin B3 low.
+  EXPECT_CALL(native_mock_, GetPINB()).WillOnce(Return(~(1 << native::PB3)));
+  EXPECT_TRUE(controller_->IsAnyKeyPressed());
+}
+
 }  // namespace
 }  // namespace threeboard
@@ -20,5 +20,16 @@ enum class Keypress : uint8_t {
   XY = 6,
   // Three-key combo.
   XYZ = 7,
+  // Repeats of individual keys, produced while a key is held down on its own
+  // once auto-repeat is enabled.
+  Z_REPEAT = 9,
+  Y_REPEAT = 10,
+  X_REPEAT = 12,
+  // Long presses of individual keys, produced when a key is held down on its
+  // own past the long press threshold once long presses are enabled. The key's
+  // release is then ignored.
+  Z_LONG = 17,
+  Y_LONG = 18,
+  X_LONG = 20,
 };
 }  // namespace threeboard
\ No newline at end of file
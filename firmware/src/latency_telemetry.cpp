@@ -0,0 +1,107 @@
+#include "src/latency_telemetry.h"
+
+namespace threeboard {
+namespace {
+
+// Timer 3 counts from 0 to 1249 (OCR3A) at F_CPU / 64, so each tick is 4us at
+// 16MHz, and each period is 5ms.
+constexpr uint8_t kTickMicroseconds = 4;
+constexpr uint16_t kTicksPerPeriod = 1250;
+constexpr uint16_t kTicksPerMs = 1000 / kTickMicroseconds;
+
+// The stage that must have been reached before each stage is recorded.
+constexpr LatencyTelemetry::Stage kPrerequisiteStage[] = {
+    LatencyTelemetry::Stage::KEY_EDGE,
+    LatencyTelemetry::Stage::KEY_EDGE,
+    LatencyTelemetry::Stage::EVENT_BUFFERED,
+    LatencyTelemetry::Stage::EVENT_BUFFERED,
+    LatencyTelemetry::Stage::REPORT_QUEUED,
+};
+
+constexpr uint8_t StageBit(LatencyTelemetry::Stage stage) {
+  return 1 << (uint8_t)stage;
+}
+
+}  // namespace
+
+LatencyTelemetry::LatencyTelemetry(native::Native *native) : native_(native) {
+  report_.tick_microseconds = kTickMicroseconds;
+}
+
+void LatencyTelemetry::RecordStage(Stage stage) {
+  // Only read the clock if the stage will be recorded.
+  if (stage == Stage::KEY_EDGE || CanRecordStage(stage)) {
+    RecordStage(stage, GetTimestamp());
+  }
+}
+
+void LatencyTelemetry::RecordStage(Stage stage, uint32_t timestamp) {
+  if (stage == Stage::KEY_EDGE) {
+    key_edge_timestamp_ = timestamp;
+    reached_stages_ = StageBit(Stage::KEY_EDGE);
+    return;
+  }
+  if (!CanRecordStage(stage)) {
+    return;
+  }
+  reached_stages_ |= StageBit(stage);
+
+  usb::LatencyReport::Stage &stats = report_.stages[(uint8_t)stage - 1];
+  if (stats.count == UINT16_MAX) {
+    return;
+  }
+  // Unsigned subtraction gives the right latency even if the clock wrapped
+  // since the key edge.
+  uint32_t latency = timestamp - key_edge_timestamp_;
+  if (stats.count == 0 || latency < stats.min) {
+    stats.min = latency;
+  }
+  if (latency > stats.max) {
+    stats.max = latency;
+  }
+  stats.total += latency;
+  stats.count++;
+
+  if (stage == Stage::REPORT_ACKED) {
+    uint8_t bucket = 0;
+    uint32_t bucket_limit = kTicksPerMs;
+    while (bucket < usb::hid::kLatencyHistogramSize - 1 &&
+           latency >= bucket_limit) {
+      bucket++;
+      bucket_limit <<= 1;
+    }
+    report_.histogram[bucket]++;
+  }
+}
+
+void LatencyTelemetry::HandleTimer3Interrupt() { timer3_periods_++; }
+
+bool LatencyTelemetry::CanRecordStage(Stage stage) const {
+  return !(reached_stages_ & StageBit(stage)) &&
+         (reached_stages_ & StageBit(kPrerequisiteStage[(uint8_t)stage]));
+}
+
+void LatencyTelemetry::RecordDroppedEvent() {
+  if (report_.dropped_events < UINT16_MAX) {
+    report_.dropped_events++;
+  }
+}
+
+uint32_t LatencyTelemetry::GetTimestamp() const {
+  uint32_t periods = timer3_periods_;
+  uint16_t ticks = native_->GetTCNT3();
+  // If the counter has wrapped but its interrupt hasn't been handled yet, the
+  // period count is one behind. The counter is read again in case it wrapped
+  // after it was first read.
+  if (native_->GetTIFR3() & (1 << native::OCF3A)) {
+    periods++;
+    ticks = native_->GetTCNT3();
+  }
+  return (periods * kTicksPerPeriod) + ticks;
+}
+
+const usb::LatencyReport &LatencyTelemetry::GetReport() const {
+  return report_;
+}
+
+}  // namespace threeboard
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "src/native/native.h"
+#include "src/usb/shared/protocol.h"
+
+namespace threeboard {
+
+// Measures how long each keypress takes to pass through the firmware, from
+// the key edge that completes it to the host reading its reports. The
+// statistics are accumulated in SRAM in the format of the keyboard interface's
+// feature report, so the host can read them at any time.
+//
+// Timestamps are read from timer 3, which counts in 4us ticks and wraps every
+// 5ms when it polls the keys, combined with a count of its periods. Reading
+// them costs a couple of register reads, so stages can be recorded from
+// interrupt handlers.
+class LatencyTelemetry {
+ public:
+  enum class Stage : uint8_t {
+    // The KeyController detected the key edge that completes a keypress.
+    KEY_EDGE = 0,
+    // The keypress was added to the event buffer.
+    EVENT_BUFFERED = 1,
+    // The active layer finished handling the keypress.
+    LAYER_HANDLED = 2,
+    // The first report for the keypress was queued.
+    REPORT_QUEUED = 3,
+    // The host read every report that was queued.
+    REPORT_ACKED = 4,
+  };
+
+  explicit LatencyTelemetry(native::Native *native);
+  virtual ~LatencyTelemetry() = default;
+
+  // Record that the current keypress has reached `stage`. KEY_EDGE begins a
+  // new keypress. Each other stage is recorded at most once per keypress, and
+  // only once the stage it follows has been: reports are queued while the
+  // layer is handling the keypress, so both LAYER_HANDLED and REPORT_QUEUED
+  // follow EVENT_BUFFERED. Must be called with interrupts disabled.
+  virtual void RecordStage(Stage stage);
+
+  // Record that the current keypress reached `stage` at `timestamp`, as
+  // returned by GetTimestamp, rather than now. Used for stages that happened
+  // before they could be recorded, such as the key edge and buffering of a
+  // keypress that waited in the event buffer.
+  virtual void RecordStage(Stage stage, uint32_t timestamp);
+
+  // Advance the clock by a timer 3 period. Must be called by the timer 3
+  // interrupt handler before any stage is recorded.
+  virtual void HandleTimer3Interrupt();
+
+  // Count a keypress event that was dropped because the event buffer was full.
+  virtual void RecordDroppedEvent();
+
+  // The current time in timer ticks, which wraps every ~4.7 hours. Must be
+  // called with interrupts disabled.
+  virtual uint32_t GetTimestamp() const;
+
+  virtual const usb::LatencyReport &GetReport() const;
+
+ protected:
+  // A default constructor used by the LatencyTelemetryMock to avoid the
+  // Native-dependent public constructor.
+  LatencyTelemetry() = default;
+
+ private:
+  // Returns true if `stage` hasn't been recorded for the current keypress yet,
+  // but the stage it follows has.
+  bool CanRecordStage(Stage stage) const;
+
+  native::Native *native_;
+
+  uint32_t timer3_periods_ = 0;
+  uint32_t key_edge_timestamp_ = 0;
+  // A bitmask of the stages that the current keypress has reached.
+  uint8_t reached_stages_ = 0;
+
+  usb::LatencyReport report_ = {};
+};
+
+}  // namespace threeboard
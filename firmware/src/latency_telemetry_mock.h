@@ -0,0 +1,23 @@
+#pragma once
+
+#include "gmock/gmock.h"
+#include "latency_telemetry.h"
+
+namespace threeboard {
+namespace detail {
+
+class DefaultLatencyTelemetryMock : public LatencyTelemetry {
+ public:
+  MOCK_METHOD(void, RecordStage, (Stage), (override));
+  MOCK_METHOD(void, RecordStage, (Stage, uint32_t), (override));
+  MOCK_METHOD(void, HandleTimer3Interrupt, (), (override));
+  MOCK_METHOD(void, RecordDroppedEvent, (), (override));
+  MOCK_METHOD(uint32_t, GetTimestamp, (), (const, override));
+  MOCK_METHOD(const usb::LatencyReport &, GetReport, (), (const, override));
+};
+}  // namespace detail
+
+using LatencyTelemetryMock =
+    ::testing::StrictMock<detail::DefaultLatencyTelemetryMock>;
+
+}  // namespace threeboard
@@ -0,0 +1,146 @@
+#include "src/latency_telemetry.h"
+
+#include "gtest/gtest.h"
+#include "src/native/native_mock.h"
+
+namespace threeboard {
+namespace {
+
+using testing::Return;
+using Stage = LatencyTelemetry::Stage;
+
+class LatencyTelemetryTest : public ::testing::Test {
+ public:
+  LatencyTelemetryTest() : latency_telemetry_(&native_mock_) {}
+
+  // Record `stage` when timer 3 has counted `ticks` into its current period.
+  void RecordStageAt(Stage stage, uint16_t ticks) {
+    EXPECT_CALL(native_mock_, GetTCNT3()).WillOnce(Return(ticks));
+    EXPECT_CALL(native_mock_, GetTIFR3()).WillOnce(Return(0));
+    latency_telemetry_.RecordStage(stage);
+  }
+
+  const usb::LatencyReport::Stage &GetStats(Stage stage) {
+    return latency_telemetry_.GetReport().stages[(uint8_t)stage - 1];
+  }
+
+  native::NativeMock native_mock_;
+  LatencyTelemetry latency_telemetry_;
+};
+
+TEST_F(LatencyTelemetryTest, ReportHasTickLength) {
+  EXPECT_EQ(latency_telemetry_.GetReport().tick_microseconds, 4);
+}
+
+TEST_F(LatencyTelemetryTest, RecordsLatencyOfEachStage) {
+  RecordStageAt(Stage::KEY_EDGE, 100);
+  RecordStageAt(Stage::EVENT_BUFFERED, 102);
+  RecordStageAt(Stage::REPORT_QUEUED, 300);
+  RecordStageAt(Stage::LAYER_HANDLED, 400);
+  latency_telemetry_.HandleTimer3Interrupt();
+  RecordStageAt(Stage::REPORT_ACKED, 50);
+
+  EXPECT_EQ(GetStats(Stage::EVENT_BUFFERED).min, 2);
+  EXPECT_EQ(GetStats(Stage::EVENT_BUFFERED).count, 1);
+  EXPECT_EQ(GetStats(Stage::LAYER_HANDLED).max, 300);
+  EXPECT_EQ(GetStats(Stage::REPORT_QUEUED).total, 200);
+  EXPECT_EQ(GetStats(Stage::REPORT_ACKED).min, 1200);
+  // 1200 ticks is 4.8ms, which is in the 4-8ms bucket.
+  EXPECT_EQ(latency_telemetry_.GetReport().histogram[3], 1);
+}
+
+TEST_F(LatencyTelemetryTest, RecordsStagesAtGivenTimestamps) {
+  // The key edge happened 2 periods before it was recorded.
+  latency_telemetry_.RecordStage(Stage::KEY_EDGE, 150);
+  latency_telemetry_.HandleTimer3Interrupt();
+  latency_telemetry_.HandleTimer3Interrupt();
+  RecordStageAt(Stage::EVENT_BUFFERED, 100);
+
+  EXPECT_EQ(GetStats(Stage::EVENT_BUFFERED).min, 2450);
+}
+
+TEST_F(LatencyTelemetryTest, TimesQueuedKeypressesSeparately) {
+  // Two keypresses are queued before the first is handled. Each one's earlier
+  // stages are recorded at their own timestamps when it's taken off the queue.
+  latency_telemetry_.RecordStage(Stage::KEY_EDGE, 100);
+  latency_telemetry_.RecordStage(Stage::EVENT_BUFFERED, 110);
+  RecordStageAt(Stage::LAYER_HANDLED, 300);
+  latency_telemetry_.RecordStage(Stage::KEY_EDGE, 200);
+  latency_telemetry_.RecordStage(Stage::EVENT_BUFFERED, 204);
+  RecordStageAt(Stage::LAYER_HANDLED, 400);
+
+  EXPECT_EQ(GetStats(Stage::EVENT_BUFFERED).count, 2);
+  EXPECT_EQ(GetStats(Stage::EVENT_BUFFERED).min, 4);
+  EXPECT_EQ(GetStats(Stage::EVENT_BUFFERED).max, 10);
+  EXPECT_EQ(GetStats(Stage::LAYER_HANDLED).count, 2);
+  EXPECT_EQ(GetStats(Stage::LAYER_HANDLED).min, 200);
+  EXPECT_EQ(GetStats(Stage::LAYER_HANDLED).max, 200);
+  EXPECT_EQ(GetStats(Stage::LAYER_HANDLED).total, 400);
+}
+
+TEST_F(LatencyTelemetryTest, AccumulatesStatisticsOverKeypresses) {
+  RecordStageAt(Stage::KEY_EDGE, 0);
+  RecordStageAt(Stage::EVENT_BUFFERED, 10);
+  RecordStageAt(Stage::KEY_EDGE, 100);
+  RecordStageAt(Stage::EVENT_BUFFERED, 104);
+  RecordStageAt(Stage::KEY_EDGE, 200);
+  RecordStageAt(Stage::EVENT_BUFFERED, 206);
+
+  const usb::LatencyReport::Stage &stats = GetStats(Stage::EVENT_BUFFERED);
+  EXPECT_EQ(stats.min, 4);
+  EXPECT_EQ(stats.max, 10);
+  EXPECT_EQ(stats.total, 20);
+  EXPECT_EQ(stats.count, 3);
+}
+
+TEST_F(LatencyTelemetryTest, StageIsOnlyRecordedOncePerKeypress) {
+  RecordStageAt(Stage::KEY_EDGE, 0);
+  RecordStageAt(Stage::EVENT_BUFFERED, 10);
+  latency_telemetry_.RecordStage(Stage::EVENT_BUFFERED);
+  EXPECT_EQ(GetStats(Stage::EVENT_BUFFERED).count, 1);
+}
+
+TEST_F(LatencyTelemetryTest, StageIsNotRecordedBeforeItsPrerequisite) {
+  // No keypress has started.
+  latency_telemetry_.RecordStage(Stage::EVENT_BUFFERED);
+  // Idle reports are acknowledged without any report being queued for the
+  // keypress.
+  RecordStageAt(Stage::KEY_EDGE, 0);
+  RecordStageAt(Stage::EVENT_BUFFERED, 10);
+  RecordStageAt(Stage::LAYER_HANDLED, 20);
+  latency_telemetry_.RecordStage(Stage::REPORT_ACKED);
+
+  EXPECT_EQ(GetStats(Stage::EVENT_BUFFERED).count, 1);
+  EXPECT_EQ(GetStats(Stage::REPORT_ACKED).count, 0);
+}
+
+TEST_F(LatencyTelemetryTest, TimestampIncludesPendingTimerPeriod) {
+  RecordStageAt(Stage::KEY_EDGE, 1200);
+  // The counter wrapped before the interrupt handler has run.
+  EXPECT_CALL(native_mock_, GetTCNT3())
+      .WillOnce(Return(1249))
+      .WillOnce(Return(3));
+  EXPECT_CALL(native_mock_, GetTIFR3()).WillOnce(Return(1 << native::OCF3A));
+  latency_telemetry_.RecordStage(Stage::EVENT_BUFFERED);
+  EXPECT_EQ(GetStats(Stage::EVENT_BUFFERED).min, 53);
+}
+
+TEST_F(LatencyTelemetryTest, SlowKeypressesAreInFinalHistogramBucket) {
+  RecordStageAt(Stage::KEY_EDGE, 0);
+  RecordStageAt(Stage::EVENT_BUFFERED, 0);
+  RecordStageAt(Stage::REPORT_QUEUED, 0);
+  for (int i = 0; i < 100; ++i) {
+    latency_telemetry_.HandleTimer3Interrupt();
+  }
+  RecordStageAt(Stage::REPORT_ACKED, 0);
+  EXPECT_EQ(latency_telemetry_.GetReport().histogram[7], 1);
+}
+
+TEST_F(LatencyTelemetryTest, CountsDroppedEvents) {
+  latency_telemetry_.RecordDroppedEvent();
+  latency_telemetry_.RecordDroppedEvent();
+  EXPECT_EQ(latency_telemetry_.GetReport().dropped_events, 2);
+}
+
+}  // namespace
+}  // namespace threeboard
@@ -5,11 +5,17 @@
 namespace threeboard {
 
 bool DefaultLayer::HandleEvent(const Keypress &keypress) {
-  if (keypress == Keypress::X) {
+  if (keypress == Keypress::X || keypress == Keypress::X_REPEAT) {
     bank0_++;
-  } else if (keypress == Keypress::Y) {
+  } else if (keypress == Keypress::Y || keypress == Keypress::Y_REPEAT) {
     bank1_++;
-  } else if (keypress == Keypress::Z) {
+  } else if (keypress == Keypress::X_LONG) {
+    bank0_--;
+  } else if (keypress == Keypress::Y_LONG) {
+    bank1_--;
+  } else if (keypress == Keypress::Z || keypress == Keypress::Z_REPEAT ||
+             keypress == Keypress::Z_LONG) {
+    // Z has no separate long press action, so a slow Z still sends.
     SendToHost(bank0_, bank1_);
   } else if (keypress == Keypress::XZ) {
     bank0_ = 0;
@@ -69,6 +69,31 @@ TEST_F(DefaultLayerTest, Bank1Clear) {
   }
 }
 
+TEST_F(DefaultLayerTest, RepeatsIncrementBanksAndFlush) {
+  EXPECT_TRUE(default_layer_.HandleEvent(Keypress::X));
+  EXPECT_TRUE(default_layer_.HandleEvent(Keypress::X_REPEAT));
+  EXPECT_TRUE(default_layer_.HandleEvent(Keypress::X_REPEAT));
+  EXPECT_TRUE(default_layer_.HandleEvent(Keypress::Y_REPEAT));
+  VerifyLayerLedExpectation();
+  EXPECT_EQ(led_state_.GetBank0(), 3);
+  EXPECT_EQ(led_state_.GetBank1(), 1);
+  EXPECT_CALL(usb_controller_mock_, SendKeypress(3, 1))
+      .Times(2)
+      .WillRepeatedly(Return(true));
+  EXPECT_TRUE(default_layer_.HandleEvent(Keypress::Z));
+  EXPECT_TRUE(default_layer_.HandleEvent(Keypress::Z_REPEAT));
+}
+
+TEST_F(DefaultLayerTest, LongPressesDecrementBanks) {
+  EXPECT_TRUE(default_layer_.HandleEvent(Keypress::X));
+  EXPECT_TRUE(default_layer_.HandleEvent(Keypress::X));
+  EXPECT_TRUE(default_layer_.HandleEvent(Keypress::X_LONG));
+  EXPECT_TRUE(default_layer_.HandleEvent(Keypress::Y_LONG));
+  VerifyLayerLedExpectation();
+  EXPECT_EQ(led_state_.GetBank0(), 1);
+  EXPECT_EQ(led_state_.GetBank1(), 255);
+}
+
 TEST_F(DefaultLayerTest, UsbFlush) {
   EXPECT_CALL(usb_controller_mock_, SendKeypress(0, 0)).WillOnce(Return(true));
   EXPECT_TRUE(default_layer_.HandleEvent(Keypress::Z));
@@ -83,6 +108,14 @@ TEST_F(DefaultLayerTest, UsbFlushFailure) {
   EXPECT_EQ(led_state_.GetErr()->state, LedState::ON);
 }
 
+TEST_F(DefaultLayerTest, LongPressZFlushes) {
+  EXPECT_TRUE(default_layer_.HandleEvent(Keypress::X));
+  EXPECT_CALL(usb_controller_mock_, SendKeypress(1, 0)).WillOnce(Return(true));
+  EXPECT_TRUE(default_layer_.HandleEvent(Keypress::Z_LONG));
+  VerifyLayerLedExpectation();
+  EXPECT_EQ(led_state_.GetErr()->state, LedState::OFF);
+}
+
 TEST_F(DefaultLayerTest, LayerSwitch) {
   EXPECT_CALL(layer_controller_delegate_mock_, SwitchToLayer(LayerId::R))
       .WillOnce(Return(true));
@@ -17,7 +17,11 @@ class Layer {
   Layer(LedState *led_state, usb::UsbController *usb_controller)
       : led_state_(led_state), usb_controller_(usb_controller) {}
 
-  // Handle a keypress event.
+  // Handle a keypress event. Keys held down with auto-repeat enabled also
+  // produce repeat events, such as Keypress::X_REPEAT, which layers handle like
+  // the key itself where repeating it is useful. Keys held down past the long
+  // press threshold produce long press events, such as Keypress::X_LONG, which
+  // layers use for the reverse of the key's action or for quicker navigation.
   virtual bool HandleEvent(const Keypress &) = 0;
 
   // Called when the threeboard has transitioned to this layer.
@@ -5,23 +5,38 @@
 namespace threeboard {
 
 bool LayerB::HandleEvent(const Keypress &keypress) {
-  if (keypress == Keypress::X) {
+  if (keypress == Keypress::X || keypress == Keypress::X_REPEAT) {
     if (prog_) {
       key_code_++;
     } else {
       shortcut_id_++;
     }
-  } else if (keypress == Keypress::Y) {
+  } else if (keypress == Keypress::X_LONG) {
+    if (prog_) {
+      key_code_--;
+    } else {
+      RETURN_IF_ERROR(JumpToNextProgrammedShortcut());
+    }
+  } else if (keypress == Keypress::Y || keypress == Keypress::Y_REPEAT) {
     if (prog_) {
       modcode_++;
     }
-  } else if (keypress == Keypress::Z) {
+  } else if (keypress == Keypress::Y_LONG) {
+    if (prog_) {
+      modcode_--;
+    }
+  } else if (keypress == Keypress::Z ||
+             (keypress == Keypress::Z_LONG && prog_)) {
+    // Z has no separate long press action in prog mode, so a slow Z still
+    // appends.
     if (prog_) {
       storage_controller_->AppendToBlobShortcut(shortcut_id_, key_code_,
                                                 modcode_);
     } else {
       storage_controller_->SendBlobShortcut(shortcut_id_);
     }
+  } else if (keypress == Keypress::Z_LONG) {
+    return layer_controller_delegate_->SwitchToLayer(LayerId::DFLT);
   } else if (keypress == Keypress::XY) {
     if (prog_) {
       storage_controller_->ClearBlobShortcut(shortcut_id_);
@@ -41,6 +56,8 @@ bool LayerB::HandleEvent(const Keypress &keypress) {
   } else if (keypress == Keypress::XYZ) {
     if (prog_) {
       prog_ = false;
+      // Write the characters appended while in prog mode to EEPROM.
+      RETURN_IF_ERROR(storage_controller_->CommitStagedShortcut());
     } else {
       return layer_controller_delegate_->SwitchToLayer(LayerId::DFLT);
     }
@@ -56,6 +73,24 @@ bool LayerB::HandleEvent(const Keypress &keypress) {
   return true;
 }
 
+bool LayerB::JumpToNextProgrammedShortcut() {
+  // Search every other shortcut in order, wrapping around, and stay on the
+  // current one if none of them are programmed. There are fewer blob shortcuts
+  // than IDs, so the search wraps around after the last blob shortcut.
+  constexpr uint16_t kCount = storage::StorageController::kBlobShortcutCount;
+  uint8_t id = shortcut_id_;
+  for (uint16_t i = 0; i < kCount; ++i) {
+    id = (id + 1) % kCount;
+    uint8_t length;
+    RETURN_IF_ERROR(storage_controller_->GetBlobShortcutLength(id, &length));
+    if (length > 0) {
+      shortcut_id_ = id;
+      break;
+    }
+  }
+  return true;
+}
+
 bool LayerB::TransitionedToLayer() {
   LOG("Switched to layer B");
   uint8_t length;
@@ -21,6 +21,9 @@ class LayerB final : public Layer {
   bool TransitionedToLayer() override;
 
  private:
+  // Move to the next shortcut after the current one that has been programmed.
+  bool JumpToNextProgrammedShortcut();
+
   LayerControllerDelegate *layer_controller_delegate_;
   storage::StorageController *storage_controller_;
 
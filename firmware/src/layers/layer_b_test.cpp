@@ -11,6 +11,7 @@ namespace {
 
 using testing::_;
 using testing::DoAll;
+using testing::Ge;
 using testing::Return;
 using testing::SetArgPointee;
 
@@ -34,6 +35,8 @@ class LayerBTest : public ::testing::Test {
   }
 
   void ExitProgMode() {
+    EXPECT_CALL(storage_controller_mock_, CommitStagedShortcut())
+        .WillOnce(Return(true));
     EXPECT_TRUE(layer_b_.HandleEvent(Keypress::XYZ));
     VerifyLayerLedExpectation();
     EXPECT_EQ(led_state_.GetProg()->state, LedState::OFF);
@@ -49,7 +52,7 @@ class LayerBTest : public ::testing::Test {
 
 TEST_F(LayerBTest, ShortcutIdIncrement) {
   EXPECT_CALL(storage_controller_mock_, GetBlobShortcutLength(1, _))
-      .WillOnce(Return(true));
+      .WillOnce(DoAll(SetArgPointee<1>(0), Return(true)));
   EXPECT_TRUE(layer_b_.HandleEvent(Keypress::X));
   VerifyLayerLedExpectation();
   EXPECT_EQ(led_state_.GetBank0(), 1);
@@ -84,6 +87,30 @@ TEST_F(LayerBTest, ProgKeycodeIncrement) {
   EXPECT_EQ(led_state_.GetBank1(), 0);
 }
 
+TEST_F(LayerBTest, ProgKeycodeAndModcodeRepeat) {
+  EnterProgMode();
+  // Holding X counts up to keycode 0x37 without 55 separate keypresses.
+  EXPECT_TRUE(layer_b_.HandleEvent(Keypress::X));
+  for (int i = 0; i < 0x36; ++i) {
+    EXPECT_TRUE(layer_b_.HandleEvent(Keypress::X_REPEAT));
+  }
+  EXPECT_TRUE(layer_b_.HandleEvent(Keypress::Y_REPEAT));
+  // Repeats of Z don't append to the shortcut.
+  EXPECT_TRUE(layer_b_.HandleEvent(Keypress::Z_REPEAT));
+  VerifyLayerLedExpectation(true);
+  EXPECT_EQ(led_state_.GetBank0(), 0x37);
+  EXPECT_EQ(led_state_.GetBank1(), 1);
+}
+
+TEST_F(LayerBTest, ProgLongPressesDecrementKeycodeAndModcode) {
+  EnterProgMode();
+  EXPECT_TRUE(layer_b_.HandleEvent(Keypress::X_LONG));
+  EXPECT_TRUE(layer_b_.HandleEvent(Keypress::Y_LONG));
+  VerifyLayerLedExpectation(true);
+  EXPECT_EQ(led_state_.GetBank0(), 255);
+  EXPECT_EQ(led_state_.GetBank1(), 255);
+}
+
 TEST_F(LayerBTest, ProgKeycodeClear) {
   EnterProgMode();
   {
@@ -98,6 +125,50 @@ TEST_F(LayerBTest, ProgKeycodeClear) {
   }
 }
 
+TEST_F(LayerBTest, LongPressJumpsToNextProgrammedShortcut) {
+  EXPECT_CALL(storage_controller_mock_, GetBlobShortcutLength(_, _))
+      .WillRepeatedly(DoAll(SetArgPointee<1>(0), Return(true)));
+  EXPECT_CALL(storage_controller_mock_, GetBlobShortcutLength(3, _))
+      .WillRepeatedly(DoAll(SetArgPointee<1>(20), Return(true)));
+  EXPECT_TRUE(layer_b_.HandleEvent(Keypress::X_LONG));
+  VerifyLayerLedExpectation();
+  EXPECT_EQ(led_state_.GetBank0(), 3);
+  EXPECT_EQ(led_state_.GetBank1(), 20);
+}
+
+TEST_F(LayerBTest, LongPressSkipsMissingShortcuts) {
+  // IDs past the last blob shortcut can't be read, so the search wraps around
+  // before them.
+  EXPECT_CALL(storage_controller_mock_, GetBlobShortcutLength(_, _))
+      .WillRepeatedly(DoAll(SetArgPointee<1>(0), Return(true)));
+  EXPECT_CALL(storage_controller_mock_, GetBlobShortcutLength(Ge(248), _))
+      .Times(0);
+  EXPECT_TRUE(layer_b_.HandleEvent(Keypress::X_LONG));
+  VerifyLayerLedExpectation();
+  EXPECT_EQ(led_state_.GetBank0(), 0);
+}
+
+TEST_F(LayerBTest, LongPressFromPastLastShortcutWrapsAround) {
+  EXPECT_CALL(storage_controller_mock_, GetBlobShortcutLength(_, _))
+      .WillRepeatedly(DoAll(SetArgPointee<1>(0), Return(true)));
+  EXPECT_CALL(storage_controller_mock_, GetBlobShortcutLength(Ge(248), _))
+      .WillRepeatedly(Return(false));
+  for (int i = 0; i < 250; i++) {
+    layer_b_.HandleEvent(Keypress::X);
+  }
+  EXPECT_CALL(storage_controller_mock_, GetBlobShortcutLength(2, _))
+      .WillRepeatedly(DoAll(SetArgPointee<1>(5), Return(true)));
+  EXPECT_TRUE(layer_b_.HandleEvent(Keypress::X_LONG));
+  EXPECT_EQ(led_state_.GetBank0(), 2);
+  EXPECT_EQ(led_state_.GetBank1(), 5);
+}
+
+TEST_F(LayerBTest, LongPressFailsOnStorageFailure) {
+  EXPECT_CALL(storage_controller_mock_, GetBlobShortcutLength(1, _))
+      .WillOnce(Return(false));
+  EXPECT_FALSE(layer_b_.HandleEvent(Keypress::X_LONG));
+}
+
 TEST_F(LayerBTest, ProgModcodeIncrement) {
   EXPECT_EQ(led_state_.GetBank1(), 0);
   EnterProgMode();
@@ -164,6 +235,8 @@ TEST_F(LayerBTest, DisplayShortcutLength) {
 
 TEST_F(LayerBTest, ExitProgMode) {
   EnterProgMode();
+  EXPECT_CALL(storage_controller_mock_, CommitStagedShortcut())
+      .WillOnce(Return(true));
   EXPECT_CALL(storage_controller_mock_, GetBlobShortcutLength(0, _))
       .WillOnce(Return(true));
   EXPECT_TRUE(layer_b_.HandleEvent(Keypress::XYZ));
@@ -171,6 +244,13 @@ TEST_F(LayerBTest, ExitProgMode) {
   EXPECT_EQ(led_state_.GetProg()->state, LedState::OFF);
 }
 
+TEST_F(LayerBTest, ExitProgModeFailsOnCommitFailure) {
+  EnterProgMode();
+  EXPECT_CALL(storage_controller_mock_, CommitStagedShortcut())
+      .WillOnce(Return(false));
+  EXPECT_FALSE(layer_b_.HandleEvent(Keypress::XYZ));
+}
+
 TEST_F(LayerBTest, LayerSwitch) {
   EXPECT_CALL(layer_controller_delegate_mock_, SwitchToLayer(LayerId::DFLT))
       .WillOnce(Return(true));
@@ -183,6 +263,23 @@ TEST_F(LayerBTest, LayerSwitchFailure) {
   EXPECT_FALSE(layer_b_.HandleEvent(Keypress::XYZ));
 }
 
+TEST_F(LayerBTest, LongPressSwitchesToDefaultLayer) {
+  EXPECT_CALL(layer_controller_delegate_mock_, SwitchToLayer(LayerId::DFLT))
+      .WillOnce(Return(true));
+  EXPECT_TRUE(layer_b_.HandleEvent(Keypress::Z_LONG));
+}
+
+TEST_F(LayerBTest, ProgLongPressZAppendsCharacter) {
+  EnterProgMode();
+  EXPECT_CALL(storage_controller_mock_, AppendToBlobShortcut(0, 1, 0))
+      .WillOnce(Return(true));
+  EXPECT_CALL(layer_controller_delegate_mock_, SwitchToLayer(_)).Times(0);
+  EXPECT_TRUE(layer_b_.HandleEvent(Keypress::X));
+  EXPECT_TRUE(layer_b_.HandleEvent(Keypress::Z_LONG));
+  VerifyLayerLedExpectation(true);
+  EXPECT_EQ(led_state_.GetErr()->state, LedState::OFF);
+}
+
 TEST_F(LayerBTest, TransitionToLayer) {
   EXPECT_CALL(storage_controller_mock_, GetBlobShortcutLength(0, _))
       .WillOnce(Return(true));
@@ -5,17 +5,30 @@
 namespace threeboard {
 
 bool LayerG::HandleEvent(const Keypress &keypress) {
-  if (keypress == Keypress::X) {
+  if (keypress == Keypress::X || keypress == Keypress::X_REPEAT) {
     if (prog_) {
       key_code_++;
     } else {
       shortcut_id_++;
     }
-  } else if (keypress == Keypress::Y) {
+  } else if (keypress == Keypress::X_LONG) {
+    if (prog_) {
+      key_code_--;
+    } else {
+      RETURN_IF_ERROR(JumpToNextProgrammedShortcut());
+    }
+  } else if (keypress == Keypress::Y || keypress == Keypress::Y_REPEAT) {
     if (!prog_) {
       word_mod_code_++;
     }
-  } else if (keypress == Keypress::Z) {
+  } else if (keypress == Keypress::Y_LONG) {
+    if (!prog_) {
+      word_mod_code_--;
+    }
+  } else if (keypress == Keypress::Z ||
+             (keypress == Keypress::Z_LONG && prog_)) {
+    // Z has no separate long press action in prog mode, so a slow Z still
+    // appends.
     if (prog_) {
       // Append key_code.
       RETURN_IF_ERROR(
@@ -24,6 +37,8 @@ bool LayerG::HandleEvent(const Keypress &keypress) {
       RETURN_IF_ERROR(
           storage_controller_->SendWordShortcut(shortcut_id_, word_mod_code_));
     }
+  } else if (keypress == Keypress::Z_LONG) {
+    return layer_controller_delegate_->SwitchToLayer(LayerId::DFLT);
   } else if (keypress == Keypress::XY) {
     if (!prog_) {
       prog_ = true;
@@ -45,6 +60,8 @@ bool LayerG::HandleEvent(const Keypress &keypress) {
       return layer_controller_delegate_->SwitchToLayer(LayerId::B);
     } else {
       prog_ = false;
+      // Write the characters appended while in prog mode to EEPROM.
+      RETURN_IF_ERROR(storage_controller_->CommitStagedShortcut());
     }
   }
   uint8_t length;
@@ -58,6 +75,20 @@ bool LayerG::HandleEvent(const Keypress &keypress) {
   return true;
 }
 
+bool LayerG::JumpToNextProgrammedShortcut() {
+  // Search every other shortcut in order, wrapping around, and stay on the
+  // current one if none of them are programmed.
+  for (uint8_t id = shortcut_id_ + 1; id != shortcut_id_; ++id) {
+    uint8_t length;
+    RETURN_IF_ERROR(storage_controller_->GetWordShortcutLength(id, &length));
+    if (length > 0) {
+      shortcut_id_ = id;
+      break;
+    }
+  }
+  return true;
+}
+
 bool LayerG::TransitionedToLayer() {
   LOG("Switched to layer G");
   uint8_t length;
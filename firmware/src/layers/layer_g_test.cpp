@@ -36,6 +36,8 @@ class LayerGTest : public ::testing::Test {
   }
 
   void ExitProgMode() {
+    EXPECT_CALL(storage_controller_mock_, CommitStagedShortcut())
+        .WillOnce(Return(true));
     EXPECT_TRUE(layer_g_.HandleEvent(Keypress::XYZ));
     VerifyLayerLedExpectation();
     EXPECT_EQ(led_state_.GetProg()->state, LedState::OFF);
@@ -51,7 +53,7 @@ class LayerGTest : public ::testing::Test {
 
 TEST_F(LayerGTest, ShortcutIdIncrement) {
   EXPECT_CALL(storage_controller_mock_, GetWordShortcutLength(1, _))
-      .WillOnce(Return(true));
+      .WillOnce(DoAll(SetArgPointee<1>(0), Return(true)));
   EXPECT_TRUE(layer_g_.HandleEvent(Keypress::X));
   VerifyLayerLedExpectation();
   EXPECT_EQ(led_state_.GetBank0(), 1);
@@ -86,6 +88,19 @@ TEST_F(LayerGTest, ProgKeycodeIncrement) {
   EXPECT_EQ(led_state_.GetBank0(), 1);
 }
 
+TEST_F(LayerGTest, ProgKeycodeRepeat) {
+  EnterProgMode();
+  EXPECT_CALL(storage_controller_mock_, GetWordShortcutLength(0, _))
+      .Times(3)
+      .WillRepeatedly(Return(true));
+  EXPECT_TRUE(layer_g_.HandleEvent(Keypress::X));
+  EXPECT_TRUE(layer_g_.HandleEvent(Keypress::X_REPEAT));
+  // Repeats of Z don't append to the shortcut.
+  EXPECT_TRUE(layer_g_.HandleEvent(Keypress::Z_REPEAT));
+  VerifyLayerLedExpectation(true);
+  EXPECT_EQ(led_state_.GetBank0(), 2);
+}
+
 TEST_F(LayerGTest, ProgKeycodeClear) {
   EnterProgMode();
   {
@@ -104,9 +119,36 @@ TEST_F(LayerGTest, ProgKeycodeClear) {
   }
 }
 
+TEST_F(LayerGTest, LongPressJumpsToNextProgrammedShortcut) {
+  EXPECT_CALL(storage_controller_mock_, GetWordShortcutLength(_, _))
+      .WillRepeatedly(DoAll(SetArgPointee<1>(0), Return(true)));
+  EXPECT_CALL(storage_controller_mock_, GetWordShortcutLength(7, _))
+      .WillRepeatedly(DoAll(SetArgPointee<1>(3), Return(true)));
+  EXPECT_TRUE(layer_g_.HandleEvent(Keypress::X_LONG));
+  VerifyLayerLedExpectation();
+  EXPECT_EQ(led_state_.GetBank0(), 7);
+  EXPECT_EQ(led_state_.GetBank1(), 3 << 4);
+}
+
+TEST_F(LayerGTest, LongPressesDecrementWordModCodeAndKeycode) {
+  EXPECT_CALL(storage_controller_mock_, GetWordShortcutLength(0, _))
+      .Times(3)
+      .WillRepeatedly(DoAll(SetArgPointee<1>(0), Return(true)));
+  EXPECT_TRUE(layer_g_.HandleEvent(Keypress::Y));
+  EXPECT_TRUE(layer_g_.HandleEvent(Keypress::Y));
+  EXPECT_TRUE(layer_g_.HandleEvent(Keypress::Y_LONG));
+  EXPECT_EQ(led_state_.GetBank1(), 1);
+  EnterProgMode();
+  EXPECT_CALL(storage_controller_mock_, GetWordShortcutLength(0, _))
+      .WillOnce(DoAll(SetArgPointee<1>(0), Return(true)));
+  EXPECT_TRUE(layer_g_.HandleEvent(Keypress::X_LONG));
+  VerifyLayerLedExpectation(true);
+  EXPECT_EQ(led_state_.GetBank0(), 255);
+}
+
 TEST_F(LayerGTest, WordModCodeIncrement) {
   EXPECT_CALL(storage_controller_mock_, GetWordShortcutLength(0, _))
-      .WillOnce(Return(true));
+      .WillOnce(DoAll(SetArgPointee<1>(0), Return(true)));
   EXPECT_TRUE(layer_g_.HandleEvent(Keypress::Y));
   VerifyLayerLedExpectation();
   EXPECT_EQ(led_state_.GetBank0(), 0);
@@ -116,14 +158,14 @@ TEST_F(LayerGTest, WordModCodeIncrement) {
 TEST_F(LayerGTest, WordModCodeClear) {
   {
     EXPECT_CALL(storage_controller_mock_, GetWordShortcutLength(0, _))
-        .WillOnce(Return(true));
+        .WillOnce(DoAll(SetArgPointee<1>(0), Return(true)));
     EXPECT_TRUE(layer_g_.HandleEvent(Keypress::Y));
     VerifyLayerLedExpectation();
     EXPECT_EQ(led_state_.GetBank1(), 1);
   }
   {
     EXPECT_CALL(storage_controller_mock_, GetWordShortcutLength(0, _))
-        .WillOnce(Return(true));
+        .WillOnce(DoAll(SetArgPointee<1>(0), Return(true)));
     EXPECT_TRUE(layer_g_.HandleEvent(Keypress::YZ));
     VerifyLayerLedExpectation();
     EXPECT_EQ(led_state_.GetBank1(), 0);
@@ -180,6 +222,8 @@ TEST_F(LayerGTest, EnterProgMode) {
 
 TEST_F(LayerGTest, ExitProgMode) {
   EnterProgMode();
+  EXPECT_CALL(storage_controller_mock_, CommitStagedShortcut())
+      .WillOnce(Return(true));
   EXPECT_CALL(storage_controller_mock_, GetWordShortcutLength(0, _))
       .WillOnce(Return(true));
   EXPECT_TRUE(layer_g_.HandleEvent(Keypress::XYZ));
@@ -187,6 +231,13 @@ TEST_F(LayerGTest, ExitProgMode) {
   EXPECT_EQ(led_state_.GetProg()->state, LedState::OFF);
 }
 
+TEST_F(LayerGTest, ExitProgModeFailsOnCommitFailure) {
+  EnterProgMode();
+  EXPECT_CALL(storage_controller_mock_, CommitStagedShortcut())
+      .WillOnce(Return(false));
+  EXPECT_FALSE(layer_g_.HandleEvent(Keypress::XYZ));
+}
+
 TEST_F(LayerGTest, LayerSwitch) {
   EXPECT_CALL(layer_controller_delegate_mock_, SwitchToLayer(LayerId::B))
       .WillOnce(Return(true));
@@ -199,6 +250,24 @@ TEST_F(LayerGTest, LayerSwitchFailure) {
   EXPECT_FALSE(layer_g_.HandleEvent(Keypress::XYZ));
 }
 
+TEST_F(LayerGTest, LongPressSwitchesToDefaultLayer) {
+  EXPECT_CALL(layer_controller_delegate_mock_, SwitchToLayer(LayerId::DFLT))
+      .WillOnce(Return(true));
+  EXPECT_TRUE(layer_g_.HandleEvent(Keypress::Z_LONG));
+}
+
+TEST_F(LayerGTest, ProgLongPressZAppendsCharacter) {
+  EnterProgMode();
+  EXPECT_CALL(storage_controller_mock_, GetWordShortcutLength(0, _))
+      .WillOnce(DoAll(SetArgPointee<1>(0), Return(true)));
+  EXPECT_CALL(storage_controller_mock_, AppendToWordShortcut(0, 0))
+      .WillOnce(Return(true));
+  EXPECT_CALL(layer_controller_delegate_mock_, SwitchToLayer(_)).Times(0);
+  EXPECT_TRUE(layer_g_.HandleEvent(Keypress::Z_LONG));
+  VerifyLayerLedExpectation(true);
+  EXPECT_EQ(led_state_.GetErr()->state, LedState::OFF);
+}
+
 TEST_F(LayerGTest, TransitionToLayer) {
   EXPECT_CALL(storage_controller_mock_, GetWordShortcutLength(0, _))
       .WillOnce(Return(true));
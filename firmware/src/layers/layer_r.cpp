@@ -5,27 +5,57 @@
 namespace threeboard {
 
 bool LayerR::HandleEvent(const Keypress &keypress) {
-  if (keypress == Keypress::X) {
-    if (prog_) {
+  // Repeats of X only change the character in SRAM, so that EEPROM isn't
+  // written at the repeat rate. The release of the repeated key isn't an event,
+  // so the character is written by the next keypress, before it can move to
+  // another shortcut or leave prog mode.
+  if (prog_char_changed_ && keypress != Keypress::X_REPEAT) {
+    RETURN_IF_ERROR(storage_controller_->SetCharacterShortcut(
+        shortcut_id_, current_prog_char_));
+    prog_char_changed_ = false;
+  }
+  if (keypress == Keypress::X || keypress == Keypress::X_REPEAT) {
+    if (prog_ && keypress == Keypress::X_REPEAT) {
+      current_prog_char_ += 1;
+      prog_char_changed_ = true;
+    } else if (prog_) {
       RETURN_IF_ERROR(storage_controller_->SetCharacterShortcut(
           shortcut_id_, current_prog_char_ + 1));
       current_prog_char_ += 1;
     } else {
       shortcut_id_++;
     }
-  } else if (keypress == Keypress::Y) {
+  } else if (keypress == Keypress::X_LONG) {
+    if (prog_) {
+      RETURN_IF_ERROR(storage_controller_->SetCharacterShortcut(
+          shortcut_id_, current_prog_char_ - 1));
+      current_prog_char_ -= 1;
+    } else {
+      RETURN_IF_ERROR(JumpToNextProgrammedShortcut());
+    }
+  } else if (keypress == Keypress::Y || keypress == Keypress::Y_REPEAT) {
     if (prog_) {
       shortcut_id_++;
     } else {
       modcode_++;
     }
-  } else if (keypress == Keypress::Z) {
+  } else if (keypress == Keypress::Y_LONG) {
+    if (prog_) {
+      shortcut_id_--;
+    } else {
+      modcode_--;
+    }
+  } else if (keypress == Keypress::Z || keypress == Keypress::Z_REPEAT ||
+             (keypress == Keypress::Z_LONG && prog_)) {
+    // Z has no separate long press action in prog mode, where it does nothing.
     if (!prog_) {
       uint8_t character;
       RETURN_IF_ERROR(
           storage_controller_->GetCharacterShortcut(shortcut_id_, &character));
       SendToHost(character, modcode_);
     }
+  } else if (keypress == Keypress::Z_LONG) {
+    return layer_controller_delegate_->SwitchToLayer(LayerId::DFLT);
   } else if (keypress == Keypress::XY) {
     prog_ = true;
   } else if (keypress == Keypress::XZ) {
@@ -49,10 +79,12 @@ bool LayerR::HandleEvent(const Keypress &keypress) {
     }
   }
   if (prog_) {
-    uint8_t character;
-    RETURN_IF_ERROR(
-        storage_controller_->GetCharacterShortcut(shortcut_id_, &character));
-    current_prog_char_ = character;
+    if (!prog_char_changed_) {
+      uint8_t character;
+      RETURN_IF_ERROR(
+          storage_controller_->GetCharacterShortcut(shortcut_id_, &character));
+      current_prog_char_ = character;
+    }
     UpdateLedState(LayerId::R, current_prog_char_, shortcut_id_);
   } else {
     UpdateLedState(LayerId::R, shortcut_id_, modcode_);
@@ -60,6 +92,20 @@ bool LayerR::HandleEvent(const Keypress &keypress) {
   return true;
 }
 
+bool LayerR::JumpToNextProgrammedShortcut() {
+  // Search every other shortcut in order, wrapping around, and stay on the
+  // current one if none of them are programmed.
+  for (uint8_t id = shortcut_id_ + 1; id != shortcut_id_; ++id) {
+    uint8_t character;
+    RETURN_IF_ERROR(storage_controller_->GetCharacterShortcut(id, &character));
+    if (character != 0) {
+      shortcut_id_ = id;
+      break;
+    }
+  }
+  return true;
+}
+
 bool LayerR::TransitionedToLayer() {
   LOG("Switched to layer R");
   UpdateLedState(LayerId::R, shortcut_id_, modcode_);
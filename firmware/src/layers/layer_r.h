@@ -21,12 +21,18 @@ class LayerR final : public Layer {
   bool TransitionedToLayer() override;
 
  private:
+  // Move to the next shortcut after the current one that has been programmed.
+  bool JumpToNextProgrammedShortcut();
+
   LayerControllerDelegate *layer_controller_delegate_;
   storage::StorageController *storage_controller_;
 
   uint8_t shortcut_id_ = 0;
   uint8_t modcode_ = 0;
   uint8_t current_prog_char_ = 0;
+  // True if current_prog_char_ was changed by repeats and hasn't been written
+  // to storage yet.
+  bool prog_char_changed_ = false;
 };
 
 }  // namespace threeboard
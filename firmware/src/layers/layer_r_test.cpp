@@ -146,6 +146,82 @@ TEST_F(LayerRTest, CurrentProgCharIncrement) {
   VerifyLayerLedExpectation(true);
 }
 
+TEST_F(LayerRTest, RepeatsIncrementShortcutIdAndModcode) {
+  EXPECT_TRUE(layer_r_.HandleEvent(Keypress::X_REPEAT));
+  EXPECT_TRUE(layer_r_.HandleEvent(Keypress::X_REPEAT));
+  EXPECT_TRUE(layer_r_.HandleEvent(Keypress::Y_REPEAT));
+  VerifyLayerLedExpectation();
+  EXPECT_EQ(led_state_.GetBank0(), 2);
+  EXPECT_EQ(led_state_.GetBank1(), 1);
+}
+
+TEST_F(LayerRTest, ProgRepeatsWriteCharacterOnceOnNextKeypress) {
+  EnterProgMode(10);
+  EXPECT_CALL(storage_controller_mock_, SetCharacterShortcut(0, 11))
+      .WillOnce(Return(true));
+  EXPECT_CALL(storage_controller_mock_, GetCharacterShortcut(0, _))
+      .WillOnce(DoAll(SetArgPointee<1>(11), Return(true)));
+  EXPECT_TRUE(layer_r_.HandleEvent(Keypress::X));
+  // Repeats only update the character shown on the LEDs.
+  for (int i = 0; i < 3; i++) {
+    EXPECT_TRUE(layer_r_.HandleEvent(Keypress::X_REPEAT));
+  }
+  VerifyLayerLedExpectation(true);
+  EXPECT_EQ(led_state_.GetBank0(), 14);
+  // The next keypress writes the character before moving to another shortcut.
+  EXPECT_CALL(storage_controller_mock_, SetCharacterShortcut(0, 14))
+      .WillOnce(Return(true));
+  EXPECT_CALL(storage_controller_mock_, GetCharacterShortcut(1, _))
+      .WillOnce(DoAll(SetArgPointee<1>(0), Return(true)));
+  EXPECT_TRUE(layer_r_.HandleEvent(Keypress::Y));
+  EXPECT_EQ(led_state_.GetBank0(), 0);
+  EXPECT_EQ(led_state_.GetBank1(), 1);
+}
+
+TEST_F(LayerRTest, ProgRepeatedCharacterWriteFailure) {
+  EnterProgMode(10);
+  EXPECT_TRUE(layer_r_.HandleEvent(Keypress::X_REPEAT));
+  EXPECT_CALL(storage_controller_mock_, SetCharacterShortcut(0, 11))
+      .WillOnce(Return(false));
+  EXPECT_FALSE(layer_r_.HandleEvent(Keypress::XYZ));
+}
+
+TEST_F(LayerRTest, LongPressJumpsToNextProgrammedShortcut) {
+  EXPECT_CALL(storage_controller_mock_, GetCharacterShortcut(_, _))
+      .WillRepeatedly(DoAll(SetArgPointee<1>(0), Return(true)));
+  EXPECT_CALL(storage_controller_mock_, GetCharacterShortcut(5, _))
+      .WillOnce(DoAll(SetArgPointee<1>(123), Return(true)));
+  EXPECT_TRUE(layer_r_.HandleEvent(Keypress::X_LONG));
+  VerifyLayerLedExpectation();
+  EXPECT_EQ(led_state_.GetBank0(), 5);
+}
+
+TEST_F(LayerRTest, LongPressStaysWithoutProgrammedShortcuts) {
+  EXPECT_CALL(storage_controller_mock_, GetCharacterShortcut(_, _))
+      .Times(255)
+      .WillRepeatedly(DoAll(SetArgPointee<1>(0), Return(true)));
+  EXPECT_TRUE(layer_r_.HandleEvent(Keypress::X_LONG));
+  VerifyLayerLedExpectation();
+  EXPECT_EQ(led_state_.GetBank0(), 0);
+}
+
+TEST_F(LayerRTest, LongPressesDecrementModcodeAndProgValues) {
+  EXPECT_TRUE(layer_r_.HandleEvent(Keypress::Y_LONG));
+  EXPECT_EQ(led_state_.GetBank1(), 255);
+  EnterProgMode(123);
+  EXPECT_CALL(storage_controller_mock_, SetCharacterShortcut(0, 122))
+      .WillOnce(Return(true));
+  EXPECT_CALL(storage_controller_mock_, GetCharacterShortcut(0, _))
+      .WillOnce(DoAll(SetArgPointee<1>(122), Return(true)));
+  EXPECT_TRUE(layer_r_.HandleEvent(Keypress::X_LONG));
+  EXPECT_EQ(led_state_.GetBank0(), 122);
+  EXPECT_CALL(storage_controller_mock_, GetCharacterShortcut(255, _))
+      .WillOnce(Return(true));
+  EXPECT_TRUE(layer_r_.HandleEvent(Keypress::Y_LONG));
+  VerifyLayerLedExpectation(true);
+  EXPECT_EQ(led_state_.GetBank1(), 255);
+}
+
 TEST_F(LayerRTest, ModcodeIncrement) {
   EXPECT_TRUE(layer_r_.HandleEvent(Keypress::Y));
   VerifyLayerLedExpectation();
@@ -220,6 +296,20 @@ TEST_F(LayerRTest, LayerSwitchFailure) {
   EXPECT_FALSE(layer_r_.HandleEvent(Keypress::XYZ));
 }
 
+TEST_F(LayerRTest, LongPressSwitchesToDefaultLayer) {
+  EXPECT_CALL(layer_controller_delegate_mock_, SwitchToLayer(LayerId::DFLT))
+      .WillOnce(Return(true));
+  EXPECT_TRUE(layer_r_.HandleEvent(Keypress::Z_LONG));
+}
+
+TEST_F(LayerRTest, ProgLongPressDoesntSwitchLayer) {
+  EnterProgMode();
+  EXPECT_CALL(storage_controller_mock_, GetCharacterShortcut(0, _))
+      .WillOnce(Return(true));
+  EXPECT_TRUE(layer_r_.HandleEvent(Keypress::Z_LONG));
+  VerifyLayerLedExpectation(true);
+}
+
 TEST_F(LayerRTest, TransitionToLayer) {
   EXPECT_TRUE(layer_r_.TransitionedToLayer());
   VerifyLayerLedExpectation();
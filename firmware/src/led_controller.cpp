@@ -50,6 +50,15 @@ void LedController::UpdateBlinkStatus() {
   }
 }
 
+void LedController::TurnOffAllLeds() {
+  // Clear the STATUS, ERR and row pins, and set the active low column pins.
+  native_->DisablePORTB((1 << native::PB6) | 0b00110000);
+  native_->DisablePORTC(1 << native::PC6);
+  native_->DisablePORTD(0b11010000);
+  native_->EnablePORTF(0b00110011);
+  next_scan_line_ = 0;
+}
+
 void LedController::WriteStateToPins(uint8_t row) {
   // ERR and STATUS are a special case since they're mutually exclusive LEDs.
   // They could be set on each scan, but to maintain consistent brightness
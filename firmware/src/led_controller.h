@@ -23,6 +23,11 @@ class LedController {
   // 5ms.
   virtual void UpdateBlinkStatus();
 
+  // Turn off every LED, without changing the LED state. Used when timer 1 is
+  // stopped, since the row being scanned would otherwise stay lit. Scanning
+  // restarts from the first row when ScanNextLine is next called.
+  virtual void TurnOffAllLeds();
+
   // state_ is guaranteed to live for the entire lifetime of the firmware.
   virtual LedState *GetLedState() { return &state_; }
 
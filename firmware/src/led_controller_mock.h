@@ -10,6 +10,7 @@ class DefaultLedControllerMock : public LedController {
  public:
   MOCK_METHOD(void, ScanNextLine, (), (override));
   MOCK_METHOD(void, UpdateBlinkStatus, (), (override));
+  MOCK_METHOD(void, TurnOffAllLeds, (), (override));
   MOCK_METHOD(LedState*, GetLedState, (), (override));
 };
 }  // namespace detail
@@ -203,5 +203,26 @@ TEST_F(LedControllerTest, TestPulse) {
   RunFullScanWithExpectations(false, _, false);
   ASSERT_EQ(controller_->GetLedState()->GetProg()->state, LedState::OFF);
 }
+TEST_F(LedControllerTest, TurnOffAllLedsRestartsScan) {
+  controller_->GetLedState()->SetStatus(LedState::ON);
+  MockDefaultScanLine(1);
+  EXPECT_CALL(native_mock_, EnablePORTB(1 << native::PB6)).Times(1);
+  EXPECT_CALL(native_mock_, EnablePORTD(1 << native::PD7)).Times(1);
+  controller_->ScanNextLine();
+
+  EXPECT_CALL(native_mock_, DisablePORTB(0b01110000)).Times(1);
+  EXPECT_CALL(native_mock_, DisablePORTC(1 << native::PC6)).Times(1);
+  EXPECT_CALL(native_mock_, DisablePORTD(0b11010000)).Times(1);
+  EXPECT_CALL(native_mock_, EnablePORTF(0b00110011)).Times(1);
+  controller_->TurnOffAllLeds();
+
+  // The LED state is kept, and the next scan is of row 0 again.
+  EXPECT_EQ(controller_->GetLedState()->GetStatus()->state, LedState::ON);
+  MockDefaultScanLine(1);
+  EXPECT_CALL(native_mock_, EnablePORTB(1 << native::PB6)).Times(1);
+  EXPECT_CALL(native_mock_, EnablePORTD(1 << native::PD7)).Times(1);
+  controller_->ScanNextLine();
+}
+
 }  // namespace
 }  // namespace threeboard
@@ -24,6 +24,16 @@ native::Native *Logging::native_;
 // static.
 void Logging::Init(native::Native *native) { native_ = native; }
 
+#ifdef THREEBOARD_USB_CONSOLE
+// static.
+LogHandlerDelegate *Logging::log_handler_delegate_ = nullptr;
+
+// static.
+void Logging::SetLogHandlerDelegate(LogHandlerDelegate *delegate) {
+  log_handler_delegate_ = delegate;
+}
+#endif
+
 void Logging::Log(const char *fmt, ...) {
   va_list va;
   va_start(va, fmt);
@@ -35,6 +45,11 @@ void Logging::Log(const char *fmt, ...) {
     Transmit(native_, buffer[i]);
   }
   Transmit(native_, '\n');
+#ifdef THREEBOARD_USB_CONSOLE
+  if (log_handler_delegate_ != nullptr) {
+    log_handler_delegate_->HandleLogMessage(buffer);
+  }
+#endif
 }
 
 }  // namespace threeboard
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "src/delegates/log_handler_delegate.h"
 #include "src/native/native.h"
 
 // TODO: disable these when not running within the simulator.
@@ -25,16 +26,25 @@ namespace threeboard {
 // This WILL NOT WORK on actual hardware, since it takes advantage of the fact
 // that simavr doesn't care about USART register setup, baud rate specification
 // etc. All simavr needs to receive USART bytes is for the bytes to be written
-// to UDR1 as fast as possible.
+// to UDR1 as fast as possible. On hardware, builds with THREEBOARD_USB_CONSOLE
+// defined also send logs to the host over the USB console.
 class Logging {
  public:
   // Must be called before any logging is performed to set the native
   // instance.
   static void Init(native::Native *native);
 
+#ifdef THREEBOARD_USB_CONSOLE
+  // Set the delegate that receives every log message in addition to UDR1.
+  static void SetLogHandlerDelegate(LogHandlerDelegate *delegate);
+#endif
+
   static void Log(const char *fmt, ...);
 
  private:
   static native::Native *native_;
+#ifdef THREEBOARD_USB_CONSOLE
+  static LogHandlerDelegate *log_handler_delegate_;
+#endif
 };
 }  // namespace threeboard
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 #include <memory>
 
+#include "src/delegates/log_handler_delegate_mock.h"
 #include "src/native/native_mock.h"
 
 using ::testing::Sequence;
@@ -33,5 +34,17 @@ TEST_F(LoggingTest, CorrectlyFormatLogString) {
   SetUartExpectation("Test string: one 1");
   Logging::Log("Test string: %s %d", "one", 1);
 }
+
+#ifdef THREEBOARD_USB_CONSOLE
+TEST_F(LoggingTest, SendLogToDelegate) {
+  LogHandlerDelegateMock delegate_mock;
+  Logging::SetLogHandlerDelegate(&delegate_mock);
+  SetUartExpectation("Test string: 1");
+  EXPECT_CALL(delegate_mock,
+              HandleLogMessage(::testing::StrEq("Test string: 1")));
+  Logging::Log("Test string: %d", 1);
+  Logging::SetLogHandlerDelegate(nullptr);
+}
+#endif
 }  // namespace
 }  // namespace threeboard
\ No newline at end of file
@@ -51,22 +51,34 @@ constexpr uint8_t RWAL = 5;
 
 // UECONX
 constexpr uint8_t EPEN = 0;
+constexpr uint8_t RSTDT = 3;
+constexpr uint8_t STALLRQC = 4;
 constexpr uint8_t STALLRQ = 5;
 
 // UDIEN
+constexpr uint8_t SUSPE = 0;
 constexpr uint8_t SOFE = 2;
 constexpr uint8_t EORSTE = 3;
+constexpr uint8_t WAKEUPE = 4;
 
 // UEIENX
+constexpr uint8_t TXINE = 0;
+constexpr uint8_t RXOUTE = 2;
 constexpr uint8_t RXSTPE = 3;
 
 // UDINT
+constexpr uint8_t SUSPI = 0;
 constexpr uint8_t SOFI = 2;
 constexpr uint8_t EORSTI = 3;
+constexpr uint8_t WAKEUPI = 4;
 
 // UDMFN
 constexpr uint8_t FNCERR = 4;
 
+// UESTA0X
+constexpr uint8_t NBUSYBK0 = 0;
+constexpr uint8_t NBUSYBK1 = 1;
+
 // UHWCON
 constexpr uint8_t UVREGE = 0;
 
@@ -77,6 +89,7 @@ constexpr uint8_t USBE = 7;
 
 // UDCON
 constexpr uint8_t DETACH = 0;
+constexpr uint8_t RMWKUP = 1;
 
 // PLLCSR
 constexpr uint8_t PLOCK = 0;
@@ -97,7 +110,11 @@ constexpr uint8_t TXEN1 = 3;
 constexpr uint8_t UCSZ10 = 1;
 constexpr uint8_t UCSZ11 = 2;
 
+// TIFR3
+constexpr uint8_t OCF3A = 1;
+
 // TWCR
+constexpr uint8_t TWIE = 0;
 constexpr uint8_t TWEN = 2;
 constexpr uint8_t TWSTO = 4;
 constexpr uint8_t TWSTA = 5;
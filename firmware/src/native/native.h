@@ -2,7 +2,10 @@
 
 #include <stdint.h>
 
+#include "src/delegates/eeprom_interrupt_handler_delegate.h"
+#include "src/delegates/pin_change_interrupt_handler_delegate.h"
 #include "src/delegates/timer_interrupt_handler_delegate.h"
+#include "src/delegates/twi_interrupt_handler_delegate.h"
 #include "src/delegates/usb_interrupt_handler_delegate.h"
 #include "src/native/constants.h"
 
@@ -36,23 +39,61 @@ class Native {
       const = 0;
   virtual void SetUsbInterruptHandlerDelegate(
       UsbInterruptHandlerDelegate *) = 0;
+  virtual TwiInterruptHandlerDelegate *GetTwiInterruptHandlerDelegate()
+      const = 0;
+  virtual void SetTwiInterruptHandlerDelegate(
+      TwiInterruptHandlerDelegate *) = 0;
+  virtual EepromInterruptHandlerDelegate *GetEepromInterruptHandlerDelegate()
+      const = 0;
+  virtual void SetEepromInterruptHandlerDelegate(
+      EepromInterruptHandlerDelegate *) = 0;
+  virtual PinChangeInterruptHandlerDelegate *
+  GetPinChangeInterruptHandlerDelegate() const = 0;
+  virtual void SetPinChangeInterruptHandlerDelegate(
+      PinChangeInterruptHandlerDelegate *) = 0;
 
   virtual void EnableInterrupts() = 0;
   virtual void DisableInterrupts() = 0;
   virtual void EnableCpuSleep() = 0;
   virtual void SleepCpu() = 0;
   virtual void DisableCpuSleep() = 0;
+  // Select power-down sleep, in which every clock is stopped. Only external
+  // interrupts (such as pin changes) and the USB wakeup interrupt can wake the
+  // CPU. When disabled, the CPU sleeps in idle mode.
+  virtual void EnablePowerDownSleepMode() = 0;
+  virtual void DisablePowerDownSleepMode() = 0;
 
   virtual void EnableTimer1() = 0;
   virtual void EnableTimer3() = 0;
+  virtual void DisableTimer1() = 0;
+  virtual void DisableTimer3() = 0;
+  // Timer 3's counter, and its interrupt flags. OCF3A is set while its compare
+  // match interrupt is pending.
+  virtual uint16_t GetTCNT3() const = 0;
+  virtual uint8_t GetTIFR3() const = 0;
+
+  // Enable the pin change interrupt for the port B pins in the mask. The
+  // interrupt is handled by the pin change interrupt handler delegate, which
+  // must be set first, and also wakes the CPU from power-down sleep.
+  virtual void EnablePinChangeInterrupt(uint8_t mask) = 0;
+  virtual void DisablePinChangeInterrupt() = 0;
 
   virtual void DelayMs(uint8_t) = 0;
 
   virtual uint16_t ReadPgmWord(const uint8_t *) const = 0;
   virtual uint8_t ReadPgmByte(const uint8_t *) const = 0;
+  // Copy `length` bytes from program memory into the FIFO of the current USB
+  // endpoint.
+  virtual void CopyPgmToUsbFifo(const uint8_t *, uint8_t length) = 0;
 
   virtual void EepromReadByte(const uint16_t &, uint8_t *) const = 0;
-  virtual void EepromWriteByte(const uint16_t &, uint8_t) = 0;
+  // Start writing a byte to internal EEPROM, without waiting for the write to
+  // finish. Must only be called when no other write is in progress.
+  virtual void EepromStartWrite(const uint16_t &, uint8_t) = 0;
+  // The EEPROM ready interrupt fires continuously for as long as it's enabled
+  // and no write is in progress.
+  virtual void EnableEepromReadyInterrupt() = 0;
+  virtual void DisableEepromReadyInterrupt() = 0;
 
   virtual void EnableDDRB(uint8_t) = 0;
   virtual void DisableDDRB(uint8_t) = 0;
@@ -80,6 +121,7 @@ class Native {
   virtual void SetUECONX(uint8_t) = 0;
   virtual void SetUECFG1X(uint8_t) = 0;
   virtual uint8_t GetUDMFN() const = 0;
+  virtual uint8_t GetUESTA0X() const = 0;
   virtual uint8_t GetSREG() const = 0;
   virtual void SetSREG(uint8_t) = 0;
   virtual uint8_t GetUDFNUML() const = 0;
@@ -87,6 +87,26 @@ ISR(USB_GEN_vect) {
 ISR(USB_COM_vect) {
   native_impl->GetUsbInterruptHandlerDelegate()->HandleEndpointInterrupt();
 }
+
+// ISR for the TWI module. This can only fire once a transfer has been started
+// with TWIE set, which happens after the delegate has been set.
+ISR(TWI_vect) {
+  native_impl->GetTwiInterruptHandlerDelegate()->HandleTwiInterrupt();
+}
+
+// ISR for pin changes on port B. This is only enabled by the KeyController,
+// which sets itself as the delegate when it's constructed.
+ISR(PCINT0_vect) {
+  native_impl->GetPinChangeInterruptHandlerDelegate()
+      ->HandlePinChangeInterrupt();
+}
+
+// ISR for the internal EEPROM. This is only enabled while there are queued
+// writes, which happens after the delegate has been set.
+ISR(EE_READY_vect) {
+  native_impl->GetEepromInterruptHandlerDelegate()
+      ->HandleEepromReadyInterrupt();
+}
 }  // namespace
 
 NativeImpl::NativeImpl() { native_impl = this; }
@@ -111,6 +131,36 @@ void NativeImpl::SetUsbInterruptHandlerDelegate(
   usb_delegate_ = delegate;
 }
 
+TwiInterruptHandlerDelegate *NativeImpl::GetTwiInterruptHandlerDelegate()
+    const {
+  return twi_delegate_;
+}
+
+void NativeImpl::SetTwiInterruptHandlerDelegate(
+    TwiInterruptHandlerDelegate *delegate) {
+  twi_delegate_ = delegate;
+}
+
+EepromInterruptHandlerDelegate *NativeImpl::GetEepromInterruptHandlerDelegate()
+    const {
+  return eeprom_delegate_;
+}
+
+void NativeImpl::SetEepromInterruptHandlerDelegate(
+    EepromInterruptHandlerDelegate *delegate) {
+  eeprom_delegate_ = delegate;
+}
+
+PinChangeInterruptHandlerDelegate *
+NativeImpl::GetPinChangeInterruptHandlerDelegate() const {
+  return pin_change_delegate_;
+}
+
+void NativeImpl::SetPinChangeInterruptHandlerDelegate(
+    PinChangeInterruptHandlerDelegate *delegate) {
+  pin_change_delegate_ = delegate;
+}
+
 void NativeImpl::EnableInterrupts() { sei(); }
 
 void NativeImpl::DisableInterrupts() { cli(); }
@@ -121,10 +171,46 @@ void NativeImpl::SleepCpu() { sleep_cpu(); }
 
 void NativeImpl::DisableCpuSleep() { sleep_disable(); }
 
+void NativeImpl::EnablePowerDownSleepMode() {
+  set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+}
+
+void NativeImpl::DisablePowerDownSleepMode() {
+  set_sleep_mode(SLEEP_MODE_IDLE);
+}
+
 void NativeImpl::EnableTimer1() { Timer1Init(); }
 
 void NativeImpl::EnableTimer3() { Timer3Init(); }
 
+void NativeImpl::DisableTimer1() {
+  // Stop the timer's clock as well as its interrupt. EnableTimer1 restarts it
+  // from zero.
+  TIMSK1 &= ~(1 << OCIE1A);
+  TCCR1B = 0;
+}
+
+void NativeImpl::DisableTimer3() {
+  TIMSK3 &= ~(1 << OCIE3A);
+  TCCR3B = 0;
+}
+
+uint16_t NativeImpl::GetTCNT3() const { return TCNT3; }
+
+uint8_t NativeImpl::GetTIFR3() const { return TIFR3; }
+
+void NativeImpl::EnablePinChangeInterrupt(uint8_t mask) {
+  PCMSK0 = mask;
+  // Clear any pin change that happened before the interrupt was enabled.
+  PCIFR = (1 << PCIF0);
+  PCICR |= (1 << PCIE0);
+}
+
+void NativeImpl::DisablePinChangeInterrupt() {
+  PCICR &= ~(1 << PCIE0);
+  PCMSK0 = 0;
+}
+
 void NativeImpl::DelayMs(uint8_t ms) { _delay_ms(ms); }
 
 uint16_t NativeImpl::ReadPgmWord(const uint8_t *ptr) const {
@@ -135,15 +221,34 @@ uint8_t NativeImpl::ReadPgmByte(const uint8_t *ptr) const {
   return pgm_read_byte(ptr);
 }
 
+void NativeImpl::CopyPgmToUsbFifo(const uint8_t *ptr, uint8_t length) {
+  while (length--) {
+    UEDATX = pgm_read_byte(ptr++);
+  }
+}
+
 void NativeImpl::EepromReadByte(const uint16_t &byte_offset,
                                 uint8_t *data) const {
   eeprom_read_block(data, (void *)byte_offset, 1);
 }
 
-void NativeImpl::EepromWriteByte(const uint16_t &byte_offset, uint8_t data) {
-  eeprom_write_block(&data, (void *)byte_offset, 1);
+void NativeImpl::EepromStartWrite(const uint16_t &byte_offset, uint8_t data) {
+  EEAR = byte_offset;
+  EEDR = data;
+  // EEPE must be set within four clock cycles of setting EEMPE, so make sure
+  // no interrupt can run in between. The write then continues in the
+  // background for ~3.4ms.
+  uint8_t sreg = SREG;
+  cli();
+  EECR |= (1 << EEMPE);
+  EECR |= (1 << EEPE);
+  SREG = sreg;
 }
 
+void NativeImpl::EnableEepromReadyInterrupt() { EECR |= (1 << EERIE); }
+
+void NativeImpl::DisableEepromReadyInterrupt() { EECR &= ~(1 << EERIE); }
+
 void NativeImpl::EnableDDRB(const uint8_t val) { DDRB |= val; }
 void NativeImpl::DisableDDRB(const uint8_t val) { DDRB &= ~val; }
 void NativeImpl::EnableDDRC(const uint8_t val) { DDRC |= val; }
@@ -171,6 +276,7 @@ uint8_t NativeImpl::GetUDINT() const { return UDINT; }
 void NativeImpl::SetUECONX(const uint8_t val) { UECONX = val; }
 void NativeImpl::SetUECFG1X(const uint8_t val) { UECFG1X = val; }
 uint8_t NativeImpl::GetUDMFN() const { return UDMFN; }
+uint8_t NativeImpl::GetUESTA0X() const { return UESTA0X; }
 uint8_t NativeImpl::GetSREG() const { return SREG; }
 void NativeImpl::SetSREG(const uint8_t val) { SREG = val; }
 uint8_t NativeImpl::GetUDFNUML() const { return UDFNUML; }
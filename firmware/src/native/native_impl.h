@@ -25,23 +25,45 @@ class NativeImpl final : public Native {
       TimerInterruptHandlerDelegate *) override;
   UsbInterruptHandlerDelegate *GetUsbInterruptHandlerDelegate() const override;
   void SetUsbInterruptHandlerDelegate(UsbInterruptHandlerDelegate *) override;
+  TwiInterruptHandlerDelegate *GetTwiInterruptHandlerDelegate() const override;
+  void SetTwiInterruptHandlerDelegate(TwiInterruptHandlerDelegate *) override;
+  EepromInterruptHandlerDelegate *GetEepromInterruptHandlerDelegate()
+      const override;
+  void SetEepromInterruptHandlerDelegate(
+      EepromInterruptHandlerDelegate *) override;
+  PinChangeInterruptHandlerDelegate *GetPinChangeInterruptHandlerDelegate()
+      const override;
+  void SetPinChangeInterruptHandlerDelegate(
+      PinChangeInterruptHandlerDelegate *) override;
 
   void EnableInterrupts() override;
   void DisableInterrupts() override;
   void EnableCpuSleep() override;
   void SleepCpu() override;
   void DisableCpuSleep() override;
+  void EnablePowerDownSleepMode() override;
+  void DisablePowerDownSleepMode() override;
 
   void EnableTimer1() override;
   void EnableTimer3() override;
+  void DisableTimer1() override;
+  void DisableTimer3() override;
+  uint16_t GetTCNT3() const override;
+  uint8_t GetTIFR3() const override;
+
+  void EnablePinChangeInterrupt(uint8_t mask) override;
+  void DisablePinChangeInterrupt() override;
 
   void DelayMs(uint8_t) override;
 
   uint16_t ReadPgmWord(const uint8_t *) const override;
   uint8_t ReadPgmByte(const uint8_t *) const override;
+  void CopyPgmToUsbFifo(const uint8_t *, uint8_t length) override;
 
   void EepromReadByte(const uint16_t &, uint8_t *) const override;
-  void EepromWriteByte(const uint16_t &, uint8_t) override;
+  void EepromStartWrite(const uint16_t &, uint8_t) override;
+  void EnableEepromReadyInterrupt() override;
+  void DisableEepromReadyInterrupt() override;
 
   void EnableDDRB(uint8_t) override;
   void DisableDDRB(uint8_t) override;
@@ -69,6 +91,7 @@ class NativeImpl final : public Native {
   void SetUECONX(uint8_t) override;
   void SetUECFG1X(uint8_t) override;
   uint8_t GetUDMFN() const override;
+  uint8_t GetUESTA0X() const override;
   uint8_t GetSREG() const override;
   void SetSREG(uint8_t) override;
   uint8_t GetUDFNUML() const override;
@@ -102,6 +125,9 @@ class NativeImpl final : public Native {
  private:
   TimerInterruptHandlerDelegate *timer_delegate_;
   UsbInterruptHandlerDelegate *usb_delegate_;
+  TwiInterruptHandlerDelegate *twi_delegate_;
+  EepromInterruptHandlerDelegate *eeprom_delegate_;
+  PinChangeInterruptHandlerDelegate *pin_change_delegate_;
 };
 
 }  // namespace native
@@ -17,6 +17,18 @@ class DefaultNativeMock : public Native {
               (const override));
   MOCK_METHOD(void, SetUsbInterruptHandlerDelegate,
               (UsbInterruptHandlerDelegate *), (override));
+  MOCK_METHOD(TwiInterruptHandlerDelegate *, GetTwiInterruptHandlerDelegate, (),
+              (const override));
+  MOCK_METHOD(void, SetTwiInterruptHandlerDelegate,
+              (TwiInterruptHandlerDelegate *), (override));
+  MOCK_METHOD(EepromInterruptHandlerDelegate *,
+              GetEepromInterruptHandlerDelegate, (), (const override));
+  MOCK_METHOD(void, SetEepromInterruptHandlerDelegate,
+              (EepromInterruptHandlerDelegate *), (override));
+  MOCK_METHOD(PinChangeInterruptHandlerDelegate *,
+              GetPinChangeInterruptHandlerDelegate, (), (const override));
+  MOCK_METHOD(void, SetPinChangeInterruptHandlerDelegate,
+              (PinChangeInterruptHandlerDelegate *), (override));
 
   MOCK_METHOD(void, EnableInterrupts, (), (override));
   MOCK_METHOD(void, DisableInterrupts, (), (override));
@@ -24,8 +36,16 @@ class DefaultNativeMock : public Native {
   MOCK_METHOD(void, SleepCpu, (), (override));
   MOCK_METHOD(void, DisableCpuSleep, (), (override));
 
+  MOCK_METHOD(void, EnablePowerDownSleepMode, (), (override));
+  MOCK_METHOD(void, DisablePowerDownSleepMode, (), (override));
   MOCK_METHOD(void, EnableTimer1, (), (override));
   MOCK_METHOD(void, EnableTimer3, (), (override));
+  MOCK_METHOD(void, DisableTimer1, (), (override));
+  MOCK_METHOD(void, DisableTimer3, (), (override));
+  MOCK_METHOD(uint16_t, GetTCNT3, (), (const, override));
+  MOCK_METHOD(uint8_t, GetTIFR3, (), (const, override));
+  MOCK_METHOD(void, EnablePinChangeInterrupt, (uint8_t), (override));
+  MOCK_METHOD(void, DisablePinChangeInterrupt, (), (override));
 
   MOCK_METHOD(void, DelayMs, (uint8_t), (override));
 
@@ -35,10 +55,17 @@ class DefaultNativeMock : public Native {
     return *ptr + (*(ptr + 1) << 8);
   }
   uint8_t ReadPgmByte(const uint8_t *ptr) const override { return *ptr; }
+  void CopyPgmToUsbFifo(const uint8_t *ptr, uint8_t length) override {
+    while (length--) {
+      SetUEDATX(*ptr++);
+    }
+  }
 
   MOCK_METHOD(void, EepromReadByte, (const uint16_t &, uint8_t *),
               (const override));
-  MOCK_METHOD(void, EepromWriteByte, (const uint16_t &, uint8_t), (override));
+  MOCK_METHOD(void, EepromStartWrite, (const uint16_t &, uint8_t), (override));
+  MOCK_METHOD(void, EnableEepromReadyInterrupt, (), (override));
+  MOCK_METHOD(void, DisableEepromReadyInterrupt, (), (override));
 
   MOCK_METHOD(void, EnableDDRB, (const uint8_t), (override));
   MOCK_METHOD(void, DisableDDRB, (const uint8_t), (override));
@@ -70,6 +97,7 @@ class DefaultNativeMock : public Native {
   MOCK_METHOD(uint8_t, GetUECFG0X, (), (const override));
   MOCK_METHOD(void, SetUECFG1X, (const uint8_t), (override));
   MOCK_METHOD(uint8_t, GetUDMFN, (), (const override));
+  MOCK_METHOD(uint8_t, GetUESTA0X, (), (const override));
   MOCK_METHOD(uint8_t, GetSREG, (), (const override));
   MOCK_METHOD(void, SetSREG, (const uint8_t), (override));
   MOCK_METHOD(uint8_t, GetUDFNUML, (), (const override));
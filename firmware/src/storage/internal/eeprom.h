@@ -10,7 +10,14 @@ class Eeprom {
   virtual ~Eeprom() = default;
 
   virtual bool ReadByte(const uint16_t &byte_offset, uint8_t *data) = 0;
+  // Read `length` consecutive bytes starting at `byte_offset` into `data`.
+  virtual bool ReadBytes(const uint16_t &byte_offset, uint8_t *data,
+                         uint16_t length) = 0;
   virtual bool WriteByte(const uint16_t &byte_offset, uint8_t data) = 0;
+  // Write `length` bytes from `data` to consecutive addresses starting at
+  // `byte_offset`.
+  virtual bool WriteBytes(const uint16_t &byte_offset, const uint8_t *data,
+                          uint16_t length) = 0;
 };
 
 }  // namespace storage
@@ -9,7 +9,11 @@ namespace storage {
 class EepromMockDefault : public Eeprom {
  public:
   MOCK_METHOD(bool, ReadByte, (const uint16_t &, uint8_t *), (override));
+  MOCK_METHOD(bool, ReadBytes, (const uint16_t &, uint8_t *, uint16_t),
+              (override));
   MOCK_METHOD(bool, WriteByte, (const uint16_t &, uint8_t), (override));
+  MOCK_METHOD(bool, WriteBytes, (const uint16_t &, const uint8_t *, uint16_t),
+              (override));
 };
 
 using EepromMock = ::testing::StrictMock<EepromMockDefault>;
@@ -1,129 +1,96 @@
 #include "i2c_eeprom.h"
 
-#include "src/logging.h"
 #include "src/util/util.h"
 
 namespace threeboard {
 namespace storage {
 namespace {
 
-constexpr uint8_t kWriteBit = 0;
-constexpr uint8_t kReadBit = 1;
+// The 24LC512 page write buffer size. See the 24LC512 data sheet, section 6.2.
+constexpr uint8_t kPageSize = 128;
 
-uint8_t CreateControlByte(I2cEeprom::Device device, uint8_t operation) {
-  return 0b10100000 | ((device & 7) << 1) | (operation & 1);
-}
+// The maximum number of control bytes sent while acknowledge polling. Each
+// attempt takes roughly 100us at a 100kHz SCL frequency, so this comfortably
+// exceeds the 5ms maximum write cycle time.
+constexpr uint8_t kMaxAckPollAttempts = 100;
 
 }  // namespace
 
-I2cEeprom::I2cEeprom(native::Native *native, Device device)
-    : native_(native), device_(device) {}
+I2cEeprom::I2cEeprom(TwiController *twi_controller, Device device)
+    : twi_controller_(twi_controller),
+      device_(device),
+      prev_address_(0),
+      is_prev_address_valid_(false),
+      is_write_cycle_pending_(false) {}
 
 bool I2cEeprom::ReadByte(const uint16_t &byte_offset, uint8_t *data) {
-  RETURN_IF_ERROR(StartAndAddress(kReadBit, byte_offset), Stop());
-  *data = ReadByte(true) + 1;
-  Stop();
-  return true;
-}
-
-bool I2cEeprom::WriteByte(const uint16_t &byte_offset, uint8_t data) {
-  data = data - 1;
-  RETURN_IF_ERROR(StartAndAddress(kWriteBit, byte_offset));
-  RETURN_IF_ERROR(WriteByteAndAck(data));
-  Stop();
-  return true;
+  return ReadBytes(byte_offset, data, 1);
 }
 
-bool I2cEeprom::Start(uint8_t operation) {
-  // Send START and wait for it to complete.
-  native_->SetTWCR((1 << native::TWINT) | (1 << native::TWSTA) |
-                   (1 << native::TWEN));
-  while (!(native_->GetTWCR() & (1 << native::TWINT)))
-    ;
-
-  // Verify that the start condition is acknowledged. For repeated start
-  // (REP_START) the ack from the EEPROM is the same, but the AVR TWI module
-  // generates a different status code to indicate ack-ing of a repeated start,
-  // so we need to check both here.
-  if (GetStatusBits() != native::TW_START &&
-      GetStatusBits() != native::TW_REP_START) {
-    return false;
+bool I2cEeprom::ReadBytes(const uint16_t &byte_offset, uint8_t *data,
+                          uint16_t length) {
+  if (length == 0) {
+    return true;
   }
-
-  // The control byte consists of: A 4 bit control code, 3 bit chip select code
-  // (determined by the EEPROM's wiring), and 1 bit read=1/write=0. This will
-  // clear the previously set TWSTA, so we don't need to explicitly clear it
-  // here.
-  RETURN_IF_ERROR(WriteByteAndAck(CreateControlByte(device_, operation)));
+  // If the device's address counter already points at byte_offset then we only
+  // need to send a read control byte to continue reading from it.
+  bool is_current_address =
+      is_prev_address_valid_ && prev_address_ == byte_offset;
+  // A failed transaction leaves the device's address counter in an unknown
+  // state, so it's only considered valid again once this read completes.
+  is_prev_address_valid_ = false;
+  RETURN_IF_ERROR(
+      Execute(true, !is_current_address, byte_offset, data, length));
+  prev_address_ = byte_offset + length;
+  is_prev_address_valid_ = true;
   return true;
 }
 
-bool I2cEeprom::StartAndAddress(uint8_t operation, uint16_t byte_offset) {
-  // Execute the EEPROM device addressing sequence. See the 24LC512 data sheet,
-  // section 5.0 for full details. In summary, the control and addressing
-  // sequence involves sending three bytes to the slave device:
-  // |-- control byte --| |-- address high byte --| |-- address low byte --|
-  //
-  // The address word must always be sent as a write operation. This means that
-  // for random reads, two control bytes must be sent; the first triggers a
-  // write operation before the two address bytes are sent, then the second
-  // control byte is sent to start the read operation.
-  RETURN_IF_ERROR(Start(kWriteBit));
-
-  // The next two bytes are the byte offset (address) of the first data byte
-  // to be written/read in this operation. The high byte is sent first.
-  RETURN_IF_ERROR(WriteByteAndAck(byte_offset >> 8));
-  RETURN_IF_ERROR(WriteByteAndAck(byte_offset));
-
-  // If we're starting a read operation, we need to send another control byte to
-  // set the device to read mode. For write operations this is not needed, as
-  // the address low byte can immediately be followed by data to write.
-  if (operation == kReadBit) {
-    RETURN_IF_ERROR(Start(kReadBit));
-  }
-  return true;
-}
-
-void I2cEeprom::Stop() {
-  // Send STOP and wait for it to complete.
-  native_->SetTWCR((1 << native::TWINT) | (1 << native::TWEN) |
-                   (1 << native::TWSTO));
-  while (native_->GetTWCR() & (1 << native::TWSTO))
-    ;
-}
-
-uint8_t I2cEeprom::GetStatusBits() {
-  // Mask out non-status bits of the TWI status register.
-  return native_->GetTWSR() & 0xF8;
+bool I2cEeprom::WriteByte(const uint16_t &byte_offset, uint8_t data) {
+  return WriteBytes(byte_offset, &data, 1);
 }
 
-bool I2cEeprom::WriteByteAndAck(uint8_t data) {
-  WriteByte(data);
-  auto status_bits = GetStatusBits();
-  if (status_bits != native::TW_MT_SLA_ACK &&
-      status_bits != native::TW_MR_SLA_ACK) {
-    LOG("I2cEeprom::WriteByteAndAck: fail status: %d", status_bits);
-    return false;
+bool I2cEeprom::WriteBytes(const uint16_t &byte_offset, const uint8_t *data,
+                           uint16_t length) {
+  // The device's address counter is left pointing into the written page, which
+  // we don't track, so the next read must be fully addressed.
+  is_prev_address_valid_ = false;
+  uint16_t i = 0;
+  while (i < length) {
+    // A page write that runs past the end of a page wraps around and
+    // overwrites the start of that same page, so each page needs its own
+    // transaction.
+    uint16_t address = byte_offset + i;
+    uint16_t page_length =
+        util::min(length - i, kPageSize - (address % kPageSize));
+    // The TwiController only reads from the buffer of a write transaction.
+    bool status = Execute(false, true, address, const_cast<uint8_t *>(data + i),
+                          page_length);
+    // Even a failed write may have started a write cycle if any data bytes
+    // were sent before the failure.
+    is_write_cycle_pending_ = true;
+    RETURN_IF_ERROR(status);
+    i += page_length;
   }
   return true;
 }
 
-void I2cEeprom::WriteByte(uint8_t data) {
-  native_->SetTWDR(data);
-  native_->SetTWCR((1 << native::TWINT) | (1 << native::TWEN));
-  while (!(native_->GetTWCR() & (1 << native::TWINT)))
-    ;
-}
-
-uint8_t I2cEeprom::ReadByte(bool is_final_byte) {
-  uint8_t twcr = (1 << native::TWINT) | (1 << native::TWEN);
-  if (!is_final_byte) {
-    twcr |= (1 << native::TWEA);
-  }
-  native_->SetTWCR(twcr);
-  while (!(native_->GetTWCR() & (1 << native::TWINT)))
-    ;
-  return native_->GetTWDR();
+bool I2cEeprom::Execute(bool is_read, bool send_address, uint16_t byte_offset,
+                        uint8_t *data, uint16_t length) {
+  TwiTransaction transaction;
+  transaction.device = device_;
+  transaction.is_read = is_read;
+  transaction.send_address = send_address;
+  transaction.address = byte_offset;
+  transaction.data = data;
+  transaction.length = length;
+  transaction.max_start_attempts =
+      is_write_cycle_pending_ ? kMaxAckPollAttempts : 1;
+  RETURN_IF_ERROR(twi_controller_->Submit(&transaction));
+  RETURN_IF_ERROR(twi_controller_->AwaitCompletion(&transaction));
+  // The device acknowledged its control byte, so any write cycle has finished.
+  is_write_cycle_pending_ = false;
+  return true;
 }
 }  // namespace storage
 }  // namespace threeboard
@@ -1,13 +1,15 @@
 #pragma once
 
-#include "src/native/native.h"
 #include "src/storage/internal/eeprom.h"
+#include "src/storage/internal/twi_controller.h"
 
 namespace threeboard {
 namespace storage {
 
 // An implementation of the Eeprom interface that interacts with external EEPROM
-// devices using the I2C protocol.
+// devices using the I2C protocol. Transfers are executed asynchronously by the
+// TwiController, but every method still blocks its caller until its transfers
+// are complete. The CPU sleeps (servicing other interrupts) while it waits.
 class I2cEeprom final : public Eeprom {
  public:
   enum Device {
@@ -15,32 +17,52 @@ class I2cEeprom final : public Eeprom {
     EEPROM_1 = 1,
   };
 
-  I2cEeprom(native::Native *native, Device device);
+  I2cEeprom(TwiController *twi_controller, Device device);
 
-  // Perform either a random or sequential read as defined by the the 24LC512
-  // data sheet, section 8.3.
+  // Read a single byte. This is a one-byte ReadBytes.
   bool ReadByte(const uint16_t &byte_offset, uint8_t *data) override;
 
-  // Perform a page write as defined by the 24LC512 data sheet, section 6.2.
+  // Perform a sequential read as defined by the 24LC512 data sheet, section
+  // 8.3. The device is addressed once, and then clocks out `length` bytes in a
+  // single transaction. If `byte_offset` is where the device's internal address
+  // counter was left by the previous read, the address word is skipped and a
+  // current address read (section 8.1) is performed instead, so consecutive
+  // calls stream through memory without re-addressing the device.
+  bool ReadBytes(const uint16_t &byte_offset, uint8_t *data,
+                 uint16_t length) override;
+
+  // Write a single byte. This is a one-byte WriteBytes.
   bool WriteByte(const uint16_t &byte_offset, uint8_t data) override;
 
+  // Perform page writes as defined by the 24LC512 data sheet, section 6.2. The
+  // data is split at 128-byte page boundaries, and each page is written in a
+  // single transaction and a single internal write cycle. This returns as soon
+  // as the final write cycle has been started, without waiting for it to
+  // complete.
+  bool WriteBytes(const uint16_t &byte_offset, const uint8_t *data,
+                  uint16_t length) override;
+
  private:
-  native::Native *native_;
+  // Submit a transaction for this device to the TwiController and wait for it
+  // to complete.
+  bool Execute(bool is_read, bool send_address, uint16_t byte_offset,
+               uint8_t *data, uint16_t length);
+
+  TwiController *twi_controller_;
   Device device_;
 
   // The 24LC512 stores the last address read from or written to. When
   // performing sequential reads we can avoid sending the address word by
-  // checking this address first.
+  // checking this address first. This is only valid when
+  // is_prev_address_valid_ is true, which is the case after a successful read.
   uint16_t prev_address_;
+  bool is_prev_address_valid_;
 
-  bool Start(uint8_t operation);
-  bool StartAndAddress(uint8_t operation, uint16_t byte_offset);
-  void Stop();
-  uint8_t GetStatusBits();
-
-  bool WriteByteAndAck(uint8_t data);
-  void WriteByte(uint8_t data);
-  uint8_t ReadByte(bool is_final_byte);
+  // Whether a page write has been sent since the device was last seen to
+  // acknowledge its control byte, meaning it may still be busy with its
+  // internal write cycle. If so, the next transaction acknowledge polls the
+  // device as defined by the 24LC512 data sheet, section 7.0.
+  bool is_write_cycle_pending_;
 };
 }  // namespace storage
 }  // namespace threeboard
@@ -5,18 +5,116 @@
 namespace threeboard {
 namespace storage {
 
-InternalEeprom::InternalEeprom(native::Native *native) : native_(native) {}
+InternalEeprom::InternalEeprom(native::Native *native)
+    : native_(native), queue_head_(0), queue_length_(0), is_busy_(false) {}
 
 bool InternalEeprom::ReadByte(const uint16_t &byte_offset, uint8_t *data) {
+  // The queue is shared with the interrupt handler, so search it atomically.
+  uint8_t sreg = native_->GetSREG();
+  native_->DisableInterrupts();
+  for (uint8_t i = 0; i < queue_length_; ++i) {
+    const PendingWrite &write = queue_[(queue_head_ + i) % kQueueSize];
+    if (write.byte_offset == byte_offset) {
+      *data = write.data + 1;
+      native_->SetSREG(sreg);
+      return true;
+    }
+  }
+  native_->SetSREG(sreg);
+  // If a write to this byte has already been started, the read waits for it
+  // to finish and then returns the new value.
   native_->EepromReadByte(byte_offset, data);
   *data = *data + 1;
   return true;
 }
 
+bool InternalEeprom::ReadBytes(const uint16_t &byte_offset, uint8_t *data,
+                               uint16_t length) {
+  for (uint16_t i = 0; i < length; ++i) {
+    RETURN_IF_ERROR(ReadByte(byte_offset + i, data + i));
+  }
+  return true;
+}
+
 bool InternalEeprom::WriteByte(const uint16_t &byte_offset, uint8_t data) {
-  native_->EepromWriteByte(byte_offset, data - 1);
+  data = data - 1;
+  uint8_t sreg = native_->GetSREG();
+  native_->DisableInterrupts();
+  if (!is_busy_) {
+    // With no write in progress the queue is empty, so the stored value is the
+    // latest one, and it can be read without waiting.
+    uint8_t current;
+    native_->EepromReadByte(byte_offset, &current);
+    if (current == data) {
+      native_->SetSREG(sreg);
+      return true;
+    }
+  }
+  // Replace any queued write to the same byte rather than writing it twice.
+  for (uint8_t i = 0; i < queue_length_; ++i) {
+    PendingWrite &write = queue_[(queue_head_ + i) % kQueueSize];
+    if (write.byte_offset == byte_offset) {
+      write.data = data;
+      native_->SetSREG(sreg);
+      return true;
+    }
+  }
+  // The interrupt handler only removes writes from the queue, so there's no
+  // need to search it again once there's space.
+  while (queue_length_ == kQueueSize) {
+    AwaitInterrupt();
+  }
+  queue_[(queue_head_ + queue_length_) % kQueueSize] = {byte_offset, data};
+  queue_length_++;
+  is_busy_ = true;
+  native_->EnableEepromReadyInterrupt();
+  native_->SetSREG(sreg);
+  return true;
+}
+
+bool InternalEeprom::WriteBytes(const uint16_t &byte_offset,
+                                const uint8_t *data, uint16_t length) {
+  for (uint16_t i = 0; i < length; ++i) {
+    RETURN_IF_ERROR(WriteByte(byte_offset + i, data[i]));
+  }
   return true;
 }
 
+void InternalEeprom::Flush() {
+  uint8_t sreg = native_->GetSREG();
+  native_->DisableInterrupts();
+  while (is_busy_) {
+    AwaitInterrupt();
+  }
+  native_->SetSREG(sreg);
+}
+
+void InternalEeprom::HandleEepromReadyInterrupt() {
+  while (queue_length_ > 0) {
+    PendingWrite write = queue_[queue_head_];
+    queue_head_ = (queue_head_ + 1) % kQueueSize;
+    queue_length_--;
+    // Update semantics: only spend a write cycle on bytes that change.
+    uint8_t current;
+    native_->EepromReadByte(write.byte_offset, &current);
+    if (current != write.data) {
+      native_->EepromStartWrite(write.byte_offset, write.data);
+      return;
+    }
+  }
+  native_->DisableEepromReadyInterrupt();
+  is_busy_ = false;
+}
+
+void InternalEeprom::AwaitInterrupt() {
+  // Enabling interrupts immediately before sleeping guarantees that the
+  // interrupt can't fire in between.
+  native_->EnableCpuSleep();
+  native_->EnableInterrupts();
+  native_->SleepCpu();
+  native_->DisableCpuSleep();
+  native_->DisableInterrupts();
+}
+
 }  // namespace storage
 }  // namespace threeboard
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "src/delegates/eeprom_interrupt_handler_delegate.h"
 #include "src/native/native.h"
 #include "src/storage/internal/eeprom.h"
 
@@ -8,16 +9,55 @@ namespace storage {
 
 // An implementation of the Eeprom interface that interacts with the small
 // internal EEPROM within the atmega32u4 MCU.
-class InternalEeprom final : public Eeprom {
+//
+// Each byte written to internal EEPROM takes ~3.4ms, so writes don't block.
+// Instead they're added to a small queue which is drained in the background by
+// the EEPROM ready interrupt, one byte at a time. Writes of a value that's
+// already stored are skipped, and reads see the value of any queued write to
+// the same byte.
+class InternalEeprom final : public Eeprom,
+                             public EepromInterruptHandlerDelegate {
  public:
   explicit InternalEeprom(native::Native *native);
 
   bool ReadByte(const uint16_t &byte_offset, uint8_t *data) override;
+  bool ReadBytes(const uint16_t &byte_offset, uint8_t *data,
+                 uint16_t length) override;
   bool WriteByte(const uint16_t &byte_offset, uint8_t data) override;
+  bool WriteBytes(const uint16_t &byte_offset, const uint8_t *data,
+                  uint16_t length) override;
+
+  // Sleep until all queued writes have been committed to EEPROM.
+  void Flush();
+
+  // Start the next queued write that changes the stored value, or disable the
+  // interrupt if there are none left.
+  void HandleEepromReadyInterrupt() override;
 
  private:
+  static constexpr uint8_t kQueueSize = 8;
+
+  struct PendingWrite {
+    uint16_t byte_offset;
+    // The raw value to be stored, including the storage offset.
+    uint8_t data;
+  };
+
+  // Sleep until the next interrupt. Must be called with interrupts disabled,
+  // and returns with them disabled again.
+  void AwaitInterrupt();
+
   native::Native *native_;
+
+  // Ring buffer of writes that haven't been started yet. There is at most one
+  // entry for each byte offset.
+  PendingWrite queue_[kQueueSize];
+  uint8_t queue_head_;
+  volatile uint8_t queue_length_;
+  // True from when a write is queued until the interrupt handler finds the
+  // queue empty and the final write finished.
+  volatile bool is_busy_;
 };
 
 }  // namespace storage
-}  // namespace threeboard
\ No newline at end of file
+}  // namespace threeboard
@@ -0,0 +1,162 @@
+#include "internal_eeprom.h"
+
+#include "gtest/gtest.h"
+#include "src/native/native_mock.h"
+
+namespace threeboard {
+namespace storage {
+namespace {
+
+using testing::_;
+using testing::AnyNumber;
+using testing::Invoke;
+using testing::SetArgPointee;
+
+class InternalEepromTest : public ::testing::Test {
+ public:
+  InternalEepromTest() : internal_eeprom_(&native_mock_) {
+    // Interrupts are disabled and restored around every queue access.
+    EXPECT_CALL(native_mock_, GetSREG()).Times(AnyNumber());
+    EXPECT_CALL(native_mock_, SetSREG(_)).Times(AnyNumber());
+    EXPECT_CALL(native_mock_, DisableInterrupts()).Times(AnyNumber());
+  }
+
+  // Set the raw value of a byte in internal EEPROM, including the storage
+  // offset.
+  void SetStoredByte(uint16_t byte_offset, uint8_t data) {
+    EXPECT_CALL(native_mock_, EepromReadByte(byte_offset, _))
+        .WillRepeatedly(SetArgPointee<1>(data));
+  }
+
+  // Write a byte while the EEPROM is idle, which should queue it.
+  void QueueWrite(uint16_t byte_offset, uint8_t data) {
+    EXPECT_CALL(native_mock_, EnableEepromReadyInterrupt());
+    EXPECT_TRUE(internal_eeprom_.WriteByte(byte_offset, data));
+  }
+
+  void ExpectSleep() {
+    EXPECT_CALL(native_mock_, EnableCpuSleep());
+    EXPECT_CALL(native_mock_, EnableInterrupts());
+    EXPECT_CALL(native_mock_, DisableCpuSleep());
+  }
+
+  native::NativeMock native_mock_;
+  InternalEeprom internal_eeprom_;
+};
+
+TEST_F(InternalEepromTest, ReadByteRemovesStorageOffset) {
+  SetStoredByte(10, 0xFF);
+  uint8_t data = 1;
+  EXPECT_TRUE(internal_eeprom_.ReadByte(10, &data));
+  EXPECT_EQ(data, 0);
+}
+
+TEST_F(InternalEepromTest, WriteOfUnchangedByteIsSkipped) {
+  SetStoredByte(10, 4);
+  EXPECT_TRUE(internal_eeprom_.WriteByte(10, 5));
+
+  // Nothing was queued, so flushing doesn't need to wait.
+  internal_eeprom_.Flush();
+}
+
+TEST_F(InternalEepromTest, WriteIsStartedByInterrupt) {
+  SetStoredByte(10, 0);
+  QueueWrite(10, 5);
+
+  EXPECT_CALL(native_mock_, EepromStartWrite(10, 4));
+  internal_eeprom_.HandleEepromReadyInterrupt();
+  EXPECT_CALL(native_mock_, DisableEepromReadyInterrupt());
+  internal_eeprom_.HandleEepromReadyInterrupt();
+  internal_eeprom_.Flush();
+}
+
+TEST_F(InternalEepromTest, ReadByteReturnsQueuedWrite) {
+  SetStoredByte(10, 0);
+  QueueWrite(10, 5);
+
+  // The EEPROM itself isn't read again.
+  uint8_t data = 0;
+  EXPECT_TRUE(internal_eeprom_.ReadByte(10, &data));
+  EXPECT_EQ(data, 5);
+}
+
+TEST_F(InternalEepromTest, QueuedWritesToSameByteAreCoalesced) {
+  SetStoredByte(10, 0);
+  QueueWrite(10, 5);
+  EXPECT_TRUE(internal_eeprom_.WriteByte(10, 6));
+
+  EXPECT_CALL(native_mock_, EepromStartWrite(10, 5));
+  internal_eeprom_.HandleEepromReadyInterrupt();
+  EXPECT_CALL(native_mock_, DisableEepromReadyInterrupt());
+  internal_eeprom_.HandleEepromReadyInterrupt();
+}
+
+TEST_F(InternalEepromTest, InterruptSkipsQueuedWriteOfUnchangedByte) {
+  SetStoredByte(10, 0);
+  SetStoredByte(11, 0);
+  QueueWrite(10, 5);
+  EXPECT_CALL(native_mock_, EnableEepromReadyInterrupt());
+  EXPECT_TRUE(internal_eeprom_.WriteByte(11, 6));
+
+  // By the time the write to byte 11 is reached, it already has the value.
+  SetStoredByte(10, 4);
+  SetStoredByte(11, 5);
+  EXPECT_CALL(native_mock_, DisableEepromReadyInterrupt());
+  internal_eeprom_.HandleEepromReadyInterrupt();
+}
+
+TEST_F(InternalEepromTest, WriteBytesQueuesEachByte) {
+  SetStoredByte(10, 0);
+  SetStoredByte(11, 0);
+  QueueWrite(10, 5);
+  uint8_t data[2] = {7, 8};
+  EXPECT_CALL(native_mock_, EnableEepromReadyInterrupt());
+  EXPECT_TRUE(internal_eeprom_.WriteBytes(10, data, 2));
+
+  EXPECT_CALL(native_mock_, EepromStartWrite(10, 6));
+  internal_eeprom_.HandleEepromReadyInterrupt();
+  EXPECT_CALL(native_mock_, EepromStartWrite(11, 7));
+  internal_eeprom_.HandleEepromReadyInterrupt();
+}
+
+TEST_F(InternalEepromTest, FlushSleepsUntilWritesFinish) {
+  SetStoredByte(10, 0);
+  QueueWrite(10, 5);
+
+  // Each time the CPU sleeps, the EEPROM ready interrupt fires.
+  EXPECT_CALL(native_mock_, EnableCpuSleep()).Times(2);
+  EXPECT_CALL(native_mock_, EnableInterrupts()).Times(2);
+  EXPECT_CALL(native_mock_, DisableCpuSleep()).Times(2);
+  EXPECT_CALL(native_mock_, SleepCpu()).Times(2).WillRepeatedly(Invoke([&]() {
+    internal_eeprom_.HandleEepromReadyInterrupt();
+  }));
+  EXPECT_CALL(native_mock_, EepromStartWrite(10, 4));
+  EXPECT_CALL(native_mock_, DisableEepromReadyInterrupt());
+  internal_eeprom_.Flush();
+}
+
+TEST_F(InternalEepromTest, WriteWaitsForSpaceWhenQueueIsFull) {
+  for (uint8_t i = 0; i < 9; ++i) {
+    SetStoredByte(i, 0);
+  }
+  // Every queued write makes sure the interrupt is enabled.
+  EXPECT_CALL(native_mock_, EnableEepromReadyInterrupt()).Times(9);
+  for (uint8_t i = 0; i < 8; ++i) {
+    EXPECT_TRUE(internal_eeprom_.WriteByte(i, 5));
+  }
+
+  ExpectSleep();
+  EXPECT_CALL(native_mock_, SleepCpu()).WillOnce(Invoke([&]() {
+    internal_eeprom_.HandleEepromReadyInterrupt();
+  }));
+  EXPECT_CALL(native_mock_, EepromStartWrite(0, 4));
+  EXPECT_TRUE(internal_eeprom_.WriteByte(8, 5));
+
+  uint8_t data = 0;
+  EXPECT_TRUE(internal_eeprom_.ReadByte(8, &data));
+  EXPECT_EQ(data, 5);
+}
+
+}  // namespace
+}  // namespace storage
+}  // namespace threeboard
@@ -0,0 +1,183 @@
+#include "twi_controller.h"
+
+#include "src/logging.h"
+
+namespace threeboard {
+namespace storage {
+namespace {
+
+constexpr uint8_t kWriteBit = 0;
+constexpr uint8_t kReadBit = 1;
+
+// TWCR bits that are set for every operation: TWINT is cleared by writing it,
+// which starts the next operation, and TWIE requests an interrupt once that
+// operation has completed.
+constexpr uint8_t kTwcrBase =
+    (1 << native::TWINT) | (1 << native::TWEN) | (1 << native::TWIE);
+
+uint8_t CreateControlByte(uint8_t device, uint8_t operation) {
+  // The control byte consists of: A 4 bit control code, 3 bit chip select code
+  // (determined by the EEPROM's wiring), and 1 bit read=1/write=0.
+  return 0b10100000 | ((device & 7) << 1) | (operation & 1);
+}
+
+}  // namespace
+
+TwiController::TwiController(native::Native *native)
+    : native_(native), queue_head_(0), queue_length_(0) {}
+
+bool TwiController::Submit(TwiTransaction *transaction) {
+  // The queue is shared with the interrupt handler, so modify it atomically.
+  uint8_t sreg = native_->GetSREG();
+  native_->DisableInterrupts();
+  if (queue_length_ == kQueueSize) {
+    native_->SetSREG(sreg);
+    return false;
+  }
+  transaction->status = TwiTransaction::Status::QUEUED;
+  queue_[(queue_head_ + queue_length_) % kQueueSize] = transaction;
+  queue_length_++;
+  // If this is the only transaction in the queue then the bus is idle, so it
+  // needs to be started here. Otherwise it will be started by the interrupt
+  // handler when the transactions ahead of it finish.
+  if (queue_length_ == 1) {
+    // Let the STOP that ended the previous transaction finish sending first.
+    while (native_->GetTWCR() & (1 << native::TWSTO))
+      ;
+    StartNextTransaction();
+    SendStart();
+  }
+  native_->SetSREG(sreg);
+  return true;
+}
+
+bool TwiController::AwaitCompletion(const TwiTransaction *transaction) {
+  uint8_t sreg = native_->GetSREG();
+  // Atomically check the transaction status, and sleep the CPU until the next
+  // interrupt if it hasn't finished. Enabling interrupts immediately before
+  // sleeping guarantees that the interrupt can't fire in between.
+  native_->DisableInterrupts();
+  while (transaction->status == TwiTransaction::Status::QUEUED ||
+         transaction->status == TwiTransaction::Status::IN_PROGRESS) {
+    native_->EnableCpuSleep();
+    native_->EnableInterrupts();
+    native_->SleepCpu();
+    native_->DisableCpuSleep();
+    native_->DisableInterrupts();
+  }
+  native_->SetSREG(sreg);
+  return transaction->status == TwiTransaction::Status::COMPLETE;
+}
+
+void TwiController::HandleTwiInterrupt() {
+  if (queue_length_ == 0) {
+    // Spurious interrupt with no transaction to advance.
+    return;
+  }
+  TwiTransaction *transaction = queue_[queue_head_];
+  // Mask out non-status bits of the TWI status register.
+  uint8_t status = native_->GetTWSR() & 0xF8;
+  switch (status) {
+    case native::TW_START:
+    case native::TW_REP_START: {
+      // Writes and addressed reads begin in write mode so the address word can
+      // be sent. Reads then switch to read mode with a repeated start once the
+      // address word has been sent.
+      bool read_mode = transaction->is_read &&
+                       (address_bytes_sent_ == 2 || !transaction->send_address);
+      Transmit(CreateControlByte(transaction->device,
+                                 read_mode ? kReadBit : kWriteBit));
+      break;
+    }
+    case native::TW_MT_SLA_ACK:
+      if (transaction->send_address) {
+        // The high byte of the address word is sent first.
+        address_bytes_sent_ = 1;
+        Transmit(transaction->address >> 8);
+      } else if (transaction->length > 0) {
+        Transmit(transaction->data[data_index_++] - 1);
+      } else {
+        Finish(TwiTransaction::Status::COMPLETE);
+      }
+      break;
+    case native::TW_MT_DATA_ACK:
+      if (address_bytes_sent_ == 1) {
+        address_bytes_sent_ = 2;
+        Transmit(transaction->address);
+      } else if (transaction->is_read) {
+        // The device has been addressed, so switch it to read mode.
+        SendStart();
+      } else if (data_index_ < transaction->length) {
+        Transmit(transaction->data[data_index_++] - 1);
+      } else {
+        Finish(TwiTransaction::Status::COMPLETE);
+      }
+      break;
+    case native::TW_MR_SLA_ACK:
+      // The device keeps clocking out bytes for as long as they're
+      // acknowledged. Not acknowledging the final byte ends the read.
+      Receive(transaction->length > 1);
+      break;
+    case native::TW_MR_DATA_ACK:
+      transaction->data[data_index_++] = native_->GetTWDR() + 1;
+      Receive(data_index_ < transaction->length - 1);
+      break;
+    case native::TW_MR_DATA_NACK:
+      transaction->data[data_index_++] = native_->GetTWDR() + 1;
+      Finish(TwiTransaction::Status::COMPLETE);
+      break;
+    case native::TW_MT_SLA_NACK:
+    case native::TW_MR_SLA_NACK:
+      // The device ignores its control byte while busy with an internal write
+      // cycle, so keep sending it until the device responds.
+      if (address_bytes_sent_ == 0 &&
+          ++start_attempts_ < transaction->max_start_attempts) {
+        SendStart();
+      } else {
+        LOG("TwiController: control byte not acknowledged");
+        Finish(TwiTransaction::Status::FAILED);
+      }
+      break;
+    default:
+      LOG("TwiController: fail status: %d", status);
+      Finish(TwiTransaction::Status::FAILED);
+      break;
+  }
+}
+
+void TwiController::SendStart() {
+  native_->SetTWCR(kTwcrBase | (1 << native::TWSTA));
+}
+
+void TwiController::Transmit(uint8_t data) {
+  native_->SetTWDR(data);
+  native_->SetTWCR(kTwcrBase);
+}
+
+void TwiController::Receive(bool ack) {
+  native_->SetTWCR(kTwcrBase | (ack ? (1 << native::TWEA) : 0));
+}
+
+void TwiController::Finish(TwiTransaction::Status status) {
+  queue_[queue_head_]->status = status;
+  queue_head_ = (queue_head_ + 1) % kQueueSize;
+  queue_length_--;
+  if (queue_length_ == 0) {
+    native_->SetTWCR(kTwcrBase | (1 << native::TWSTO));
+    return;
+  }
+  // Setting both TWSTO and TWSTA sends STOP followed by START, beginning the
+  // next transaction without leaving the interrupt handler.
+  StartNextTransaction();
+  native_->SetTWCR(kTwcrBase | (1 << native::TWSTO) | (1 << native::TWSTA));
+}
+
+void TwiController::StartNextTransaction() {
+  queue_[queue_head_]->status = TwiTransaction::Status::IN_PROGRESS;
+  address_bytes_sent_ = 0;
+  start_attempts_ = 0;
+  data_index_ = 0;
+}
+
+}  // namespace storage
+}  // namespace threeboard
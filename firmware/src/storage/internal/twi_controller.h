@@ -0,0 +1,101 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "src/delegates/twi_interrupt_handler_delegate.h"
+#include "src/native/native.h"
+
+namespace threeboard {
+namespace storage {
+
+// A single read or write operation on a 24LC512 EEPROM, as executed by the
+// TwiController. The transaction and its data buffer are owned by the caller,
+// and must outlive the operation.
+struct TwiTransaction {
+  enum class Status : uint8_t {
+    QUEUED,
+    IN_PROGRESS,
+    COMPLETE,
+    FAILED,
+  };
+
+  // The chip select code of the target device.
+  uint8_t device;
+  bool is_read;
+  // Whether to send the address word. Reads that skip it are current address
+  // reads (see the 24LC512 data sheet, section 8.1), which start from wherever
+  // the device's address counter was left by the previous operation.
+  bool send_address;
+  uint16_t address;
+  uint8_t *data;
+  uint16_t length;
+  // The number of times the control byte will be sent before giving up if the
+  // device doesn't acknowledge it. This is > 1 when the device may still be
+  // busy with an internal write cycle, in which case the device is acknowledge
+  // polled as defined by the 24LC512 data sheet, section 7.0.
+  uint8_t max_start_attempts;
+  // Written by the TWI interrupt handler as the transaction progresses.
+  volatile Status status;
+};
+
+// Executes TwiTransactions on the TWI bus asynchronously. Transactions are
+// queued by Submit, and the entire transfer is then driven by the TWI
+// interrupt, one bus event at a time, so the CPU is free to service other
+// interrupts (or sleep) while storage traffic is in flight.
+//
+// Limitation: every caller currently needs the result, so every caller blocks
+// in AwaitCompletion, and each storage call returns only once its transfers
+// have finished. Interrupt handlers keep running, so keys are still polled into
+// the event buffer and the USB interrupts are still serviced. The event loop,
+// though, stalls for the whole transfer. That includes acknowledge polling of
+// up to 100 start attempts (roughly 10ms) while the EEPROM finishes a previous
+// write cycle. Keypress events and memory requests wait until the storage call
+// returns.
+//
+// Bytes are stored in external EEPROM offset by -1, so that erased (0xFF)
+// bytes read as 0. This is applied here as bytes are transmitted and received.
+class TwiController final : public TwiInterruptHandlerDelegate {
+ public:
+  explicit TwiController(native::Native *native);
+
+  // Add a transaction to the back of the queue, starting it immediately if the
+  // bus is idle. Returns false if the queue is full.
+  bool Submit(TwiTransaction *transaction);
+
+  // Sleep until the transaction has finished, servicing interrupts in the
+  // meantime. Returns true if the transaction completed successfully.
+  bool AwaitCompletion(const TwiTransaction *transaction);
+
+  // Advance the current transaction in response to the TWI status code.
+  void HandleTwiInterrupt() override;
+
+ private:
+  static constexpr uint8_t kQueueSize = 4;
+
+  // Send START (or repeated START) for the current transaction.
+  void SendStart();
+  // Transmit a byte, or receive one and acknowledge it if `ack` is true.
+  void Transmit(uint8_t data);
+  void Receive(bool ack);
+  // Mark the current transaction as finished, and either send STOP or a STOP
+  // followed by the START of the next queued transaction.
+  void Finish(TwiTransaction::Status status);
+  // Begin the transaction at the front of the queue, if there is one.
+  void StartNextTransaction();
+
+  native::Native *native_;
+
+  // Ring buffer of queued transactions. The front of the queue is the current
+  // transaction.
+  TwiTransaction *queue_[kQueueSize];
+  uint8_t queue_head_;
+  volatile uint8_t queue_length_;
+
+  // Progress of the current transaction.
+  uint8_t address_bytes_sent_;
+  uint8_t start_attempts_;
+  uint16_t data_index_;
+};
+
+}  // namespace storage
+}  // namespace threeboard
@@ -0,0 +1,254 @@
+#include "twi_controller.h"
+
+#include "gtest/gtest.h"
+#include "src/logging_fake.h"
+#include "src/native/native_mock.h"
+
+namespace threeboard {
+namespace storage {
+namespace {
+
+using testing::InSequence;
+using testing::Return;
+
+constexpr uint8_t kTwcrBase =
+    (1 << native::TWINT) | (1 << native::TWEN) | (1 << native::TWIE);
+constexpr uint8_t kTwcrStart = kTwcrBase | (1 << native::TWSTA);
+constexpr uint8_t kTwcrStop = kTwcrBase | (1 << native::TWSTO);
+constexpr uint8_t kTwcrAck = kTwcrBase | (1 << native::TWEA);
+
+// Read the volatile status of a transaction so it can be printed by gtest.
+TwiTransaction::Status StatusOf(const TwiTransaction &transaction) {
+  return transaction.status;
+}
+
+class TwiControllerTest : public ::testing::Test {
+ public:
+  TwiControllerTest() : twi_controller_(&native_mock_) {}
+
+  TwiTransaction CreateTransaction(bool is_read, bool send_address,
+                                   uint8_t *data, uint16_t length) {
+    TwiTransaction transaction;
+    transaction.device = 1;
+    transaction.is_read = is_read;
+    transaction.send_address = send_address;
+    transaction.address = 0x1234;
+    transaction.data = data;
+    transaction.length = length;
+    transaction.max_start_attempts = 1;
+    return transaction;
+  }
+
+  // Submit a transaction to an idle bus, which should immediately send START.
+  void SubmitToIdleBus(TwiTransaction *transaction) {
+    EXPECT_CALL(native_mock_, GetSREG()).WillOnce(Return(0));
+    EXPECT_CALL(native_mock_, DisableInterrupts());
+    EXPECT_CALL(native_mock_, GetTWCR()).WillOnce(Return(0));
+    EXPECT_CALL(native_mock_, SetTWCR(kTwcrStart));
+    EXPECT_CALL(native_mock_, SetSREG(0));
+    EXPECT_TRUE(twi_controller_.Submit(transaction));
+  }
+
+  // Deliver a TWI interrupt with the provided status code, and expect the
+  // controller to respond by transmitting `data`.
+  void InterruptAndExpectTransmit(uint8_t status, uint8_t data) {
+    EXPECT_CALL(native_mock_, GetTWSR()).WillOnce(Return(status));
+    EXPECT_CALL(native_mock_, SetTWDR(data));
+    EXPECT_CALL(native_mock_, SetTWCR(kTwcrBase));
+    twi_controller_.HandleTwiInterrupt();
+  }
+
+  // Deliver a TWI interrupt with the provided status code, and expect the
+  // controller to respond by writing `twcr` to the TWI control register.
+  void InterruptAndExpectTwcr(uint8_t status, uint8_t twcr) {
+    EXPECT_CALL(native_mock_, GetTWSR()).WillOnce(Return(status));
+    EXPECT_CALL(native_mock_, SetTWCR(twcr));
+    twi_controller_.HandleTwiInterrupt();
+  }
+
+  // Deliver a TWI interrupt for a received byte.
+  void InterruptAndExpectReceive(uint8_t status, uint8_t data, uint8_t twcr) {
+    EXPECT_CALL(native_mock_, GetTWSR()).WillOnce(Return(status));
+    EXPECT_CALL(native_mock_, GetTWDR()).WillOnce(Return(data));
+    EXPECT_CALL(native_mock_, SetTWCR(twcr));
+    twi_controller_.HandleTwiInterrupt();
+  }
+
+  native::NativeMock native_mock_;
+  LoggingFake logging_fake_;
+  TwiController twi_controller_;
+};
+
+TEST_F(TwiControllerTest, WriteTransaction) {
+  uint8_t data[] = {10, 20};
+  auto transaction = CreateTransaction(false, true, data, 2);
+  InSequence seq;
+  SubmitToIdleBus(&transaction);
+  EXPECT_EQ(StatusOf(transaction), TwiTransaction::Status::IN_PROGRESS);
+
+  InterruptAndExpectTransmit(native::TW_START, 0b10100010);
+  InterruptAndExpectTransmit(native::TW_MT_SLA_ACK, 0x12);
+  InterruptAndExpectTransmit(native::TW_MT_DATA_ACK, 0x34);
+  // Bytes are stored offset by -1.
+  InterruptAndExpectTransmit(native::TW_MT_DATA_ACK, 9);
+  InterruptAndExpectTransmit(native::TW_MT_DATA_ACK, 19);
+  InterruptAndExpectTwcr(native::TW_MT_DATA_ACK, kTwcrStop);
+  EXPECT_EQ(StatusOf(transaction), TwiTransaction::Status::COMPLETE);
+}
+
+TEST_F(TwiControllerTest, RandomReadTransaction) {
+  uint8_t data[3] = {};
+  auto transaction = CreateTransaction(true, true, data, 3);
+  InSequence seq;
+  SubmitToIdleBus(&transaction);
+
+  InterruptAndExpectTransmit(native::TW_START, 0b10100010);
+  InterruptAndExpectTransmit(native::TW_MT_SLA_ACK, 0x12);
+  InterruptAndExpectTransmit(native::TW_MT_DATA_ACK, 0x34);
+  InterruptAndExpectTwcr(native::TW_MT_DATA_ACK, kTwcrStart);
+  InterruptAndExpectTransmit(native::TW_REP_START, 0b10100011);
+  InterruptAndExpectTwcr(native::TW_MR_SLA_ACK, kTwcrAck);
+  InterruptAndExpectReceive(native::TW_MR_DATA_ACK, 9, kTwcrAck);
+  InterruptAndExpectReceive(native::TW_MR_DATA_ACK, 19, kTwcrBase);
+  InterruptAndExpectReceive(native::TW_MR_DATA_NACK, 29, kTwcrStop);
+  EXPECT_EQ(StatusOf(transaction), TwiTransaction::Status::COMPLETE);
+  EXPECT_EQ(data[0], 10);
+  EXPECT_EQ(data[1], 20);
+  EXPECT_EQ(data[2], 30);
+}
+
+TEST_F(TwiControllerTest, CurrentAddressReadTransaction) {
+  uint8_t data = 0;
+  auto transaction = CreateTransaction(true, false, &data, 1);
+  InSequence seq;
+  SubmitToIdleBus(&transaction);
+
+  InterruptAndExpectTransmit(native::TW_START, 0b10100011);
+  InterruptAndExpectTwcr(native::TW_MR_SLA_ACK, kTwcrBase);
+  InterruptAndExpectReceive(native::TW_MR_DATA_NACK, 9, kTwcrStop);
+  EXPECT_EQ(StatusOf(transaction), TwiTransaction::Status::COMPLETE);
+  EXPECT_EQ(data, 10);
+}
+
+TEST_F(TwiControllerTest, AcknowledgePollingRetriesControlByte) {
+  uint8_t data = 10;
+  auto transaction = CreateTransaction(false, true, &data, 1);
+  transaction.max_start_attempts = 3;
+  InSequence seq;
+  SubmitToIdleBus(&transaction);
+
+  InterruptAndExpectTransmit(native::TW_START, 0b10100010);
+  InterruptAndExpectTwcr(native::TW_MT_SLA_NACK, kTwcrStart);
+  InterruptAndExpectTransmit(native::TW_REP_START, 0b10100010);
+  InterruptAndExpectTwcr(native::TW_MT_SLA_NACK, kTwcrStart);
+  InterruptAndExpectTransmit(native::TW_REP_START, 0b10100010);
+  InterruptAndExpectTransmit(native::TW_MT_SLA_ACK, 0x12);
+  EXPECT_EQ(StatusOf(transaction), TwiTransaction::Status::IN_PROGRESS);
+}
+
+TEST_F(TwiControllerTest, FailsWhenControlByteNeverAcknowledged) {
+  uint8_t data = 10;
+  auto transaction = CreateTransaction(false, true, &data, 1);
+  transaction.max_start_attempts = 2;
+  InSequence seq;
+  SubmitToIdleBus(&transaction);
+
+  InterruptAndExpectTransmit(native::TW_START, 0b10100010);
+  InterruptAndExpectTwcr(native::TW_MT_SLA_NACK, kTwcrStart);
+  InterruptAndExpectTransmit(native::TW_REP_START, 0b10100010);
+  InterruptAndExpectTwcr(native::TW_MT_SLA_NACK, kTwcrStop);
+  EXPECT_EQ(StatusOf(transaction), TwiTransaction::Status::FAILED);
+}
+
+TEST_F(TwiControllerTest, FailsOnDataNack) {
+  uint8_t data = 10;
+  auto transaction = CreateTransaction(false, true, &data, 1);
+  InSequence seq;
+  SubmitToIdleBus(&transaction);
+
+  InterruptAndExpectTransmit(native::TW_START, 0b10100010);
+  InterruptAndExpectTwcr(native::TW_MT_DATA_NACK, kTwcrStop);
+  EXPECT_EQ(StatusOf(transaction), TwiTransaction::Status::FAILED);
+}
+
+TEST_F(TwiControllerTest, QueuedTransactionStartsWhenPreviousFinishes) {
+  uint8_t data[] = {10, 20};
+  auto first = CreateTransaction(false, true, &data[0], 1);
+  auto second = CreateTransaction(true, false, &data[1], 1);
+  InSequence seq;
+  SubmitToIdleBus(&first);
+
+  // The bus is busy, so the second transaction is only queued.
+  EXPECT_CALL(native_mock_, GetSREG()).WillOnce(Return(0));
+  EXPECT_CALL(native_mock_, DisableInterrupts());
+  EXPECT_CALL(native_mock_, SetSREG(0));
+  EXPECT_TRUE(twi_controller_.Submit(&second));
+  EXPECT_EQ(StatusOf(second), TwiTransaction::Status::QUEUED);
+
+  InterruptAndExpectTransmit(native::TW_START, 0b10100010);
+  InterruptAndExpectTransmit(native::TW_MT_SLA_ACK, 0x12);
+  InterruptAndExpectTransmit(native::TW_MT_DATA_ACK, 0x34);
+  InterruptAndExpectTransmit(native::TW_MT_DATA_ACK, 9);
+  // The first transaction finishes with STOP immediately followed by START.
+  InterruptAndExpectTwcr(native::TW_MT_DATA_ACK,
+                         kTwcrStop | (1 << native::TWSTA));
+  EXPECT_EQ(StatusOf(first), TwiTransaction::Status::COMPLETE);
+  EXPECT_EQ(StatusOf(second), TwiTransaction::Status::IN_PROGRESS);
+
+  InterruptAndExpectTransmit(native::TW_START, 0b10100011);
+  InterruptAndExpectTwcr(native::TW_MR_SLA_ACK, kTwcrBase);
+  InterruptAndExpectReceive(native::TW_MR_DATA_NACK, 99, kTwcrStop);
+  EXPECT_EQ(StatusOf(second), TwiTransaction::Status::COMPLETE);
+  EXPECT_EQ(data[1], 100);
+}
+
+TEST_F(TwiControllerTest, SubmitFailsWhenQueueFull) {
+  uint8_t data = 0;
+  TwiTransaction transactions[5];
+  for (auto &transaction : transactions) {
+    transaction = CreateTransaction(true, false, &data, 1);
+  }
+  EXPECT_CALL(native_mock_, GetSREG()).WillRepeatedly(Return(0));
+  EXPECT_CALL(native_mock_, DisableInterrupts()).Times(5);
+  EXPECT_CALL(native_mock_, SetSREG(0)).Times(5);
+  EXPECT_CALL(native_mock_, GetTWCR()).WillOnce(Return(0));
+  EXPECT_CALL(native_mock_, SetTWCR(kTwcrStart));
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_TRUE(twi_controller_.Submit(&transactions[i]));
+  }
+  EXPECT_FALSE(twi_controller_.Submit(&transactions[4]));
+}
+
+TEST_F(TwiControllerTest, AwaitCompletionSleepsUntilFinished) {
+  uint8_t data = 0;
+  auto transaction = CreateTransaction(true, false, &data, 1);
+  transaction.status = TwiTransaction::Status::IN_PROGRESS;
+  InSequence seq;
+  EXPECT_CALL(native_mock_, GetSREG()).WillOnce(Return(0));
+  EXPECT_CALL(native_mock_, DisableInterrupts());
+  EXPECT_CALL(native_mock_, EnableCpuSleep());
+  EXPECT_CALL(native_mock_, EnableInterrupts());
+  // Simulate the transaction completing while the CPU is asleep.
+  EXPECT_CALL(native_mock_, SleepCpu()).WillOnce([&transaction]() {
+    transaction.status = TwiTransaction::Status::COMPLETE;
+  });
+  EXPECT_CALL(native_mock_, DisableCpuSleep());
+  EXPECT_CALL(native_mock_, DisableInterrupts());
+  EXPECT_CALL(native_mock_, SetSREG(0));
+  EXPECT_TRUE(twi_controller_.AwaitCompletion(&transaction));
+}
+
+TEST_F(TwiControllerTest, AwaitCompletionReturnsFailure) {
+  uint8_t data = 0;
+  auto transaction = CreateTransaction(true, false, &data, 1);
+  transaction.status = TwiTransaction::Status::FAILED;
+  InSequence seq;
+  EXPECT_CALL(native_mock_, GetSREG()).WillOnce(Return(0));
+  EXPECT_CALL(native_mock_, DisableInterrupts());
+  EXPECT_CALL(native_mock_, SetSREG(0));
+  EXPECT_FALSE(twi_controller_.AwaitCompletion(&transaction));
+}
+
+}  // namespace
+}  // namespace storage
+}  // namespace threeboard
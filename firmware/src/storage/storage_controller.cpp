@@ -4,6 +4,7 @@
 #include "src/native/mcu.h"
 #include "src/storage/internal/i2c_eeprom.h"
 #include "src/storage/internal/internal_eeprom.h"
+#include "src/storage/internal/twi_controller.h"
 #include "src/util/util.h"
 
 namespace threeboard {
@@ -32,11 +33,18 @@ namespace {
 // |------------------------- EEPROM_1 size = 65,536 B ------------------------|
 // |----------------------- layer B shortcuts [120 - 247] ---------------------|
 
+constexpr uint16_t kInternalEepromSize = 1024;
 constexpr uint16_t kInternalEepromLayerGLengthStart = 0x100;
 constexpr uint16_t kInternalEepromLayerBLengthStart = 0x200;
 constexpr uint16_t kEeprom0LayerBStart = 0x1000;
 constexpr uint8_t kLayerBMaxIndex = 247;
 constexpr uint8_t kEeprom1LayerBStartShortcutId = 120;
+constexpr uint8_t kWordShortcutMaxLength = 15;
+
+// The number of blob shortcut characters read from external EEPROM at a time
+// during playback. Each character is stored with its modcode, so a chunk takes
+// up twice as many bytes of SRAM.
+constexpr uint8_t kBlobReadChunkLength = 16;
 
 }  // namespace
 
@@ -48,16 +56,27 @@ StorageController::StorageController(native::Native *native,
   // Set the SCL clock frequency for the TWI interface to 100kHz.
   native->SetTWBR(((F_CPU / 100000) - 16) / 2);
 
-  // Enable the MCUs TWI module before constructing the I2cEeprom instances, so
-  // they don't need to configure this themselves and duplicate the logic.
+  // Enable the MCUs TWI module before constructing the TwiController, so it
+  // doesn't need to configure this itself and duplicate the logic.
   native->SetTWCR(1 << native::TWEN);
 
+  // Both external EEPROMs share the TWI bus, which is driven by a single
+  // interrupt-driven TwiController.
+  static TwiController twi_controller(native);
+  native->SetTwiInterruptHandlerDelegate(&twi_controller);
+
+  // Internal EEPROM writes are drained in the background by the EEPROM ready
+  // interrupt.
   static InternalEeprom internal_eeprom(native);
-  static I2cEeprom external_eeprom_0(native, I2cEeprom::EEPROM_0);
-  static I2cEeprom external_eeprom_1(native, I2cEeprom::EEPROM_1);
+  native->SetEepromInterruptHandlerDelegate(&internal_eeprom);
+  static I2cEeprom external_eeprom_0(&twi_controller, I2cEeprom::EEPROM_0);
+  static I2cEeprom external_eeprom_1(&twi_controller, I2cEeprom::EEPROM_1);
   internal_eeprom_ = &internal_eeprom;
   external_eeprom_0_ = &external_eeprom_0;
   external_eeprom_1_ = &external_eeprom_1;
+
+  // If this fails, the lengths are loaded again when they're first needed.
+  LoadShortcutLengths();
 }
 
 bool StorageController::SetCharacterShortcut(uint8_t index, uint8_t character) {
@@ -73,59 +92,59 @@ bool StorageController::AppendToWordShortcut(uint8_t index, uint8_t character) {
   RETURN_IF_ERROR(GetWordShortcutLength(index, &length));
   // If this shortcut slot is already full (15 characters) then we need to
   // propagate an error.
-  if (length == 15) {
+  if (length == kWordShortcutMaxLength) {
     return false;
   }
-  RETURN_IF_ERROR(
-      external_eeprom_0_->WriteByte((index * 16) + length, character));
-  return internal_eeprom_->WriteByte(kInternalEepromLayerGLengthStart + index,
-                                     length + 1);
+  return StageShortcutData(ShortcutType::WORD, index, &character, 1);
 }
 
 bool StorageController::ClearWordShortcut(uint8_t index) {
-  return internal_eeprom_->WriteByte(kInternalEepromLayerGLengthStart + index,
-                                     0);
+  if (GetStagedLength(ShortcutType::WORD, index) > 0) {
+    staged_size_ = 0;
+  }
+  return SetWordShortcutLength(index, 0);
 }
 
 bool StorageController::GetWordShortcutLength(uint8_t index, uint8_t *output) {
-  return internal_eeprom_->ReadByte(kInternalEepromLayerGLengthStart + index,
-                                    output);
+  if (!shortcut_lengths_loaded_) {
+    RETURN_IF_ERROR(LoadShortcutLengths());
+  }
+  *output = word_shortcut_lengths_[index] +
+            GetStagedLength(ShortcutType::WORD, index);
+  return true;
 }
 
 bool StorageController::SendWordShortcut(uint8_t index, uint8_t raw_mod_code) {
   auto word_mod_code = (WordModCode)raw_mod_code;
+  RETURN_IF_ERROR(CommitStagedShortcut());
   uint8_t length;
   RETURN_IF_ERROR(GetWordShortcutLength(index, &length));
   // If this shortcut slot is empty then we should propagate an error instead of
   // doing nothing.
-  if (length == 0) {
+  if (length == 0 || length > kWordShortcutMaxLength) {
     return false;
   }
-  for (int i = 0; i < length; ++i) {
-    uint8_t character;
-    RETURN_IF_ERROR(external_eeprom_0_->ReadByte((index * 16) + i, &character));
+  // Read the whole word in a single sequential read, leaving space for a
+  // character appended by the word mod code.
+  uint8_t characters[kWordShortcutMaxLength + 1];
+  RETURN_IF_ERROR(
+      external_eeprom_0_->ReadBytes(index * 16, characters, length));
+  if (word_mod_code == WordModCode::APPEND_PERIOD) {
+    characters[length++] = 0x37;
+  } else if (word_mod_code == WordModCode::APPEND_COMMA) {
+    characters[length++] = 0x36;
+  } else if (word_mod_code == WordModCode::APPEND_HYPHEN) {
+    characters[length++] = 0x2d;
+  }
+  for (uint8_t i = 0; i < length; ++i) {
+    uint8_t mod = 0;
     if (word_mod_code == WordModCode::UPPERCASE ||
         (word_mod_code == WordModCode::CAPITALISE && i == 0)) {
-      RETURN_IF_ERROR(usb_controller_->SendKeypress(character, (1 << 1)));
-    } else {
-      if (i == length - 1) {
-        uint8_t append = 0;
-        if (word_mod_code == WordModCode::APPEND_PERIOD) {
-          append = 0x37;
-        } else if (word_mod_code == WordModCode::APPEND_COMMA) {
-          append = 0x36;
-        } else if (word_mod_code == WordModCode::APPEND_HYPHEN) {
-          append = 0x2d;
-        }
-        if (append > 0) {
-          RETURN_IF_ERROR(usb_controller_->SendKeypress(character, 0));
-          character = append;
-        }
-      }
-      RETURN_IF_ERROR(usb_controller_->SendKeypress(character, 0));
+      mod = (1 << 1);
     }
+    RETURN_IF_ERROR(usb_controller_->TypeKey(characters[i], mod));
   }
-  return true;
+  return usb_controller_->EndKeySequence();
 }
 
 bool StorageController::AppendToBlobShortcut(uint8_t index, uint8_t character,
@@ -138,62 +157,185 @@ bool StorageController::AppendToBlobShortcut(uint8_t index, uint8_t character,
   if (length == 255) {
     return false;
   }
-  if (index >= kEeprom1LayerBStartShortcutId) {
-    uint16_t eeprom_idx =
-        ((index - kEeprom1LayerBStartShortcutId) * 512) + (length * 2);
-    RETURN_IF_ERROR(external_eeprom_1_->WriteByte(eeprom_idx, character));
-    RETURN_IF_ERROR(external_eeprom_1_->WriteByte(eeprom_idx + 1, modcode));
-  } else {
-    uint16_t eeprom_idx = kEeprom0LayerBStart + (index * 512) + (length * 2);
-    RETURN_IF_ERROR(external_eeprom_0_->WriteByte(eeprom_idx, character));
-    RETURN_IF_ERROR(external_eeprom_0_->WriteByte(eeprom_idx + 1, modcode));
-  }
-  return internal_eeprom_->WriteByte(kInternalEepromLayerBLengthStart + index,
-                                     length + 1);
+  uint8_t data[2] = {character, modcode};
+  return StageShortcutData(ShortcutType::BLOB, index, data, 2);
 }
 
 bool StorageController::ClearBlobShortcut(uint8_t index) {
   if (index > kLayerBMaxIndex) {
     return false;
   }
-  return internal_eeprom_->WriteByte(kInternalEepromLayerBLengthStart + index,
-                                     0);
+  if (GetStagedLength(ShortcutType::BLOB, index) > 0) {
+    staged_size_ = 0;
+  }
+  return SetBlobShortcutLength(index, 0);
 }
 
 bool StorageController::GetBlobShortcutLength(uint8_t index, uint8_t *output) {
   if (index > kLayerBMaxIndex) {
     return false;
   }
-  return internal_eeprom_->ReadByte(kInternalEepromLayerBLengthStart + index,
-                                    output);
+  if (!shortcut_lengths_loaded_) {
+    RETURN_IF_ERROR(LoadShortcutLengths());
+  }
+  *output = blob_shortcut_lengths_[index] +
+            GetStagedLength(ShortcutType::BLOB, index);
+  return true;
 }
 
 bool StorageController::SendBlobShortcut(uint8_t index) {
   if (index > kLayerBMaxIndex) {
     return false;
   }
+  RETURN_IF_ERROR(CommitStagedShortcut());
   uint8_t length;
   RETURN_IF_ERROR(GetBlobShortcutLength(index, &length));
   if (length == 0) {
     return false;
   }
-  for (int i = 0; i < length; ++i) {
-    uint8_t character;
-    uint8_t modcode;
-    if (index >= kEeprom1LayerBStartShortcutId) {
-      uint16_t eeprom_idx =
-          ((index - kEeprom1LayerBStartShortcutId) * 512) + (i * 2);
-      RETURN_IF_ERROR(external_eeprom_1_->ReadByte(eeprom_idx, &character));
-      RETURN_IF_ERROR(external_eeprom_1_->ReadByte(eeprom_idx + 1, &modcode));
-    } else {
-      uint16_t eeprom_idx = kEeprom0LayerBStart + (index * 512) + (i * 2);
-      RETURN_IF_ERROR(external_eeprom_0_->ReadByte(eeprom_idx, &character));
-      RETURN_IF_ERROR(external_eeprom_0_->ReadByte(eeprom_idx + 1, &modcode));
+  Eeprom *eeprom;
+  uint16_t eeprom_idx;
+  GetBlobShortcutAddress(index, &eeprom, &eeprom_idx);
+
+  // Stream the shortcut out of EEPROM a chunk at a time. Only the first chunk
+  // needs to address the device; the following reads continue from where the
+  // device's address counter was left by the previous one.
+  uint8_t buffer[kBlobReadChunkLength * 2];
+  for (uint16_t i = 0; i < length; i += kBlobReadChunkLength) {
+    uint8_t chunk_length = util::min(length - i, kBlobReadChunkLength);
+    RETURN_IF_ERROR(
+        eeprom->ReadBytes(eeprom_idx + (i * 2), buffer, chunk_length * 2));
+    for (uint8_t j = 0; j < chunk_length; ++j) {
+      RETURN_IF_ERROR(
+          usb_controller_->TypeKey(buffer[j * 2], buffer[(j * 2) + 1]));
     }
-    RETURN_IF_ERROR(usb_controller_->SendKeypress(character, modcode));
   }
+  return usb_controller_->EndKeySequence();
+}
+
+bool StorageController::CommitStagedShortcut() {
+  if (staged_size_ == 0) {
+    return true;
+  }
+  // The staged data is discarded even if the commit fails, so that a failed
+  // write isn't retried on every following append.
+  uint8_t size = staged_size_;
+  staged_size_ = 0;
+  if (staged_type_ == ShortcutType::WORD) {
+    uint8_t length = word_shortcut_lengths_[staged_index_];
+    // Word shortcut slots are 16 byte aligned, so they never cross a page
+    // boundary and are committed in a single write cycle.
+    RETURN_IF_ERROR(external_eeprom_0_->WriteBytes(
+        (staged_index_ * 16) + length, staged_data_, size));
+    return SetWordShortcutLength(staged_index_, length + size);
+  }
+  uint8_t length = blob_shortcut_lengths_[staged_index_];
+  Eeprom *eeprom;
+  uint16_t eeprom_idx;
+  GetBlobShortcutAddress(staged_index_, &eeprom, &eeprom_idx);
+  // Blob shortcut slots are page aligned, so the staged characters span at
+  // most two pages. The Eeprom splits the write at the page boundary.
+  RETURN_IF_ERROR(
+      eeprom->WriteBytes(eeprom_idx + (length * 2), staged_data_, size));
+  return SetBlobShortcutLength(staged_index_, length + (size / 2));
+}
+
+bool StorageController::ReadMemory(StorageDevice device, uint16_t address,
+                                   uint8_t *data, uint8_t length) {
+  Eeprom *eeprom = GetMemoryDevice(device, address, length);
+  if (eeprom == nullptr) {
+    return false;
+  }
+  RETURN_IF_ERROR(CommitStagedShortcut());
+  return eeprom->ReadBytes(address, data, length);
+}
+
+bool StorageController::WriteMemory(StorageDevice device, uint16_t address,
+                                    const uint8_t *data, uint8_t length) {
+  Eeprom *eeprom = GetMemoryDevice(device, address, length);
+  if (eeprom == nullptr) {
+    return false;
+  }
+  RETURN_IF_ERROR(CommitStagedShortcut());
+  RETURN_IF_ERROR(eeprom->WriteBytes(address, data, length));
+  // The write may have changed the length of any shortcut.
+  if (device == StorageDevice::INTERNAL_EEPROM &&
+      address + length > kInternalEepromLayerGLengthStart) {
+    RETURN_IF_ERROR(LoadShortcutLengths());
+  }
+  return true;
+}
+
+bool StorageController::StageShortcutData(ShortcutType type, uint8_t index,
+                                          const uint8_t *data, uint8_t size) {
+  if (staged_type_ != type || staged_index_ != index ||
+      staged_size_ + size > kStagingBufferSize) {
+    RETURN_IF_ERROR(CommitStagedShortcut());
+  }
+  staged_type_ = type;
+  staged_index_ = index;
+  for (uint8_t i = 0; i < size; ++i) {
+    staged_data_[staged_size_++] = data[i];
+  }
+  return true;
+}
+
+uint8_t StorageController::GetStagedLength(ShortcutType type, uint8_t index) {
+  if (staged_type_ != type || staged_index_ != index) {
+    return 0;
+  }
+  return type == ShortcutType::BLOB ? staged_size_ / 2 : staged_size_;
+}
+
+bool StorageController::LoadShortcutLengths() {
+  shortcut_lengths_loaded_ =
+      internal_eeprom_->ReadBytes(kInternalEepromLayerGLengthStart,
+                                  word_shortcut_lengths_, kWordShortcutCount) &&
+      internal_eeprom_->ReadBytes(kInternalEepromLayerBLengthStart,
+                                  blob_shortcut_lengths_, kBlobShortcutCount);
+  return shortcut_lengths_loaded_;
+}
+
+bool StorageController::SetWordShortcutLength(uint8_t index, uint8_t length) {
+  RETURN_IF_ERROR(internal_eeprom_->WriteByte(
+      kInternalEepromLayerGLengthStart + index, length));
+  word_shortcut_lengths_[index] = length;
   return true;
 }
 
+bool StorageController::SetBlobShortcutLength(uint8_t index, uint8_t length) {
+  RETURN_IF_ERROR(internal_eeprom_->WriteByte(
+      kInternalEepromLayerBLengthStart + index, length));
+  blob_shortcut_lengths_[index] = length;
+  return true;
+}
+
+Eeprom *StorageController::GetMemoryDevice(StorageDevice device,
+                                           uint16_t address, uint8_t length) {
+  // External EEPROMs fill the whole 16 bit address space.
+  uint32_t end = (uint32_t)address + length;
+  switch (device) {
+    case StorageDevice::INTERNAL_EEPROM:
+      return end <= kInternalEepromSize ? internal_eeprom_ : nullptr;
+    case StorageDevice::EEPROM_0:
+      return end <= 0x10000 ? external_eeprom_0_ : nullptr;
+    case StorageDevice::EEPROM_1:
+      return end <= 0x10000 ? external_eeprom_1_ : nullptr;
+    default:
+      return nullptr;
+  }
+}
+
+void StorageController::GetBlobShortcutAddress(uint8_t index, Eeprom **eeprom,
+                                               uint16_t *eeprom_idx) {
+  if (index >= kEeprom1LayerBStartShortcutId) {
+    *eeprom = external_eeprom_1_;
+    *eeprom_idx = (index - kEeprom1LayerBStartShortcutId) * 512;
+  } else {
+    *eeprom = external_eeprom_0_;
+    *eeprom_idx = kEeprom0LayerBStart + (index * 512);
+  }
+}
+
 }  // namespace storage
-}  // namespace threeboard
\ No newline at end of file
+}  // namespace threeboard
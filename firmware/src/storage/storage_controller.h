@@ -16,12 +16,23 @@ enum class WordModCode {
   APPEND_HYPHEN = 5,
 };
 
+// The storage devices on the threeboard, for direct access to shortcut memory.
+enum class StorageDevice : uint8_t {
+  INTERNAL_EEPROM = 0,
+  EEPROM_0 = 1,
+  EEPROM_1 = 2,
+};
+
 // Abstracts away interactions with the various storage devices on the
 // threeboard. This class controls the layout of storage, interfaces with the
 // storage devices, and provides a human-readable C++ abstraction on top of
 // them.
 class StorageController {
  public:
+  // Blob shortcuts only have indices below this, unlike the other shortcuts
+  // which use every index.
+  static constexpr uint16_t kBlobShortcutCount = 248;
+
   StorageController(native::Native *native, usb::UsbController *usb_controller);
   virtual ~StorageController() {}
 
@@ -39,6 +50,22 @@ class StorageController {
   virtual bool GetBlobShortcutLength(uint8_t index, uint8_t *output);
   virtual bool SendBlobShortcut(uint8_t index);
 
+  // Characters appended to word and blob shortcuts are staged in SRAM rather
+  // than being written immediately. They're committed automatically when a
+  // different shortcut is edited, the staging buffer fills up, or a shortcut is
+  // sent, but otherwise stay in SRAM until this is called.
+  virtual bool CommitStagedShortcut();
+
+  // Read or write `length` bytes of a storage device directly, starting at
+  // `address`, in the layout described in storage_controller.cpp. This lets a
+  // host tool upload or download every shortcut at once. Staged characters are
+  // committed first, and the shortcut lengths are reloaded after writes to
+  // internal EEPROM. Returns false if the range is outside of the device.
+  virtual bool ReadMemory(StorageDevice device, uint16_t address,
+                          uint8_t *data, uint8_t length);
+  virtual bool WriteMemory(StorageDevice device, uint16_t address,
+                           const uint8_t *data, uint8_t length);
+
  protected:
   // Allow derived classes (StorageControllerMock) to skip the initialising
   // constructor.
@@ -54,12 +81,68 @@ class StorageController {
       : usb_controller_(usb_controller),
         internal_eeprom_(internal_eeprom),
         external_eeprom_0_(external_eeprom_0),
-        external_eeprom_1_(external_eeprom_1) {}
+        external_eeprom_1_(external_eeprom_1) {
+    LoadShortcutLengths();
+  }
+
+  static constexpr uint16_t kWordShortcutCount = 256;
+  static constexpr uint8_t kStagingBufferSize = 32;
+
+  enum class ShortcutType : uint8_t {
+    NONE,
+    WORD,
+    BLOB,
+  };
+
+  // Add `size` bytes of shortcut data to the staging buffer, committing the
+  // buffer first if it belongs to another shortcut or doesn't have space.
+  bool StageShortcutData(ShortcutType type, uint8_t index, const uint8_t *data,
+                         uint8_t size);
+  // The number of characters staged for the shortcut.
+  uint8_t GetStagedLength(ShortcutType type, uint8_t index);
+
+  // Populate the SRAM shortcut length caches from internal EEPROM. Returns
+  // false if they couldn't be read, in which case they're reloaded the next
+  // time a shortcut length is needed.
+  bool LoadShortcutLengths();
+
+  // Write-through updates of a shortcut length in both internal EEPROM and the
+  // SRAM cache. The cache is only updated if the EEPROM write succeeds.
+  bool SetWordShortcutLength(uint8_t index, uint8_t length);
+  bool SetBlobShortcutLength(uint8_t index, uint8_t length);
+
+  // Get the external EEPROM containing blob shortcut `index`, and the address
+  // of that shortcut's first character within it.
+  void GetBlobShortcutAddress(uint8_t index, Eeprom **eeprom,
+                              uint16_t *eeprom_idx);
+
+  // Get the Eeprom for `device`, or nullptr if `length` bytes starting at
+  // `address` don't fit in it.
+  Eeprom *GetMemoryDevice(StorageDevice device, uint16_t address,
+                          uint8_t length);
 
   usb::UsbController *usb_controller_;
   Eeprom *internal_eeprom_;
   Eeprom *external_eeprom_0_;
   Eeprom *external_eeprom_1_;
+
+  // SRAM copies of the layer G and B shortcut length tables in internal EEPROM,
+  // loaded once at boot. These are read on almost every keypress to update the
+  // LEDs, so serving them from SRAM keeps EEPROM off the keypress path.
+  uint8_t word_shortcut_lengths_[kWordShortcutCount];
+  uint8_t blob_shortcut_lengths_[kBlobShortcutCount];
+  // False until both caches have been read successfully, so a failed read at
+  // boot can't be served as garbage lengths.
+  bool shortcut_lengths_loaded_ = false;
+
+  // Shortcut data (in the same format as it's stored in external EEPROM)
+  // appended to a single shortcut since the last commit. Batching these up
+  // lets a whole programming session be written in as few page writes as
+  // possible, instead of one write cycle per character.
+  ShortcutType staged_type_ = ShortcutType::NONE;
+  uint8_t staged_index_ = 0;
+  uint8_t staged_size_ = 0;
+  uint8_t staged_data_[kStagingBufferSize];
 };
 
 }  // namespace storage
@@ -20,6 +20,12 @@ class StorageControllerMockDefault : public StorageController {
   MOCK_METHOD(bool, ClearBlobShortcut, (uint8_t), (override));
   MOCK_METHOD(bool, GetBlobShortcutLength, (uint8_t, uint8_t *), (override));
   MOCK_METHOD(bool, SendBlobShortcut, (uint8_t), (override));
+
+  MOCK_METHOD(bool, CommitStagedShortcut, (), (override));
+  MOCK_METHOD(bool, ReadMemory, (StorageDevice, uint16_t, uint8_t *, uint8_t),
+              (override));
+  MOCK_METHOD(bool, WriteMemory,
+              (StorageDevice, uint16_t, const uint8_t *, uint8_t), (override));
 };
 
 using StorageControllerMock =
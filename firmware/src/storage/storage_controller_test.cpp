@@ -1,5 +1,9 @@
 #include "storage_controller.h"
 
+#include <algorithm>
+#include <array>
+#include <vector>
+
 #include "gtest/gtest.h"
 #include "src/storage/internal/eeprom_mock.h"
 #include "src/usb/usb_controller_mock.h"
@@ -8,20 +12,56 @@ namespace threeboard {
 namespace storage {
 
 using testing::_;
+using testing::Args;
 using testing::DoAll;
+using testing::ElementsAre;
+using testing::ElementsAreArray;
 using testing::Return;
 using testing::Sequence;
 using testing::SetArgPointee;
+using testing::SetArrayArgument;
 
 class StorageControllerTest : public ::testing::Test {
  public:
   StorageControllerTest() {
+    // The shortcut length tables are loaded from internal EEPROM on
+    // construction.
+    EXPECT_CALL(internal_eeprom_mock_, ReadBytes(0x100, _, 256))
+        .WillOnce(Return(true));
+    EXPECT_CALL(internal_eeprom_mock_, ReadBytes(0x200, _, 248))
+        .WillOnce(Return(true));
+    CreateStorageController();
+  }
+
+  void CreateStorageController() {
     auto *raw_ptr =
         new StorageController(&usb_controller_mock_, &internal_eeprom_mock_,
                               &eeprom0_mock_, &eeprom1_mock_);
     storage_controller_ = std::unique_ptr<StorageController>(raw_ptr);
   }
 
+  void SetCachedWordShortcutLength(uint8_t index, uint8_t length) {
+    storage_controller_->word_shortcut_lengths_[index] = length;
+  }
+
+  void SetCachedBlobShortcutLength(uint8_t index, uint8_t length) {
+    storage_controller_->blob_shortcut_lengths_[index] = length;
+  }
+
+  // Expect `keys` to be typed in order with the same modifiers, followed by the
+  // end of the key sequence.
+  void ExpectKeySequence(Sequence *seq, const std::vector<uint8_t> &keys,
+                         uint8_t mod) {
+    for (uint8_t key : keys) {
+      EXPECT_CALL(usb_controller_mock_, TypeKey(key, mod))
+          .InSequence(*seq)
+          .WillOnce(Return(true));
+    }
+    EXPECT_CALL(usb_controller_mock_, EndKeySequence())
+        .InSequence(*seq)
+        .WillOnce(Return(true));
+  }
+
   std::unique_ptr<StorageController> storage_controller_;
   usb::UsbControllerMock usb_controller_mock_;
   EepromMock internal_eeprom_mock_;
@@ -31,6 +71,70 @@ class StorageControllerTest : public ::testing::Test {
 
 namespace {
 
+// Shortcut data as stored in external EEPROM. Word shortcut character i is i,
+// and blob shortcut character i is i with modcode i + 1.
+constexpr uint8_t kData[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14};
+constexpr auto kBlobData = [] {
+  std::array<uint8_t, 510> data{};
+  for (int i = 0; i < 255; ++i) {
+    data[i * 2] = i;
+    data[(i * 2) + 1] = i + 1;
+  }
+  return data;
+}();
+
+// Action for a successful ReadBytes call that outputs `length` bytes of `data`.
+auto ReadBytesAction(const uint8_t *data, uint16_t length) {
+  return DoAll(SetArrayArgument<1>(data, data + length), Return(true));
+}
+
+// Characters [start, length) of the word shortcut test data.
+std::vector<uint8_t> Word(uint8_t length, uint8_t start = 0) {
+  return std::vector<uint8_t>(kData + start, kData + length);
+}
+
+TEST_F(StorageControllerTest, LoadsShortcutLengthsOnConstruction) {
+  std::array<uint8_t, 256> word_lengths{};
+  word_lengths[4] = 10;
+  std::array<uint8_t, 248> blob_lengths{};
+  blob_lengths[247] = 200;
+  EXPECT_CALL(internal_eeprom_mock_, ReadBytes(0x100, _, 256))
+      .WillOnce(ReadBytesAction(word_lengths.data(), 256));
+  EXPECT_CALL(internal_eeprom_mock_, ReadBytes(0x200, _, 248))
+      .WillOnce(ReadBytesAction(blob_lengths.data(), 248));
+  CreateStorageController();
+
+  uint8_t length = 0;
+  EXPECT_TRUE(storage_controller_->GetWordShortcutLength(4, &length));
+  EXPECT_EQ(length, 10);
+  EXPECT_TRUE(storage_controller_->GetBlobShortcutLength(247, &length));
+  EXPECT_EQ(length, 200);
+}
+
+TEST_F(StorageControllerTest, ReloadsShortcutLengthsAfterLoadFailure) {
+  EXPECT_CALL(internal_eeprom_mock_, ReadBytes(0x100, _, 256))
+      .WillOnce(Return(false));
+  CreateStorageController();
+
+  // The lengths are loaded again when they're first needed, and aren't served
+  // from the cache until that succeeds.
+  uint8_t length = 0;
+  EXPECT_CALL(internal_eeprom_mock_, ReadBytes(0x100, _, 256))
+      .WillOnce(Return(false));
+  EXPECT_FALSE(storage_controller_->GetBlobShortcutLength(0, &length));
+
+  std::array<uint8_t, 256> word_lengths{};
+  word_lengths[4] = 10;
+  EXPECT_CALL(internal_eeprom_mock_, ReadBytes(0x100, _, 256))
+      .WillOnce(ReadBytesAction(word_lengths.data(), 256));
+  EXPECT_CALL(internal_eeprom_mock_, ReadBytes(0x200, _, 248))
+      .WillOnce(Return(true));
+  EXPECT_TRUE(storage_controller_->GetWordShortcutLength(4, &length));
+  EXPECT_EQ(length, 10);
+  // Once loaded, the lengths are served from the cache.
+  EXPECT_TRUE(storage_controller_->GetWordShortcutLength(4, &length));
+}
+
 TEST_F(StorageControllerTest, SetCharacterShortcutSuccess) {
   EXPECT_CALL(internal_eeprom_mock_, WriteByte(0, 10)).WillOnce(Return(true));
   EXPECT_TRUE(storage_controller_->SetCharacterShortcut(0, 10));
@@ -57,43 +161,108 @@ TEST_F(StorageControllerTest, GetCharacterShortcutFailure) {
 }
 
 TEST_F(StorageControllerTest, AppendToWordShortcutSuccess) {
-  EXPECT_CALL(internal_eeprom_mock_, ReadByte(0x100 + 4, _))
-      .WillOnce(DoAll(SetArgPointee<1>(10), Return(true)));
-  EXPECT_CALL(eeprom0_mock_, WriteByte((16 * 4) + 10, 100))
+  SetCachedWordShortcutLength(4, 10);
+  // Appended characters are staged without writing to EEPROM, but are
+  // included in the shortcut length.
+  EXPECT_TRUE(storage_controller_->AppendToWordShortcut(4, 100));
+  uint8_t length = 0;
+  EXPECT_TRUE(storage_controller_->GetWordShortcutLength(4, &length));
+  EXPECT_EQ(length, 11);
+
+  EXPECT_CALL(eeprom0_mock_, WriteBytes((16 * 4) + 10, _, 1))
+      .With(Args<1, 2>(ElementsAre(100)))
       .WillOnce(Return(true));
   EXPECT_CALL(internal_eeprom_mock_, WriteByte(0x100 + 4, 11))
       .WillOnce(Return(true));
-  EXPECT_TRUE(storage_controller_->AppendToWordShortcut(4, 100));
+  EXPECT_TRUE(storage_controller_->CommitStagedShortcut());
+  EXPECT_TRUE(storage_controller_->GetWordShortcutLength(4, &length));
+  EXPECT_EQ(length, 11);
 }
 
-TEST_F(StorageControllerTest, AppendToWordShortcutFailsOnGetLengthFailure) {
-  EXPECT_CALL(internal_eeprom_mock_, ReadByte(0x100 + 4, _))
-      .WillOnce(Return(false));
-  EXPECT_FALSE(storage_controller_->AppendToWordShortcut(4, 100));
+TEST_F(StorageControllerTest, AppendToWordShortcutCommitsInSingleWrite) {
+  SetCachedWordShortcutLength(4, 10);
+  EXPECT_TRUE(storage_controller_->AppendToWordShortcut(4, 100));
+  EXPECT_TRUE(storage_controller_->AppendToWordShortcut(4, 101));
+  EXPECT_TRUE(storage_controller_->AppendToWordShortcut(4, 102));
+
+  EXPECT_CALL(eeprom0_mock_, WriteBytes((16 * 4) + 10, _, 3))
+      .With(Args<1, 2>(ElementsAre(100, 101, 102)))
+      .WillOnce(Return(true));
+  EXPECT_CALL(internal_eeprom_mock_, WriteByte(0x100 + 4, 13))
+      .WillOnce(Return(true));
+  EXPECT_TRUE(storage_controller_->CommitStagedShortcut());
 }
 
 TEST_F(StorageControllerTest, AppendToWordShortcutFailsWhenFull) {
-  EXPECT_CALL(internal_eeprom_mock_, ReadByte(0x100 + 4, _))
-      .WillOnce(DoAll(SetArgPointee<1>(15), Return(true)));
+  SetCachedWordShortcutLength(4, 15);
   EXPECT_FALSE(storage_controller_->AppendToWordShortcut(4, 100));
 }
 
-TEST_F(StorageControllerTest, AppendToWordShortcutFailsOnShortcutWriteFailure) {
-  EXPECT_CALL(internal_eeprom_mock_, ReadByte(0x100 + 4, _))
-      .WillOnce(DoAll(SetArgPointee<1>(10), Return(true)));
-  EXPECT_CALL(eeprom0_mock_, WriteByte((16 * 4) + 10, 100))
+TEST_F(StorageControllerTest, AppendToWordShortcutFailsWhenFullOfStagedData) {
+  SetCachedWordShortcutLength(4, 14);
+  EXPECT_TRUE(storage_controller_->AppendToWordShortcut(4, 100));
+  EXPECT_FALSE(storage_controller_->AppendToWordShortcut(4, 101));
+}
+
+TEST_F(StorageControllerTest, AppendToAnotherShortcutCommitsStagedShortcut) {
+  SetCachedWordShortcutLength(4, 10);
+  EXPECT_TRUE(storage_controller_->AppendToWordShortcut(4, 100));
+
+  EXPECT_CALL(eeprom0_mock_, WriteBytes((16 * 4) + 10, _, 1))
+      .With(Args<1, 2>(ElementsAre(100)))
+      .WillOnce(Return(true));
+  EXPECT_CALL(internal_eeprom_mock_, WriteByte(0x100 + 4, 11))
+      .WillOnce(Return(true));
+  EXPECT_TRUE(storage_controller_->AppendToWordShortcut(5, 101));
+
+  uint8_t length = 0;
+  EXPECT_TRUE(storage_controller_->GetWordShortcutLength(5, &length));
+  EXPECT_EQ(length, 1);
+}
+
+TEST_F(StorageControllerTest, CommitStagedShortcutWithNothingStaged) {
+  EXPECT_TRUE(storage_controller_->CommitStagedShortcut());
+}
+
+TEST_F(StorageControllerTest, CommitStagedWordShortcutFailsOnWriteFailure) {
+  SetCachedWordShortcutLength(4, 10);
+  EXPECT_TRUE(storage_controller_->AppendToWordShortcut(4, 100));
+  EXPECT_CALL(eeprom0_mock_, WriteBytes((16 * 4) + 10, _, 1))
       .WillOnce(Return(false));
-  EXPECT_FALSE(storage_controller_->AppendToWordShortcut(4, 100));
+  EXPECT_FALSE(storage_controller_->CommitStagedShortcut());
+
+  // The staged character is discarded.
+  uint8_t length = 0;
+  EXPECT_TRUE(storage_controller_->GetWordShortcutLength(4, &length));
+  EXPECT_EQ(length, 10);
 }
 
-TEST_F(StorageControllerTest, AppendToWordShortcutFailsOnLengthWriteFailure) {
-  EXPECT_CALL(internal_eeprom_mock_, ReadByte(0x100 + 4, _))
-      .WillOnce(DoAll(SetArgPointee<1>(10), Return(true)));
-  EXPECT_CALL(eeprom0_mock_, WriteByte((16 * 4) + 10, 100))
+TEST_F(StorageControllerTest, CommitStagedWordShortcutFailsOnLengthWrite) {
+  SetCachedWordShortcutLength(4, 10);
+  EXPECT_TRUE(storage_controller_->AppendToWordShortcut(4, 100));
+  EXPECT_CALL(eeprom0_mock_, WriteBytes((16 * 4) + 10, _, 1))
       .WillOnce(Return(true));
   EXPECT_CALL(internal_eeprom_mock_, WriteByte(0x100 + 4, 11))
       .WillOnce(Return(false));
-  EXPECT_FALSE(storage_controller_->AppendToWordShortcut(4, 100));
+  EXPECT_FALSE(storage_controller_->CommitStagedShortcut());
+
+  // The cached length must still match what's stored in EEPROM.
+  uint8_t length = 0;
+  EXPECT_TRUE(storage_controller_->GetWordShortcutLength(4, &length));
+  EXPECT_EQ(length, 10);
+}
+
+TEST_F(StorageControllerTest, ClearWordShortcutDiscardsStagedCharacters) {
+  SetCachedWordShortcutLength(4, 10);
+  EXPECT_TRUE(storage_controller_->AppendToWordShortcut(4, 100));
+  EXPECT_CALL(internal_eeprom_mock_, WriteByte(0x100 + 4, 0))
+      .WillOnce(Return(true));
+  EXPECT_TRUE(storage_controller_->ClearWordShortcut(4));
+
+  uint8_t length = 1;
+  EXPECT_TRUE(storage_controller_->GetWordShortcutLength(4, &length));
+  EXPECT_EQ(length, 0);
+  EXPECT_TRUE(storage_controller_->CommitStagedShortcut());
 }
 
 TEST_F(StorageControllerTest, ClearWordShortcutSuccess) {
@@ -109,206 +278,177 @@ TEST_F(StorageControllerTest, ClearWordShortcutFailure) {
 }
 
 TEST_F(StorageControllerTest, GetWordShortcutLengthSuccess) {
-  EXPECT_CALL(internal_eeprom_mock_, ReadByte(0x100 + 4, _))
-      .WillOnce(DoAll(SetArgPointee<1>(10), Return(true)));
+  SetCachedWordShortcutLength(4, 10);
   uint8_t length = 0;
   EXPECT_TRUE(storage_controller_->GetWordShortcutLength(4, &length));
   EXPECT_EQ(length, 10);
 }
 
-TEST_F(StorageControllerTest, GetWordShortcutLengthFailure) {
-  EXPECT_CALL(internal_eeprom_mock_, ReadByte(0x100 + 4, _))
-      .WillOnce(Return(false));
-  uint8_t length = 0;
-  EXPECT_FALSE(storage_controller_->GetWordShortcutLength(4, &length));
-  EXPECT_EQ(length, 0);
-}
-
 TEST_F(StorageControllerTest, SendWordShortcutSuccess) {
-  EXPECT_CALL(internal_eeprom_mock_, ReadByte(0x100 + 4, _))
-      .WillOnce(DoAll(SetArgPointee<1>(10), Return(true)));
+  SetCachedWordShortcutLength(4, 10);
   Sequence seq;
-  for (int i = 0; i < 10; ++i) {
-    EXPECT_CALL(eeprom0_mock_, ReadByte((16 * 4) + i, _))
-        .InSequence(seq)
-        .WillOnce(DoAll(SetArgPointee<1>(i), Return(true)));
-    EXPECT_CALL(usb_controller_mock_, SendKeypress(i, 0))
-        .InSequence(seq)
-        .WillOnce(Return(true));
-  }
+  EXPECT_CALL(eeprom0_mock_, ReadBytes(16 * 4, _, 10))
+      .InSequence(seq)
+      .WillOnce(ReadBytesAction(kData, 10));
+  ExpectKeySequence(&seq, Word(10), 0);
   EXPECT_TRUE(storage_controller_->SendWordShortcut(4, 0));
 }
 
 TEST_F(StorageControllerTest, SendWordShortcutSuccessUppercase) {
-  EXPECT_CALL(internal_eeprom_mock_, ReadByte(0x100 + 4, _))
-      .WillOnce(DoAll(SetArgPointee<1>(10), Return(true)));
+  SetCachedWordShortcutLength(4, 10);
   Sequence seq;
-  for (int i = 0; i < 10; ++i) {
-    EXPECT_CALL(eeprom0_mock_, ReadByte((16 * 4) + i, _))
-        .InSequence(seq)
-        .WillOnce(DoAll(SetArgPointee<1>(i), Return(true)));
-    EXPECT_CALL(usb_controller_mock_, SendKeypress(i, (1 << 1)))
-        .InSequence(seq)
-        .WillOnce(Return(true));
-  }
+  EXPECT_CALL(eeprom0_mock_, ReadBytes(16 * 4, _, 10))
+      .InSequence(seq)
+      .WillOnce(ReadBytesAction(kData, 10));
+  ExpectKeySequence(&seq, Word(10), (1 << 1));
   EXPECT_TRUE(storage_controller_->SendWordShortcut(4, 1));
 }
 
 TEST_F(StorageControllerTest, SendWordShortcutSuccessCapitalise) {
-  EXPECT_CALL(internal_eeprom_mock_, ReadByte(0x100 + 4, _))
-      .WillOnce(DoAll(SetArgPointee<1>(10), Return(true)));
+  SetCachedWordShortcutLength(4, 10);
   Sequence seq;
-  for (int i = 0; i < 10; ++i) {
-    EXPECT_CALL(eeprom0_mock_, ReadByte((16 * 4) + i, _))
-        .InSequence(seq)
-        .WillOnce(DoAll(SetArgPointee<1>(i), Return(true)));
-    uint8_t modcode = (i == 0) ? (1 << 1) : 0;
-    EXPECT_CALL(usb_controller_mock_, SendKeypress(i, modcode))
-        .InSequence(seq)
-        .WillOnce(Return(true));
-  }
+  EXPECT_CALL(eeprom0_mock_, ReadBytes(16 * 4, _, 10))
+      .InSequence(seq)
+      .WillOnce(ReadBytesAction(kData, 10));
+  EXPECT_CALL(usb_controller_mock_, TypeKey(0, (1 << 1)))
+      .InSequence(seq)
+      .WillOnce(Return(true));
+  ExpectKeySequence(&seq, Word(10, 1), 0);
   EXPECT_TRUE(storage_controller_->SendWordShortcut(4, 2));
 }
 
 TEST_F(StorageControllerTest, SendWordShortcutSuccessAppendPeriod) {
-  EXPECT_CALL(internal_eeprom_mock_, ReadByte(0x100 + 4, _))
-      .WillOnce(DoAll(SetArgPointee<1>(10), Return(true)));
+  SetCachedWordShortcutLength(4, 10);
   Sequence seq;
-  for (int i = 0; i < 10; ++i) {
-    EXPECT_CALL(eeprom0_mock_, ReadByte((16 * 4) + i, _))
-        .InSequence(seq)
-        .WillOnce(DoAll(SetArgPointee<1>(i), Return(true)));
-    EXPECT_CALL(usb_controller_mock_, SendKeypress(i, 0))
-        .InSequence(seq)
-        .WillOnce(Return(true));
-  }
-  EXPECT_CALL(usb_controller_mock_, SendKeypress(0x37, 0))
+  EXPECT_CALL(eeprom0_mock_, ReadBytes(16 * 4, _, 10))
       .InSequence(seq)
-      .WillOnce(Return(true));
+      .WillOnce(ReadBytesAction(kData, 10));
+  auto keys = Word(10);
+  keys.push_back(0x37);
+  ExpectKeySequence(&seq, keys, 0);
   EXPECT_TRUE(storage_controller_->SendWordShortcut(4, 3));
 }
 
 TEST_F(StorageControllerTest, SendWordShortcutSuccessAppendComma) {
-  EXPECT_CALL(internal_eeprom_mock_, ReadByte(0x100 + 4, _))
-      .WillOnce(DoAll(SetArgPointee<1>(10), Return(true)));
+  SetCachedWordShortcutLength(4, 10);
   Sequence seq;
-  for (int i = 0; i < 10; ++i) {
-    EXPECT_CALL(eeprom0_mock_, ReadByte((16 * 4) + i, _))
-        .InSequence(seq)
-        .WillOnce(DoAll(SetArgPointee<1>(i), Return(true)));
-    EXPECT_CALL(usb_controller_mock_, SendKeypress(i, 0))
-        .InSequence(seq)
-        .WillOnce(Return(true));
-  }
-  EXPECT_CALL(usb_controller_mock_, SendKeypress(0x36, 0))
+  EXPECT_CALL(eeprom0_mock_, ReadBytes(16 * 4, _, 10))
       .InSequence(seq)
-      .WillOnce(Return(true));
+      .WillOnce(ReadBytesAction(kData, 10));
+  auto keys = Word(10);
+  keys.push_back(0x36);
+  ExpectKeySequence(&seq, keys, 0);
   EXPECT_TRUE(storage_controller_->SendWordShortcut(4, 4));
 }
 
 TEST_F(StorageControllerTest, SendWordShortcutSuccessAppendHyphen) {
-  EXPECT_CALL(internal_eeprom_mock_, ReadByte(0x100 + 4, _))
-      .WillOnce(DoAll(SetArgPointee<1>(10), Return(true)));
+  SetCachedWordShortcutLength(4, 10);
   Sequence seq;
-  for (int i = 0; i < 10; ++i) {
-    EXPECT_CALL(eeprom0_mock_, ReadByte(64 + i, _))
-        .InSequence(seq)
-        .WillOnce(DoAll(SetArgPointee<1>(i), Return(true)));
-    EXPECT_CALL(usb_controller_mock_, SendKeypress(i, 0))
-        .InSequence(seq)
-        .WillOnce(Return(true));
-  }
-  EXPECT_CALL(usb_controller_mock_, SendKeypress(0x2d, 0))
+  EXPECT_CALL(eeprom0_mock_, ReadBytes(16 * 4, _, 10))
       .InSequence(seq)
-      .WillOnce(Return(true));
+      .WillOnce(ReadBytesAction(kData, 10));
+  auto keys = Word(10);
+  keys.push_back(0x2d);
+  ExpectKeySequence(&seq, keys, 0);
   EXPECT_TRUE(storage_controller_->SendWordShortcut(4, 5));
 }
 
 TEST_F(StorageControllerTest, SendWordShortcutSuccessAppendToFullShortcut) {
-  EXPECT_CALL(internal_eeprom_mock_, ReadByte(0x100 + 4, _))
-      .WillOnce(DoAll(SetArgPointee<1>(15), Return(true)));
+  SetCachedWordShortcutLength(4, 15);
   Sequence seq;
-  for (int i = 0; i < 15; ++i) {
-    EXPECT_CALL(eeprom0_mock_, ReadByte(64 + i, _))
-        .InSequence(seq)
-        .WillOnce(DoAll(SetArgPointee<1>(i), Return(true)));
-    EXPECT_CALL(usb_controller_mock_, SendKeypress(i, 0))
-        .InSequence(seq)
-        .WillOnce(Return(true));
-  }
-  EXPECT_CALL(usb_controller_mock_, SendKeypress(0x2d, 0))
+  EXPECT_CALL(eeprom0_mock_, ReadBytes(16 * 4, _, 15))
       .InSequence(seq)
-      .WillOnce(Return(true));
+      .WillOnce(ReadBytesAction(kData, 15));
+  auto keys = Word(15);
+  keys.push_back(0x2d);
+  ExpectKeySequence(&seq, keys, 0);
   EXPECT_TRUE(storage_controller_->SendWordShortcut(4, 5));
 }
 
-TEST_F(StorageControllerTest, SendWordShortcutFailsOnLengthReadFailure) {
-  EXPECT_CALL(internal_eeprom_mock_, ReadByte(0x100 + 4, _))
-      .WillOnce(Return(false));
-  EXPECT_FALSE(storage_controller_->SendWordShortcut(4, 5));
-}
-
 TEST_F(StorageControllerTest, SendWordShortcutFailsOnShortcutReadFailure) {
-  EXPECT_CALL(internal_eeprom_mock_, ReadByte(0x100 + 4, _))
-      .WillOnce(DoAll(SetArgPointee<1>(10), Return(true)));
-  EXPECT_CALL(eeprom0_mock_, ReadByte(64, _)).WillOnce(Return(false));
+  SetCachedWordShortcutLength(4, 10);
+  EXPECT_CALL(eeprom0_mock_, ReadBytes(64, _, 10)).WillOnce(Return(false));
   EXPECT_FALSE(storage_controller_->SendWordShortcut(4, 5));
 }
 
 TEST_F(StorageControllerTest, SendWordShortcutFailsOnUsbSendFailure) {
-  EXPECT_CALL(internal_eeprom_mock_, ReadByte(0x100 + 4, _))
-      .WillOnce(DoAll(SetArgPointee<1>(15), Return(true)));
-  EXPECT_CALL(eeprom0_mock_, ReadByte(64, _))
-      .WillOnce(DoAll(SetArgPointee<1>(0), Return(true)));
-  EXPECT_CALL(usb_controller_mock_, SendKeypress(0, 0)).WillOnce(Return(false));
+  SetCachedWordShortcutLength(4, 15);
+  EXPECT_CALL(eeprom0_mock_, ReadBytes(64, _, 15))
+      .WillOnce(ReadBytesAction(kData, 15));
+  EXPECT_CALL(usb_controller_mock_, TypeKey(0, 0)).WillOnce(Return(false));
   EXPECT_FALSE(storage_controller_->SendWordShortcut(4, 5));
 }
 
-TEST_F(StorageControllerTest, SendWordShortcutFailsOnUsbSendAppendFailure) {
-  EXPECT_CALL(internal_eeprom_mock_, ReadByte(0x100 + 4, _))
-      .WillOnce(DoAll(SetArgPointee<1>(15), Return(true)));
+TEST_F(StorageControllerTest, SendWordShortcutFailsOnEndSequenceFailure) {
+  SetCachedWordShortcutLength(4, 15);
   Sequence seq;
+  EXPECT_CALL(eeprom0_mock_, ReadBytes(16 * 4, _, 15))
+      .InSequence(seq)
+      .WillOnce(ReadBytesAction(kData, 15));
   for (int i = 0; i < 15; ++i) {
-    EXPECT_CALL(eeprom0_mock_, ReadByte(64 + i, _))
-        .InSequence(seq)
-        .WillOnce(DoAll(SetArgPointee<1>(i), Return(true)));
-    EXPECT_CALL(usb_controller_mock_, SendKeypress(i, 0))
+    EXPECT_CALL(usb_controller_mock_, TypeKey(i, 0))
         .InSequence(seq)
         .WillOnce(Return(true));
   }
-  EXPECT_CALL(usb_controller_mock_, SendKeypress(0x2d, 0))
+  EXPECT_CALL(usb_controller_mock_, TypeKey(0x2d, 0))
+      .InSequence(seq)
+      .WillOnce(Return(true));
+  EXPECT_CALL(usb_controller_mock_, EndKeySequence())
       .InSequence(seq)
       .WillOnce(Return(false));
   EXPECT_FALSE(storage_controller_->SendWordShortcut(4, 5));
 }
 
 TEST_F(StorageControllerTest, AppendToBlobShortcutSuccessEeprom0) {
-  EXPECT_CALL(internal_eeprom_mock_, ReadByte(0x200 + 119, _))
-      .WillOnce(DoAll(SetArgPointee<1>(10), Return(true)));
-  EXPECT_CALL(eeprom0_mock_, WriteByte(0x1000 + (119 * 512) + (10 * 2), 100))
-      .WillOnce(Return(true));
-  EXPECT_CALL(eeprom0_mock_,
-              WriteByte(0x1000 + (119 * 512) + (10 * 2) + 1, 101))
+  SetCachedBlobShortcutLength(119, 10);
+  EXPECT_TRUE(storage_controller_->AppendToBlobShortcut(119, 100, 101));
+  uint8_t length = 0;
+  EXPECT_TRUE(storage_controller_->GetBlobShortcutLength(119, &length));
+  EXPECT_EQ(length, 11);
+
+  EXPECT_CALL(eeprom0_mock_, WriteBytes(0x1000 + (119 * 512) + (10 * 2), _, 2))
+      .With(Args<1, 2>(ElementsAre(100, 101)))
       .WillOnce(Return(true));
   EXPECT_CALL(internal_eeprom_mock_, WriteByte(0x200 + 119, 11))
       .WillOnce(Return(true));
-  EXPECT_TRUE(storage_controller_->AppendToBlobShortcut(119, 100, 101));
+  EXPECT_TRUE(storage_controller_->CommitStagedShortcut());
 }
 
 TEST_F(StorageControllerTest, AppendToBlobShortcutSuccessEeprom1) {
-  EXPECT_CALL(internal_eeprom_mock_, ReadByte(0x200 + 120, _))
-      .WillOnce(DoAll(SetArgPointee<1>(10), Return(true)));
-  EXPECT_CALL(eeprom1_mock_, WriteByte((10 * 2), 100)).WillOnce(Return(true));
-  EXPECT_CALL(eeprom1_mock_, WriteByte((10 * 2) + 1, 101))
+  SetCachedBlobShortcutLength(120, 10);
+  EXPECT_TRUE(storage_controller_->AppendToBlobShortcut(120, 100, 101));
+  EXPECT_TRUE(storage_controller_->AppendToBlobShortcut(120, 102, 103));
+
+  EXPECT_CALL(eeprom1_mock_, WriteBytes(10 * 2, _, 4))
+      .With(Args<1, 2>(ElementsAre(100, 101, 102, 103)))
       .WillOnce(Return(true));
-  EXPECT_CALL(internal_eeprom_mock_, WriteByte(0x200 + 120, 11))
+  EXPECT_CALL(internal_eeprom_mock_, WriteByte(0x200 + 120, 12))
       .WillOnce(Return(true));
-  EXPECT_TRUE(storage_controller_->AppendToBlobShortcut(120, 100, 101));
+  EXPECT_TRUE(storage_controller_->CommitStagedShortcut());
+}
+
+TEST_F(StorageControllerTest, AppendToBlobShortcutCommitsFullStagingBuffer) {
+  SetCachedBlobShortcutLength(120, 10);
+  for (int i = 0; i < 16; ++i) {
+    EXPECT_TRUE(storage_controller_->AppendToBlobShortcut(120, i, i + 1));
+  }
+
+  // The staging buffer holds 16 characters, so the next one can't be staged
+  // until they've been committed.
+  EXPECT_CALL(eeprom1_mock_, WriteBytes(10 * 2, _, 32))
+      .With(Args<1, 2>(ElementsAreArray(kBlobData.data(), 32)))
+      .WillOnce(Return(true));
+  EXPECT_CALL(internal_eeprom_mock_, WriteByte(0x200 + 120, 26))
+      .WillOnce(Return(true));
+  EXPECT_TRUE(storage_controller_->AppendToBlobShortcut(120, 16, 17));
+
+  uint8_t length = 0;
+  EXPECT_TRUE(storage_controller_->GetBlobShortcutLength(120, &length));
+  EXPECT_EQ(length, 27);
 }
 
 TEST_F(StorageControllerTest, AppendToBlobShortcutFailsWhenFull) {
-  EXPECT_CALL(internal_eeprom_mock_, ReadByte(0x200 + 120, _))
-      .WillOnce(DoAll(SetArgPointee<1>(255), Return(true)));
+  SetCachedBlobShortcutLength(120, 255);
   EXPECT_FALSE(storage_controller_->AppendToBlobShortcut(120, 100, 101));
 }
 
@@ -316,62 +456,63 @@ TEST_F(StorageControllerTest, AppendToBlobShortcutFailsOnInvalidShortcutId) {
   EXPECT_FALSE(storage_controller_->AppendToBlobShortcut(249, 0, 0));
 }
 
-TEST_F(StorageControllerTest, AppendToBlobShortcutFailsOnLengthReadFailure) {
-  EXPECT_CALL(internal_eeprom_mock_, ReadByte(0x200 + 119, _))
-      .WillOnce(Return(false));
-  EXPECT_FALSE(storage_controller_->AppendToBlobShortcut(119, 100, 101));
-}
-
-TEST_F(StorageControllerTest, AppendToBlobShortcutFailsOnLengthWriteFailure) {
-  EXPECT_CALL(internal_eeprom_mock_, ReadByte(0x200 + 120, _))
-      .WillOnce(DoAll(SetArgPointee<1>(10), Return(true)));
-  EXPECT_CALL(eeprom1_mock_, WriteByte((10 * 2), 100)).WillOnce(Return(true));
-  EXPECT_CALL(eeprom1_mock_, WriteByte((10 * 2) + 1, 101))
+TEST_F(StorageControllerTest, CommitStagedBlobShortcutFailsOnLengthWrite) {
+  SetCachedBlobShortcutLength(120, 10);
+  EXPECT_TRUE(storage_controller_->AppendToBlobShortcut(120, 100, 101));
+  EXPECT_CALL(eeprom1_mock_, WriteBytes(10 * 2, _, 2))
       .WillOnce(Return(true));
   EXPECT_CALL(internal_eeprom_mock_, WriteByte(0x200 + 120, 11))
       .WillOnce(Return(false));
-  EXPECT_FALSE(storage_controller_->AppendToBlobShortcut(120, 100, 101));
+  EXPECT_FALSE(storage_controller_->CommitStagedShortcut());
 }
 
-TEST_F(StorageControllerTest, AppendToBlobShortcutFailsOnFirstEeprom0Write) {
-  EXPECT_CALL(internal_eeprom_mock_, ReadByte(0x200 + 119, _))
-      .WillOnce(DoAll(SetArgPointee<1>(10), Return(true)));
-  EXPECT_CALL(eeprom0_mock_, WriteByte(0x1000 + (119 * 512) + (10 * 2), 100))
+TEST_F(StorageControllerTest, CommitStagedBlobShortcutFailsOnEeprom0Write) {
+  SetCachedBlobShortcutLength(119, 10);
+  EXPECT_TRUE(storage_controller_->AppendToBlobShortcut(119, 100, 101));
+  EXPECT_CALL(eeprom0_mock_, WriteBytes(0x1000 + (119 * 512) + (10 * 2), _, 2))
       .WillOnce(Return(false));
-  EXPECT_FALSE(storage_controller_->AppendToBlobShortcut(119, 100, 101));
+  EXPECT_FALSE(storage_controller_->CommitStagedShortcut());
 }
 
-TEST_F(StorageControllerTest, AppendToBlobShortcutFailsOnSecondEeprom0Write) {
-  EXPECT_CALL(internal_eeprom_mock_, ReadByte(0x200 + 119, _))
-      .WillOnce(DoAll(SetArgPointee<1>(10), Return(true)));
-  EXPECT_CALL(eeprom0_mock_, WriteByte(0x1000 + (119 * 512) + (10 * 2), 100))
-      .WillOnce(Return(true));
-  EXPECT_CALL(eeprom0_mock_,
-              WriteByte(0x1000 + (119 * 512) + (10 * 2) + 1, 101))
-      .WillOnce(Return(false));
-  EXPECT_FALSE(storage_controller_->AppendToBlobShortcut(119, 100, 101));
+TEST_F(StorageControllerTest, CommitStagedBlobShortcutFailsOnEeprom1Write) {
+  SetCachedBlobShortcutLength(120, 10);
+  EXPECT_TRUE(storage_controller_->AppendToBlobShortcut(120, 100, 101));
+  EXPECT_CALL(eeprom1_mock_, WriteBytes(10 * 2, _, 2)).WillOnce(Return(false));
+  EXPECT_FALSE(storage_controller_->CommitStagedShortcut());
 }
 
-TEST_F(StorageControllerTest, AppendToBlobShortcutFailsOnFirstEeprom1Write) {
-  EXPECT_CALL(internal_eeprom_mock_, ReadByte(0x200 + 120, _))
-      .WillOnce(DoAll(SetArgPointee<1>(10), Return(true)));
-  EXPECT_CALL(eeprom1_mock_, WriteByte((10 * 2), 100)).WillOnce(Return(false));
-  EXPECT_FALSE(storage_controller_->AppendToBlobShortcut(120, 100, 101));
-}
+TEST_F(StorageControllerTest, SendBlobShortcutCommitsStagedCharacters) {
+  SetCachedBlobShortcutLength(120, 0);
+  EXPECT_TRUE(storage_controller_->AppendToBlobShortcut(120, 0, 1));
 
-TEST_F(StorageControllerTest, AppendToBlobShortcutFailsOnSecondEeprom1Write) {
-  EXPECT_CALL(internal_eeprom_mock_, ReadByte(0x200 + 120, _))
-      .WillOnce(DoAll(SetArgPointee<1>(10), Return(true)));
-  EXPECT_CALL(eeprom1_mock_, WriteByte((10 * 2), 100)).WillOnce(Return(true));
-  EXPECT_CALL(eeprom1_mock_, WriteByte((10 * 2) + 1, 101))
-      .WillOnce(Return(false));
-  EXPECT_FALSE(storage_controller_->AppendToBlobShortcut(120, 100, 101));
+  Sequence sequence;
+  EXPECT_CALL(eeprom1_mock_, WriteBytes(0, _, 2))
+      .InSequence(sequence)
+      .WillOnce(Return(true));
+  EXPECT_CALL(internal_eeprom_mock_, WriteByte(0x200 + 120, 1))
+      .InSequence(sequence)
+      .WillOnce(Return(true));
+  EXPECT_CALL(eeprom1_mock_, ReadBytes(0, _, 2))
+      .InSequence(sequence)
+      .WillOnce(ReadBytesAction(kBlobData.data(), 2));
+  EXPECT_CALL(usb_controller_mock_, TypeKey(0, 1))
+      .InSequence(sequence)
+      .WillOnce(Return(true));
+  EXPECT_CALL(usb_controller_mock_, EndKeySequence())
+      .InSequence(sequence)
+      .WillOnce(Return(true));
+  EXPECT_TRUE(storage_controller_->SendBlobShortcut(120));
 }
 
 TEST_F(StorageControllerTest, ClearBlobShortcutSuccess) {
+  SetCachedBlobShortcutLength(4, 10);
   EXPECT_CALL(internal_eeprom_mock_, WriteByte(0x200 + 4, 0))
       .WillOnce(Return(true));
   EXPECT_TRUE(storage_controller_->ClearBlobShortcut(4));
+
+  uint8_t length = 1;
+  EXPECT_TRUE(storage_controller_->GetBlobShortcutLength(4, &length));
+  EXPECT_EQ(length, 0);
 }
 
 TEST_F(StorageControllerTest, ClearBlobShortcutFailsOnLengthWriteFailure) {
@@ -385,21 +526,12 @@ TEST_F(StorageControllerTest, ClearBlobShortcutFailsOnInvalidShortcutId) {
 }
 
 TEST_F(StorageControllerTest, GetBlobShortcutLengthSuccess) {
-  EXPECT_CALL(internal_eeprom_mock_, ReadByte(0x200 + 10, _))
-      .WillOnce(DoAll(SetArgPointee<1>(101), Return(true)));
+  SetCachedBlobShortcutLength(10, 101);
   uint8_t length = 0;
   EXPECT_TRUE(storage_controller_->GetBlobShortcutLength(10, &length));
   EXPECT_EQ(length, 101);
 }
 
-TEST_F(StorageControllerTest, GetBlobShortcutLengthFailsOnLengthReadFailure) {
-  EXPECT_CALL(internal_eeprom_mock_, ReadByte(0x200 + 10, _))
-      .WillOnce(Return(false));
-  uint8_t length = 0;
-  EXPECT_FALSE(storage_controller_->GetBlobShortcutLength(10, &length));
-  EXPECT_EQ(length, 0);
-}
-
 TEST_F(StorageControllerTest, GetBlobShortcutLengthFailsOnInvalidShortcutId) {
   uint8_t length = 0;
   EXPECT_FALSE(storage_controller_->GetBlobShortcutLength(249, &length));
@@ -407,38 +539,45 @@ TEST_F(StorageControllerTest, GetBlobShortcutLengthFailsOnInvalidShortcutId) {
 }
 
 TEST_F(StorageControllerTest, SendBlobShortcutSuccessEeprom0) {
-  EXPECT_CALL(internal_eeprom_mock_, ReadByte(0x200 + 119, _))
-      .WillOnce(DoAll(SetArgPointee<1>(101), Return(true)));
+  SetCachedBlobShortcutLength(119, 101);
+  // The shortcut is streamed in chunks of 16 characters (32 bytes).
   Sequence seq;
   for (int i = 0; i < 101; ++i) {
-    EXPECT_CALL(eeprom0_mock_, ReadByte(0x1000 + (119 * 512) + (i * 2), _))
-        .InSequence(seq)
-        .WillOnce(DoAll(SetArgPointee<1>(i), Return(true)));
-    EXPECT_CALL(eeprom0_mock_, ReadByte(0x1000 + (119 * 512) + (i * 2) + 1, _))
-        .InSequence(seq)
-        .WillOnce(DoAll(SetArgPointee<1>(i + 1), Return(true)));
-    EXPECT_CALL(usb_controller_mock_, SendKeypress(i, i + 1))
+    if (i % 16 == 0) {
+      uint16_t chunk_length = std::min(101 - i, 16) * 2;
+      EXPECT_CALL(eeprom0_mock_,
+                  ReadBytes(0x1000 + (119 * 512) + (i * 2), _, chunk_length))
+          .InSequence(seq)
+          .WillOnce(ReadBytesAction(kBlobData.data() + (i * 2), chunk_length));
+    }
+    EXPECT_CALL(usb_controller_mock_, TypeKey(i, i + 1))
         .InSequence(seq)
         .WillOnce(Return(true));
   }
+  EXPECT_CALL(usb_controller_mock_, EndKeySequence())
+      .InSequence(seq)
+      .WillOnce(Return(true));
   EXPECT_TRUE(storage_controller_->SendBlobShortcut(119));
 }
 
 TEST_F(StorageControllerTest, SendBlobShortcutSuccessEeprom1) {
-  EXPECT_CALL(internal_eeprom_mock_, ReadByte(0x200 + 120, _))
-      .WillOnce(DoAll(SetArgPointee<1>(101), Return(true)));
+  SetCachedBlobShortcutLength(120, 101);
+  // The shortcut is streamed in chunks of 16 characters (32 bytes).
   Sequence seq;
   for (int i = 0; i < 101; ++i) {
-    EXPECT_CALL(eeprom1_mock_, ReadByte(i * 2, _))
-        .InSequence(seq)
-        .WillOnce(DoAll(SetArgPointee<1>(i), Return(true)));
-    EXPECT_CALL(eeprom1_mock_, ReadByte((i * 2) + 1, _))
-        .InSequence(seq)
-        .WillOnce(DoAll(SetArgPointee<1>(i + 1), Return(true)));
-    EXPECT_CALL(usb_controller_mock_, SendKeypress(i, i + 1))
+    if (i % 16 == 0) {
+      uint16_t chunk_length = std::min(101 - i, 16) * 2;
+      EXPECT_CALL(eeprom1_mock_, ReadBytes(i * 2, _, chunk_length))
+          .InSequence(seq)
+          .WillOnce(ReadBytesAction(kBlobData.data() + (i * 2), chunk_length));
+    }
+    EXPECT_CALL(usb_controller_mock_, TypeKey(i, i + 1))
         .InSequence(seq)
         .WillOnce(Return(true));
   }
+  EXPECT_CALL(usb_controller_mock_, EndKeySequence())
+      .InSequence(seq)
+      .WillOnce(Return(true));
   EXPECT_TRUE(storage_controller_->SendBlobShortcut(120));
 }
 
@@ -446,55 +585,120 @@ TEST_F(StorageControllerTest, SendBlobShortcutFailsOnInvalidShortcutId) {
   EXPECT_FALSE(storage_controller_->SendBlobShortcut(249));
 }
 
-TEST_F(StorageControllerTest, SendBlobShortcutFailsOnLengthReadFailure) {
-  EXPECT_CALL(internal_eeprom_mock_, ReadByte(0x200 + 119, _))
+TEST_F(StorageControllerTest, SendBlobShortcutFailsOnEeprom0ReadFailure) {
+  SetCachedBlobShortcutLength(119, 101);
+  EXPECT_CALL(eeprom0_mock_, ReadBytes(0x1000 + (119 * 512), _, 32))
       .WillOnce(Return(false));
   EXPECT_FALSE(storage_controller_->SendBlobShortcut(119));
 }
 
-TEST_F(StorageControllerTest, SendBlobShortcutFailsOnEeprom0KeyReadFailure) {
-  EXPECT_CALL(internal_eeprom_mock_, ReadByte(0x200 + 119, _))
-      .WillOnce(DoAll(SetArgPointee<1>(101), Return(true)));
-  EXPECT_CALL(eeprom0_mock_, ReadByte(0x1000 + (119 * 512), _))
-      .WillOnce(Return(false));
-  EXPECT_FALSE(storage_controller_->SendBlobShortcut(119));
+TEST_F(StorageControllerTest, SendBlobShortcutFailsOnEeprom1ReadFailure) {
+  SetCachedBlobShortcutLength(120, 101);
+  EXPECT_CALL(eeprom1_mock_, ReadBytes(0, _, 32)).WillOnce(Return(false));
+  EXPECT_FALSE(storage_controller_->SendBlobShortcut(120));
 }
 
-TEST_F(StorageControllerTest, SendBlobShortcutFailsOnEeprom0ModReadFailure) {
-  EXPECT_CALL(internal_eeprom_mock_, ReadByte(0x200 + 119, _))
-      .WillOnce(DoAll(SetArgPointee<1>(101), Return(true)));
-  EXPECT_CALL(eeprom0_mock_, ReadByte(0x1000 + (119 * 512), _))
-      .WillOnce(Return(true));
-  EXPECT_CALL(eeprom0_mock_, ReadByte(0x1000 + (119 * 512) + 1, _))
+TEST_F(StorageControllerTest, SendBlobShortcutFailsOnSecondChunkReadFailure) {
+  SetCachedBlobShortcutLength(120, 101);
+  Sequence seq;
+  EXPECT_CALL(eeprom1_mock_, ReadBytes(0, _, 32))
+      .InSequence(seq)
+      .WillOnce(ReadBytesAction(kBlobData.data(), 32));
+  for (int i = 0; i < 16; ++i) {
+    EXPECT_CALL(usb_controller_mock_, TypeKey(i, i + 1))
+        .InSequence(seq)
+        .WillOnce(Return(true));
+  }
+  EXPECT_CALL(eeprom1_mock_, ReadBytes(32, _, 32))
+      .InSequence(seq)
       .WillOnce(Return(false));
-  EXPECT_FALSE(storage_controller_->SendBlobShortcut(119));
+  EXPECT_FALSE(storage_controller_->SendBlobShortcut(120));
 }
 
-TEST_F(StorageControllerTest, SendBlobShortcutFailsOnEeprom1KeyReadFailure) {
-  EXPECT_CALL(internal_eeprom_mock_, ReadByte(0x200 + 120, _))
-      .WillOnce(DoAll(SetArgPointee<1>(101), Return(true)));
-  EXPECT_CALL(eeprom1_mock_, ReadByte(0, _)).WillOnce(Return(false));
+TEST_F(StorageControllerTest, SendBlobShortcutFailsOnUsbSendFailure) {
+  SetCachedBlobShortcutLength(120, 101);
+  EXPECT_CALL(eeprom1_mock_, ReadBytes(0, _, 32))
+      .WillOnce(ReadBytesAction(kBlobData.data(), 32));
+  EXPECT_CALL(usb_controller_mock_, TypeKey(0, 1))
+      .WillOnce(Return(false));
   EXPECT_FALSE(storage_controller_->SendBlobShortcut(120));
 }
 
-TEST_F(StorageControllerTest, SendBlobShortcutFailsOnEeprom1ModReadFailure) {
-  EXPECT_CALL(internal_eeprom_mock_, ReadByte(0x200 + 120, _))
-      .WillOnce(DoAll(SetArgPointee<1>(101), Return(true)));
-  EXPECT_CALL(eeprom1_mock_, ReadByte(0, _)).WillOnce(Return(true));
-  EXPECT_CALL(eeprom1_mock_, ReadByte(1, _)).WillOnce(Return(false));
-  EXPECT_FALSE(storage_controller_->SendBlobShortcut(120));
+TEST_F(StorageControllerTest, ReadMemoryReadsFromDevice) {
+  EXPECT_CALL(eeprom1_mock_, ReadBytes(0xFFC0, _, 64))
+      .WillOnce(ReadBytesAction(kBlobData.data(), 64));
+  uint8_t data[64];
+  EXPECT_TRUE(storage_controller_->ReadMemory(StorageDevice::EEPROM_1, 0xFFC0,
+                                              data, 64));
+  EXPECT_THAT(data, ElementsAreArray(kBlobData.data(), 64));
 }
 
-TEST_F(StorageControllerTest, SendBlobShortcutFailsOnUsbSendFailure) {
-  EXPECT_CALL(internal_eeprom_mock_, ReadByte(0x200 + 120, _))
-      .WillOnce(DoAll(SetArgPointee<1>(101), Return(true)));
-  EXPECT_CALL(eeprom1_mock_, ReadByte(0, _))
-      .WillOnce(DoAll(SetArgPointee<1>(123), Return(true)));
-  EXPECT_CALL(eeprom1_mock_, ReadByte(1, _))
-      .WillOnce(DoAll(SetArgPointee<1>(456), Return(true)));
-  EXPECT_CALL(usb_controller_mock_, SendKeypress(123, 456))
+TEST_F(StorageControllerTest, ReadMemoryCommitsStagedShortcutFirst) {
+  SetCachedWordShortcutLength(4, 10);
+  EXPECT_TRUE(storage_controller_->AppendToWordShortcut(4, 100));
+  Sequence seq;
+  EXPECT_CALL(eeprom0_mock_, WriteBytes((16 * 4) + 10, _, 1))
+      .InSequence(seq)
+      .WillOnce(Return(true));
+  EXPECT_CALL(internal_eeprom_mock_, WriteByte(0x100 + 4, 11))
+      .InSequence(seq)
+      .WillOnce(Return(true));
+  EXPECT_CALL(eeprom0_mock_, ReadBytes(64, _, 64))
+      .InSequence(seq)
+      .WillOnce(Return(true));
+  uint8_t data[64];
+  EXPECT_TRUE(
+      storage_controller_->ReadMemory(StorageDevice::EEPROM_0, 64, data, 64));
+}
+
+TEST_F(StorageControllerTest, ReadMemoryFailsOutsideOfDevice) {
+  uint8_t data[64];
+  EXPECT_FALSE(storage_controller_->ReadMemory(StorageDevice::INTERNAL_EEPROM,
+                                               1000, data, 64));
+  EXPECT_FALSE(storage_controller_->ReadMemory(StorageDevice::EEPROM_0, 0xFFC1,
+                                               data, 64));
+  EXPECT_FALSE(
+      storage_controller_->ReadMemory((StorageDevice)3, 0, data, 64));
+}
+
+TEST_F(StorageControllerTest, WriteMemoryToExternalEeprom) {
+  EXPECT_CALL(eeprom0_mock_, WriteBytes(0x1000, _, 64))
+      .With(Args<1, 2>(ElementsAreArray(kBlobData.data(), 64)))
+      .WillOnce(Return(true));
+  EXPECT_TRUE(storage_controller_->WriteMemory(StorageDevice::EEPROM_0, 0x1000,
+                                               kBlobData.data(), 64));
+}
+
+TEST_F(StorageControllerTest, WriteMemoryReloadsShortcutLengths) {
+  std::array<uint8_t, 64> lengths{};
+  lengths[4] = 10;
+  EXPECT_CALL(internal_eeprom_mock_, WriteBytes(0x100, _, 64))
+      .WillOnce(Return(true));
+  std::array<uint8_t, 256> word_lengths{};
+  word_lengths[4] = 10;
+  EXPECT_CALL(internal_eeprom_mock_, ReadBytes(0x100, _, 256))
+      .WillOnce(ReadBytesAction(word_lengths.data(), 256));
+  EXPECT_CALL(internal_eeprom_mock_, ReadBytes(0x200, _, 248))
+      .WillOnce(Return(true));
+  EXPECT_TRUE(storage_controller_->WriteMemory(StorageDevice::INTERNAL_EEPROM,
+                                               0x100, lengths.data(), 64));
+  uint8_t length = 0;
+  EXPECT_TRUE(storage_controller_->GetWordShortcutLength(4, &length));
+  EXPECT_EQ(length, 10);
+}
+
+TEST_F(StorageControllerTest, WriteMemoryOfCharacterShortcutsKeepsLengths) {
+  EXPECT_CALL(internal_eeprom_mock_, WriteBytes(0xC0, _, 64))
+      .WillOnce(Return(true));
+  EXPECT_TRUE(storage_controller_->WriteMemory(StorageDevice::INTERNAL_EEPROM,
+                                               0xC0, kBlobData.data(), 64));
+}
+
+TEST_F(StorageControllerTest, WriteMemoryFailsOnWriteFailure) {
+  EXPECT_CALL(internal_eeprom_mock_, WriteBytes(0x100, _, 64))
       .WillOnce(Return(false));
-  EXPECT_FALSE(storage_controller_->SendBlobShortcut(120));
+  EXPECT_FALSE(storage_controller_->WriteMemory(
+      StorageDevice::INTERNAL_EEPROM, 0x100, kBlobData.data(), 64));
 }
 
 }  // namespace
@@ -13,14 +13,16 @@ Threeboard::Threeboard(native::Native *native, EventBuffer *event_buffer,
                        storage::StorageController *storage_controller,
                        LedController *led_controller,
                        KeyController *key_controller,
-                       LayerController *layer_controller)
+                       LayerController *layer_controller,
+                       LatencyTelemetry *latency_telemetry)
     : native_(native),
       event_buffer_(event_buffer),
       usb_controller_(usb_controller),
       storage_controller_(storage_controller),
       led_controller_(led_controller),
       key_controller_(key_controller),
-      layer_controller_(layer_controller) {
+      layer_controller_(layer_controller),
+      latency_telemetry_(latency_telemetry) {
   native_->SetTimerInterruptHandlerDelegate(this);
   native_->EnableTimer1();
   native_->EnableTimer3();
@@ -54,8 +56,10 @@ void Threeboard::HandleTimer1Interrupt() {
 
 void Threeboard::HandleTimer3Interrupt() {
   LOG_ONCE("Timer 3 setup complete");
+  latency_telemetry_->HandleTimer3Interrupt();
   key_controller_->PollKeyState();
   led_controller_->UpdateBlinkStatus();
+  usb_controller_->UpdateIdleTimer();
 
   if (boot_indicator_state_.status > 0) {
     PollBootIndicator();
@@ -74,17 +78,19 @@ void Threeboard::WaitForUsbSetup() {
 }
 
 void Threeboard::WaitForUsbConfiguration() {
-  // Fast busy loop until the USB stack configures. If this never happens it
-  // will continue to loop infinitely, but also blink the error LED.
-  uint8_t iterations = 0;
+  // Fast busy loop until the USB stack configures. It's polled once per USB
+  // frame, so the event loop starts within a frame of the host configuring
+  // the device. If this never happens it will continue to loop infinitely, but
+  // also blink the error LED.
+  uint16_t iterations = 0;
   while (!usb_controller_->HasConfigured()) {
     iterations += 1;
     // After 2.5 seconds, begin flashing the ERR LED.
-    if (iterations > 250) {
+    if (iterations > 2500) {
       LOG_ONCE("Failed to configure USB, continuing to retry");
       led_controller_->GetLedState()->SetErr(LedState::BLINK);
     }
-    native_->DelayMs(10);
+    native_->DelayMs(1);
   }
   led_controller_->GetLedState()->SetErr(LedState::OFF);
 }
@@ -120,20 +126,34 @@ void Threeboard::PollBootIndicator() {
 
 void Threeboard::RunEventLoopIteration() {
   // Atomically check for new keyboard events, and either handle them or
-  // sleep the CPU until the next interrupt.
+  // sleep the CPU until the next interrupt. Reading the event buffer doesn't
+  // need interrupts to be disabled, but checking for work and sleeping does,
+  // so that an interrupt can't add work between the two.
   native_->DisableInterrupts();
   if (event_buffer_->HasKeypressEvent()) {
+    KeypressEvent event = event_buffer_->GetKeypressEvent();
+    // Other keypresses may have been queued since this one was, so its
+    // earlier stages are only recorded now that it's being handled.
+    latency_telemetry_->RecordStage(LatencyTelemetry::Stage::KEY_EDGE,
+                                    event.key_edge_timestamp);
+    latency_telemetry_->RecordStage(LatencyTelemetry::Stage::EVENT_BUFFERED,
+                                    event.buffered_timestamp);
     // Event success status is propagated up through the relevant Layer to
     // here. A false return from HandleEvent indicates that an unrecoverable
     // error occurred during handling of this event.
-    bool status =
-        layer_controller_->HandleEvent(event_buffer_->GetKeypressEvent());
+    bool status = layer_controller_->HandleEvent(event.keypress);
+    latency_telemetry_->RecordStage(LatencyTelemetry::Stage::LAYER_HANDLED);
     if (!status) {
       led_controller_->GetLedState()->SetErr(LedState::PULSE);
     }
 
     // Re-enable interrupts after handling the event.
     native_->EnableInterrupts();
+  } else if (usb::MemoryReport *request = usb_controller_->GetMemoryRequest()) {
+    usb_controller_->CompleteMemoryRequest(HandleMemoryRequest(request));
+    native_->EnableInterrupts();
+  } else if (usb_controller_->IsSuspended()) {
+    SleepUntilUsbResume();
   } else {
     // Sleep the CPU until another interrupt fires.
     native_->EnableCpuSleep();
@@ -143,4 +163,52 @@ void Threeboard::RunEventLoopIteration() {
   }
 }
 
+bool Threeboard::HandleMemoryRequest(usb::MemoryReport *request) {
+  auto device = (storage::StorageDevice)request->device;
+  if (request->command == usb::MemoryReport::Command::READ) {
+    return storage_controller_->ReadMemory(device, request->address,
+                                           request->data,
+                                           usb::hid::kMemoryReportChunkSize);
+  }
+  if (request->command == usb::MemoryReport::Command::WRITE) {
+    return storage_controller_->WriteMemory(device, request->address,
+                                            request->data,
+                                            usb::hid::kMemoryReportChunkSize);
+  }
+  return false;
+}
+
+void Threeboard::SleepUntilUsbResume() {
+  // Stop everything that draws power while the host has suspended the bus. The
+  // LED state is kept, and shown again once the timers restart.
+  native_->DisableTimer1();
+  native_->DisableTimer3();
+  led_controller_->TurnOffAllLeds();
+  key_controller_->EnableWakeOnKeypress();
+  native_->EnablePowerDownSleepMode();
+  // Interrupts are still disabled from the event loop, so the bus can't resume
+  // between checking and sleeping. In power-down sleep, only the USB wakeup
+  // interrupt and the keys' pin change interrupt can wake the CPU.
+  while (usb_controller_->IsSuspended()) {
+    native_->EnableCpuSleep();
+    native_->EnableInterrupts();
+    native_->SleepCpu();
+    native_->DisableCpuSleep();
+    native_->DisableInterrupts();
+    // A keypress asks the host to resume the bus, if it has allowed it. The
+    // keypress itself isn't handled, since the keys weren't being polled.
+    if (key_controller_->IsAnyKeyPressed() &&
+        usb_controller_->RequestRemoteWakeup()) {
+      // Power-down stops the clock that the USB controller needs to drive the
+      // resume signal, so only idle sleep until the host resumes the bus.
+      native_->DisablePowerDownSleepMode();
+    }
+  }
+  native_->DisablePowerDownSleepMode();
+  key_controller_->DisableWakeOnKeypress();
+  native_->EnableTimer1();
+  native_->EnableTimer3();
+  native_->EnableInterrupts();
+}
+
 }  // namespace threeboard
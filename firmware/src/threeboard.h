@@ -2,6 +2,7 @@
 
 #include "src/event_buffer.h"
 #include "src/key_controller.h"
+#include "src/latency_telemetry.h"
 #include "src/layers/layer_controller.h"
 #include "src/led_controller.h"
 #include "src/native/native.h"
@@ -18,7 +19,8 @@ class Threeboard final : public TimerInterruptHandlerDelegate {
              usb::UsbController *usb_controller,
              storage::StorageController *storage_controller,
              LedController *led_controller, KeyController *key_controller,
-             LayerController *layer_controller);
+             LayerController *layer_controller,
+             LatencyTelemetry *latency_telemetry);
   ~Threeboard() override = default;
 
   // Main application event loop.
@@ -39,6 +41,7 @@ class Threeboard final : public TimerInterruptHandlerDelegate {
   LedController *led_controller_;
   KeyController *key_controller_;
   LayerController *layer_controller_;
+  LatencyTelemetry *latency_telemetry_;
 
   // A small bit-packed struct to store the state of the LED boot indicator
   // sequence in a single byte.
@@ -59,6 +62,12 @@ class Threeboard final : public TimerInterruptHandlerDelegate {
   void DisplayBootIndicator();
   void PollBootIndicator();
   void RunEventLoopIteration();
+  // Read or write shortcut memory as requested by the host on the vendor USB
+  // interface. Returns false if the request failed.
+  bool HandleMemoryRequest(usb::MemoryReport *request);
+  // Put the device into power-down sleep while the USB bus is suspended, and
+  // restore it once the bus resumes. Must be called with interrupts disabled.
+  void SleepUntilUsbResume();
 };
 
 }  // namespace threeboard
@@ -1,13 +1,16 @@
 #include "threeboard.h"
 
 #include <memory>
+#include <utility>
 
 #include "src/event_buffer.h"
 #include "src/key_controller_mock.h"
+#include "src/latency_telemetry_mock.h"
 #include "src/layers/layer_controller_mock.h"
 #include "src/led_controller_mock.h"
 #include "src/logging_fake.h"
 #include "src/native/native_mock.h"
+#include "src/storage/storage_controller_mock.h"
 #include "src/usb/usb_controller_mock.h"
 
 using ::testing::_;
@@ -25,8 +28,9 @@ class ThreeboardTest : public ::testing::Test {
     EXPECT_CALL(native_mock_, EnableTimer1()).Times(1);
     EXPECT_CALL(native_mock_, EnableTimer3()).Times(1);
     threeboard_ = std::make_unique<Threeboard>(
-        &native_mock_, &event_buffer_, &usb_controller_mock_, nullptr,
-        &led_controller_mock_, &key_controller_mock_, &layer_controller_mock_);
+        &native_mock_, &event_buffer_, &usb_controller_mock_,
+        &storage_controller_mock_, &led_controller_mock_, &key_controller_mock_,
+        &layer_controller_mock_, &latency_telemetry_mock_);
   }
 
   void WaitForUsbSetup() { threeboard_->WaitForUsbSetup(); }
@@ -35,16 +39,20 @@ class ThreeboardTest : public ::testing::Test {
   void RunTimer3Invocation() {
     EXPECT_CALL(led_controller_mock_, UpdateBlinkStatus()).Times(1);
     EXPECT_CALL(key_controller_mock_, PollKeyState()).Times(1);
+    EXPECT_CALL(usb_controller_mock_, UpdateIdleTimer()).Times(1);
+    EXPECT_CALL(latency_telemetry_mock_, HandleTimer3Interrupt()).Times(1);
     threeboard_->HandleTimer3Interrupt();
   }
   void EnableBootIndicator() { threeboard_->DisplayBootIndicator(); }
 
   native::NativeMock native_mock_;
   usb::UsbControllerMock usb_controller_mock_;
-  EventBuffer event_buffer_;
+  storage::StorageControllerMock storage_controller_mock_;
   LedControllerMock led_controller_mock_;
   KeyControllerMock key_controller_mock_;
   LayerControllerMock layer_controller_mock_;
+  LatencyTelemetryMock latency_telemetry_mock_;
+  EventBuffer event_buffer_{&latency_telemetry_mock_};
   LedState led_state_;
   LoggingFake logging_fake_;
   std::unique_ptr<Threeboard> threeboard_;
@@ -58,6 +66,8 @@ TEST_F(ThreeboardTest, CorrectlyHandleTimer1Interrupt) {
 TEST_F(ThreeboardTest, CorrectlyHandleTimer3Interrupt) {
   EXPECT_CALL(led_controller_mock_, UpdateBlinkStatus()).Times(1);
   EXPECT_CALL(key_controller_mock_, PollKeyState()).Times(1);
+  EXPECT_CALL(usb_controller_mock_, UpdateIdleTimer()).Times(1);
+  EXPECT_CALL(latency_telemetry_mock_, HandleTimer3Interrupt()).Times(1);
   threeboard_->HandleTimer3Interrupt();
 }
 
@@ -80,7 +90,7 @@ TEST_F(ThreeboardTest, RetryOnUsbSetupFailure) {
 
 TEST_F(ThreeboardTest, RetryOnUsbConfigureFailure) {
   Sequence seq;
-  EXPECT_CALL(native_mock_, DelayMs(10)).Times(10).WillRepeatedly(Return());
+  EXPECT_CALL(native_mock_, DelayMs(1)).Times(10).WillRepeatedly(Return());
   EXPECT_CALL(usb_controller_mock_, HasConfigured())
       .Times(10)
       .InSequence(seq)
@@ -97,9 +107,9 @@ TEST_F(ThreeboardTest, RetryOnUsbConfigureFailure) {
 
 TEST_F(ThreeboardTest, BlinkErrorOnRepeatedUsbConfigureFailure) {
   Sequence seq;
-  EXPECT_CALL(native_mock_, DelayMs(10)).Times(251).WillRepeatedly(Return());
+  EXPECT_CALL(native_mock_, DelayMs(1)).Times(2501).WillRepeatedly(Return());
   EXPECT_CALL(usb_controller_mock_, HasConfigured())
-      .Times(251)
+      .Times(2501)
       .InSequence(seq)
       .WillRepeatedly(Return(false));
   EXPECT_CALL(usb_controller_mock_, HasConfigured())
@@ -116,21 +126,36 @@ TEST_F(ThreeboardTest, BlinkErrorOnRepeatedUsbConfigureFailure) {
 
 TEST_F(ThreeboardTest, EventLoopIterationWithEvent) {
   // Add an event to the event buffer.
-  event_buffer_.HandleKeypress(Keypress::X);
+  EXPECT_CALL(latency_telemetry_mock_, GetTimestamp()).WillOnce(Return(20));
+  event_buffer_.HandleKeypress(Keypress::X, 10);
   EXPECT_CALL(native_mock_, DisableInterrupts()).Times(1);
+  EXPECT_CALL(latency_telemetry_mock_,
+              RecordStage(LatencyTelemetry::Stage::KEY_EDGE, 10))
+      .Times(1);
+  EXPECT_CALL(latency_telemetry_mock_,
+              RecordStage(LatencyTelemetry::Stage::EVENT_BUFFERED, 20))
+      .Times(1);
   EXPECT_CALL(layer_controller_mock_, HandleEvent(Keypress::X))
       .WillOnce(Return(true));
+  EXPECT_CALL(latency_telemetry_mock_,
+              RecordStage(LatencyTelemetry::Stage::LAYER_HANDLED))
+      .Times(1);
   EXPECT_CALL(native_mock_, EnableInterrupts()).Times(1);
 
   RunEventLoopIteration();
 }
 
 TEST_F(ThreeboardTest, EventLoopIterationWithFailedEvent) {
-  event_buffer_.HandleKeypress(Keypress::X);
+  EXPECT_CALL(latency_telemetry_mock_, GetTimestamp()).WillOnce(Return(0));
+  event_buffer_.HandleKeypress(Keypress::X, 0);
   EXPECT_CALL(native_mock_, DisableInterrupts()).Times(1);
+  EXPECT_CALL(latency_telemetry_mock_, RecordStage(_, 0)).Times(2);
   // Simulate an error during handling of the event.
   EXPECT_CALL(layer_controller_mock_, HandleEvent(Keypress::X))
       .WillOnce(Return(false));
+  EXPECT_CALL(latency_telemetry_mock_,
+              RecordStage(LatencyTelemetry::Stage::LAYER_HANDLED))
+      .Times(1);
   EXPECT_CALL(led_controller_mock_, GetLedState())
       .WillOnce(Return(&led_state_));
   EXPECT_CALL(native_mock_, EnableInterrupts()).Times(1);
@@ -140,7 +165,43 @@ TEST_F(ThreeboardTest, EventLoopIterationWithFailedEvent) {
   EXPECT_EQ(led_state_.GetErr()->state, LedState::PULSE);
 }
 
+TEST_F(ThreeboardTest, EventLoopIterationsTimeQueuedEventsSeparately) {
+  // Queue two events before the event loop handles either of them.
+  EXPECT_CALL(latency_telemetry_mock_, GetTimestamp())
+      .WillOnce(Return(20))
+      .WillOnce(Return(40));
+  event_buffer_.HandleKeypress(Keypress::X, 10);
+  event_buffer_.HandleKeypress(Keypress::Y, 30);
+
+  // Each event's stages are recorded with its own timestamps when it's
+  // handled, rather than when it was queued.
+  testing::InSequence sequence;
+  for (auto [keypress, timestamp] : {std::pair(Keypress::X, 10u),
+                                     std::pair(Keypress::Y, 30u)}) {
+    EXPECT_CALL(native_mock_, DisableInterrupts()).Times(1);
+    EXPECT_CALL(latency_telemetry_mock_,
+                RecordStage(LatencyTelemetry::Stage::KEY_EDGE, timestamp))
+        .Times(1);
+    EXPECT_CALL(latency_telemetry_mock_,
+                RecordStage(LatencyTelemetry::Stage::EVENT_BUFFERED,
+                            timestamp + 10))
+        .Times(1);
+    EXPECT_CALL(layer_controller_mock_, HandleEvent(keypress))
+        .WillOnce(Return(true));
+    EXPECT_CALL(latency_telemetry_mock_,
+                RecordStage(LatencyTelemetry::Stage::LAYER_HANDLED))
+        .Times(1);
+    EXPECT_CALL(native_mock_, EnableInterrupts()).Times(1);
+  }
+
+  RunEventLoopIteration();
+  RunEventLoopIteration();
+}
+
 TEST_F(ThreeboardTest, EventLoopIterationWithNoEvent) {
+  EXPECT_CALL(usb_controller_mock_, GetMemoryRequest())
+      .WillOnce(Return(nullptr));
+  EXPECT_CALL(usb_controller_mock_, IsSuspended()).WillOnce(Return(false));
   EXPECT_CALL(native_mock_, DisableInterrupts()).Times(1);
   EXPECT_CALL(native_mock_, EnableCpuSleep()).Times(1);
   EXPECT_CALL(native_mock_, EnableInterrupts()).Times(1);
@@ -150,6 +211,126 @@ TEST_F(ThreeboardTest, EventLoopIterationWithNoEvent) {
   RunEventLoopIteration();
 }
 
+TEST_F(ThreeboardTest, EventLoopIterationHandlesMemoryWrite) {
+  usb::MemoryReport request = {};
+  request.command = usb::MemoryReport::Command::WRITE;
+  request.device = (uint8_t)storage::StorageDevice::EEPROM_1;
+  request.address = 0x40;
+  EXPECT_CALL(native_mock_, DisableInterrupts()).Times(1);
+  EXPECT_CALL(usb_controller_mock_, GetMemoryRequest())
+      .WillOnce(Return(&request));
+  EXPECT_CALL(storage_controller_mock_,
+              WriteMemory(storage::StorageDevice::EEPROM_1, 0x40, request.data,
+                          usb::hid::kMemoryReportChunkSize))
+      .WillOnce(Return(true));
+  EXPECT_CALL(usb_controller_mock_, CompleteMemoryRequest(true)).Times(1);
+  EXPECT_CALL(native_mock_, EnableInterrupts()).Times(1);
+
+  RunEventLoopIteration();
+}
+
+TEST_F(ThreeboardTest, EventLoopIterationHandlesFailedMemoryRead) {
+  usb::MemoryReport request = {};
+  request.command = usb::MemoryReport::Command::READ;
+  request.device = (uint8_t)storage::StorageDevice::INTERNAL_EEPROM;
+  request.address = 0x3C0;
+  EXPECT_CALL(native_mock_, DisableInterrupts()).Times(1);
+  EXPECT_CALL(usb_controller_mock_, GetMemoryRequest())
+      .WillOnce(Return(&request));
+  EXPECT_CALL(storage_controller_mock_,
+              ReadMemory(storage::StorageDevice::INTERNAL_EEPROM, 0x3C0,
+                         request.data, usb::hid::kMemoryReportChunkSize))
+      .WillOnce(Return(false));
+  EXPECT_CALL(usb_controller_mock_, CompleteMemoryRequest(false)).Times(1);
+  EXPECT_CALL(native_mock_, EnableInterrupts()).Times(1);
+
+  RunEventLoopIteration();
+}
+
+TEST_F(ThreeboardTest, EventLoopIterationFailsUnknownMemoryCommand) {
+  usb::MemoryReport request = {};
+  request.command = (usb::MemoryReport::Command)0;
+  EXPECT_CALL(native_mock_, DisableInterrupts()).Times(1);
+  EXPECT_CALL(usb_controller_mock_, GetMemoryRequest())
+      .WillOnce(Return(&request));
+  EXPECT_CALL(usb_controller_mock_, CompleteMemoryRequest(false)).Times(1);
+  EXPECT_CALL(native_mock_, EnableInterrupts()).Times(1);
+
+  RunEventLoopIteration();
+}
+
+TEST_F(ThreeboardTest, EventLoopIterationSleepsWhileUsbIsSuspended) {
+  EXPECT_CALL(usb_controller_mock_, GetMemoryRequest())
+      .WillOnce(Return(nullptr));
+  EXPECT_CALL(usb_controller_mock_, IsSuspended())
+      .WillOnce(Return(true))
+      .WillOnce(Return(true))
+      .WillOnce(Return(false));
+  EXPECT_CALL(native_mock_, DisableTimer1()).Times(1);
+  EXPECT_CALL(native_mock_, DisableTimer3()).Times(1);
+  EXPECT_CALL(led_controller_mock_, TurnOffAllLeds()).Times(1);
+  EXPECT_CALL(key_controller_mock_, EnableWakeOnKeypress()).Times(1);
+  EXPECT_CALL(native_mock_, EnablePowerDownSleepMode()).Times(1);
+  EXPECT_CALL(native_mock_, EnableCpuSleep()).Times(1);
+  EXPECT_CALL(native_mock_, SleepCpu()).Times(1);
+  EXPECT_CALL(native_mock_, DisableCpuSleep()).Times(1);
+  EXPECT_CALL(native_mock_, DisableInterrupts()).Times(2);
+  // The CPU was woken by the host resuming the bus, not a keypress.
+  EXPECT_CALL(key_controller_mock_, IsAnyKeyPressed()).WillOnce(Return(false));
+  EXPECT_CALL(native_mock_, DisablePowerDownSleepMode()).Times(1);
+  EXPECT_CALL(key_controller_mock_, DisableWakeOnKeypress()).Times(1);
+  EXPECT_CALL(native_mock_, EnableTimer1()).Times(1);
+  EXPECT_CALL(native_mock_, EnableTimer3()).Times(1);
+  EXPECT_CALL(native_mock_, EnableInterrupts()).Times(2);
+
+  RunEventLoopIteration();
+}
+
+TEST_F(ThreeboardTest, KeypressWhileUsbIsSuspendedRequestsRemoteWakeup) {
+  EXPECT_CALL(usb_controller_mock_, GetMemoryRequest())
+      .WillOnce(Return(nullptr));
+  EXPECT_CALL(usb_controller_mock_, IsSuspended())
+      .WillOnce(Return(true))
+      .WillOnce(Return(true))
+      .WillOnce(Return(true))
+      .WillOnce(Return(false));
+  EXPECT_CALL(native_mock_, DisableTimer1());
+  EXPECT_CALL(native_mock_, DisableTimer3());
+  EXPECT_CALL(led_controller_mock_, TurnOffAllLeds());
+  EXPECT_CALL(key_controller_mock_, EnableWakeOnKeypress());
+  EXPECT_CALL(native_mock_, EnableCpuSleep()).Times(2);
+  EXPECT_CALL(native_mock_, DisableCpuSleep()).Times(2);
+  EXPECT_CALL(native_mock_, DisableInterrupts()).Times(3);
+  Sequence seq;
+  EXPECT_CALL(native_mock_, EnablePowerDownSleepMode()).InSequence(seq);
+  EXPECT_CALL(native_mock_, SleepCpu()).InSequence(seq);
+  EXPECT_CALL(key_controller_mock_, IsAnyKeyPressed())
+      .InSequence(seq)
+      .WillOnce(Return(true));
+  EXPECT_CALL(usb_controller_mock_, RequestRemoteWakeup())
+      .InSequence(seq)
+      .WillOnce(Return(true));
+  // The CPU mustn't return to power-down sleep while the USB controller is
+  // signalling the host to resume the bus.
+  EXPECT_CALL(native_mock_, DisablePowerDownSleepMode()).InSequence(seq);
+  EXPECT_CALL(native_mock_, SleepCpu()).InSequence(seq);
+  // The wakeup was already requested, so holding the key doesn't request it
+  // again.
+  EXPECT_CALL(key_controller_mock_, IsAnyKeyPressed())
+      .InSequence(seq)
+      .WillOnce(Return(true));
+  EXPECT_CALL(usb_controller_mock_, RequestRemoteWakeup())
+      .InSequence(seq)
+      .WillOnce(Return(false));
+  EXPECT_CALL(native_mock_, DisablePowerDownSleepMode()).InSequence(seq);
+  EXPECT_CALL(key_controller_mock_, DisableWakeOnKeypress());
+  EXPECT_CALL(native_mock_, EnableTimer1());
+  EXPECT_CALL(native_mock_, EnableTimer3());
+  EXPECT_CALL(native_mock_, EnableInterrupts()).Times(3);
+
+  RunEventLoopIteration();
+}
+
 TEST_F(ThreeboardTest, DisplayBootIndicator) {
   {
     EXPECT_CALL(native_mock_, DelayMs(255)).Times(1);
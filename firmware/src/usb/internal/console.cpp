@@ -0,0 +1,62 @@
+#include "console.h"
+
+#include "src/util/util.h"
+
+namespace threeboard {
+namespace usb {
+namespace {
+
+// Terminals expect both a carriage return and a line feed.
+constexpr char kLineBreak[] = "\r\n";
+
+}  // namespace
+
+Console::Console(native::Native *native) : native_(native) {}
+
+void Console::Write(const char *message) {
+  uint8_t message_length = 0;
+  while (message[message_length] != 0) {
+    // Messages that can't fit in the buffer are dropped anyway, so there's no
+    // need to count past its size.
+    if (++message_length == cdc::kConsoleBufferSize) {
+      return;
+    }
+  }
+  // Drop the whole message rather than sending part of it.
+  if (length_ + message_length + sizeof(kLineBreak) - 1 >
+      cdc::kConsoleBufferSize) {
+    return;
+  }
+  uint8_t tail = (head_ + length_) % cdc::kConsoleBufferSize;
+  for (uint8_t i = 0; i < message_length; ++i) {
+    buffer_[tail] = message[i];
+    tail = (tail + 1) % cdc::kConsoleBufferSize;
+  }
+  for (uint8_t i = 0; i < sizeof(kLineBreak) - 1; ++i) {
+    buffer_[tail] = kLineBreak[i];
+    tail = (tail + 1) % cdc::kConsoleBufferSize;
+  }
+  length_ += message_length + sizeof(kLineBreak) - 1;
+}
+
+bool Console::HasPendingData() const {
+  return length_ > 0 || send_zero_length_packet_;
+}
+
+void Console::SendNextPacket() {
+  uint8_t length =
+      util::min(length_, descriptor::kConsoleDataEndpointMaxPacketSize);
+  for (uint8_t i = 0; i < length; ++i) {
+    native_->SetUEDATX(buffer_[head_]);
+    head_ = (head_ + 1) % cdc::kConsoleBufferSize;
+  }
+  length_ -= length;
+  send_zero_length_packet_ =
+      length == descriptor::kConsoleDataEndpointMaxPacketSize;
+  // Hand the bank to the controller by clearing TXINI and FIFOCON.
+  native_->SetUEINTX((1 << native::RWAL) | (1 << native::NAKOUTI) |
+                     (1 << native::RXSTPI) | (1 << native::STALLEDI));
+}
+
+}  // namespace usb
+}  // namespace threeboard
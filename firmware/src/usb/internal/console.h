@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "src/native/native.h"
+#include "src/usb/shared/constants.h"
+
+namespace threeboard {
+namespace usb {
+
+// A ring buffer of log output waiting to be read by the host from the CDC-ACM
+// console's data IN endpoint. Writing never blocks: a message that doesn't fit
+// in the buffer is dropped, so logging can't stall the firmware while no
+// terminal is reading the console.
+class Console {
+ public:
+  explicit Console(native::Native *native);
+
+  // Append a log message to the buffer, followed by a line break. Must be
+  // called with interrupts disabled, since the buffer is drained by the start
+  // of frame interrupt.
+  void Write(const char *message);
+
+  // Returns true if there's output, or the zero length packet that ends a
+  // transfer, waiting to be sent.
+  bool HasPendingData() const;
+
+  // Write the next packet of output to the data IN endpoint, which must be
+  // selected and have a free bank.
+  void SendNextPacket();
+
+ private:
+  native::Native *native_;
+
+  char buffer_[cdc::kConsoleBufferSize];
+  uint8_t head_ = 0;
+  uint8_t length_ = 0;
+  // Set when the last packet was full, in which case a zero length packet is
+  // needed so the host doesn't wait for more data before returning it.
+  bool send_zero_length_packet_ = false;
+};
+}  // namespace usb
+}  // namespace threeboard
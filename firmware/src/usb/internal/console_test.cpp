@@ -0,0 +1,93 @@
+#include "console.h"
+
+#include <string>
+
+#include "src/native/native_mock.h"
+
+namespace threeboard {
+namespace usb {
+namespace {
+
+using ::testing::_;
+using ::testing::AnyNumber;
+using ::testing::Invoke;
+
+class ConsoleTest : public ::testing::Test {
+ public:
+  ConsoleTest() : console_(&native_mock_) {
+    EXPECT_CALL(native_mock_, SetUEDATX(_))
+        .Times(AnyNumber())
+        .WillRepeatedly(Invoke([&](uint8_t data) { fifo_.push_back(data); }));
+  }
+
+  // Send the next packet to the host, and return its contents.
+  std::string SendNextPacket() {
+    fifo_.clear();
+    EXPECT_CALL(native_mock_, SetUEINTX((1 << native::RWAL) |
+                                        (1 << native::NAKOUTI) |
+                                        (1 << native::RXSTPI) |
+                                        (1 << native::STALLEDI)));
+    console_.SendNextPacket();
+    return fifo_;
+  }
+
+  native::NativeMock native_mock_;
+  Console console_;
+  std::string fifo_;
+};
+
+TEST_F(ConsoleTest, NothingPendingInitially) {
+  EXPECT_FALSE(console_.HasPendingData());
+}
+
+TEST_F(ConsoleTest, SendsMessageWithLineBreak) {
+  console_.Write("hello");
+  EXPECT_TRUE(console_.HasPendingData());
+  EXPECT_EQ(SendNextPacket(), "hello\r\n");
+  EXPECT_FALSE(console_.HasPendingData());
+}
+
+TEST_F(ConsoleTest, SendsMessagesInOrderAroundBuffer) {
+  std::string message(40, 'a');
+  console_.Write(message.c_str());
+  console_.Write("b");
+  EXPECT_EQ(SendNextPacket(), message + "\r\nb\r\n");
+  EXPECT_FALSE(console_.HasPendingData());
+
+  // Messages wrap around the end of the buffer.
+  std::string long_message(100, 'c');
+  console_.Write(long_message.c_str());
+  std::string sent = SendNextPacket();
+  sent += SendNextPacket();
+  EXPECT_EQ(sent, long_message + "\r\n");
+}
+
+TEST_F(ConsoleTest, SendsZeroLengthPacketAfterFullPacket) {
+  std::string message(62, 'a');
+  console_.Write(message.c_str());
+  EXPECT_EQ(SendNextPacket().size(), 64);
+  EXPECT_TRUE(console_.HasPendingData());
+  EXPECT_TRUE(SendNextPacket().empty());
+  EXPECT_FALSE(console_.HasPendingData());
+}
+
+TEST_F(ConsoleTest, DropsMessagesThatDontFit) {
+  std::string message(100, 'a');
+  console_.Write(message.c_str());
+  // Only 26 bytes are left, so a 25 byte message doesn't fit with its line
+  // break, but a 24 byte message does.
+  console_.Write(std::string(25, 'b').c_str());
+  console_.Write(std::string(24, 'c').c_str());
+  std::string sent = SendNextPacket();
+  sent += SendNextPacket();
+  EXPECT_EQ(sent, message + "\r\n" + std::string(24, 'c') + "\r\n");
+}
+
+TEST_F(ConsoleTest, DropsMessagesLongerThanBuffer) {
+  console_.Write(std::string(200, 'a').c_str());
+  EXPECT_FALSE(console_.HasPendingData());
+}
+
+}  // namespace
+}  // namespace usb
+}  // namespace threeboard
@@ -8,26 +8,30 @@
 namespace threeboard {
 namespace usb {
 
-// A container for a generic descriptor. Used in a list as a descriptor lookup
-// table. Requires packed attribute to avoid alignment when compiling for x86.
-struct __attribute__((__packed__)) DescriptorContainer {
-  DescriptorId id;
-  uint16_t index;
-  const uint8_t *data;
+// The location of a descriptor in program memory. `data` is a void pointer so
+// that descriptors can be referred to in constant expressions, which don't
+// allow reinterpret_cast.
+struct DescriptorEntry {
+  const void *data;
   uint8_t length;
-
-  static DescriptorContainer ParseFromProgmem(native::Native *native,
-                                              const uint8_t *ptr);
 };
 
-// The top-level USB device descriptor.
+// The top-level USB device descriptor. Builds with the USB console declare that
+// they use interface association descriptors, otherwise the device class comes
+// from each interface descriptor.
 static constexpr DeviceDescriptor PROGMEM device_descriptor = {
     .bLength = 18,
     .bDescriptorType = DescriptorType::DEVICE,
     .bcdUSB = descriptor::kUsbSpecificationReleaseNumber,
+#ifdef THREEBOARD_USB_CONSOLE
+    .bDeviceClass = descriptor::kMiscellaneousDeviceClassCode,
+    .bDeviceSubClass = descriptor::kCommonClassSubclassCode,
+    .bDeviceProtocol = descriptor::kInterfaceAssociationProtocol,
+#else
     .bDeviceClass = descriptor::kBaseDeviceClassCode,
     .bDeviceSubClass = descriptor::kBaseDeviceSubclassCode,
     .bDeviceProtocol = descriptor::kBaseDeviceProtocol,
+#endif
     .bMaxPacketSize0 = k32BytePacketSize,
     .idVendor = kVendorId,
     .idProduct = kProductId,
@@ -39,8 +43,12 @@ static constexpr DeviceDescriptor PROGMEM device_descriptor = {
 
 // The HID report object for the keyboard. The format of this object is quite
 // nasty and obscure, and I think it would be even more confusing if it were
-// strictly typed. It's taken from the example from the HID spec v1.11, section
-// E.6.
+// strictly typed. It's based on the example from the HID spec v1.11, section
+// E.6, but the keys are reported as a bitmap rather than an array of 6 keys, so
+// any number of keys can be pressed in a single report (N-key rollover). This
+// only describes the report protocol; hosts that select the boot protocol use
+// the fixed boot report format instead. The read-only feature report is the
+// LatencyReport, the keypress latency telemetry.
 static constexpr uint8_t PROGMEM hid_report[] = {
     0x05, 0x01,  // Usage Page (Generic Desktop)
     0x09, 0x06,  // Usage (Keyboard)
@@ -49,13 +57,10 @@ static constexpr uint8_t PROGMEM hid_report[] = {
     0x19, 0xE0,  //   Usage Minimum (224)
     0x29, 0xE7,  //   Usage Maximum (231)
     0x15, 0x00,  //   Logical Minimum (0)
-    0x25, 0x01,  //   Logical Minimum (1)
+    0x25, 0x01,  //   Logical Maximum (1)
     0x75, 0x01,  //   Report Size (1)
     0x95, 0x08,  //   Report Count (8)
     0x81, 0x02,  //   Input (Data, Variable, Absolute)
-    0x95, 0x01,  //   Report Count (1)
-    0x75, 0x08,  //   Report Size (8)
-    0x81, 0x01,  //   Input (Constant)
     0x95, 0x05,  //   Report Count (5)
     0x75, 0x01,  //   Report Size (1)
     0x05, 0x08,  //   Usage Page (Page# for LEDs)
@@ -65,22 +70,59 @@ static constexpr uint8_t PROGMEM hid_report[] = {
     0x95, 0x01,  //   Report Count (1)
     0x75, 0x03,  //   Report Size (3)
     0x91, 0x01,  //   Output (Constant)
-    0x95, 0x06,  //   Report Count (6)
-    0x75, 0x08,  //   Report Size (8)
+    0x95, 0x68,  //   Report Count (104)
+    0x75, 0x01,  //   Report Size (1)
     0x15, 0x00,  //   Logical Minimum (0)
-    0x25, 0x65,  //   Logical Maximum(101)
+    0x25, 0x01,  //   Logical Maximum (1)
     0x05, 0x07,  //   Usage Page (Key Codes)
     0x19, 0x00,  //   Usage Minimum (0)
-    0x29, 0x65,  //   Usage Maximum (101)
-    0x81, 0x00,  //   Input (Data, Array)
+    0x29, 0x67,  //   Usage Maximum (103)
+    0x81, 0x02,  //   Input (Data, Variable, Absolute)
+    0x06, 0x00, 0xFF,  //   Usage Page (Vendor Defined 0xFF00)
+    0x09, 0x03,        //   Usage (3)
+    0x15, 0x00,        //   Logical Minimum (0)
+    0x26, 0xFF, 0x00,  //   Logical Maximum (255)
+    0x75, 0x08,        //   Report Size (8)
+    0x95, hid::kLatencyReportSize,  //   Report Count
+    0xB1, 0x03,  //   Feature (Constant, Variable, Absolute)
     0xC0         // End Collection
 };
 
+// The HID report object for the vendor-defined interface. It has a single
+// feature report, the MemoryReport, which is opaque to the host's HID driver.
+static constexpr uint8_t PROGMEM vendor_hid_report[] = {
+    0x06, 0x00, 0xFF,  // Usage Page (Vendor Defined 0xFF00)
+    0x09, 0x01,        // Usage (1)
+    0xA1, 0x01,        // Collection (Application)
+    0x09, 0x02,        //   Usage (2)
+    0x15, 0x00,        //   Logical Minimum (0)
+    0x26, 0xFF, 0x00,  //   Logical Maximum (255)
+    0x75, 0x08,        //   Report Size (8)
+    0x95, hid::kMemoryReportSize,  //   Report Count
+    0xB1, 0x02,        //   Feature (Data, Variable, Absolute)
+    0xC0               // End Collection
+};
+
 struct CombinedDescriptor {
   ConfigurationDescriptor configuration_descriptor;
   InterfaceDescriptor interface_descriptor;
   HidDescriptor hid_descriptor;
   EndpointDescriptor endpoint_descriptor;
+  InterfaceDescriptor vendor_interface_descriptor;
+  HidDescriptor vendor_hid_descriptor;
+  EndpointDescriptor vendor_endpoint_descriptor;
+#ifdef THREEBOARD_USB_CONSOLE
+  InterfaceAssociationDescriptor console_association_descriptor;
+  InterfaceDescriptor console_control_interface_descriptor;
+  CdcHeaderDescriptor console_header_descriptor;
+  CdcCallManagementDescriptor console_call_management_descriptor;
+  CdcAbstractControlManagementDescriptor console_acm_descriptor;
+  CdcUnionDescriptor console_union_descriptor;
+  EndpointDescriptor console_notification_endpoint_descriptor;
+  InterfaceDescriptor console_data_interface_descriptor;
+  EndpointDescriptor console_data_out_endpoint_descriptor;
+  EndpointDescriptor console_data_in_endpoint_descriptor;
+#endif
 };
 
 // The CombinedDescriptor is a collection of all additional (i.e. non-device)
@@ -121,14 +163,149 @@ static constexpr CombinedDescriptor PROGMEM combined_descriptor = {
             .bReportDescriptorType = DescriptorType::HID_REPORT,
             .wReportDescriptorLength = sizeof(hid_report),
         },
-    .endpoint_descriptor = {
+    .endpoint_descriptor =
+        {
+            .bLength = 7,
+            .bDescriptorType = DescriptorType::ENDPOINT,
+            .bEndpointAddress = descriptor::kKeyboardEndpoint |
+                                descriptor::kEndpointPipeTypeIn,
+            .bmAttributes = descriptor::kKeyboardEndpointAttributes,
+            .wMaxPacketSize = descriptor::kKeyboardEndpointMaxPacketSize,
+            .bInterval = 1,
+        },
+    .vendor_interface_descriptor =
+        {
+            .bLength = 9,
+            .bDescriptorType = DescriptorType::INTERFACE,
+            .bInterfaceNumber = descriptor::kVendorInterfaceIndex,
+            .bAlternateSetting = 0,
+            .bNumEndpoints = 1,
+            .bInterfaceClass = hid::kHidClassCode,
+            .bInterfaceSubClass = hid::kNoSubclassCode,
+            .bInterfaceProtocol = hid::kNoInterfaceProtocol,
+            .iInterface = 0,
+        },
+    .vendor_hid_descriptor =
+        {
+            .bLength = 9,
+            .bDescriptorType = DescriptorType::HID,
+            .bcdHID = hid::kSpecificationComplianceVersion,
+            .bCountryCode = hid::kNotLocalized,
+            .bNumDescriptors = 1,
+            .bReportDescriptorType = DescriptorType::HID_REPORT,
+            .wReportDescriptorLength = sizeof(vendor_hid_report),
+        },
+    .vendor_endpoint_descriptor = {
         .bLength = 7,
         .bDescriptorType = DescriptorType::ENDPOINT,
         .bEndpointAddress =
-            descriptor::kKeyboardEndpoint | descriptor::kEndpointPipeTypeIn,
+            descriptor::kVendorEndpoint | descriptor::kEndpointPipeTypeIn,
         .bmAttributes = descriptor::kKeyboardEndpointAttributes,
-        .wMaxPacketSize = descriptor::kKeyboardEndpointMaxPacketSize,
-        .bInterval = 1}};
+        .wMaxPacketSize = descriptor::kVendorEndpointMaxPacketSize,
+        // The endpoint is never used, so ask the host to poll it as rarely as
+        // possible.
+        .bInterval = 255},
+#ifdef THREEBOARD_USB_CONSOLE
+    // The CDC-ACM console, which appears to the host as a serial port that log
+    // output can be read from.
+    .console_association_descriptor =
+        {
+            .bLength = 8,
+            .bDescriptorType = DescriptorType::INTERFACE_ASSOCIATION,
+            .bFirstInterface = descriptor::kConsoleControlInterfaceIndex,
+            .bInterfaceCount = 2,
+            .bFunctionClass = cdc::kCommunicationsClassCode,
+            .bFunctionSubClass = cdc::kAbstractControlModelSubclassCode,
+            .bFunctionProtocol = cdc::kNoProtocol,
+            .iFunction = 0,
+        },
+    .console_control_interface_descriptor =
+        {
+            .bLength = 9,
+            .bDescriptorType = DescriptorType::INTERFACE,
+            .bInterfaceNumber = descriptor::kConsoleControlInterfaceIndex,
+            .bAlternateSetting = 0,
+            .bNumEndpoints = 1,
+            .bInterfaceClass = cdc::kCommunicationsClassCode,
+            .bInterfaceSubClass = cdc::kAbstractControlModelSubclassCode,
+            .bInterfaceProtocol = cdc::kNoProtocol,
+            .iInterface = 0,
+        },
+    .console_header_descriptor =
+        {
+            .bLength = 5,
+            .bDescriptorType = DescriptorType::CDC_INTERFACE,
+            .bDescriptorSubtype = CdcDescriptorSubtype::HEADER,
+            .bcdCDC = cdc::kSpecificationReleaseNumber,
+        },
+    .console_call_management_descriptor =
+        {
+            .bLength = 5,
+            .bDescriptorType = DescriptorType::CDC_INTERFACE,
+            .bDescriptorSubtype = CdcDescriptorSubtype::CALL_MANAGEMENT,
+            .bmCapabilities = 0,
+            .bDataInterface = descriptor::kConsoleDataInterfaceIndex,
+        },
+    .console_acm_descriptor =
+        {
+            .bLength = 4,
+            .bDescriptorType = DescriptorType::CDC_INTERFACE,
+            .bDescriptorSubtype =
+                CdcDescriptorSubtype::ABSTRACT_CONTROL_MANAGEMENT,
+            .bmCapabilities = cdc::kAbstractControlModelCapabilities,
+        },
+    .console_union_descriptor =
+        {
+            .bLength = 5,
+            .bDescriptorType = DescriptorType::CDC_INTERFACE,
+            .bDescriptorSubtype = CdcDescriptorSubtype::UNION,
+            .bMasterInterface = descriptor::kConsoleControlInterfaceIndex,
+            .bSlaveInterface0 = descriptor::kConsoleDataInterfaceIndex,
+        },
+    .console_notification_endpoint_descriptor =
+        {
+            .bLength = 7,
+            .bDescriptorType = DescriptorType::ENDPOINT,
+            .bEndpointAddress = descriptor::kConsoleNotificationEndpoint |
+                                descriptor::kEndpointPipeTypeIn,
+            .bmAttributes = descriptor::kKeyboardEndpointAttributes,
+            .wMaxPacketSize =
+                descriptor::kConsoleNotificationEndpointMaxPacketSize,
+            .bInterval = 255,
+        },
+    .console_data_interface_descriptor =
+        {
+            .bLength = 9,
+            .bDescriptorType = DescriptorType::INTERFACE,
+            .bInterfaceNumber = descriptor::kConsoleDataInterfaceIndex,
+            .bAlternateSetting = 0,
+            .bNumEndpoints = 2,
+            .bInterfaceClass = cdc::kDataClassCode,
+            .bInterfaceSubClass = 0,
+            .bInterfaceProtocol = cdc::kNoProtocol,
+            .iInterface = 0,
+        },
+    .console_data_out_endpoint_descriptor =
+        {
+            .bLength = 7,
+            .bDescriptorType = DescriptorType::ENDPOINT,
+            .bEndpointAddress = descriptor::kConsoleDataOutEndpoint,
+            .bmAttributes = descriptor::kBulkEndpointAttributes,
+            .wMaxPacketSize = descriptor::kConsoleDataEndpointMaxPacketSize,
+            .bInterval = 0,
+        },
+    .console_data_in_endpoint_descriptor =
+        {
+            .bLength = 7,
+            .bDescriptorType = DescriptorType::ENDPOINT,
+            .bEndpointAddress = descriptor::kConsoleDataInEndpoint |
+                                descriptor::kEndpointPipeTypeIn,
+            .bmAttributes = descriptor::kBulkEndpointAttributes,
+            .wMaxPacketSize = descriptor::kConsoleDataEndpointMaxPacketSize,
+            .bInterval = 0,
+        },
+#endif
+};
 
 // Define all of the string descriptors we send from this device. The
 // supported_languages descriptor is mandatory, the others are just so the host
@@ -147,40 +324,56 @@ static constexpr UnicodeStringDescriptor<14> PROGMEM product = {
     .bDescriptorType = DescriptorType::STRING,
     .bString = L"threeboard v1"};
 
-// This table defines which descriptor data is sent for each specific
-// GetDescriptor request from the host, for a given DescriptorValue.
-// This can't be constexpr because of the implicit reinterpret_cast operations
-// used to convert the descriptors into uint8_t* values for transmission.
-static const DescriptorContainer PROGMEM descriptor_list[] = {
-    {.id = DescriptorType::DEVICE,
-     .index = 0,
-     .data = (uint8_t *)&device_descriptor,
-     .length = sizeof(device_descriptor)},
-    {.id = DescriptorType::CONFIGURATION,
-     .index = 0,
-     .data = (uint8_t *)&combined_descriptor,
-     .length = sizeof(combined_descriptor)},
-    {.id = DescriptorType::HID_REPORT,
-     .index = descriptor::kKeyboardInterfaceIndex,
-     .data = hid_report,
-     .length = sizeof(hid_report)},
-    {.id = DescriptorType::HID,
-     .index = descriptor::kKeyboardInterfaceIndex,
-     // TODO: i'm 99% sure this is UB. But it works.
-     .data = (uint8_t *)(void *)&combined_descriptor.hid_descriptor,
-     .length = combined_descriptor.hid_descriptor.bLength},
-    {.id = {DescriptorType::STRING, 0},
-     .index = 0,
-     .data = (uint8_t *)&supported_languages,
-     .length = supported_languages.bLength},
-    {.id = {DescriptorType::STRING, 1},
-     .index = descriptor::kLanguageIdEnglish,
-     .data = (uint8_t *)&manufacturer,
-     .length = manufacturer.bLength},
-    {.id = {DescriptorType::STRING, 2},
-     .index = descriptor::kLanguageIdEnglish,
-     .data = (uint8_t *)&product,
-     .length = product.bLength}};
+// Returns the descriptor data sent in response to a GetDescriptor request
+// from the host, for a given DescriptorId. HID class descriptors belong to the
+// interface given by `interface`. Data is nullptr if there's no such
+// descriptor. This is resolved from the descriptor type and index without
+// reading from program memory, so it takes constant time.
+constexpr DescriptorEntry FindDescriptor(const DescriptorId &id,
+                                         uint16_t interface = 0) {
+  if (id.GetType() == DescriptorType::STRING) {
+    switch (id.GetIndex()) {
+      case 0:
+        return {&supported_languages, supported_languages.bLength};
+      case 1:
+        return {&manufacturer, manufacturer.bLength};
+      case 2:
+        return {&product, product.bLength};
+      default:
+        return {nullptr, 0};
+    }
+  }
+  // There's only one of every other type of descriptor.
+  if (id.GetIndex() != 0) {
+    return {nullptr, 0};
+  }
+  switch (id.GetType()) {
+    case DescriptorType::DEVICE:
+      return {&device_descriptor, sizeof(device_descriptor)};
+    case DescriptorType::CONFIGURATION:
+      return {&combined_descriptor, sizeof(combined_descriptor)};
+    case DescriptorType::HID:
+      if (interface == descriptor::kVendorInterfaceIndex) {
+        return {&combined_descriptor.vendor_hid_descriptor,
+                combined_descriptor.vendor_hid_descriptor.bLength};
+      }
+      return {&combined_descriptor.hid_descriptor,
+              combined_descriptor.hid_descriptor.bLength};
+    case DescriptorType::HID_REPORT:
+      if (interface == descriptor::kVendorInterfaceIndex) {
+        return {vendor_hid_report, sizeof(vendor_hid_report)};
+      }
+      return {hid_report, sizeof(hid_report)};
+    default:
+      return {nullptr, 0};
+  }
+}
+
+static_assert(FindDescriptor(DescriptorType::DEVICE).length == 18);
+static_assert(FindDescriptor({DescriptorType::STRING, 3}).data == nullptr);
+static_assert(FindDescriptor(DescriptorType::HID_REPORT,
+                             descriptor::kVendorInterfaceIndex)
+                  .data == vendor_hid_report);
 
 }  // namespace usb
 }  // namespace threeboard
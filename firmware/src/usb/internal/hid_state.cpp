@@ -0,0 +1,30 @@
+#include "hid_state.h"
+
+namespace threeboard {
+namespace usb {
+
+void WriteHidReport(native::Native *native, const HidReport &report,
+                    uint8_t protocol) {
+  native->SetUEDATX(report.modifier_keys);
+  if (protocol == hid::kBootProtocol) {
+    native->SetUEDATX(0);
+    for (uint8_t i = 0; i < hid::kBootReportKeyCount; ++i) {
+      native->SetUEDATX(report.keyboard_keys[i]);
+    }
+    return;
+  }
+  uint8_t key_bitmap[hid::kKeyBitmapSize] = {};
+  for (uint8_t key : report.keyboard_keys) {
+    // Keys outside of the bitmap can't be reported, but they're also outside
+    // the range of keys supported by the report descriptor.
+    if (key != 0 && key < hid::kKeyBitmapSize * 8) {
+      key_bitmap[key / 8] |= 1 << (key % 8);
+    }
+  }
+  for (uint8_t data : key_bitmap) {
+    native->SetUEDATX(data);
+  }
+}
+
+}  // namespace usb
+}  // namespace threeboard
@@ -2,32 +2,84 @@
 
 #include <stdint.h>
 
+#include "src/native/native.h"
+#include "src/usb/shared/constants.h"
+#include "src/usb/shared/protocol.h"
+
 namespace threeboard {
 namespace usb {
 
+// The maximum number of keys in a single report. Boot protocol reports can
+// only hold the first hid::kBootReportKeyCount of them.
+constexpr uint8_t kMaxReportKeyCount = 14;
+
+// The keys pressed in a single keyboard report, independent of the protocol
+// used to send it to the host.
+struct HidReport {
+  uint8_t modifier_keys = 0;
+  // Pressed keys in the order they were pressed. Zero when not pressed.
+  uint8_t keyboard_keys[kMaxReportKeyCount] = {};
+};
+
+// Write a report to the current endpoint's FIFO, in the format of the given
+// protocol. Boot protocol reports are a modifier byte, a reserved byte and up
+// to 6 keys (HID spec v1.11, appendix B.1). Report protocol reports are a
+// modifier byte followed by a bitmap of pressed keys, as described by the
+// report descriptor.
+void WriteHidReport(native::Native *native, const HidReport &report,
+                    uint8_t protocol);
+
 // State of the HID device which can be read and mutated by the USB handlers.
 struct HidState {
   // The configuration of the USB device, set by the host. Zero when not
   // configured, non-zero after enumeration.
   volatile uint8_t configuration = 0;
 
-  // Currently pressed modifier keys. Zero when not pressed.
-  uint8_t modifier_keys = 0;
-
-  // Currently pressed keyboard keys. USB supports up to 6 concurrent
-  // keypresses, plus modifier key byte. Zero when not pressed.
-  uint8_t keyboard_keys[6] = {0, 0, 0, 0, 0, 0};
+  // Currently pressed keys, as last reported to the host.
+  HidReport report;
 
-  // Protocol setting from the host. This is unused, but we need to store it so
-  // we can report it back to the host in GetProtocol.
-  uint8_t protocol = 1;
+  // Protocol setting from the host, which selects the format of reports.
+  uint8_t protocol = hid::kReportProtocol;
 
-  // Host-configurable reporting timeout when idle, in ms. We send a new HID
-  // report to the host every `idle_config` ms, even if nothing has changed.
+  // Host-configurable reporting timeout when idle, in units of 4ms (HID spec
+  // v1.11, section 7.2.4). We send a new HID report to the host every
+  // `idle_config` * 4ms, even if nothing has changed. Zero disables idle
+  // reports.
   uint8_t idle_config = 125;
 
-  // Used to count up to `idle_config` for HID reporting.
-  uint8_t idle_count = 0;
+  // Time since the last report was read by the host, in ms. Used to count up
+  // to `idle_config` for HID reporting.
+  uint16_t idle_elapsed_ms = 0;
+
+  // The keyboard LED states (num lock, caps lock, etc.) from the most recent
+  // output report sent by the host with SET_REPORT. Bit layout defined by the
+  // LED usage page in the report descriptor.
+  uint8_t led_state = 0;
+
+  // Set when the host has enabled remote wakeup with SET_FEATURE, allowing a
+  // keypress to wake it from suspend.
+  bool remote_wakeup_enabled = false;
+
+  // Set when the host has halted the keyboard endpoint with SET_FEATURE, and
+  // cleared again by CLEAR_FEATURE or when the device is configured.
+  bool keyboard_endpoint_halted = false;
+
+  // The most recent memory report sent by the host on the vendor interface,
+  // which is replaced by its result once the event loop has handled it. The
+  // report is only written by the interrupt handler while the status isn't
+  // BUSY, and only by the event loop while it is.
+  MemoryReport memory_report;
+  volatile MemoryReport::Status memory_report_status =
+      MemoryReport::Status::IDLE;
+
+#ifdef THREEBOARD_USB_CONSOLE
+  // The serial port settings of the console, as set by the host.
+  LineCoding line_coding;
+
+  // Set while a terminal on the host has the console open, which is when log
+  // output is sent to it.
+  volatile bool console_open = false;
+#endif
 };
 }  // namespace usb
 }  // namespace threeboard
@@ -7,10 +7,10 @@ namespace threeboard {
 namespace usb {
 namespace {
 
-constexpr uint8_t GetDescriptorListSize() {
-  return sizeof(descriptor_list) / sizeof(DescriptorContainer);
-}
-
+// Wait for the endpoint 0 bank to be free. Single packet replies are written
+// directly after the SETUP packet has been handshaked, when the bank is already
+// free, so this doesn't wait in practice. Longer transfers are driven by the
+// TXINI interrupt instead.
 void AwaitTransmitterReady(native::Native *native) {
   while (!(native->GetUEINTX() & (1 << native::TXINI)))
     ;
@@ -20,38 +20,58 @@ void HandshakeTransmitterInterrupt(native::Native *native) {
   native->SetUEINTX(~(1 << native::TXINI));
 }
 
-// Find the DescriptorContainer from the descriptor_list in PROGMEM that matches
-// the DescriptorType of this packet.
-bool FindMatchingContainer(native::Native *native, const SetupPacket &packet,
-                           DescriptorContainer *descriptor) {
-  const DescriptorContainer *ptr = descriptor_list;
-  // Find the first descriptor with a matching descriptor value.
-  uint8_t i = 0;
-  for (; i < GetDescriptorListSize(); i++, ptr++) {
-    DescriptorId id = native->ReadPgmWord((uint8_t *)ptr);
-    if (id == packet.wValue) {
-      *descriptor =
-          DescriptorContainer::ParseFromProgmem(native, (uint8_t *)ptr);
-      return true;
-    }
-  }
-  return false;
+// Reply to the current request on endpoint 0 with STALL. The controller clears
+// the stall automatically when the next SETUP packet arrives.
+void Stall(native::Native *native) {
+  native->SetUECONX((1 << native::STALLRQ) | (1 << native::EPEN));
 }
+
 }  // namespace
 
 RequestHandler::RequestHandler(native::Native *native) : native_(native) {}
 
-// Called when the host requests the status of the device.
-void RequestHandler::HandleGetStatus() {
+// Called when the host requests the status of the device, an interface or an
+// endpoint. The response is always two bytes (USB spec rev. 2.0, section
+// 9.4.5).
+void RequestHandler::HandleGetStatus(const SetupPacket &packet,
+                                     const HidState &hid_state) {
+  // For the device, bit 0 = 0 indicates that this device is not self-powered
+  // (it relies on bus power), and bit 1 indicates whether the host has enabled
+  // remote wakeup. Interface status is reserved, and always zero.
+  uint8_t status = 0;
+  if (packet.bmRequestType.GetRecipient() == RequestType::Recipient::DEVICE) {
+    status = hid_state.remote_wakeup_enabled << 1;
+  } else if (packet.bmRequestType.GetRecipient() ==
+             RequestType::Recipient::ENDPOINT) {
+    uint8_t endpoint = packet.wIndex & 0x7F;
+    if (endpoint == descriptor::kKeyboardEndpoint) {
+      // Bit 0 is set if the endpoint is halted.
+      status = hid_state.keyboard_endpoint_halted;
+    } else if (endpoint != 0) {
+      Stall(native_);
+      return;
+    }
+  }
   AwaitTransmitterReady(native_);
-  // The response only contains two status bits. Bit 0 = 0 indicates that this
-  // device is not self-powered (it relies on bus power), and bit 1 = 0
-  // indicates that the device does not support remote wakeup. We send this
-  // response directly into the data register.
+  native_->SetUEDATX(status);
   native_->SetUEDATX(0);
   HandshakeTransmitterInterrupt(native_);
 }
 
+// Clears a feature of the device. The features supported are remote wakeup,
+// and the halt feature of the keyboard endpoint.
+void RequestHandler::HandleClearFeature(const SetupPacket &packet,
+                                        HidState *hid_state) {
+  UpdateFeature(packet, hid_state, false);
+}
+
+// Sets a feature of the device. The features supported are remote wakeup, and
+// the halt feature of the keyboard endpoint.
+void RequestHandler::HandleSetFeature(const SetupPacket &packet,
+                                      HidState *hid_state) {
+  UpdateFeature(packet, hid_state, true);
+}
+
 // Allows the host to set the USB address of this device.
 void RequestHandler::HandleSetAddress(const SetupPacket &packet) {
   // TODO: USB spec section 9.4.6 specifies different behaviours here for
@@ -60,38 +80,29 @@ void RequestHandler::HandleSetAddress(const SetupPacket &packet) {
   // wValue contains the 7-bit address. The highest-order bit of the request
   // is unspecified.
   native_->SetUDADDR(packet.wValue);
-  AwaitTransmitterReady(native_);
-  // Enable the address by setting the highest-order bit (a feature of the
-  // microcontroller, not the USB protocol).
-  native_->SetUDADDR(native_->GetUDADDR() | (1 << native::ADDEN));
+  // The address can't be enabled until the host has read the status packet,
+  // which was sent to the old address.
+  SetControlStage(ControlStage::STATUS_IN_SET_ADDRESS);
 }
 
 // Returns a descriptor as requested by the host, if such a descriptor exists.
 void RequestHandler::HandleGetDescriptor(const SetupPacket &packet) {
-  DescriptorContainer container;
-  bool found = FindMatchingContainer(native_, packet, &container);
-  if (!found) {
-    // Stall if we can't find a matching DescriptorContainer. This is an
-    // unrecoverable error.
-    native_->SetUECONX((1 << native::STALLRQ) | (1 << native::EPEN));
+  DescriptorEntry descriptor = FindDescriptor(packet.wValue, packet.wIndex);
+  if (descriptor.data == nullptr) {
+    // Stall if we can't find a matching descriptor. This is an unrecoverable
+    // error.
+    Stall(native_);
     return;
   }
 
-  // Send the descriptor to the host.
-  uint16_t remaining_packet_length =
-      util::min(util::min(packet.wLength, 255), container.length);
-  uint16_t current_frame_length = 0;
-  while (remaining_packet_length > 0 ||
-         current_frame_length == k32BytePacketSize) {
-    AwaitTransmitterReady(native_);
-    current_frame_length =
-        util::min(remaining_packet_length, k32BytePacketSize);
-    for (uint16_t i = current_frame_length; i > 0; i--) {
-      native_->SetUEDATX(native_->ReadPgmByte(container.data++));
-    }
-    remaining_packet_length -= current_frame_length;
-    HandshakeTransmitterInterrupt(native_);
-  }
+  // Send the descriptor to the host from the TXINI interrupt, one packet at a
+  // time.
+  data_ = static_cast<const uint8_t *>(descriptor.data);
+  data_remaining_ =
+      util::min(util::min(packet.wLength, 255), descriptor.length);
+  data_in_program_memory_ = true;
+  send_zero_length_packet_ = false;
+  SetControlStage(ControlStage::DATA_IN);
 }
 
 // Replies with the current Configuration of the device.
@@ -106,6 +117,7 @@ void RequestHandler::HandleSetConfiguration(const SetupPacket &packet,
                                             HidState *hid_state) {
   HandshakeTransmitterInterrupt(native_);
   hid_state->configuration = packet.wValue;
+  hid_state->keyboard_endpoint_halted = false;
 
   // Make sure the host isn't trying to set us in a configuration we don't
   // support.
@@ -113,18 +125,79 @@ void RequestHandler::HandleSetConfiguration(const SetupPacket &packet,
     return;
   }
 
-  // Configure the only endpoint needed for the threeboard, the
-  // interrupt-based keyboard endpoint.
+  // Endpoints are allocated in ascending order, since the controller packs
+  // their banks into its memory in endpoint order (atmega32u4 datasheet,
+  // section 22.6).
+  // Configure the interrupt-based keyboard endpoint, which all keypresses are
+  // sent on.
   native_->SetUENUM(descriptor::kKeyboardEndpoint);
   native_->SetUECONX(1 << native::EPEN);
   native_->SetUECFG0X(kEndpointTypeInterrupt | kEndpointDirectionIn);
-  native_->SetUECFG1X(kEndpointDoubleBank | kEndpointAlloc);
+  // Double bank the endpoint, so that a report can be written to the FIFO
+  // while the previous one is still waiting to be read by the host. Report
+  // protocol reports need the 16 byte packet size.
+  native_->SetUECFG1X(k16BytePacketSize | kEndpointDoubleBank | kEndpointAlloc);
+
+  // Configure the vendor interface's endpoint, which is never written to.
+  native_->SetUENUM(descriptor::kVendorEndpoint);
+  native_->SetUECONX(1 << native::EPEN);
+  native_->SetUECFG0X(kEndpointTypeInterrupt | kEndpointDirectionIn);
+  native_->SetUECFG1X(k8BytePacketSize | kEndpointAlloc);
+  uint8_t endpoints = (1 << descriptor::kKeyboardEndpoint) |
+                      (1 << descriptor::kVendorEndpoint);
 
-  // Reset the keyboard endpoint to enable it.
-  native_->SetUERST(1 << descriptor::kKeyboardEndpoint);
+#ifdef THREEBOARD_USB_CONSOLE
+  // Configure the console's endpoints. Only the data IN endpoint is written
+  // to, and it's double banked so log output can be written while the host
+  // reads the previous packet.
+  hid_state->console_open = false;
+  native_->SetUENUM(descriptor::kConsoleNotificationEndpoint);
+  native_->SetUECONX(1 << native::EPEN);
+  native_->SetUECFG0X(kEndpointTypeInterrupt | kEndpointDirectionIn);
+  native_->SetUECFG1X(k8BytePacketSize | kEndpointAlloc);
+  native_->SetUENUM(descriptor::kConsoleDataOutEndpoint);
+  native_->SetUECONX(1 << native::EPEN);
+  native_->SetUECFG0X(kEndpointTypeBulk);
+  native_->SetUECFG1X(k64BytePacketSize | kEndpointAlloc);
+  native_->SetUENUM(descriptor::kConsoleDataInEndpoint);
+  native_->SetUECONX(1 << native::EPEN);
+  native_->SetUECFG0X(kEndpointTypeBulk | kEndpointDirectionIn);
+  native_->SetUECFG1X(k64BytePacketSize | kEndpointDoubleBank | kEndpointAlloc);
+  endpoints |= (1 << descriptor::kConsoleNotificationEndpoint) |
+               (1 << descriptor::kConsoleDataOutEndpoint) |
+               (1 << descriptor::kConsoleDataInEndpoint);
+#endif
+
+  // Reset the endpoints to enable them.
+  native_->SetUERST(endpoints);
   native_->SetUERST(0);
 }
 
+// Replies with the alternate setting of an interface. Each interface only has
+// one, so this is always zero. Only valid once the device is configured.
+void RequestHandler::HandleGetInterface(const SetupPacket &packet,
+                                        const HidState &hid_state) {
+  if (!hid_state.configuration || packet.wIndex >= hid::kNumInterfaces) {
+    Stall(native_);
+    return;
+  }
+  AwaitTransmitterReady(native_);
+  native_->SetUEDATX(0);
+  HandshakeTransmitterInterrupt(native_);
+}
+
+// Allows the host to select an alternate setting of an interface. Selecting
+// the only setting it has is acknowledged, anything else stalls.
+void RequestHandler::HandleSetInterface(const SetupPacket &packet,
+                                        const HidState &hid_state) {
+  if (!hid_state.configuration || packet.wIndex >= hid::kNumInterfaces ||
+      packet.wValue != 0) {
+    Stall(native_);
+    return;
+  }
+  HandshakeTransmitterInterrupt(native_);
+}
+
 // Replies with the state of the keyboard keys and modifier keys. Response
 // protocol defined by HID spec v1.11, section B.1.
 // TODO: this will always return zeroes, since the state is sent to the host in
@@ -132,14 +205,28 @@ void RequestHandler::HandleSetConfiguration(const SetupPacket &packet,
 // missed?
 void RequestHandler::HandleGetReport(const HidState &hid_state) {
   AwaitTransmitterReady(native_);
-  native_->SetUEDATX(hid_state.modifier_keys);
-  native_->SetUEDATX(0);
-  for (auto &keyboard_key : hid_state.keyboard_keys) {
-    native_->SetUEDATX(keyboard_key);
-  }
+  WriteHidReport(native_, hid_state.report, hid_state.protocol);
   HandshakeTransmitterInterrupt(native_);
 }
 
+// Receives an output report from the host, which contains the state of the
+// keyboard LEDs (e.g. caps lock). The report arrives in the data stage, so it's
+// stored by the RXOUTI interrupt that follows. The report type is in the high
+// byte of wValue.
+void RequestHandler::HandleSetReport(const SetupPacket &packet,
+                                     HidState *hid_state) {
+  if ((packet.wValue >> 8) != (uint8_t)ReportType::OUTPUT ||
+      packet.wLength == 0) {
+    Stall(native_);
+    return;
+  }
+  // The output report is a single byte of LED states in both protocols.
+  output_data_ = &hid_state->led_state;
+  output_remaining_ = 1;
+  memory_report_state_ = nullptr;
+  SetControlStage(ControlStage::DATA_OUT);
+}
+
 // Get the idle config of the device.
 void RequestHandler::HandleGetIdle(const HidState &hid_state) {
   AwaitTransmitterReady(native_);
@@ -147,27 +234,234 @@ void RequestHandler::HandleGetIdle(const HidState &hid_state) {
   HandshakeTransmitterInterrupt(native_);
 }
 
-// Set the idle config of the device. It determines how frequently to send
-// HidState on SOFI.
+// Set the idle config of the device. It determines how frequently HidState is
+// repeated to the host while nothing changes.
 void RequestHandler::HandleSetIdle(const SetupPacket &packet,
                                    HidState *hid_state) {
   HandshakeTransmitterInterrupt(native_);
   hid_state->idle_config = (packet.wValue >> 8);
-  hid_state->idle_count = 0;
+  hid_state->idle_elapsed_ms = 0;
 }
 
-// Get the current HID protocol. We only use one.
+// Get the current HID protocol.
 void RequestHandler::HandleGetProtocol(const HidState &hid_state) {
   AwaitTransmitterReady(native_);
   native_->SetUEDATX(hid_state.protocol);
   HandshakeTransmitterInterrupt(native_);
 }
 
-// Set the current HID protocol.
+// Set the current HID protocol. Hosts that don't parse report descriptors
+// (e.g. a BIOS) select the boot protocol, and every report sent after this
+// uses the selected protocol's format.
 void RequestHandler::HandleSetProtocol(const SetupPacket &packet,
                                        HidState *hid_state) {
   HandshakeTransmitterInterrupt(native_);
   hid_state->protocol = packet.wValue;
 }
+
+// Replies with the latency report, the keyboard interface's feature report. The
+// report is sent straight from SRAM, so a keypress handled during the transfer
+// can make it slightly inconsistent.
+void RequestHandler::HandleGetLatencyReport(const SetupPacket &packet,
+                                            const LatencyReport &report) {
+  data_ = reinterpret_cast<const uint8_t *>(&report);
+  data_remaining_ = util::min(packet.wLength, sizeof(LatencyReport));
+  data_in_program_memory_ = false;
+  send_zero_length_packet_ = false;
+  SetControlStage(ControlStage::DATA_IN);
+}
+
+// Replies with the memory report, which holds the result of the last command
+// once its status is no longer BUSY.
+void RequestHandler::HandleGetMemoryReport(const SetupPacket &packet,
+                                           HidState *hid_state) {
+  if ((packet.wValue >> 8) != (uint8_t)ReportType::FEATURE) {
+    Stall(native_);
+    return;
+  }
+  hid_state->memory_report.status = hid_state->memory_report_status;
+  data_ = reinterpret_cast<const uint8_t *>(&hid_state->memory_report);
+  data_remaining_ = util::min(packet.wLength, sizeof(MemoryReport));
+  data_in_program_memory_ = false;
+  send_zero_length_packet_ = false;
+  SetControlStage(ControlStage::DATA_IN);
+}
+
+// Receives a memory command from the host, which spans several packets of the
+// data stage. Commands can't be sent while the previous one is still being
+// handled.
+void RequestHandler::HandleSetMemoryReport(const SetupPacket &packet,
+                                           HidState *hid_state) {
+  if ((packet.wValue >> 8) != (uint8_t)ReportType::FEATURE ||
+      packet.wLength != sizeof(MemoryReport) ||
+      hid_state->memory_report_status == MemoryReport::Status::BUSY) {
+    Stall(native_);
+    return;
+  }
+  output_data_ = reinterpret_cast<uint8_t *>(&hid_state->memory_report);
+  output_remaining_ = sizeof(MemoryReport);
+  memory_report_state_ = hid_state;
+  SetControlStage(ControlStage::DATA_OUT);
+}
+
+#ifdef THREEBOARD_USB_CONSOLE
+// Receives the console's serial port settings in the data stage. They're only
+// stored so they can be read back, since the console isn't a real serial port.
+void RequestHandler::HandleSetLineCoding(const SetupPacket &packet,
+                                         HidState *hid_state) {
+  if (packet.wLength != sizeof(LineCoding)) {
+    Stall(native_);
+    return;
+  }
+  output_data_ = reinterpret_cast<uint8_t *>(&hid_state->line_coding);
+  output_remaining_ = sizeof(LineCoding);
+  memory_report_state_ = nullptr;
+  SetControlStage(ControlStage::DATA_OUT);
+}
+
+// Replies with the console's serial port settings.
+void RequestHandler::HandleGetLineCoding(const SetupPacket &packet,
+                                         const HidState &hid_state) {
+  data_ = reinterpret_cast<const uint8_t *>(&hid_state.line_coding);
+  data_remaining_ = util::min(packet.wLength, sizeof(LineCoding));
+  data_in_program_memory_ = false;
+  send_zero_length_packet_ = false;
+  SetControlStage(ControlStage::DATA_IN);
+}
+
+// The host sets DTR when a terminal opens the console, and clears it when the
+// terminal closes it.
+void RequestHandler::HandleSetControlLineState(const SetupPacket &packet,
+                                               HidState *hid_state) {
+  HandshakeTransmitterInterrupt(native_);
+  hid_state->console_open = packet.wValue & cdc::kDataTerminalReady;
+}
+#endif
+
+void RequestHandler::HandleUnsupportedRequest() { Stall(native_); }
+
+void RequestHandler::HandleControlInterrupt(uint8_t interrupt) {
+  if ((interrupt & (1 << native::RXOUTI)) &&
+      control_stage_ == ControlStage::DATA_OUT) {
+    // Every packet but the last is full. Any bytes beyond the expected data
+    // are discarded when the bank is released.
+    uint8_t length = util::min(output_remaining_, k32BytePacketSize);
+    for (uint8_t i = 0; i < length; ++i) {
+      *output_data_++ = native_->GetUEDATX();
+    }
+    output_remaining_ -= length;
+    native_->SetUEINTX(~(1 << native::RXOUTI));
+    if (output_remaining_ > 0) {
+      return;
+    }
+    // End the control write with a zero length status packet.
+    AwaitTransmitterReady(native_);
+    HandshakeTransmitterInterrupt(native_);
+    if (memory_report_state_ != nullptr) {
+      memory_report_state_->memory_report_status = MemoryReport::Status::BUSY;
+      memory_report_state_ = nullptr;
+    }
+    SetControlStage(ControlStage::SETUP);
+    return;
+  }
+  if ((interrupt & (1 << native::RXOUTI)) &&
+      (control_stage_ == ControlStage::DATA_IN ||
+       control_stage_ == ControlStage::STATUS_OUT)) {
+    // The host ended the control read, possibly before reading all of the
+    // data if it didn't need it.
+    native_->SetUEINTX(~(1 << native::RXOUTI));
+    SetControlStage(ControlStage::SETUP);
+    return;
+  }
+  if ((interrupt & (1 << native::TXINI)) &&
+      control_stage_ == ControlStage::DATA_IN) {
+    SendNextDataPacket();
+    return;
+  }
+  if ((interrupt & (1 << native::TXINI)) &&
+      control_stage_ == ControlStage::STATUS_IN_SET_ADDRESS) {
+    // Enable the address by setting the highest-order bit (a feature of the
+    // microcontroller, not the USB protocol).
+    native_->SetUDADDR(native_->GetUDADDR() | (1 << native::ADDEN));
+    SetControlStage(ControlStage::SETUP);
+    return;
+  }
+  // The interrupt doesn't belong to a control transfer, so reply with STALL.
+  Stall(native_);
+  SetControlStage(ControlStage::SETUP);
+}
+
+void RequestHandler::ResetControlTransfer() {
+  if (control_stage_ != ControlStage::SETUP) {
+    SetControlStage(ControlStage::SETUP);
+  }
+}
+
+void RequestHandler::SetControlStage(ControlStage stage) {
+  control_stage_ = stage;
+  // Only enable the interrupts that advance the new stage. TXINI stays set
+  // while the bank is free, so TXINE must be disabled when it isn't needed.
+  uint8_t interrupts = 1 << native::RXSTPE;
+  if (stage == ControlStage::DATA_IN ||
+      stage == ControlStage::STATUS_IN_SET_ADDRESS) {
+    interrupts |= 1 << native::TXINE;
+  }
+  if (stage == ControlStage::DATA_IN || stage == ControlStage::DATA_OUT ||
+      stage == ControlStage::STATUS_OUT) {
+    interrupts |= 1 << native::RXOUTE;
+  }
+  native_->SetUEIENX(interrupts);
+}
+
+void RequestHandler::SendNextDataPacket() {
+  if (data_remaining_ == 0 && !send_zero_length_packet_) {
+    SetControlStage(ControlStage::STATUS_OUT);
+    return;
+  }
+  uint8_t length = util::min(data_remaining_, k32BytePacketSize);
+  if (data_in_program_memory_) {
+    native_->CopyPgmToUsbFifo(data_, length);
+  } else {
+    for (uint8_t i = 0; i < length; ++i) {
+      native_->SetUEDATX(data_[i]);
+    }
+  }
+  data_ += length;
+  data_remaining_ -= length;
+  // A data stage that ends with a full packet needs to be followed by a zero
+  // length packet, so the host knows that there's no more data.
+  send_zero_length_packet_ = length == k32BytePacketSize;
+  HandshakeTransmitterInterrupt(native_);
+}
+
+void RequestHandler::UpdateFeature(const SetupPacket &packet,
+                                   HidState *hid_state, bool enabled) {
+  if (packet.bmRequestType.GetRecipient() == RequestType::Recipient::DEVICE &&
+      packet.wValue == (uint8_t)Feature::DEVICE_REMOTE_WAKEUP) {
+    HandshakeTransmitterInterrupt(native_);
+    hid_state->remote_wakeup_enabled = enabled;
+    return;
+  }
+  // This device doesn't support test mode, and endpoint 0 can't be halted.
+  if (packet.bmRequestType.GetRecipient() !=
+          RequestType::Recipient::ENDPOINT ||
+      packet.wValue != (uint8_t)Feature::ENDPOINT_HALT ||
+      (packet.wIndex & 0x7F) != descriptor::kKeyboardEndpoint) {
+    Stall(native_);
+    return;
+  }
+  HandshakeTransmitterInterrupt(native_);
+  native_->SetUENUM(descriptor::kKeyboardEndpoint);
+  if (enabled) {
+    native_->SetUECONX((1 << native::STALLRQ) | (1 << native::EPEN));
+  } else {
+    // Clearing the halt feature also resets the endpoint's data toggle (USB
+    // spec rev. 2.0, section 9.4.5).
+    native_->SetUECONX((1 << native::STALLRQC) | (1 << native::RSTDT) |
+                       (1 << native::EPEN));
+  }
+  hid_state->keyboard_endpoint_halted = enabled;
+}
+
 }  // namespace usb
 }  // namespace threeboard
@@ -16,21 +16,94 @@ class RequestHandler {
   virtual ~RequestHandler() = default;
 
   // Device handlers.
-  virtual void HandleGetStatus();
+  virtual void HandleGetStatus(const SetupPacket &, const HidState &);
+  virtual void HandleClearFeature(const SetupPacket &, HidState *);
+  virtual void HandleSetFeature(const SetupPacket &, HidState *);
   virtual void HandleSetAddress(const SetupPacket &);
   virtual void HandleGetDescriptor(const SetupPacket &);
   virtual void HandleGetConfiguration(const HidState &);
   virtual void HandleSetConfiguration(const SetupPacket &, HidState *);
+  virtual void HandleGetInterface(const SetupPacket &, const HidState &);
+  virtual void HandleSetInterface(const SetupPacket &, const HidState &);
 
   // HID handlers.
   virtual void HandleGetReport(const HidState &);
+  virtual void HandleSetReport(const SetupPacket &, HidState *);
   virtual void HandleGetIdle(const HidState &);
   virtual void HandleSetIdle(const SetupPacket &, HidState *);
   virtual void HandleGetProtocol(const HidState &);
   virtual void HandleSetProtocol(const SetupPacket &, HidState *);
+  virtual void HandleGetLatencyReport(const SetupPacket &,
+                                      const LatencyReport &);
+
+  // Vendor interface handlers.
+  virtual void HandleGetMemoryReport(const SetupPacket &, HidState *);
+  virtual void HandleSetMemoryReport(const SetupPacket &, HidState *);
+
+#ifdef THREEBOARD_USB_CONSOLE
+  // Console (CDC-ACM) handlers.
+  virtual void HandleSetLineCoding(const SetupPacket &, HidState *);
+  virtual void HandleGetLineCoding(const SetupPacket &, const HidState &);
+  virtual void HandleSetControlLineState(const SetupPacket &, HidState *);
+#endif
+
+  // Reply with STALL to a request that this device doesn't support, so the
+  // host gets an immediate error rather than waiting for a timeout.
+  virtual void HandleUnsupportedRequest();
+
+  // Continue the data or status stage of the current control transfer, in
+  // response to an endpoint 0 interrupt that wasn't caused by a SETUP packet.
+  // `interrupt` is the value of UEINTX.
+  virtual void HandleControlInterrupt(uint8_t interrupt);
+  // Abandon the current control transfer, because the host has started a new
+  // one.
+  virtual void ResetControlTransfer();
 
  private:
+  // The stage of the current control transfer on endpoint 0. Stages that wait
+  // for the host enable the relevant endpoint interrupt and return, rather
+  // than busy waiting in the interrupt handler.
+  enum class ControlStage : uint8_t {
+    // Waiting for the next SETUP packet.
+    SETUP,
+    // Sending the data of a control read, one packet per TXINI interrupt.
+    DATA_IN,
+    // Receiving the report of a SET_REPORT request, one packet per RXOUTI
+    // interrupt.
+    DATA_OUT,
+    // Waiting for the host to send the zero length packet that ends a control
+    // read.
+    STATUS_OUT,
+    // Waiting for the host to read the zero length status packet of a
+    // SET_ADDRESS request, after which the new address is enabled.
+    STATUS_IN_SET_ADDRESS,
+  };
+
+  void SetControlStage(ControlStage stage);
+  // Send the next packet of the data stage, or move to the status stage if
+  // all of the data has been sent.
+  void SendNextDataPacket();
+  // Set or clear the feature addressed by a CLEAR_FEATURE or SET_FEATURE
+  // request.
+  void UpdateFeature(const SetupPacket &packet, HidState *hid_state,
+                     bool enabled);
+
   native::Native *native_;
+
+  ControlStage control_stage_ = ControlStage::SETUP;
+  // The remaining data to send in the data stage, in program memory or SRAM.
+  const uint8_t *data_ = nullptr;
+  uint8_t data_remaining_ = 0;
+  bool data_in_program_memory_ = true;
+  // Set when the data stage ended with a full packet, in which case a zero
+  // length packet is needed to tell the host that the data has ended.
+  bool send_zero_length_packet_ = false;
+  // Where to store the rest of the report received in the DATA_OUT stage.
+  uint8_t *output_data_ = nullptr;
+  uint8_t output_remaining_ = 0;
+  // Set while receiving a memory report, which is handed to the event loop
+  // once all of it has arrived.
+  HidState *memory_report_state_ = nullptr;
 };
 }  // namespace usb
 }  // namespace threeboard
@@ -10,19 +10,47 @@ class RequestHandlerMockDefault : public RequestHandler {
  public:
   RequestHandlerMockDefault(native::Native *native) : RequestHandler(native) {}
 
-  MOCK_METHOD(void, HandleGetStatus, (), (override));
+  MOCK_METHOD(void, HandleGetStatus, (const SetupPacket &, const HidState &),
+              (override));
+  MOCK_METHOD(void, HandleClearFeature, (const SetupPacket &, HidState *),
+              (override));
+  MOCK_METHOD(void, HandleSetFeature, (const SetupPacket &, HidState *),
+              (override));
   MOCK_METHOD(void, HandleSetAddress, (const SetupPacket &), (override));
   MOCK_METHOD(void, HandleGetDescriptor, (const SetupPacket &), (override));
   MOCK_METHOD(void, HandleGetConfiguration, (const HidState &), (override));
   MOCK_METHOD(void, HandleSetConfiguration, (const SetupPacket &, HidState *),
               (override));
+  MOCK_METHOD(void, HandleGetInterface,
+              (const SetupPacket &, const HidState &), (override));
+  MOCK_METHOD(void, HandleSetInterface,
+              (const SetupPacket &, const HidState &), (override));
   MOCK_METHOD(void, HandleGetReport, (const HidState &), (override));
+  MOCK_METHOD(void, HandleSetReport, (const SetupPacket &, HidState *),
+              (override));
   MOCK_METHOD(void, HandleGetIdle, (const HidState &), (override));
   MOCK_METHOD(void, HandleSetIdle, (const SetupPacket &, HidState *),
               (override));
   MOCK_METHOD(void, HandleGetProtocol, (const HidState &), (override));
   MOCK_METHOD(void, HandleSetProtocol, (const SetupPacket &, HidState *),
               (override));
+  MOCK_METHOD(void, HandleGetLatencyReport,
+              (const SetupPacket &, const LatencyReport &), (override));
+  MOCK_METHOD(void, HandleGetMemoryReport, (const SetupPacket &, HidState *),
+              (override));
+  MOCK_METHOD(void, HandleSetMemoryReport, (const SetupPacket &, HidState *),
+              (override));
+#ifdef THREEBOARD_USB_CONSOLE
+  MOCK_METHOD(void, HandleSetLineCoding, (const SetupPacket &, HidState *),
+              (override));
+  MOCK_METHOD(void, HandleGetLineCoding,
+              (const SetupPacket &, const HidState &), (override));
+  MOCK_METHOD(void, HandleSetControlLineState,
+              (const SetupPacket &, HidState *), (override));
+#endif
+  MOCK_METHOD(void, HandleUnsupportedRequest, (), (override));
+  MOCK_METHOD(void, HandleControlInterrupt, (uint8_t), (override));
+  MOCK_METHOD(void, ResetControlTransfer, (), (override));
 };
 
 using RequestHandlerMock = ::testing::StrictMock<RequestHandlerMockDefault>;
@@ -0,0 +1,472 @@
+#include "request_handler.h"
+
+#include <vector>
+
+#include "src/native/native_mock.h"
+#include "src/usb/internal/descriptors.h"
+
+namespace threeboard {
+namespace usb {
+namespace {
+
+using ::testing::_;
+using ::testing::AnyNumber;
+using ::testing::Invoke;
+using ::testing::Return;
+
+constexpr uint8_t kSetupInterrupts = 1 << native::RXSTPE;
+constexpr uint8_t kDataInInterrupts =
+    (1 << native::RXSTPE) | (1 << native::TXINE) | (1 << native::RXOUTE);
+constexpr uint8_t kStatusOutInterrupts =
+    (1 << native::RXSTPE) | (1 << native::RXOUTE);
+constexpr uint8_t kDataOutInterrupts = kStatusOutInterrupts;
+constexpr uint8_t kStall = (1 << native::STALLRQ) | (1 << native::EPEN);
+
+class RequestHandlerTest : public ::testing::Test {
+ public:
+  RequestHandlerTest() : request_handler_(&native_mock_) {
+    EXPECT_CALL(native_mock_, SetUEDATX(_))
+        .Times(AnyNumber())
+        .WillRepeatedly(Invoke([&](uint8_t data) { fifo_.push_back(data); }));
+  }
+
+  SetupPacket GetDescriptorPacket(DescriptorType type, uint16_t length) {
+    SetupPacket packet;
+    packet.bRequest = Request::GET_DESCRIPTOR;
+    packet.wValue = DescriptorId(type).GetValue();
+    packet.wIndex = 0;
+    packet.wLength = length;
+    return packet;
+  }
+
+  SetupPacket FeaturePacket(Request request, RequestType::Recipient recipient,
+                            Feature feature, uint16_t index) {
+    SetupPacket packet;
+    packet.bmRequestType =
+        RequestType(RequestType::Direction::HOST_TO_DEVICE,
+                    RequestType::Type::STANDARD, recipient);
+    packet.bRequest = request;
+    packet.wValue = (uint16_t)feature;
+    packet.wIndex = index;
+    packet.wLength = 0;
+    return packet;
+  }
+
+  SetupPacket SetReportPacket(ReportType type) {
+    SetupPacket packet;
+    packet.bmRequestType = RequestType(RequestType::Direction::HOST_TO_DEVICE,
+                                       RequestType::Type::CLASS,
+                                       RequestType::Recipient::INTERFACE);
+    packet.bRequest = Request::HID_SET_REPORT;
+    packet.wValue = (uint16_t)type << 8;
+    packet.wIndex = descriptor::kKeyboardInterfaceIndex;
+    packet.wLength = 1;
+    return packet;
+  }
+
+  MemoryReport::Status MemoryStatus() {
+    return hid_state_.memory_report_status;
+  }
+
+  // Fire a TXINI interrupt, and return the packet that was sent to the host.
+  std::vector<uint8_t> SendTransmitterReady() {
+    fifo_.clear();
+    EXPECT_CALL(native_mock_, SetUEINTX(~(1 << native::TXINI)));
+    request_handler_.HandleControlInterrupt(1 << native::TXINI);
+    return fifo_;
+  }
+
+  native::NativeMock native_mock_;
+  RequestHandler request_handler_;
+  HidState hid_state_;
+  std::vector<uint8_t> fifo_;
+};
+
+TEST_F(RequestHandlerTest, GetDescriptorSendsPacketsFromInterrupts) {
+  // Nothing is sent until the bank is free.
+  EXPECT_CALL(native_mock_, SetUEIENX(kDataInInterrupts));
+  request_handler_.HandleGetDescriptor(
+      GetDescriptorPacket(DescriptorType::CONFIGURATION, 255));
+  EXPECT_TRUE(fifo_.empty());
+
+  const uint8_t *data = reinterpret_cast<const uint8_t *>(&combined_descriptor);
+  const uint8_t *end = data + sizeof(combined_descriptor);
+  for (; end - data > 32; data += 32) {
+    EXPECT_EQ(SendTransmitterReady(), std::vector<uint8_t>(data, data + 32));
+  }
+  EXPECT_EQ(SendTransmitterReady(), std::vector<uint8_t>(data, end));
+
+  // All of the data has been sent, so wait for the status stage.
+  EXPECT_CALL(native_mock_, SetUEIENX(kStatusOutInterrupts));
+  request_handler_.HandleControlInterrupt(1 << native::TXINI);
+  EXPECT_CALL(native_mock_, SetUEINTX(~(1 << native::RXOUTI)));
+  EXPECT_CALL(native_mock_, SetUEIENX(kSetupInterrupts));
+  request_handler_.HandleControlInterrupt(1 << native::RXOUTI);
+}
+
+TEST_F(RequestHandlerTest, GetDescriptorSendsZeroLengthPacketAfterFullPacket) {
+  EXPECT_CALL(native_mock_, SetUEIENX(kDataInInterrupts));
+  request_handler_.HandleGetDescriptor(
+      GetDescriptorPacket(DescriptorType::CONFIGURATION, 32));
+  EXPECT_EQ(SendTransmitterReady().size(), 32);
+  EXPECT_TRUE(SendTransmitterReady().empty());
+  EXPECT_CALL(native_mock_, SetUEIENX(kStatusOutInterrupts));
+  request_handler_.HandleControlInterrupt(1 << native::TXINI);
+}
+
+TEST_F(RequestHandlerTest, HostCanEndDataStageEarly) {
+  EXPECT_CALL(native_mock_, SetUEIENX(kDataInInterrupts));
+  request_handler_.HandleGetDescriptor(
+      GetDescriptorPacket(DescriptorType::CONFIGURATION, 255));
+  SendTransmitterReady();
+  EXPECT_CALL(native_mock_, SetUEINTX(~(1 << native::RXOUTI)));
+  EXPECT_CALL(native_mock_, SetUEIENX(kSetupInterrupts));
+  request_handler_.HandleControlInterrupt(1 << native::RXOUTI);
+}
+
+TEST_F(RequestHandlerTest, GetDescriptorSendsReportDescriptorOfInterface) {
+  SetupPacket packet = GetDescriptorPacket(DescriptorType::HID_REPORT, 255);
+  packet.wIndex = descriptor::kVendorInterfaceIndex;
+  EXPECT_CALL(native_mock_, SetUEIENX(kDataInInterrupts));
+  request_handler_.HandleGetDescriptor(packet);
+  const uint8_t *report_end = vendor_hid_report + sizeof(vendor_hid_report);
+  EXPECT_EQ(SendTransmitterReady(),
+            std::vector<uint8_t>(vendor_hid_report, report_end));
+}
+
+TEST_F(RequestHandlerTest, GetDescriptorStallsOnUnknownDescriptor) {
+  EXPECT_CALL(native_mock_, SetUECONX(kStall));
+  request_handler_.HandleGetDescriptor(
+      GetDescriptorPacket(DescriptorType::DEVICE_QUALIFIER, 255));
+}
+
+TEST_F(RequestHandlerTest, SetAddressEnablesAddressAfterStatusStage) {
+  SetupPacket packet;
+  packet.bRequest = Request::SET_ADDRESS;
+  packet.wValue = 12;
+  EXPECT_CALL(native_mock_, SetUEINTX(~(1 << native::TXINI)));
+  EXPECT_CALL(native_mock_, SetUDADDR(12));
+  EXPECT_CALL(native_mock_,
+              SetUEIENX((1 << native::RXSTPE) | (1 << native::TXINE)));
+  request_handler_.HandleSetAddress(packet);
+
+  EXPECT_CALL(native_mock_, GetUDADDR()).WillOnce(Return(12));
+  EXPECT_CALL(native_mock_, SetUDADDR(12 | (1 << native::ADDEN)));
+  EXPECT_CALL(native_mock_, SetUEIENX(kSetupInterrupts));
+  request_handler_.HandleControlInterrupt(1 << native::TXINI);
+}
+
+TEST_F(RequestHandlerTest, StallsOnInterruptOutsideControlTransfer) {
+  EXPECT_CALL(native_mock_, SetUECONX(kStall));
+  EXPECT_CALL(native_mock_, SetUEIENX(kSetupInterrupts));
+  request_handler_.HandleControlInterrupt(1 << native::TXINI);
+}
+
+TEST_F(RequestHandlerTest, ResetControlTransferAbandonsDataStage) {
+  EXPECT_CALL(native_mock_, SetUEIENX(kDataInInterrupts));
+  request_handler_.HandleGetDescriptor(
+      GetDescriptorPacket(DescriptorType::DEVICE, 255));
+  EXPECT_CALL(native_mock_, SetUEIENX(kSetupInterrupts));
+  request_handler_.ResetControlTransfer();
+}
+
+TEST_F(RequestHandlerTest, GetStatusSendsTwoBytes) {
+  SetupPacket packet;
+  packet.bmRequestType = RequestType(RequestType::Direction::DEVICE_TO_HOST);
+  packet.bRequest = Request::GET_STATUS;
+  EXPECT_CALL(native_mock_, GetUEINTX()).WillOnce(Return(1 << native::TXINI));
+  EXPECT_CALL(native_mock_, SetUEINTX(~(1 << native::TXINI)));
+  request_handler_.HandleGetStatus(packet, hid_state_);
+  EXPECT_EQ(fifo_, std::vector<uint8_t>({0, 0}));
+}
+
+TEST_F(RequestHandlerTest, SetFeatureHaltsKeyboardEndpoint) {
+  EXPECT_CALL(native_mock_, SetUEINTX(~(1 << native::TXINI)));
+  EXPECT_CALL(native_mock_, SetUENUM(descriptor::kKeyboardEndpoint));
+  EXPECT_CALL(native_mock_, SetUECONX(kStall));
+  request_handler_.HandleSetFeature(
+      FeaturePacket(Request::SET_FEATURE, RequestType::Recipient::ENDPOINT,
+                    Feature::ENDPOINT_HALT,
+                    descriptor::kKeyboardEndpoint |
+                        descriptor::kEndpointPipeTypeIn),
+      &hid_state_);
+  EXPECT_TRUE(hid_state_.keyboard_endpoint_halted);
+
+  // The halt is reported by GET_STATUS for the endpoint.
+  SetupPacket packet;
+  packet.bmRequestType = RequestType(RequestType::Direction::DEVICE_TO_HOST,
+                                     RequestType::Type::STANDARD,
+                                     RequestType::Recipient::ENDPOINT);
+  packet.bRequest = Request::GET_STATUS;
+  packet.wIndex = descriptor::kKeyboardEndpoint;
+  EXPECT_CALL(native_mock_, GetUEINTX()).WillOnce(Return(1 << native::TXINI));
+  EXPECT_CALL(native_mock_, SetUEINTX(~(1 << native::TXINI)));
+  request_handler_.HandleGetStatus(packet, hid_state_);
+  EXPECT_EQ(fifo_, std::vector<uint8_t>({1, 0}));
+}
+
+TEST_F(RequestHandlerTest, ClearFeatureResetsKeyboardEndpoint) {
+  hid_state_.keyboard_endpoint_halted = true;
+  EXPECT_CALL(native_mock_, SetUEINTX(~(1 << native::TXINI)));
+  EXPECT_CALL(native_mock_, SetUENUM(descriptor::kKeyboardEndpoint));
+  EXPECT_CALL(native_mock_,
+              SetUECONX((1 << native::STALLRQC) | (1 << native::RSTDT) |
+                        (1 << native::EPEN)));
+  request_handler_.HandleClearFeature(
+      FeaturePacket(Request::CLEAR_FEATURE, RequestType::Recipient::ENDPOINT,
+                    Feature::ENDPOINT_HALT, descriptor::kKeyboardEndpoint),
+      &hid_state_);
+  EXPECT_FALSE(hid_state_.keyboard_endpoint_halted);
+}
+
+TEST_F(RequestHandlerTest, SetFeatureEnablesRemoteWakeup) {
+  EXPECT_CALL(native_mock_, SetUEINTX(~(1 << native::TXINI)));
+  request_handler_.HandleSetFeature(
+      FeaturePacket(Request::SET_FEATURE, RequestType::Recipient::DEVICE,
+                    Feature::DEVICE_REMOTE_WAKEUP, 0),
+      &hid_state_);
+  EXPECT_TRUE(hid_state_.remote_wakeup_enabled);
+
+  // Remote wakeup is reported by GET_STATUS for the device.
+  SetupPacket packet;
+  packet.bmRequestType = RequestType(RequestType::Direction::DEVICE_TO_HOST);
+  packet.bRequest = Request::GET_STATUS;
+  EXPECT_CALL(native_mock_, GetUEINTX()).WillOnce(Return(1 << native::TXINI));
+  EXPECT_CALL(native_mock_, SetUEINTX(~(1 << native::TXINI)));
+  request_handler_.HandleGetStatus(packet, hid_state_);
+  EXPECT_EQ(fifo_, std::vector<uint8_t>({2, 0}));
+}
+
+TEST_F(RequestHandlerTest, ClearFeatureDisablesRemoteWakeup) {
+  hid_state_.remote_wakeup_enabled = true;
+  EXPECT_CALL(native_mock_, SetUEINTX(~(1 << native::TXINI)));
+  request_handler_.HandleClearFeature(
+      FeaturePacket(Request::CLEAR_FEATURE, RequestType::Recipient::DEVICE,
+                    Feature::DEVICE_REMOTE_WAKEUP, 0),
+      &hid_state_);
+  EXPECT_FALSE(hid_state_.remote_wakeup_enabled);
+}
+
+TEST_F(RequestHandlerTest, SetFeatureStallsUnsupportedFeature) {
+  EXPECT_CALL(native_mock_, SetUECONX(kStall));
+  request_handler_.HandleSetFeature(
+      FeaturePacket(Request::SET_FEATURE, RequestType::Recipient::DEVICE,
+                    Feature::TEST_MODE, 0),
+      &hid_state_);
+}
+
+TEST_F(RequestHandlerTest, GetInterfaceSendsAlternateSetting) {
+  hid_state_.configuration = descriptor::kConfigurationValue;
+  SetupPacket packet;
+  packet.bRequest = Request::GET_INTERFACE;
+  packet.wIndex = descriptor::kKeyboardInterfaceIndex;
+  EXPECT_CALL(native_mock_, GetUEINTX()).WillOnce(Return(1 << native::TXINI));
+  EXPECT_CALL(native_mock_, SetUEINTX(~(1 << native::TXINI)));
+  request_handler_.HandleGetInterface(packet, hid_state_);
+  EXPECT_EQ(fifo_, std::vector<uint8_t>({0}));
+}
+
+TEST_F(RequestHandlerTest, GetInterfaceStallsForUnknownInterface) {
+  hid_state_.configuration = descriptor::kConfigurationValue;
+  SetupPacket packet;
+  packet.bRequest = Request::GET_INTERFACE;
+  packet.wIndex = hid::kNumInterfaces;
+  EXPECT_CALL(native_mock_, SetUECONX(kStall));
+  request_handler_.HandleGetInterface(packet, hid_state_);
+}
+
+TEST_F(RequestHandlerTest, GetInterfaceStallsWhenNotConfigured) {
+  SetupPacket packet;
+  packet.bRequest = Request::GET_INTERFACE;
+  packet.wIndex = descriptor::kKeyboardInterfaceIndex;
+  EXPECT_CALL(native_mock_, SetUECONX(kStall));
+  request_handler_.HandleGetInterface(packet, hid_state_);
+}
+
+TEST_F(RequestHandlerTest, SetInterfaceAcceptsOnlyAlternateSetting) {
+  hid_state_.configuration = descriptor::kConfigurationValue;
+  SetupPacket packet;
+  packet.bRequest = Request::SET_INTERFACE;
+  packet.wIndex = descriptor::kKeyboardInterfaceIndex;
+  packet.wValue = 0;
+  EXPECT_CALL(native_mock_, SetUEINTX(~(1 << native::TXINI)));
+  request_handler_.HandleSetInterface(packet, hid_state_);
+
+  packet.wValue = 1;
+  EXPECT_CALL(native_mock_, SetUECONX(kStall));
+  request_handler_.HandleSetInterface(packet, hid_state_);
+}
+
+TEST_F(RequestHandlerTest, SetReportStoresLedStateFromDataStage) {
+  EXPECT_CALL(native_mock_, SetUEIENX(kDataOutInterrupts));
+  request_handler_.HandleSetReport(SetReportPacket(ReportType::OUTPUT),
+                                   &hid_state_);
+
+  // Caps lock is turned on in the data stage, and the transfer ends with a
+  // zero length status packet.
+  EXPECT_CALL(native_mock_, GetUEDATX()).WillOnce(Return(0b10));
+  EXPECT_CALL(native_mock_, SetUEINTX(~(1 << native::RXOUTI)));
+  EXPECT_CALL(native_mock_, GetUEINTX()).WillOnce(Return(1 << native::TXINI));
+  EXPECT_CALL(native_mock_, SetUEINTX(~(1 << native::TXINI)));
+  EXPECT_CALL(native_mock_, SetUEIENX(kSetupInterrupts));
+  request_handler_.HandleControlInterrupt(1 << native::RXOUTI);
+  EXPECT_EQ(hid_state_.led_state, 0b10);
+  EXPECT_TRUE(fifo_.empty());
+}
+
+TEST_F(RequestHandlerTest, SetReportStallsFeatureReport) {
+  EXPECT_CALL(native_mock_, SetUECONX(kStall));
+  request_handler_.HandleSetReport(SetReportPacket(ReportType::FEATURE),
+                                   &hid_state_);
+}
+
+TEST_F(RequestHandlerTest, SetMemoryReportReceivesEveryPacket) {
+  SetupPacket packet = SetReportPacket(ReportType::FEATURE);
+  packet.wIndex = descriptor::kVendorInterfaceIndex;
+  packet.wLength = sizeof(MemoryReport);
+  EXPECT_CALL(native_mock_, SetUEIENX(kDataOutInterrupts));
+  request_handler_.HandleSetMemoryReport(packet, &hid_state_);
+
+  // The report arrives in packets of 32, 32 and 5 bytes.
+  uint8_t next_byte = 0;
+  EXPECT_CALL(native_mock_, GetUEDATX())
+      .Times(sizeof(MemoryReport))
+      .WillRepeatedly(Invoke([&]() { return next_byte++; }));
+  EXPECT_CALL(native_mock_, SetUEINTX(~(1 << native::RXOUTI))).Times(3);
+  request_handler_.HandleControlInterrupt(1 << native::RXOUTI);
+  request_handler_.HandleControlInterrupt(1 << native::RXOUTI);
+  EXPECT_EQ(MemoryStatus(), MemoryReport::Status::IDLE);
+
+  // The command is handed to the event loop once the last packet arrives.
+  EXPECT_CALL(native_mock_, GetUEINTX()).WillOnce(Return(1 << native::TXINI));
+  EXPECT_CALL(native_mock_, SetUEINTX(~(1 << native::TXINI)));
+  EXPECT_CALL(native_mock_, SetUEIENX(kSetupInterrupts));
+  request_handler_.HandleControlInterrupt(1 << native::RXOUTI);
+  EXPECT_EQ(MemoryStatus(), MemoryReport::Status::BUSY);
+  EXPECT_EQ((uint8_t)hid_state_.memory_report.command, 0);
+  EXPECT_EQ(hid_state_.memory_report.address, 0x0403);
+  EXPECT_EQ(hid_state_.memory_report.data[63], 68);
+}
+
+TEST_F(RequestHandlerTest, SetMemoryReportStallsWhileBusy) {
+  SetupPacket packet = SetReportPacket(ReportType::FEATURE);
+  packet.wIndex = descriptor::kVendorInterfaceIndex;
+  packet.wLength = sizeof(MemoryReport);
+  hid_state_.memory_report_status = MemoryReport::Status::BUSY;
+  EXPECT_CALL(native_mock_, SetUECONX(kStall));
+  request_handler_.HandleSetMemoryReport(packet, &hid_state_);
+}
+
+TEST_F(RequestHandlerTest, SetMemoryReportStallsOnWrongLength) {
+  SetupPacket packet = SetReportPacket(ReportType::FEATURE);
+  packet.wIndex = descriptor::kVendorInterfaceIndex;
+  packet.wLength = sizeof(MemoryReport) - 1;
+  EXPECT_CALL(native_mock_, SetUECONX(kStall));
+  request_handler_.HandleSetMemoryReport(packet, &hid_state_);
+}
+
+TEST_F(RequestHandlerTest, GetMemoryReportSendsResult) {
+  hid_state_.memory_report.command = MemoryReport::Command::READ;
+  hid_state_.memory_report.address = 0x40;
+  hid_state_.memory_report.data[0] = 7;
+  hid_state_.memory_report_status = MemoryReport::Status::COMPLETE;
+  SetupPacket packet;
+  packet.bRequest = Request::HID_GET_REPORT;
+  packet.wValue = (uint16_t)ReportType::FEATURE << 8;
+  packet.wIndex = descriptor::kVendorInterfaceIndex;
+  packet.wLength = sizeof(MemoryReport);
+  EXPECT_CALL(native_mock_, SetUEIENX(kDataInInterrupts));
+  request_handler_.HandleGetMemoryReport(packet, &hid_state_);
+
+  std::vector<uint8_t> report = SendTransmitterReady();
+  EXPECT_EQ(report.size(), 32);
+  EXPECT_EQ(report[0], (uint8_t)MemoryReport::Command::READ);
+  EXPECT_EQ(report[1], (uint8_t)MemoryReport::Status::COMPLETE);
+  EXPECT_EQ(report[3], 0x40);
+  EXPECT_EQ(report[5], 7);
+  EXPECT_EQ(SendTransmitterReady().size(), 32);
+  EXPECT_EQ(SendTransmitterReady().size(), 5);
+  EXPECT_CALL(native_mock_, SetUEIENX(kStatusOutInterrupts));
+  request_handler_.HandleControlInterrupt(1 << native::TXINI);
+}
+
+#ifdef THREEBOARD_USB_CONSOLE
+TEST_F(RequestHandlerTest, SetLineCodingCanBeReadBack) {
+  SetupPacket packet;
+  packet.bRequest = Request::CDC_SET_LINE_CODING;
+  packet.wIndex = descriptor::kConsoleControlInterfaceIndex;
+  packet.wLength = sizeof(LineCoding);
+  EXPECT_CALL(native_mock_, SetUEIENX(kDataOutInterrupts));
+  request_handler_.HandleSetLineCoding(packet, &hid_state_);
+
+  // 9600 baud, 1 stop bit, no parity, 7 data bits.
+  std::vector<uint8_t> line_coding = {0x80, 0x25, 0, 0, 0, 0, 7};
+  auto next_byte = line_coding.begin();
+  EXPECT_CALL(native_mock_, GetUEDATX())
+      .Times(sizeof(LineCoding))
+      .WillRepeatedly(Invoke([&]() { return *next_byte++; }));
+  EXPECT_CALL(native_mock_, SetUEINTX(~(1 << native::RXOUTI)));
+  EXPECT_CALL(native_mock_, GetUEINTX()).WillOnce(Return(1 << native::TXINI));
+  EXPECT_CALL(native_mock_, SetUEINTX(~(1 << native::TXINI)));
+  EXPECT_CALL(native_mock_, SetUEIENX(kSetupInterrupts));
+  request_handler_.HandleControlInterrupt(1 << native::RXOUTI);
+  EXPECT_EQ(hid_state_.line_coding.dwDTERate, 9600);
+  EXPECT_EQ(hid_state_.line_coding.bDataBits, 7);
+
+  packet.bRequest = Request::CDC_GET_LINE_CODING;
+  EXPECT_CALL(native_mock_, SetUEIENX(kDataInInterrupts));
+  request_handler_.HandleGetLineCoding(packet, hid_state_);
+  EXPECT_EQ(SendTransmitterReady(), line_coding);
+}
+
+TEST_F(RequestHandlerTest, SetLineCodingStallsOnWrongLength) {
+  SetupPacket packet;
+  packet.bRequest = Request::CDC_SET_LINE_CODING;
+  packet.wLength = sizeof(LineCoding) + 1;
+  EXPECT_CALL(native_mock_, SetUECONX(kStall));
+  request_handler_.HandleSetLineCoding(packet, &hid_state_);
+}
+
+TEST_F(RequestHandlerTest, SetControlLineStateOpensConsoleWithDtr) {
+  SetupPacket packet;
+  packet.bRequest = Request::CDC_SET_CONTROL_LINE_STATE;
+  packet.wValue = cdc::kDataTerminalReady;
+  EXPECT_CALL(native_mock_, SetUEINTX(~(1 << native::TXINI))).Times(2);
+  request_handler_.HandleSetControlLineState(packet, &hid_state_);
+  EXPECT_TRUE(hid_state_.console_open);
+  packet.wValue = 0;
+  request_handler_.HandleSetControlLineState(packet, &hid_state_);
+  EXPECT_FALSE(hid_state_.console_open);
+}
+#endif
+
+TEST_F(RequestHandlerTest, GetLatencyReportSendsReport) {
+  LatencyReport latency_report = {};
+  latency_report.tick_microseconds = 4;
+  latency_report.stages[0].min = 0x0102;
+  latency_report.histogram[hid::kLatencyHistogramSize - 1] = 9;
+  SetupPacket packet;
+  packet.bRequest = Request::HID_GET_REPORT;
+  packet.wValue = (uint16_t)ReportType::FEATURE << 8;
+  packet.wIndex = descriptor::kKeyboardInterfaceIndex;
+  packet.wLength = sizeof(LatencyReport);
+  EXPECT_CALL(native_mock_, SetUEIENX(kDataInInterrupts));
+  request_handler_.HandleGetLatencyReport(packet, latency_report);
+
+  std::vector<uint8_t> report = SendTransmitterReady();
+  EXPECT_EQ(report.size(), 32);
+  EXPECT_EQ(report[0], 4);
+  EXPECT_EQ(report[1], 0x02);
+  EXPECT_EQ(report[2], 0x01);
+  EXPECT_EQ(SendTransmitterReady().size(), 32);
+  report = SendTransmitterReady();
+  EXPECT_EQ(report.size(), sizeof(LatencyReport) - 64);
+  EXPECT_EQ(report.back(), 0);
+  EXPECT_EQ(report[report.size() - 2], 9);
+  EXPECT_CALL(native_mock_, SetUEIENX(kStatusOutInterrupts));
+  request_handler_.HandleControlInterrupt(1 << native::TXINI);
+}
+
+}  // namespace
+}  // namespace usb
+}  // namespace threeboard
@@ -13,8 +13,9 @@ constexpr uint16_t kVendorId = 0x04D8;
 // threeboard v1 product id.
 constexpr uint16_t kProductId = 0xEC51;
 
-// Specify endpoint type as "interrupt" in UECFG0X.
+// Specify endpoint type as "interrupt" or "bulk" in UECFG0X.
 constexpr uint8_t kEndpointTypeInterrupt = 0b11000000;
+constexpr uint8_t kEndpointTypeBulk = 0b10000000;
 
 // Used to set EPDIR (endpoint direction) in UECFG0X as IN (device to host).
 constexpr uint8_t kEndpointDirectionIn = 0b00000001;
@@ -26,7 +27,10 @@ constexpr uint8_t kEndpointAlloc = 0b00000010;
 constexpr uint8_t kEndpointDoubleBank = 0b00000100;
 
 // Maximum packet size.
+constexpr uint8_t k8BytePacketSize = 0b00000000;
+constexpr uint8_t k16BytePacketSize = 0b00010000;
 constexpr uint8_t k32BytePacketSize = 0b00100000;
+constexpr uint8_t k64BytePacketSize = 0b00110000;
 
 // USB HID-related constants.
 namespace hid {
@@ -34,8 +38,14 @@ namespace hid {
 // Identifier for the HID spec v1.11.
 constexpr uint16_t kSpecificationComplianceVersion = 0x1011;
 
-// Amount of interfaces used in the ConfigurationDescriptor.
-constexpr uint8_t kNumInterfaces = 1;
+// Amount of interfaces used in the ConfigurationDescriptor: the keyboard, and
+// the vendor-defined interface used to access shortcut memory. Builds with the
+// USB console also have its two CDC-ACM interfaces.
+#ifdef THREEBOARD_USB_CONSOLE
+constexpr uint8_t kNumInterfaces = 4;
+#else
+constexpr uint8_t kNumInterfaces = 2;
+#endif
 
 // HID country code: no specific country.
 constexpr uint8_t kNotLocalized = 0;
@@ -48,8 +58,65 @@ constexpr uint8_t kBootInterfaceSubclassCode = 1;
 
 // USB keyboard protocol code. HID spec v1.11, section 4.3.
 constexpr uint8_t kKeyboardInterfaceProtocol = 1;
+
+// Values of the HID protocol, selected by the host with SetProtocol. HID spec
+// v1.11, section 7.2.6. Devices must default to the report protocol.
+constexpr uint8_t kBootProtocol = 0;
+constexpr uint8_t kReportProtocol = 1;
+
+// The number of keys in a boot protocol report. HID spec v1.11, appendix B.1.
+constexpr uint8_t kBootReportKeyCount = 6;
+
+// The size in bytes of the key bitmap in a report protocol report, which
+// follows the modifier byte. Each bit is a key, for key codes 0 to 103.
+constexpr uint8_t kKeyBitmapSize = 13;
+
+// Subclass and protocol codes of the vendor-defined interface, which is neither
+// a boot device nor a keyboard. HID spec v1.11, sections 4.2 and 4.3.
+constexpr uint8_t kNoSubclassCode = 0;
+constexpr uint8_t kNoInterfaceProtocol = 0;
+
+// The number of bytes of shortcut memory read or written by a single memory
+// report, and the size of the whole report including its 5 byte header.
+constexpr uint8_t kMemoryReportChunkSize = 64;
+constexpr uint8_t kMemoryReportSize = kMemoryReportChunkSize + 5;
+
+// The latency report has statistics for each stage after the key edge, a count
+// of dropped events, and a histogram of the latency of the final stage.
+constexpr uint8_t kLatencyStageCount = 4;
+constexpr uint8_t kLatencyHistogramSize = 8;
+constexpr uint8_t kLatencyReportSize =
+    1 + (kLatencyStageCount * 14) + 2 + (kLatencyHistogramSize * 2);
 }  // namespace hid
 
+// USB CDC-related constants, used by the optional console.
+namespace cdc {
+
+// Identifier for the CDC spec v1.10.
+constexpr uint16_t kSpecificationReleaseNumber = 0x0110;
+
+// Class codes of the communications interface, which uses the abstract control
+// model (a virtual serial port) with no AT command protocol, and of the data
+// interface. CDC spec v1.10, sections 4.2 to 4.5.
+constexpr uint8_t kCommunicationsClassCode = 0x02;
+constexpr uint8_t kAbstractControlModelSubclassCode = 0x02;
+constexpr uint8_t kNoProtocol = 0;
+constexpr uint8_t kDataClassCode = 0x0A;
+
+// The abstract control model capabilities: the line coding and control line
+// state requests are supported. PSTN spec v1.20, section 5.3.2, table 4.
+constexpr uint8_t kAbstractControlModelCapabilities = 0b00000010;
+
+// The bit of wValue in SET_CONTROL_LINE_STATE which is set while a terminal
+// on the host has the serial port open (DTR). PSTN spec v1.20, section 6.3.12.
+constexpr uint8_t kDataTerminalReady = 0b00000001;
+
+// The number of bytes of log output buffered until the host reads them. Log
+// output is dropped while the buffer is full.
+constexpr uint8_t kConsoleBufferSize = 128;
+
+}  // namespace cdc
+
 // USB Descriptor-related constants.
 namespace descriptor {
 
@@ -66,6 +133,13 @@ constexpr uint8_t kBaseDeviceClassCode = 0;
 constexpr uint8_t kBaseDeviceSubclassCode = 0;
 constexpr uint8_t kBaseDeviceProtocol = 0;
 
+// Device class codes of a device that uses interface association descriptors,
+// which the USB console needs to group its two interfaces into one function.
+// USB interface association descriptor ECN, section 3.0.
+constexpr uint8_t kMiscellaneousDeviceClassCode = 0xEF;
+constexpr uint8_t kCommonClassSubclassCode = 0x02;
+constexpr uint8_t kInterfaceAssociationProtocol = 0x01;
+
 // Specify the ID of the endpoint to use for the HID keyboard protocol.
 constexpr uint8_t kKeyboardEndpoint = 1;
 
@@ -73,6 +147,9 @@ constexpr uint8_t kKeyboardEndpoint = 1;
 // spec v2.0, section 9.6.9, table 9-13.
 constexpr uint8_t kKeyboardEndpointAttributes = 0b00000011;
 
+// The 'bulk' transfer type, used by the console's data endpoints.
+constexpr uint8_t kBulkEndpointAttributes = 0b00000010;
+
 // Zero-based value identifying the index in the array of concurrent interfaces
 // supported by this configuration. Only one configuration is supported by the
 // threeboard.
@@ -80,11 +157,30 @@ constexpr uint8_t kKeyboardInterfaceIndex = 0;
 
 // Maximum packet size the keyboard endpoint is capable of sending or receiving
 // when this configuration is selected.
-constexpr uint8_t kKeyboardEndpointMaxPacketSize = 8;
-
-// Attributes used in the configuration descriptor. Only bit 7 (reserved) is set
-// as it must be set to 1.
-constexpr uint8_t kConfigurationAttributes = 0b10000000;
+constexpr uint8_t kKeyboardEndpointMaxPacketSize = 16;
+
+// The interface and endpoint of the vendor-defined interface. HID interfaces
+// need an interrupt IN endpoint, but this one has no input reports, so nothing
+// is ever sent on it. Memory reports are transferred on endpoint 0.
+constexpr uint8_t kVendorInterfaceIndex = 1;
+constexpr uint8_t kVendorEndpoint = 2;
+constexpr uint8_t kVendorEndpointMaxPacketSize = 8;
+
+// The interfaces and endpoints of the CDC-ACM console, in builds that have it.
+// Its notification endpoint is never written to, since the console has no
+// serial state to report. Data sent by the host on the OUT endpoint is
+// ignored.
+constexpr uint8_t kConsoleControlInterfaceIndex = 2;
+constexpr uint8_t kConsoleDataInterfaceIndex = 3;
+constexpr uint8_t kConsoleNotificationEndpoint = 3;
+constexpr uint8_t kConsoleDataOutEndpoint = 4;
+constexpr uint8_t kConsoleDataInEndpoint = 5;
+constexpr uint8_t kConsoleNotificationEndpointMaxPacketSize = 8;
+constexpr uint8_t kConsoleDataEndpointMaxPacketSize = 64;
+
+// Attributes used in the configuration descriptor. Bit 7 (reserved) must be set
+// to 1, and bit 5 advertises support for remote wakeup.
+constexpr uint8_t kConfigurationAttributes = 0b10100000;
 
 // Max bus power specified in the configuration descriptor. It's measured in
 // increments of 2mA, so this indicates we use 100mA of bus power.
@@ -4,8 +4,6 @@ namespace threeboard {
 namespace usb {
 
 SetupPacket SetupPacket::ParseFromUsbEndpoint(native::Native *native) {
-  // Switch to endpoint 0.
-  native->SetUENUM(0);
   // Construct a SetupPacket from data on the bank.
   SetupPacket packet;
   packet.bmRequestType = native->GetUEDATX();
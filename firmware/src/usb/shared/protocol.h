@@ -3,6 +3,7 @@
 #include <stdint.h>
 
 #include "src/native/native.h"
+#include "src/usb/shared/constants.h"
 #include "src/util/util.h"
 
 namespace threeboard {
@@ -53,8 +54,8 @@ class RequestType {
 
 // USB request codes as defined by the USB spec rev. 2.0, section 9.3, table
 // 9-4. Class-specific HID request codes as defined by the USB HID firmware
-// specification v1.11, section 7.2. This device will only ever be an HID class
-// device.
+// specification v1.11, section 7.2, and CDC request codes used by the optional
+// console as defined by the PSTN spec v1.20, section 6.3.
 enum class Request : uint8_t {
   GET_STATUS = 0x00,
   CLEAR_FEATURE = 0x01,
@@ -74,6 +75,27 @@ enum class Request : uint8_t {
   HID_SET_REPORT = 0x09,
   HID_SET_IDLE = 0x0A,
   HID_SET_PROTOCOL = 0x0B,
+
+  CDC_SET_LINE_CODING = 0x20,
+  CDC_GET_LINE_CODING = 0x21,
+  CDC_SET_CONTROL_LINE_STATE = 0x22,
+};
+
+// Feature selectors for CLEAR_FEATURE and SET_FEATURE as defined by the USB
+// spec rev. 2.0, section 9.4, table 9-6.
+enum class Feature : uint8_t {
+  ENDPOINT_HALT = 0,
+  DEVICE_REMOTE_WAKEUP = 1,
+  TEST_MODE = 2,
+};
+
+// HID report types, stored in the high byte of wValue for GET_REPORT and
+// SET_REPORT, as defined by the USB HID firmware specification v1.11, section
+// 7.2.1.
+enum class ReportType : uint8_t {
+  INPUT = 0x01,
+  OUTPUT = 0x02,
+  FEATURE = 0x03,
 };
 
 // Descriptor types for GET_DESCRIPTOR as defined by the USB spec rev. 2.0,
@@ -88,10 +110,22 @@ enum class DescriptorType : uint8_t {
   DEVICE_QUALIFIER = 0x06,
   OTHER_SPEED_CONFIGURATION = 0x07,
   INTERFACE_POWER = 0x08,
+  INTERFACE_ASSOCIATION = 0x0B,
 
   HID = 0x21,
   HID_REPORT = 0x22,
   HID_PHYSICAL_DESCRIPTOR = 0x23,
+
+  CDC_INTERFACE = 0x24,
+};
+
+// Subtypes of the CDC class-specific interface descriptors. CDC spec v1.10,
+// section 5.2.3, table 25.
+enum class CdcDescriptorSubtype : uint8_t {
+  HEADER = 0x00,
+  CALL_MANAGEMENT = 0x01,
+  ABSTRACT_CONTROL_MANAGEMENT = 0x02,
+  UNION = 0x06,
 };
 
 // Global descriptor identifier, derived from the value field of the
@@ -118,6 +152,10 @@ class DescriptorId {
   }
 
   constexpr uint16_t GetValue() const { return value_; }
+  constexpr DescriptorType GetType() const {
+    return (DescriptorType)(value_ >> 8);
+  }
+  constexpr uint8_t GetIndex() const { return value_ & 0xFF; }
 
  private:
   uint16_t value_ = 0;
@@ -187,6 +225,64 @@ struct EndpointDescriptor {
   uint8_t bInterval;
 };
 
+// USB interface association descriptor ECN, table 9-Z.
+struct InterfaceAssociationDescriptor {
+  uint8_t bLength;
+  DescriptorType bDescriptorType;
+  uint8_t bFirstInterface;
+  uint8_t bInterfaceCount;
+  uint8_t bFunctionClass;
+  uint8_t bFunctionSubClass;
+  uint8_t bFunctionProtocol;
+  uint8_t iFunction;
+};
+
+// CDC spec v1.10, section 5.2.3.1, table 26.
+struct CdcHeaderDescriptor {
+  uint8_t bLength;
+  DescriptorType bDescriptorType;
+  CdcDescriptorSubtype bDescriptorSubtype;
+  uint16_t bcdCDC;
+};
+
+// CDC spec v1.10, section 5.2.3.2, table 27.
+struct CdcCallManagementDescriptor {
+  uint8_t bLength;
+  DescriptorType bDescriptorType;
+  CdcDescriptorSubtype bDescriptorSubtype;
+  uint8_t bmCapabilities;
+  uint8_t bDataInterface;
+};
+
+// PSTN spec v1.20, section 5.3.2, table 4.
+struct CdcAbstractControlManagementDescriptor {
+  uint8_t bLength;
+  DescriptorType bDescriptorType;
+  CdcDescriptorSubtype bDescriptorSubtype;
+  uint8_t bmCapabilities;
+};
+
+// CDC spec v1.10, section 5.2.3.8, table 33.
+struct CdcUnionDescriptor {
+  uint8_t bLength;
+  DescriptorType bDescriptorType;
+  CdcDescriptorSubtype bDescriptorSubtype;
+  uint8_t bMasterInterface;
+  uint8_t bSlaveInterface0;
+};
+
+// The serial port settings set by the host with SET_LINE_CODING. The console
+// doesn't use them, since it isn't a real serial port, but hosts expect to
+// read back what they set. PSTN spec v1.20, section 6.3.11, table 17.
+struct LineCoding {
+  uint32_t dwDTERate = 115200;
+  uint8_t bCharFormat = 0;
+  uint8_t bParityType = 0;
+  uint8_t bDataBits = 8;
+} __attribute__((packed));
+
+static_assert(sizeof(LineCoding) == 7);
+
 // USB spec rev. 2.0, section 9.6.7, table 9-16.
 template <int T>
 struct UnicodeStringDescriptor {
@@ -205,6 +301,8 @@ class SetupPacket {
   uint16_t wIndex;
   uint16_t wLength;
 
+  // Read a SETUP packet from the bank of the current endpoint, which must be
+  // endpoint 0.
   static SetupPacket ParseFromUsbEndpoint(native::Native *);
 
   bool operator==(const SetupPacket &other) const {
@@ -213,5 +311,64 @@ class SetupPacket {
            wIndex == other.wIndex && wLength == other.wLength;
   }
 };
+
+// The feature report of the vendor-defined interface, which host tools use to
+// read and write shortcut memory a chunk at a time. The host sends a command
+// with SET_REPORT, and reads back the result with GET_REPORT once `status` is
+// no longer BUSY. Addresses and data are as seen by the StorageController, so
+// erased bytes read as 0.
+struct MemoryReport {
+  enum class Command : uint8_t {
+    READ = 1,
+    WRITE = 2,
+  };
+  enum class Status : uint8_t {
+    // No command has been sent since the device was configured.
+    IDLE = 0,
+    // The command is waiting to be handled by the event loop.
+    BUSY = 1,
+    COMPLETE = 2,
+    FAILED = 3,
+  };
+
+  Command command;
+  // Written by the device. Ignored in reports sent by the host.
+  Status status;
+  // The storage device to access: 0 = internal EEPROM, 1 = EEPROM_0 and
+  // 2 = EEPROM_1.
+  uint8_t device;
+  uint16_t address;
+  uint8_t data[hid::kMemoryReportChunkSize];
+} __attribute__((packed));
+
+static_assert(sizeof(MemoryReport) == hid::kMemoryReportSize);
+
+// The feature report of the keyboard interface, which holds statistics about
+// the latency of keypresses. Latencies are measured from the key edge that
+// completes a keypress, in timer ticks.
+struct LatencyReport {
+  struct Stage {
+    uint32_t min;
+    uint32_t max;
+    // The sum of every latency, so the host can calculate the average.
+    uint32_t total;
+    // Stops increasing once it saturates, along with the other statistics.
+    uint16_t count;
+  } __attribute__((packed));
+
+  // The length of a timer tick.
+  uint8_t tick_microseconds;
+  // The statistics of each stage, in the order they're defined in
+  // LatencyTelemetry::Stage (excluding the key edge itself).
+  Stage stages[hid::kLatencyStageCount];
+  // The number of keypress events dropped because the event buffer was full.
+  uint16_t dropped_events;
+  // The number of keypresses whose reports were read by the host in under
+  // 1ms, then in each doubling of that up to 64ms. The final bucket counts
+  // every slower keypress.
+  uint16_t histogram[hid::kLatencyHistogramSize];
+} __attribute__((packed));
+
+static_assert(sizeof(LatencyReport) == hid::kLatencyReportSize);
 }  // namespace usb
 }  // namespace threeboard
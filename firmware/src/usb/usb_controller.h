@@ -2,6 +2,8 @@
 
 #include <stdint.h>
 
+#include "src/usb/shared/protocol.h"
+
 namespace threeboard {
 namespace usb {
 
@@ -18,9 +20,45 @@ class UsbController {
   // Returns true if the HID device configuration has completed successfully.
   virtual bool HasConfigured() = 0;
 
-  // Send the provided key and modifier code to the host device. Returns false
-  // if an error occurred during sending.
+  // Queue the provided key and modifier code to be sent to the host device.
+  // This doesn't wait for the keypress to be sent. Returns false without
+  // queueing anything if the device isn't configured or the queue is full.
   virtual bool SendKeypress(uint8_t key, uint8_t mod) = 0;
+
+  // Type a sequence of keys, one TypeKey call per key, followed by a call to
+  // EndKeySequence. Consecutive keys are packed into the same report (up to
+  // six at a time with the boot protocol, or runs of ascending keys with the
+  // report protocol), and keys are only released between reports when a key is
+  // repeated or the modifier code changes, so a sequence takes far fewer USB
+  // frames than sending each key with SendKeypress. Keys may not be sent to
+  // the host until the sequence ends. When the queue is full these wait for
+  // it to drain, and return false if it doesn't, or if the device isn't
+  // configured.
+  virtual bool TypeKey(uint8_t key, uint8_t mod) = 0;
+  virtual bool EndKeySequence() = 0;
+
+  // Called by the timer 3 interrupt handler every 5ms. Times the idle rate
+  // set by the host, so that the start of frame interrupt only needs to be
+  // enabled while there's a report to send.
+  virtual void UpdateIdleTimer() = 0;
+
+  // Returns true while the host has suspended the bus. The USB clock is
+  // frozen while suspended, and the rest of the device should be put to sleep
+  // until the host resumes it.
+  virtual bool IsSuspended() = 0;
+
+  // Signal the host to resume the suspended bus, if the host has enabled
+  // remote wakeup. Returns false if it hasn't, or the bus isn't suspended.
+  virtual bool RequestRemoteWakeup() = 0;
+
+  // Returns the memory command sent by the host on the vendor interface, or
+  // nullptr if there isn't one waiting to be handled. The command is handled
+  // in the event loop rather than the interrupt handler, since it accesses
+  // storage.
+  virtual MemoryReport *GetMemoryRequest() = 0;
+  // Mark the command returned by GetMemoryRequest as handled. The report now
+  // holds its result, which the host reads with GET_REPORT.
+  virtual void CompleteMemoryRequest(bool success) = 0;
 };
 }  // namespace usb
 }  // namespace threeboard
@@ -7,8 +7,26 @@ namespace threeboard {
 namespace usb {
 
 constexpr uint8_t kFrameTimeout = 50;
+// The period of UpdateIdleTimer, which is called by the timer 3 interrupt.
+constexpr uint8_t kIdleTimerPeriodMs = 5;
 
-UsbControllerImpl::UsbControllerImpl(native::Native *native) : native_(native) {
+namespace {
+
+// Returns true if `key` is in the first `length` entries of `keys`.
+bool Contains(const uint8_t *keys, uint8_t length, uint8_t key) {
+  for (uint8_t i = 0; i < length; ++i) {
+    if (keys[i] == key) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
+UsbControllerImpl::UsbControllerImpl(native::Native *native,
+                                     LatencyTelemetry *latency_telemetry)
+    : native_(native), latency_telemetry_(latency_telemetry) {
   native_->SetUsbInterruptHandlerDelegate(this);
   // There's no reason to expose RequestHandler outside usb/internal, but we
   // also need to be able to inject a mock. Instead of exposing it, we compose
@@ -32,9 +50,9 @@ bool UsbControllerImpl::Setup() {
   // Enable USB and the VBUS pad.
   native_->SetUSBCON((1 << native::USBE) | (1 << native::OTGPADE));
   // Configure USB general interrupts (handled by the USB_GEN_vect routine). We
-  // want to interrupt on start of frame (SOFE), and also on end of reset
-  // (EORSTE).
-  native_->SetUDIEN((1 << native::EORSTE) | (1 << native::SOFE));
+  // want to interrupt on end of reset (EORSTE) and suspend (SUSPE). The start
+  // of frame interrupt is only enabled once there's a report to send.
+  SetStartOfFrameInterruptEnabled(false);
   // Unset DETACH, activating the internal pull-up attach resistor on USB D+
   // (which specifies full-speed mode). This must be the final step in the setup
   // process because it indicates that the device is now ready.
@@ -44,22 +62,176 @@ bool UsbControllerImpl::Setup() {
 
 bool UsbControllerImpl::HasConfigured() { return hid_state_.configuration; }
 
+bool UsbControllerImpl::IsSuspended() { return suspended_; }
+
+bool UsbControllerImpl::RequestRemoteWakeup() {
+  // The suspend state is shared with the interrupt handler, so check and
+  // modify it atomically.
+  uint8_t sreg = native_->GetSREG();
+  native_->DisableInterrupts();
+  if (!suspended_ || !hid_state_.remote_wakeup_enabled ||
+      remote_wakeup_requested_) {
+    native_->SetSREG(sreg);
+    return false;
+  }
+  // The controller needs its clock to drive the resume signal onto the bus.
+  // The host then resumes the bus, which fires the wakeup interrupt.
+  StartUsbClock();
+  native_->SetUDCON(native_->GetUDCON() | (1 << native::RMWKUP));
+  remote_wakeup_requested_ = true;
+  native_->SetSREG(sreg);
+  return true;
+}
+
+MemoryReport *UsbControllerImpl::GetMemoryRequest() {
+  if (hid_state_.memory_report_status != MemoryReport::Status::BUSY) {
+    return nullptr;
+  }
+  return &hid_state_.memory_report;
+}
+
+void UsbControllerImpl::CompleteMemoryRequest(bool success) {
+  hid_state_.memory_report_status = success ? MemoryReport::Status::COMPLETE
+                                            : MemoryReport::Status::FAILED;
+}
+
 bool UsbControllerImpl::SendKeypress(const uint8_t key, const uint8_t mod) {
-  hid_state_.modifier_keys = mod;
-  // Currently, we only support sending a single key at a time, even though this
-  // USB implementation supports the full 6 keys. Functionality of the
-  // threeboard may change in future to send multiple keys.
-  hid_state_.keyboard_keys[0] = key;
-  RETURN_IF_ERROR(SendKeypress());
-  hid_state_.modifier_keys = 0;
-  hid_state_.keyboard_keys[0] = 0;
-  RETURN_IF_ERROR(SendKeypress());
+  // A keypress queues at most three reports: one releasing the previous keys,
+  // one pressing the key, and one releasing it. Reject the keypress rather
+  // than waiting for the queue to drain.
+  if (kReportQueueSize - report_queue_length_ < 3) {
+    LOG("USB report queue is full");
+    return false;
+  }
+  RETURN_IF_ERROR(TypeKey(key, mod));
+  return EndKeySequence();
+}
+
+bool UsbControllerImpl::TypeKey(const uint8_t key, const uint8_t mod) {
+  // Hosts register every key that wasn't pressed in the previous report as a
+  // new keypress, in the order they appear in the report. So the key can join
+  // the pending report as long as it isn't already pressed in either report,
+  // and it has the same modifiers. Report protocol reports are a bitmap, which
+  // hosts read in key code order, so keys can only join in ascending order.
+  bool is_boot_protocol = hid_state_.protocol == hid::kBootProtocol;
+  if (pending_key_count_ > 0 &&
+      (pending_key_count_ ==
+           (is_boot_protocol ? hid::kBootReportKeyCount : kMaxReportKeyCount) ||
+       mod != pending_modifier_keys_ ||
+       (!is_boot_protocol &&
+        key <= pending_keyboard_keys_[pending_key_count_ - 1]) ||
+       Contains(pending_keyboard_keys_, pending_key_count_, key) ||
+       Contains(queued_report_.keyboard_keys, kMaxReportKeyCount, key))) {
+    RETURN_IF_ERROR(SendPendingReport());
+  }
+  if (pending_key_count_ == 0) {
+    // Keys that are still pressed, or pressed with other modifiers, have to be
+    // released before the key can be pressed again in a new report.
+    if (Contains(queued_report_.keyboard_keys, kMaxReportKeyCount, key) ||
+        (queued_report_.keyboard_keys[0] != 0 &&
+         mod != queued_report_.modifier_keys)) {
+      RETURN_IF_ERROR(SendReleaseReport());
+    }
+    pending_modifier_keys_ = mod;
+  }
+  pending_keyboard_keys_[pending_key_count_++] = key;
+  return true;
+}
+
+bool UsbControllerImpl::EndKeySequence() {
+  if (pending_key_count_ > 0) {
+    RETURN_IF_ERROR(SendPendingReport());
+  }
+  return SendReleaseReport();
+}
+
+bool UsbControllerImpl::SendPendingReport() {
+  // The pending report is discarded even if sending fails, so that a failed
+  // sequence doesn't leak into the next one.
+  queued_report_.modifier_keys = pending_modifier_keys_;
+  for (uint8_t i = 0; i < kMaxReportKeyCount; ++i) {
+    queued_report_.keyboard_keys[i] =
+        i < pending_key_count_ ? pending_keyboard_keys_[i] : 0;
+  }
+  pending_key_count_ = 0;
+  return QueueReport(queued_report_);
+}
+
+bool UsbControllerImpl::SendReleaseReport() {
+  queued_report_ = HidReport();
+  return QueueReport(queued_report_);
+}
+
+bool UsbControllerImpl::QueueReport(const HidReport &report) {
+  // The queue is shared with the interrupt handler, so modify it atomically.
+  uint8_t sreg = native_->GetSREG();
+  native_->DisableInterrupts();
+  if (!hid_state_.configuration) {
+    native_->SetSREG(sreg);
+    return false;
+  }
+  uint8_t initial_frame_num = native_->GetUDFNUML();
+  while (report_queue_length_ == kReportQueueSize) {
+    // Only wait for the queue to drain for 50 frames (50ms on our full-speed
+    // bus). The frame number doesn't advance while the bus is suspended, so
+    // give up immediately in that case.
+    if (suspended_ ||
+        static_cast<uint8_t>(native_->GetUDFNUML() - initial_frame_num) >=
+            kFrameTimeout) {
+      native_->SetSREG(sreg);
+      return false;
+    }
+    // Sleep until the next interrupt. The start of frame interrupt fires
+    // every 1ms, and sends the report at the front of the queue. Enabling
+    // interrupts immediately before sleeping guarantees that the interrupt
+    // can't fire in between.
+    native_->EnableCpuSleep();
+    native_->EnableInterrupts();
+    native_->SleepCpu();
+    native_->DisableCpuSleep();
+    native_->DisableInterrupts();
+  }
+  report_queue_[(report_queue_head_ + report_queue_length_) %
+                kReportQueueSize] = report;
+  report_queue_length_++;
+  report_state_ = ReportState::PENDING;
+  latency_telemetry_->RecordStage(LatencyTelemetry::Stage::REPORT_QUEUED);
+  SetStartOfFrameInterruptEnabled(true);
+  native_->SetSREG(sreg);
   return true;
 }
 
+void UsbControllerImpl::UpdateIdleTimer() {
+  // Idle reports are only counted once the last report has been read, so
+  // they can never be sent ahead of, or in place of, a data report. Some hosts
+  // disable idle reporting by setting idle_config to 0.
+  if (!hid_state_.configuration || !hid_state_.idle_config ||
+      report_state_ != ReportState::ACKED || idle_report_due_) {
+    return;
+  }
+  hid_state_.idle_elapsed_ms += kIdleTimerPeriodMs;
+  if (hid_state_.idle_elapsed_ms >= hid_state_.idle_config * 4) {
+    idle_report_due_ = true;
+    SetStartOfFrameInterruptEnabled(true);
+  }
+}
+
 void UsbControllerImpl::HandleGeneralInterrupt() {
   uint8_t device_interrupt = native_->GetUDINT();
   native_->SetUDINT(0);
+  // The suspend and wakeup interrupt flags are set regardless of whether
+  // their interrupts are enabled, so only the one that's enabled is checked.
+  // A bus reset also wakes the device, so the rest of the interrupts are
+  // handled once the bus has resumed.
+  if (suspended_) {
+    if (!(device_interrupt & (1 << native::WAKEUPI))) {
+      return;
+    }
+    HandleWakeup();
+  } else if (device_interrupt & (1 << native::SUSPI)) {
+    HandleSuspend();
+    return;
+  }
   // Detect end of reset interrupt, and configure Endpoint 0.
   if (device_interrupt & (1 << native::EORSTI)) {
     // Switch to Endpoint 0.
@@ -73,133 +245,344 @@ void UsbControllerImpl::HandleGeneralInterrupt() {
     // Configure an endpoint interrupt when RXSTPI is sent (i.e. when the
     // current bank contains a new valid SETUP packet).
     native_->SetUEIENX(1 << native::RXSTPE);
+    // Any reports queued before the reset are no longer relevant.
+    report_queue_length_ = 0;
+    report_state_ = ReportState::ACKED;
+    idle_report_due_ = false;
+    // A reset disables remote wakeup (USB spec rev. 2.0, section 9.1.1.6).
+    hid_state_.remote_wakeup_enabled = false;
+    SetStartOfFrameInterruptEnabled(false);
   }
 
-  // SOFI (start of frame interrupt) will fire every 1ms on our full speed bus.
-  // We use it to time the HID reporting frequency based on the idle rate once
-  // the device has been configured. Some hosts may disable this by setting
-  // idle_config to 0.
+  // SOFI (start of frame interrupt) will fire every 1ms on our full speed bus
+  // while it's enabled. We use it to send queued reports, one per frame, and
+  // idle reports once the idle timer has expired.
   if ((device_interrupt & (1 << native::SOFI)) &&
       !(native_->GetUDMFN() & (1 << native::FNCERR)) &&
-      hid_state_.configuration && hid_state_.idle_config) {
-    native_->SetUENUM(descriptor::kKeyboardEndpoint);
-    // Check we're allowed to write out to USB FIFO.
-    if (native_->GetUEINTX() & (1 << native::RWAL)) {
-      hid_state_.idle_count++;
-      if (hid_state_.idle_count == hid_state_.idle_config) {
-        // TODO: we should check if there's something in the IN buffer already
-        // before sending zeroes, otherwise we may miss keystrokes.
-        SendHidState();
-      }
+      hid_state_.configuration) {
+    HandleStartOfFrame();
+  }
+}
+
+void UsbControllerImpl::HandleStartOfFrame() {
+  native_->SetUENUM(descriptor::kKeyboardEndpoint);
+  // The host has read every report once none of the endpoint's banks are
+  // busy.
+  if (report_state_ == ReportState::IN_FLIGHT &&
+      !(native_->GetUESTA0X() &
+        ((1 << native::NBUSYBK0) | (1 << native::NBUSYBK1)))) {
+    report_state_ = ReportState::ACKED;
+    latency_telemetry_->RecordStage(LatencyTelemetry::Stage::REPORT_ACKED);
+  }
+  if (report_state_ == ReportState::PENDING) {
+    // Check we're allowed to write out to USB FIFO. The endpoint is double
+    // banked, so the next report can be written to one bank while the other
+    // is still waiting for the host to poll it. Filling both banks means the
+    // host can read a report in every frame.
+    while (report_queue_length_ > 0 &&
+           (native_->GetUEINTX() & (1 << native::RWAL))) {
+      SendNextReport();
+    }
+    if (report_queue_length_ == 0) {
+      report_state_ = ReportState::IN_FLIGHT;
     }
+  } else if (report_state_ == ReportState::ACKED && idle_report_due_ &&
+             (native_->GetUEINTX() & (1 << native::RWAL))) {
+    idle_report_due_ = false;
+    SendHidState();
+    report_state_ = ReportState::IN_FLIGHT;
+  }
+#ifdef THREEBOARD_USB_CONSOLE
+  SendConsoleOutput();
+#endif
+  // Stop waking the CPU every frame once there's nothing left to send, and
+  // nothing waiting to be read by the host.
+  if (!HasStartOfFrameWork()) {
+    SetStartOfFrameInterruptEnabled(false);
+  }
+}
+
+bool UsbControllerImpl::HasStartOfFrameWork() {
+  if (report_state_ != ReportState::ACKED || idle_report_due_) {
+    return true;
   }
+#ifdef THREEBOARD_USB_CONSOLE
+  return hid_state_.console_open && console_.HasPendingData();
+#else
+  return false;
+#endif
+}
+
+void UsbControllerImpl::SetStartOfFrameInterruptEnabled(bool enabled) {
+  native_->SetUDIEN((1 << native::EORSTE) |
+                    (suspended_ ? (1 << native::WAKEUPE)
+                                : (1 << native::SUSPE)) |
+                    (enabled ? (1 << native::SOFE) : 0));
+}
+
+void UsbControllerImpl::HandleSuspend() {
+  // There are no frames while the bus is suspended, so only the wakeup
+  // interrupt is needed (atmega32u4 datasheet, section 21.13).
+  suspended_ = true;
+  SetStartOfFrameInterruptEnabled(false);
+  // Freeze the USB clock and stop the PLL, which are the controller's main
+  // power draw. The wakeup interrupt is still detected asynchronously.
+  native_->SetUSBCON((1 << native::USBE) | (1 << native::OTGPADE) |
+                     (1 << native::FRZCLK));
+  native_->SetPLLCSR(1 << native::PINDIV);
+}
+
+void UsbControllerImpl::HandleWakeup() {
+  StartUsbClock();
+  // WAKEUPI can only be cleared once the clock is running again. Writing ones
+  // to the other flags leaves them unchanged.
+  native_->SetUDINT(~(1 << native::WAKEUPI));
+  suspended_ = false;
+  remote_wakeup_requested_ = false;
+  // Reports may have been queued before the suspend, or while it was being
+  // resumed.
+  SetStartOfFrameInterruptEnabled(HasStartOfFrameWork());
+}
+
+void UsbControllerImpl::StartUsbClock() {
+  native_->SetPLLCSR((1 << native::PINDIV) | (1 << native::PLLE));
+  // The PLL locks within 100us.
+  while (!(native_->GetPLLCSR() & (1 << native::PLOCK)))
+    ;
+  native_->SetUSBCON((1 << native::USBE) | (1 << native::OTGPADE));
 }
 
 void UsbControllerImpl::HandleEndpointInterrupt() {
-  // Immediately parse incoming data into a SETUP packet. If there's an issue
-  // with the interrupt type it'll be handled afterwards.
-  SetupPacket packet = SetupPacket::ParseFromUsbEndpoint(native_);
-  // Backup and clear interrupt bits to handshake the interrupt.
+  // Endpoint interrupts are only enabled for endpoint 0, the control endpoint.
+  native_->SetUENUM(0);
   uint8_t interrupt = native_->GetUEINTX();
+  // Any interrupt other than a new SETUP packet continues the data or status
+  // stage of the current control transfer.
+  if (!(interrupt & (1 << native::RXSTPI))) {
+    request_handler_->HandleControlInterrupt(interrupt);
+    return;
+  }
+
+  // Parse incoming data into a SETUP packet, then clear interrupt bits to
+  // handshake the interrupt.
+  SetupPacket packet = SetupPacket::ParseFromUsbEndpoint(native_);
   native_->SetUEINTX(
       native_->GetUEINTX() &
       ~((1 << native::RXSTPI) | (1 << native::RXOUTI) | (1 << native::TXINI)));
+  request_handler_->ResetControlTransfer();
 
-  // This interrupt handler is only used for responding to USB SETUP packets. If
-  // the interrupt has triggered for any other reason, we should reply with
-  // STALL.
-  if (!(interrupt & (1 << native::RXSTPI))) {
-    native_->SetUECONX((1 << native::STALLRQ) | (1 << native::EPEN));
-    return;
+  // Standard and class request codes overlap, so the request type has to be
+  // checked before the request code.
+  RequestType request_type = packet.bmRequestType;
+  if (request_type.GetType() == RequestType::Type::STANDARD) {
+    HandleStandardRequest(packet);
+  } else if (request_type.GetType() == RequestType::Type::CLASS &&
+             request_type.GetRecipient() ==
+                 RequestType::Recipient::INTERFACE &&
+             packet.wIndex == descriptor::kKeyboardInterfaceIndex) {
+    HandleHidRequest(packet);
+  } else if (request_type.GetType() == RequestType::Type::CLASS &&
+             request_type.GetRecipient() ==
+                 RequestType::Recipient::INTERFACE &&
+             packet.wIndex == descriptor::kVendorInterfaceIndex) {
+    HandleVendorRequest(packet);
+#ifdef THREEBOARD_USB_CONSOLE
+  } else if (request_type.GetType() == RequestType::Type::CLASS &&
+             request_type.GetRecipient() ==
+                 RequestType::Recipient::INTERFACE &&
+             packet.wIndex == descriptor::kConsoleControlInterfaceIndex) {
+    HandleConsoleRequest(packet);
+#endif
+  } else {
+    request_handler_->HandleUnsupportedRequest();
   }
+}
 
-  // Call the appropriate device handlers for device requests.
-  if (packet.bRequest == Request::GET_STATUS) {
-    request_handler_->HandleGetStatus();
-  }
-  if (packet.bRequest == Request::SET_ADDRESS) {
-    request_handler_->HandleSetAddress(packet);
-  }
-  if (packet.bRequest == Request::GET_DESCRIPTOR) {
-    request_handler_->HandleGetDescriptor(packet);
-  }
-  if (packet.bRequest == Request::GET_CONFIGURATION &&
-      packet.bmRequestType.GetDirection() ==
-          RequestType::Direction::DEVICE_TO_HOST) {
-    request_handler_->HandleGetConfiguration(hid_state_);
-  }
-  if (packet.bRequest == Request::SET_CONFIGURATION &&
-      packet.bmRequestType.GetDirection() ==
-          RequestType::Direction::HOST_TO_DEVICE) {
-    request_handler_->HandleSetConfiguration(packet, &hid_state_);
+void UsbControllerImpl::HandleStandardRequest(const SetupPacket &packet) {
+  bool device_to_host = packet.bmRequestType.GetDirection() ==
+                        RequestType::Direction::DEVICE_TO_HOST;
+  switch (packet.bRequest) {
+    case Request::GET_STATUS:
+      if (device_to_host) {
+        request_handler_->HandleGetStatus(packet, hid_state_);
+        return;
+      }
+      break;
+    case Request::CLEAR_FEATURE:
+      if (!device_to_host) {
+        request_handler_->HandleClearFeature(packet, &hid_state_);
+        return;
+      }
+      break;
+    case Request::SET_FEATURE:
+      if (!device_to_host) {
+        request_handler_->HandleSetFeature(packet, &hid_state_);
+        return;
+      }
+      break;
+    case Request::SET_ADDRESS:
+      if (!device_to_host) {
+        request_handler_->HandleSetAddress(packet);
+        return;
+      }
+      break;
+    case Request::GET_DESCRIPTOR:
+      if (device_to_host) {
+        request_handler_->HandleGetDescriptor(packet);
+        return;
+      }
+      break;
+    case Request::GET_CONFIGURATION:
+      if (device_to_host) {
+        request_handler_->HandleGetConfiguration(hid_state_);
+        return;
+      }
+      break;
+    case Request::SET_CONFIGURATION:
+      if (!device_to_host) {
+        request_handler_->HandleSetConfiguration(packet, &hid_state_);
+        return;
+      }
+      break;
+    case Request::GET_INTERFACE:
+      if (device_to_host) {
+        request_handler_->HandleGetInterface(packet, hid_state_);
+        return;
+      }
+      break;
+    case Request::SET_INTERFACE:
+      if (!device_to_host) {
+        request_handler_->HandleSetInterface(packet, hid_state_);
+        return;
+      }
+      break;
+    default:
+      break;
   }
+  request_handler_->HandleUnsupportedRequest();
+}
 
-  // Call the appropriate HID handlers for HID requests.
-  if (packet.wIndex == descriptor::kKeyboardInterfaceIndex &&
-      packet.bmRequestType.GetType() == RequestType::Type::CLASS &&
-      packet.bmRequestType.GetRecipient() ==
-          RequestType::Recipient::INTERFACE) {
-    if (packet.bmRequestType.GetDirection() ==
-        RequestType::Direction::DEVICE_TO_HOST) {
-      if (packet.bRequest == Request::HID_GET_REPORT) {
+void UsbControllerImpl::HandleHidRequest(const SetupPacket &packet) {
+  bool device_to_host = packet.bmRequestType.GetDirection() ==
+                        RequestType::Direction::DEVICE_TO_HOST;
+  switch (packet.bRequest) {
+    case Request::HID_GET_REPORT:
+      // The keyboard's only feature report is the latency report. Its input
+      // report is the HID state.
+      if (device_to_host &&
+          (packet.wValue >> 8) == (uint8_t)ReportType::FEATURE) {
+        request_handler_->HandleGetLatencyReport(
+            packet, latency_telemetry_->GetReport());
+        return;
+      }
+      if (device_to_host) {
         request_handler_->HandleGetReport(hid_state_);
+        return;
       }
-      if (packet.bRequest == Request::HID_GET_IDLE) {
+      break;
+    case Request::HID_GET_IDLE:
+      if (device_to_host) {
         request_handler_->HandleGetIdle(hid_state_);
+        return;
       }
-      if (packet.bRequest == Request::HID_GET_PROTOCOL) {
+      break;
+    case Request::HID_GET_PROTOCOL:
+      if (device_to_host) {
         request_handler_->HandleGetProtocol(hid_state_);
+        return;
       }
-    }
-    if (packet.bmRequestType.GetDirection() ==
-        RequestType::Direction::HOST_TO_DEVICE) {
-      if (packet.bRequest == Request::HID_SET_IDLE) {
+      break;
+    case Request::HID_SET_REPORT:
+      if (!device_to_host) {
+        request_handler_->HandleSetReport(packet, &hid_state_);
+        return;
+      }
+      break;
+    case Request::HID_SET_IDLE:
+      if (!device_to_host) {
         request_handler_->HandleSetIdle(packet, &hid_state_);
+        return;
       }
-      if (packet.bRequest == Request::HID_SET_PROTOCOL) {
+      break;
+    case Request::HID_SET_PROTOCOL:
+      if (!device_to_host) {
         request_handler_->HandleSetProtocol(packet, &hid_state_);
+        return;
       }
-    }
+      break;
+    default:
+      break;
+  }
+  request_handler_->HandleUnsupportedRequest();
+}
+
+void UsbControllerImpl::HandleVendorRequest(const SetupPacket &packet) {
+  // The vendor interface only has a feature report, so the idle rate and
+  // protocol requests don't apply to it.
+  bool device_to_host = packet.bmRequestType.GetDirection() ==
+                        RequestType::Direction::DEVICE_TO_HOST;
+  if (packet.bRequest == Request::HID_GET_REPORT && device_to_host) {
+    request_handler_->HandleGetMemoryReport(packet, &hid_state_);
+  } else if (packet.bRequest == Request::HID_SET_REPORT && !device_to_host) {
+    request_handler_->HandleSetMemoryReport(packet, &hid_state_);
+  } else {
+    request_handler_->HandleUnsupportedRequest();
   }
 }
 
-bool UsbControllerImpl::SendKeypress() {
-  uint8_t intr_state = native_->GetSREG();
+#ifdef THREEBOARD_USB_CONSOLE
+void UsbControllerImpl::HandleConsoleRequest(const SetupPacket &packet) {
+  bool device_to_host = packet.bmRequestType.GetDirection() ==
+                        RequestType::Direction::DEVICE_TO_HOST;
+  if (packet.bRequest == Request::CDC_SET_LINE_CODING && !device_to_host) {
+    request_handler_->HandleSetLineCoding(packet, &hid_state_);
+  } else if (packet.bRequest == Request::CDC_GET_LINE_CODING &&
+             device_to_host) {
+    request_handler_->HandleGetLineCoding(packet, hid_state_);
+  } else if (packet.bRequest == Request::CDC_SET_CONTROL_LINE_STATE &&
+             !device_to_host) {
+    request_handler_->HandleSetControlLineState(packet, &hid_state_);
+    // Send any output logged while the console was closed.
+    SetStartOfFrameInterruptEnabled(HasStartOfFrameWork());
+  } else {
+    request_handler_->HandleUnsupportedRequest();
+  }
+}
+
+void UsbControllerImpl::HandleLogMessage(const char *message) {
+  // The console is shared with the interrupt handler, so modify it
+  // atomically.
+  uint8_t sreg = native_->GetSREG();
   native_->DisableInterrupts();
-  uint8_t initial_frame_num = native_->GetUDFNUML();
-  while (true) {
-    // Switch to keyboard endpoint.
-    native_->SetUENUM(descriptor::kKeyboardEndpoint);
-    native_->EnableInterrupts();
-    // Check if we're allowed to push data into the FIFO. If we are, we can
-    // immediately break and begin transmitting.
-    if (native_->GetUEINTX() & (1 << native::RWAL)) {
-      break;
-    }
-    native_->SetSREG(intr_state);
-    // Ensure the device is still configured.
-    RETURN_IF_ERROR(hid_state_.configuration);
-    // Only continue polling RWAL for 50 frames (50ms on our full-speed bus).
-    if ((native_->GetUDFNUML() - initial_frame_num) >= kFrameTimeout) {
-      return false;
-    }
-    intr_state = native_->GetSREG();
-    native_->DisableInterrupts();
+  console_.Write(message);
+  if (!suspended_ && hid_state_.configuration && hid_state_.console_open) {
+    SetStartOfFrameInterruptEnabled(true);
   }
+  native_->SetSREG(sreg);
+}
+
+void UsbControllerImpl::SendConsoleOutput() {
+  if (!hid_state_.console_open || !console_.HasPendingData()) {
+    return;
+  }
+  native_->SetUENUM(descriptor::kConsoleDataInEndpoint);
+  if (native_->GetUEINTX() & (1 << native::RWAL)) {
+    console_.SendNextPacket();
+  }
+}
+#endif
 
+void UsbControllerImpl::SendNextReport() {
+  hid_state_.report = report_queue_[report_queue_head_];
+  report_queue_head_ = (report_queue_head_ + 1) % kReportQueueSize;
+  report_queue_length_--;
   SendHidState();
-  native_->SetSREG(intr_state);
-  return true;
 }
 
 // Send the state of the HID device to the bus.
 void UsbControllerImpl::SendHidState() {
-  hid_state_.idle_count = 0;
-  native_->SetUEDATX(hid_state_.modifier_keys);
-  native_->SetUEDATX(0);
-  for (uint8_t i = 0; i < 6; i++) {
-    native_->SetUEDATX(hid_state_.keyboard_keys[i]);
-  }
+  hid_state_.idle_elapsed_ms = 0;
+  WriteHidReport(native_, hid_state_.report, hid_state_.protocol);
   // Reset UEINTX after send
   native_->SetUEINTX((1 << native::RWAL) | (1 << native::NAKOUTI) |
                      (1 << native::RXSTPI) | (1 << native::STALLEDI));
@@ -1,7 +1,10 @@
 #pragma once
 
+#include "src/delegates/log_handler_delegate.h"
 #include "src/delegates/usb_interrupt_handler_delegate.h"
+#include "src/latency_telemetry.h"
 #include "src/native/native.h"
+#include "src/usb/internal/console.h"
 #include "src/usb/internal/hid_state.h"
 #include "src/usb/internal/request_handler.h"
 #include "src/usb/usb_controller.h"
@@ -13,28 +16,133 @@ namespace usb {
 // (https://github.com/abcminiuser/lufa), and by the Atreus firmware
 // (https://github.com/technomancy/atreus-firmware).
 // It explicitly does not support the ENDPOINT_HALT feature, since it's rarely
-// used and shouldn't affect functionality at all.
+// used and shouldn't affect functionality at all. Builds with
+// THREEBOARD_USB_CONSOLE defined also have a CDC-ACM console, which sends log
+// output to a serial port on the host.
 class UsbControllerImpl final : public UsbController,
+#ifdef THREEBOARD_USB_CONSOLE
+                                public LogHandlerDelegate,
+#endif
                                 public UsbInterruptHandlerDelegate {
  public:
-  UsbControllerImpl(native::Native *);
+  UsbControllerImpl(native::Native *, LatencyTelemetry *);
 
   bool Setup() override;
   bool HasConfigured() override;
   bool SendKeypress(uint8_t key, uint8_t mod) override;
+  bool TypeKey(uint8_t key, uint8_t mod) override;
+  bool EndKeySequence() override;
+  void UpdateIdleTimer() override;
+  bool IsSuspended() override;
+  bool RequestRemoteWakeup() override;
+  MemoryReport *GetMemoryRequest() override;
+  void CompleteMemoryRequest(bool success) override;
 
   void HandleGeneralInterrupt() override;
   void HandleEndpointInterrupt() override;
 
+#ifdef THREEBOARD_USB_CONSOLE
+  void HandleLogMessage(const char *message) override;
+#endif
+
  private:
   friend class UsbImplTest;
 
-  bool SendKeypress();
+  // The state of the reports given to the keyboard endpoint. This is shared by
+  // the send path and the idle timer, so that idle reports are only sent once
+  // every data report has reached the host.
+  enum class ReportState : uint8_t {
+    // Every report written to the endpoint has been read by the host.
+    ACKED,
+    // Reports are waiting in the queue to be written to the endpoint.
+    PENDING,
+    // The queue is empty, but the host hasn't read every report written to
+    // the endpoint yet.
+    IN_FLIGHT,
+  };
+
+  // The maximum number of reports waiting to be sent to the host. One report
+  // is sent per USB frame.
+  static constexpr uint8_t kReportQueueSize = 8;
+
+  // Add a report to the back of the queue, sleeping until there's space for
+  // it if the queue is full. Returns false if the device isn't configured, or
+  // the queue doesn't drain for kFrameTimeout frames.
+  bool QueueReport(const HidReport &report);
+  // Remove the report at the front of the queue and send it to the host. Must
+  // only be called from the interrupt handler when RWAL is set.
+  void SendNextReport();
+  // Send the reports that are due in this frame, if the endpoint can accept
+  // them.
+  void HandleStartOfFrame();
+  // Returns true if the start of frame interrupt has something to send, or is
+  // waiting for the host to read a report.
+  bool HasStartOfFrameWork();
+  // Enable or disable the start of frame interrupt. It's only enabled while
+  // there's a report to send or one waiting to be read by the host, so the CPU
+  // isn't woken every 1ms when there's nothing to do. The suspend interrupt is
+  // enabled while the bus is active, and the wakeup interrupt while it's
+  // suspended.
+  void SetStartOfFrameInterruptEnabled(bool enabled);
+  // Freeze the USB clock when the host suspends the bus, and restart it when
+  // the bus resumes.
+  void HandleSuspend();
+  void HandleWakeup();
+  // Restart the PLL and unfreeze the USB clock.
+  void StartUsbClock();
+  // Dispatch a SETUP packet to the handler for its request. Requests that
+  // aren't handled are stalled.
+  void HandleStandardRequest(const SetupPacket &packet);
+  void HandleHidRequest(const SetupPacket &packet);
+  void HandleVendorRequest(const SetupPacket &packet);
   void SendHidState();
+#ifdef THREEBOARD_USB_CONSOLE
+  void HandleConsoleRequest(const SetupPacket &packet);
+  // Send the next packet of log output, if a terminal has the console open and
+  // the endpoint can accept it.
+  void SendConsoleOutput();
+#endif
+
+  // Queue the pending report of a key sequence, or a report releasing every
+  // key.
+  bool SendPendingReport();
+  bool SendReleaseReport();
 
   native::Native *native_;
+  // Records when reports are queued and read by the host, and provides the
+  // latency report.
+  LatencyTelemetry *latency_telemetry_;
+  // The state last reported to the host.
   HidState hid_state_;
+
+  // Ring buffer of reports waiting to be sent to the host, drained by the
+  // start of frame interrupt.
+  HidReport report_queue_[kReportQueueSize];
+  uint8_t report_queue_head_ = 0;
+  volatile uint8_t report_queue_length_ = 0;
+  // The last report added to the queue, which is the state the host will see
+  // once the queue has drained.
+  HidReport queued_report_;
+  volatile ReportState report_state_ = ReportState::ACKED;
+  // Set by the idle timer when an idle report should be sent in the next
+  // frame.
+  volatile bool idle_report_due_ = false;
+  // Set while the host has suspended the bus.
+  volatile bool suspended_ = false;
+  // Set once remote wakeup has been signalled, until the bus resumes.
+  bool remote_wakeup_requested_ = false;
+
+  // The next report of the current key sequence, which hasn't been queued yet.
+  uint8_t pending_modifier_keys_ = 0;
+  uint8_t pending_keyboard_keys_[kMaxReportKeyCount];
+  uint8_t pending_key_count_ = 0;
   RequestHandler *request_handler_;
+
+#ifdef THREEBOARD_USB_CONSOLE
+  // Log output waiting to be read by the host. Declared after native_, so
+  // it's initialised after it.
+  Console console_{native_};
+#endif
 };
 }  // namespace usb
 }  // namespace threeboard
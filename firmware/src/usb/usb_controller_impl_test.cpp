@@ -1,5 +1,9 @@
 #include "usb_controller_impl.h"
 
+#include <string>
+#include <vector>
+
+#include "src/latency_telemetry_mock.h"
 #include "src/logging_fake.h"
 #include "src/native/native_mock.h"
 #include "src/usb/internal/request_handler_mock.h"
@@ -9,18 +13,36 @@ namespace threeboard {
 namespace usb {
 
 using ::testing::_;
+using ::testing::AnyNumber;
 using ::testing::Invoke;
 using ::testing::Return;
 
+// A HID report as it's written to the keyboard endpoint.
+using Report = std::vector<uint8_t>;
+
+// General interrupts with the start of frame interrupt enabled or disabled,
+// while the bus is active.
+constexpr uint8_t kStartOfFrameEnabled =
+    (1 << native::EORSTE) | (1 << native::SUSPE) | (1 << native::SOFE);
+constexpr uint8_t kStartOfFrameDisabled =
+    (1 << native::EORSTE) | (1 << native::SUSPE);
+// General interrupts while the bus is suspended.
+constexpr uint8_t kSuspendedInterrupts =
+    (1 << native::EORSTE) | (1 << native::WAKEUPE);
+
 class UsbImplTest : public ::testing::Test {
  public:
   UsbImplTest() : handler_mock_(&native_mock_) {
     EXPECT_CALL(native_mock_, SetUsbInterruptHandlerDelegate(_)).Times(1);
-    usb_controller_ = std::make_unique<UsbControllerImpl>(&native_mock_);
+    // Tests that aren't about latency telemetry don't care when it's recorded.
+    EXPECT_CALL(latency_telemetry_mock_, RecordStage(_)).Times(AnyNumber());
+    usb_controller_ = std::make_unique<UsbControllerImpl>(
+        &native_mock_, &latency_telemetry_mock_);
     usb_controller_->request_handler_ = &handler_mock_;
   }
 
   void SetupEndpointInterruptMocks() {
+    EXPECT_CALL(native_mock_, SetUENUM(0)).Times(1);
     EXPECT_CALL(native_mock_, GetUEINTX())
         .Times(2)
         .WillOnce(Return(1 << native::RXSTPI))
@@ -29,7 +51,7 @@ class UsbImplTest : public ::testing::Test {
                 SetUEINTX(99 & ~((1 << native::RXSTPI) | (1 << native::RXOUTI) |
                                  (1 << native::TXINI))))
         .Times(1);
-    EXPECT_CALL(native_mock_, SetUENUM(0)).Times(1);
+    EXPECT_CALL(handler_mock_, ResetControlTransfer()).Times(1);
   }
 
   SetupPacket MockEndpointInterrupt(Request request, RequestType request_type,
@@ -54,8 +76,116 @@ class UsbImplTest : public ::testing::Test {
     return MockEndpointInterrupt(request, 0, 0);
   }
 
+  // Mark the device as configured by the host, and allow reports to be
+  // queued without the queue filling up. Most tests use the boot protocol,
+  // since its reports are easier to read.
+  void Configure(uint8_t protocol = hid::kBootProtocol) {
+    usb_controller_->hid_state_.configuration = 1;
+    usb_controller_->hid_state_.protocol = protocol;
+    EXPECT_CALL(native_mock_, GetSREG()).WillRepeatedly(Return(0));
+    EXPECT_CALL(native_mock_, SetSREG(0)).Times(AnyNumber());
+    EXPECT_CALL(native_mock_, DisableInterrupts()).Times(AnyNumber());
+    EXPECT_CALL(native_mock_, GetUDFNUML()).WillRepeatedly(Return(0));
+    // The start of frame interrupt is enabled whenever a report is queued, and
+    // disabled once there's nothing left to send.
+    EXPECT_CALL(native_mock_, SetUDIEN(kStartOfFrameEnabled))
+        .Times(AnyNumber());
+    EXPECT_CALL(native_mock_, SetUDIEN(kStartOfFrameDisabled))
+        .Times(AnyNumber());
+  }
+
+  // Fire a general interrupt as the host suspends the bus.
+  void Suspend() {
+    EXPECT_CALL(native_mock_, GetUDINT()).WillOnce(Return(1 << native::SUSPI));
+    EXPECT_CALL(native_mock_, SetUDINT(0));
+    EXPECT_CALL(native_mock_, SetUDIEN(kSuspendedInterrupts));
+    EXPECT_CALL(native_mock_, SetUSBCON((1 << native::USBE) |
+                                        (1 << native::OTGPADE) |
+                                        (1 << native::FRZCLK)));
+    EXPECT_CALL(native_mock_, SetPLLCSR(1 << native::PINDIV));
+    usb_controller_->HandleGeneralInterrupt();
+  }
+
+  // Expect the USB clock to be restarted after a suspend.
+  void ExpectUsbClockStart() {
+    EXPECT_CALL(native_mock_,
+                SetPLLCSR((1 << native::PINDIV) | (1 << native::PLLE)));
+    EXPECT_CALL(native_mock_, GetPLLCSR())
+        .WillOnce(Return(0))
+        .WillOnce(Return(1 << native::PLOCK));
+    EXPECT_CALL(native_mock_,
+                SetUSBCON((1 << native::USBE) | (1 << native::OTGPADE)));
+  }
+
+  void SetIdleConfig(uint8_t idle_config) {
+    usb_controller_->hid_state_.idle_config = idle_config;
+  }
+
+  void SetMemoryReportStatus(MemoryReport::Status status) {
+    usb_controller_->hid_state_.memory_report_status = status;
+  }
+
+  MemoryReport::Status MemoryReportStatus() {
+    return usb_controller_->hid_state_.memory_report_status;
+  }
+
+  void SetRemoteWakeupEnabled(bool enabled) {
+    usb_controller_->hid_state_.remote_wakeup_enabled = enabled;
+  }
+
+  bool RemoteWakeupEnabled() {
+    return usb_controller_->hid_state_.remote_wakeup_enabled;
+  }
+
+  uint8_t QueuedReportCount() { return usb_controller_->report_queue_length_; }
+
+  // Fire a start of frame interrupt while the keyboard endpoint is ready to
+  // accept one report, and return the report that was sent.
+  Report SendStartOfFrame() {
+    Report report;
+    EXPECT_CALL(native_mock_, GetUDINT()).WillOnce(Return(1 << native::SOFI));
+    EXPECT_CALL(native_mock_, SetUDINT(0));
+    EXPECT_CALL(native_mock_, GetUDMFN()).WillOnce(Return(0));
+    EXPECT_CALL(native_mock_, SetUENUM(descriptor::kKeyboardEndpoint));
+    EXPECT_CALL(native_mock_, GetUEINTX())
+        .WillOnce(Return(1 << native::RWAL))
+        .WillRepeatedly(Return(0));
+    EXPECT_CALL(native_mock_, SetUEDATX(_))
+        .WillRepeatedly(Invoke([&](uint8_t data) { report.push_back(data); }));
+    EXPECT_CALL(native_mock_, SetUEINTX(_));
+    usb_controller_->HandleGeneralInterrupt();
+    return report;
+  }
+
+  // Fire a start of frame interrupt which shouldn't send a report, while the
+  // endpoint has `busy_banks` banks waiting to be read by the host.
+  void SendStartOfFrameWithoutReport(uint8_t busy_banks) {
+    EXPECT_CALL(native_mock_, GetUDINT()).WillOnce(Return(1 << native::SOFI));
+    EXPECT_CALL(native_mock_, SetUDINT(0));
+    EXPECT_CALL(native_mock_, GetUDMFN()).WillOnce(Return(0));
+    EXPECT_CALL(native_mock_, SetUENUM(descriptor::kKeyboardEndpoint));
+    // The busy banks are only checked while a report is in flight.
+    EXPECT_CALL(native_mock_, GetUESTA0X())
+        .Times(AnyNumber())
+        .WillRepeatedly(Return(busy_banks));
+    EXPECT_CALL(native_mock_, GetUEINTX())
+        .Times(AnyNumber())
+        .WillRepeatedly(Return(busy_banks < 2 ? 1 << native::RWAL : 0));
+    usb_controller_->HandleGeneralInterrupt();
+  }
+
+  // Send every queued report to the host, one per frame.
+  std::vector<Report> DrainReports() {
+    std::vector<Report> reports;
+    while (QueuedReportCount() > 0) {
+      reports.push_back(SendStartOfFrame());
+    }
+    return reports;
+  }
+
   native::NativeMock native_mock_;
   RequestHandlerMock handler_mock_;
+  LatencyTelemetryMock latency_telemetry_mock_;
   LoggingFake logging_fake_;
   std::unique_ptr<UsbControllerImpl> usb_controller_;
 };
@@ -86,48 +216,79 @@ TEST_F(UsbImplTest, SetupSuccess) {
   EXPECT_CALL(native_mock_,
               SetUSBCON((1 << native::USBE) | (1 << native::OTGPADE)))
       .Times(1);
-  EXPECT_CALL(native_mock_,
-              SetUDIEN((1 << native::EORSTE) | (1 << native::SOFE)))
-      .Times(1);
+  EXPECT_CALL(native_mock_, SetUDIEN(kStartOfFrameDisabled)).Times(1);
   EXPECT_CALL(native_mock_, GetUDCON()).WillOnce(Return(42));
   EXPECT_CALL(native_mock_, SetUDCON(42 & ~(1 << native::DETACH))).Times(1);
   EXPECT_EQ(usb_controller_->Setup(), true);
 }
 
-TEST_F(UsbImplTest, DoesNothingOnInvalidSetupPacket) {
+TEST_F(UsbImplTest, StallsUnknownRequest) {
   SetupEndpointInterruptMocks();
   EXPECT_CALL(native_mock_, GetUEDATX())
       .Times(8)
       .WillOnce(Return(0))    // bmRequestType
       .WillOnce(Return(255))  // bRequest
       .WillRepeatedly(Return(0));
+  EXPECT_CALL(handler_mock_, HandleUnsupportedRequest()).Times(1);
   usb_controller_->HandleEndpointInterrupt();
 }
 
-TEST_F(UsbImplTest, StallsWithoutInterrupt) {
-  EXPECT_CALL(native_mock_, GetUEINTX())
-      .Times(2)
-      .WillOnce(Return(0))
-      .WillOnce(Return(99));
-  EXPECT_CALL(native_mock_,
-              SetUEINTX(99 & ~((1 << native::RXSTPI) | (1 << native::RXOUTI) |
-                               (1 << native::TXINI))))
-      .Times(1);
+TEST_F(UsbImplTest, StallsRequestWithWrongDirection) {
+  MockEndpointInterrupt(Request::GET_DESCRIPTOR,
+                        {RequestType::Direction::HOST_TO_DEVICE});
+  EXPECT_CALL(handler_mock_, HandleUnsupportedRequest()).Times(1);
+  usb_controller_->HandleEndpointInterrupt();
+}
+
+TEST_F(UsbImplTest, StallsVendorRequest) {
+  MockEndpointInterrupt(
+      Request::GET_STATUS,
+      {RequestType::Direction::DEVICE_TO_HOST, RequestType::Type::VENDOR});
+  EXPECT_CALL(handler_mock_, HandleUnsupportedRequest()).Times(1);
+  usb_controller_->HandleEndpointInterrupt();
+}
+
+TEST_F(UsbImplTest, StallsHidRequestForOtherInterface) {
+  MockEndpointInterrupt(
+      Request::HID_GET_REPORT,
+      {RequestType::Direction::DEVICE_TO_HOST, RequestType::Type::CLASS,
+       RequestType::Recipient::INTERFACE},
+      hid::kNumInterfaces);
+  EXPECT_CALL(handler_mock_, HandleUnsupportedRequest()).Times(1);
+  usb_controller_->HandleEndpointInterrupt();
+}
+
+TEST_F(UsbImplTest, ContinuesControlTransferWithoutSetupPacket) {
   EXPECT_CALL(native_mock_, SetUENUM(0)).Times(1);
-  EXPECT_CALL(native_mock_,
-              SetUECONX((1 << native::STALLRQ) | (1 << native::EPEN)))
+  EXPECT_CALL(native_mock_, GetUEINTX()).WillOnce(Return(1 << native::TXINI));
+  EXPECT_CALL(handler_mock_, HandleControlInterrupt(1 << native::TXINI))
       .Times(1);
-  // TODO: We need to do this for now because we immediately parse the SETUP
-  // packet on interrupt. Do we still need to do this?
-  SetupPacket packet;
-  testutil::MockSendingSetupPacket(&native_mock_, packet);
   usb_controller_->HandleEndpointInterrupt();
 }
 
 // Device requests.
 TEST_F(UsbImplTest, HandlesGetStatusRequest) {
-  MockEndpointInterrupt(Request::GET_STATUS);
-  EXPECT_CALL(handler_mock_, HandleGetStatus()).Times(1);
+  auto packet = MockEndpointInterrupt(Request::GET_STATUS,
+                                      {RequestType::Direction::DEVICE_TO_HOST});
+  EXPECT_CALL(handler_mock_, HandleGetStatus(packet, _)).Times(1);
+  usb_controller_->HandleEndpointInterrupt();
+}
+
+TEST_F(UsbImplTest, HandleClearFeatureRequest) {
+  auto packet = MockEndpointInterrupt(
+      Request::CLEAR_FEATURE,
+      {RequestType::Direction::HOST_TO_DEVICE, RequestType::Type::STANDARD,
+       RequestType::Recipient::ENDPOINT});
+  EXPECT_CALL(handler_mock_, HandleClearFeature(packet, _)).Times(1);
+  usb_controller_->HandleEndpointInterrupt();
+}
+
+TEST_F(UsbImplTest, HandleSetFeatureRequest) {
+  auto packet = MockEndpointInterrupt(
+      Request::SET_FEATURE,
+      {RequestType::Direction::HOST_TO_DEVICE, RequestType::Type::STANDARD,
+       RequestType::Recipient::ENDPOINT});
+  EXPECT_CALL(handler_mock_, HandleSetFeature(packet, _)).Times(1);
   usb_controller_->HandleEndpointInterrupt();
 }
 
@@ -138,7 +299,8 @@ TEST_F(UsbImplTest, HandleSetAddressRequest) {
 }
 
 TEST_F(UsbImplTest, HandleGetDescriptorRequest) {
-  auto packet = MockEndpointInterrupt(Request::GET_DESCRIPTOR);
+  auto packet = MockEndpointInterrupt(Request::GET_DESCRIPTOR,
+                                      {RequestType::Direction::DEVICE_TO_HOST});
   EXPECT_CALL(handler_mock_, HandleGetDescriptor(packet)).Times(1);
   usb_controller_->HandleEndpointInterrupt();
 }
@@ -157,6 +319,24 @@ TEST_F(UsbImplTest, HandleSetConfigurationRequest) {
   usb_controller_->HandleEndpointInterrupt();
 }
 
+TEST_F(UsbImplTest, HandleGetInterfaceRequest) {
+  auto packet = MockEndpointInterrupt(
+      Request::GET_INTERFACE,
+      {RequestType::Direction::DEVICE_TO_HOST, RequestType::Type::STANDARD,
+       RequestType::Recipient::INTERFACE});
+  EXPECT_CALL(handler_mock_, HandleGetInterface(packet, _)).Times(1);
+  usb_controller_->HandleEndpointInterrupt();
+}
+
+TEST_F(UsbImplTest, HandleSetInterfaceRequest) {
+  auto packet = MockEndpointInterrupt(
+      Request::SET_INTERFACE,
+      {RequestType::Direction::HOST_TO_DEVICE, RequestType::Type::STANDARD,
+       RequestType::Recipient::INTERFACE});
+  EXPECT_CALL(handler_mock_, HandleSetInterface(packet, _)).Times(1);
+  usb_controller_->HandleEndpointInterrupt();
+}
+
 // HID requests.
 TEST_F(UsbImplTest, HandleGetReportRequest) {
   MockEndpointInterrupt(
@@ -168,6 +348,25 @@ TEST_F(UsbImplTest, HandleGetReportRequest) {
   usb_controller_->HandleEndpointInterrupt();
 }
 
+TEST_F(UsbImplTest, HandleGetFeatureReportRequestWithLatencyReport) {
+  SetupEndpointInterruptMocks();
+  SetupPacket packet = {
+      .bmRequestType = {RequestType::Direction::DEVICE_TO_HOST,
+                        RequestType::Type::CLASS,
+                        RequestType::Recipient::INTERFACE},
+      .bRequest = Request::HID_GET_REPORT,
+      .wValue = (uint16_t)ReportType::FEATURE << 8,
+      .wIndex = descriptor::kKeyboardInterfaceIndex,
+      .wLength = sizeof(LatencyReport),
+  };
+  testutil::MockSendingSetupPacket(&native_mock_, packet);
+  LatencyReport report = {};
+  EXPECT_CALL(latency_telemetry_mock_, GetReport())
+      .WillOnce(::testing::ReturnRef(report));
+  EXPECT_CALL(handler_mock_, HandleGetLatencyReport(packet, _)).Times(1);
+  usb_controller_->HandleEndpointInterrupt();
+}
+
 TEST_F(UsbImplTest, HandleGetIdleRequest) {
   MockEndpointInterrupt(
       Request::HID_GET_IDLE,
@@ -188,6 +387,16 @@ TEST_F(UsbImplTest, HandleGetProtocolRequest) {
   usb_controller_->HandleEndpointInterrupt();
 }
 
+TEST_F(UsbImplTest, HandleSetReportRequest) {
+  auto packet = MockEndpointInterrupt(
+      Request::HID_SET_REPORT,
+      {RequestType::Direction::HOST_TO_DEVICE, RequestType::Type::CLASS,
+       RequestType::Recipient::INTERFACE},
+      descriptor::kKeyboardInterfaceIndex);
+  EXPECT_CALL(handler_mock_, HandleSetReport(packet, _)).Times(1);
+  usb_controller_->HandleEndpointInterrupt();
+}
+
 TEST_F(UsbImplTest, HandleSetIdleRequest) {
   auto packet = MockEndpointInterrupt(
       Request::HID_SET_IDLE,
@@ -207,5 +416,502 @@ TEST_F(UsbImplTest, HandleSetProtocolRequest) {
   EXPECT_CALL(handler_mock_, HandleSetProtocol(packet, _)).Times(1);
   usb_controller_->HandleEndpointInterrupt();
 }
+
+// Vendor interface requests.
+TEST_F(UsbImplTest, HandleGetMemoryReportRequest) {
+  auto packet = MockEndpointInterrupt(
+      Request::HID_GET_REPORT,
+      {RequestType::Direction::DEVICE_TO_HOST, RequestType::Type::CLASS,
+       RequestType::Recipient::INTERFACE},
+      descriptor::kVendorInterfaceIndex);
+  EXPECT_CALL(handler_mock_, HandleGetMemoryReport(packet, _)).Times(1);
+  usb_controller_->HandleEndpointInterrupt();
+}
+
+TEST_F(UsbImplTest, HandleSetMemoryReportRequest) {
+  auto packet = MockEndpointInterrupt(
+      Request::HID_SET_REPORT,
+      {RequestType::Direction::HOST_TO_DEVICE, RequestType::Type::CLASS,
+       RequestType::Recipient::INTERFACE},
+      descriptor::kVendorInterfaceIndex);
+  EXPECT_CALL(handler_mock_, HandleSetMemoryReport(packet, _)).Times(1);
+  usb_controller_->HandleEndpointInterrupt();
+}
+
+TEST_F(UsbImplTest, StallsIdleRequestForVendorInterface) {
+  MockEndpointInterrupt(
+      Request::HID_SET_IDLE,
+      {RequestType::Direction::HOST_TO_DEVICE, RequestType::Type::CLASS,
+       RequestType::Recipient::INTERFACE},
+      descriptor::kVendorInterfaceIndex);
+  EXPECT_CALL(handler_mock_, HandleUnsupportedRequest()).Times(1);
+  usb_controller_->HandleEndpointInterrupt();
+}
+
+#ifdef THREEBOARD_USB_CONSOLE
+// Console requests.
+TEST_F(UsbImplTest, HandleConsoleLineCodingRequests) {
+  auto packet = MockEndpointInterrupt(
+      Request::CDC_SET_LINE_CODING,
+      {RequestType::Direction::HOST_TO_DEVICE, RequestType::Type::CLASS,
+       RequestType::Recipient::INTERFACE},
+      descriptor::kConsoleControlInterfaceIndex);
+  EXPECT_CALL(handler_mock_, HandleSetLineCoding(packet, _)).Times(1);
+  usb_controller_->HandleEndpointInterrupt();
+
+  packet = MockEndpointInterrupt(
+      Request::CDC_GET_LINE_CODING,
+      {RequestType::Direction::DEVICE_TO_HOST, RequestType::Type::CLASS,
+       RequestType::Recipient::INTERFACE},
+      descriptor::kConsoleControlInterfaceIndex);
+  EXPECT_CALL(handler_mock_, HandleGetLineCoding(packet, _)).Times(1);
+  usb_controller_->HandleEndpointInterrupt();
+}
+
+TEST_F(UsbImplTest, StallsHidRequestForConsoleInterface) {
+  MockEndpointInterrupt(
+      Request::HID_GET_REPORT,
+      {RequestType::Direction::DEVICE_TO_HOST, RequestType::Type::CLASS,
+       RequestType::Recipient::INTERFACE},
+      descriptor::kConsoleControlInterfaceIndex);
+  EXPECT_CALL(handler_mock_, HandleUnsupportedRequest()).Times(1);
+  usb_controller_->HandleEndpointInterrupt();
+}
+
+TEST_F(UsbImplTest, LogOutputIsSentOnceConsoleIsOpened) {
+  Configure();
+  // Nothing is sent while the console is closed.
+  EXPECT_CALL(native_mock_, SetUDIEN(kStartOfFrameEnabled)).Times(0);
+  usb_controller_->HandleLogMessage("boot");
+
+  // Opening the console enables the start of frame interrupt to send the
+  // output logged while it was closed.
+  auto packet = MockEndpointInterrupt(
+      Request::CDC_SET_CONTROL_LINE_STATE,
+      {RequestType::Direction::HOST_TO_DEVICE, RequestType::Type::CLASS,
+       RequestType::Recipient::INTERFACE},
+      descriptor::kConsoleControlInterfaceIndex);
+  EXPECT_CALL(handler_mock_, HandleSetControlLineState(packet, _))
+      .WillOnce(Invoke([](const SetupPacket &, HidState *hid_state) {
+        hid_state->console_open = true;
+      }));
+  EXPECT_CALL(native_mock_, SetUDIEN(kStartOfFrameEnabled)).Times(1);
+  usb_controller_->HandleEndpointInterrupt();
+
+  std::string output;
+  EXPECT_CALL(native_mock_, GetUDINT()).WillOnce(Return(1 << native::SOFI));
+  EXPECT_CALL(native_mock_, SetUDINT(0));
+  EXPECT_CALL(native_mock_, GetUDMFN()).WillOnce(Return(0));
+  EXPECT_CALL(native_mock_, SetUENUM(descriptor::kKeyboardEndpoint));
+  EXPECT_CALL(native_mock_, SetUENUM(descriptor::kConsoleDataInEndpoint));
+  EXPECT_CALL(native_mock_, GetUEINTX()).WillOnce(Return(1 << native::RWAL));
+  EXPECT_CALL(native_mock_, SetUEDATX(_))
+      .WillRepeatedly(Invoke([&](uint8_t data) { output.push_back(data); }));
+  EXPECT_CALL(native_mock_, SetUEINTX(_));
+  // Everything has been sent, so the interrupt is disabled again.
+  EXPECT_CALL(native_mock_, SetUDIEN(kStartOfFrameDisabled)).Times(1);
+  usb_controller_->HandleGeneralInterrupt();
+  EXPECT_EQ(output, "boot\r\n");
+
+  // Later output enables the interrupt straight away.
+  EXPECT_CALL(native_mock_, SetUDIEN(kStartOfFrameEnabled)).Times(1);
+  usb_controller_->HandleLogMessage("more");
+}
+#endif
+
+TEST_F(UsbImplTest, MemoryRequestIsAvailableWhileBusy) {
+  EXPECT_EQ(usb_controller_->GetMemoryRequest(), nullptr);
+  SetMemoryReportStatus(MemoryReport::Status::BUSY);
+  ASSERT_NE(usb_controller_->GetMemoryRequest(), nullptr);
+
+  usb_controller_->CompleteMemoryRequest(true);
+  EXPECT_EQ(usb_controller_->GetMemoryRequest(), nullptr);
+  EXPECT_EQ(MemoryReportStatus(), MemoryReport::Status::COMPLETE);
+
+  SetMemoryReportStatus(MemoryReport::Status::BUSY);
+  usb_controller_->CompleteMemoryRequest(false);
+  EXPECT_EQ(MemoryReportStatus(), MemoryReport::Status::FAILED);
+}
+
+TEST_F(UsbImplTest, SendKeypressQueuesPressAndRelease) {
+  Configure();
+  EXPECT_TRUE(usb_controller_->SendKeypress(4, 2));
+  EXPECT_EQ(DrainReports(), (std::vector<Report>{{2, 0, 4, 0, 0, 0, 0, 0},
+                                                 {0, 0, 0, 0, 0, 0, 0, 0}}));
+}
+
+TEST_F(UsbImplTest, SendKeypressFailsWhenQueueIsFull) {
+  Configure();
+  for (uint8_t i = 0; i < 3; ++i) {
+    EXPECT_TRUE(usb_controller_->SendKeypress(4 + i, 0));
+  }
+  // There's only space for two more reports, which isn't enough for a
+  // keypress, so nothing is queued.
+  EXPECT_FALSE(usb_controller_->SendKeypress(7, 0));
+  EXPECT_EQ(QueuedReportCount(), 6);
+}
+
+TEST_F(UsbImplTest, SendKeypressFailsWhenNotConfigured) {
+  EXPECT_CALL(native_mock_, GetSREG()).WillOnce(Return(0));
+  EXPECT_CALL(native_mock_, DisableInterrupts());
+  EXPECT_CALL(native_mock_, SetSREG(0));
+  EXPECT_FALSE(usb_controller_->SendKeypress(4, 0));
+  EXPECT_EQ(QueuedReportCount(), 0);
+}
+
+TEST_F(UsbImplTest, StartOfFrameSendsOneQueuedReport) {
+  Configure();
+  EXPECT_TRUE(usb_controller_->SendKeypress(4, 0));
+  EXPECT_EQ(SendStartOfFrame(), (Report{0, 0, 4, 0, 0, 0, 0, 0}));
+  EXPECT_EQ(QueuedReportCount(), 1);
+}
+
+TEST_F(UsbImplTest, StartOfFrameFillsBothEndpointBanks) {
+  Configure();
+  EXPECT_TRUE(usb_controller_->SendKeypress(4, 0));
+  EXPECT_TRUE(usb_controller_->SendKeypress(5, 0));
+  ASSERT_EQ(QueuedReportCount(), 4);
+
+  // Both banks are free, so two reports are written in the same frame.
+  std::vector<uint8_t> data;
+  EXPECT_CALL(native_mock_, GetUDINT()).WillOnce(Return(1 << native::SOFI));
+  EXPECT_CALL(native_mock_, SetUDINT(0));
+  EXPECT_CALL(native_mock_, GetUDMFN()).WillOnce(Return(0));
+  EXPECT_CALL(native_mock_, SetUENUM(descriptor::kKeyboardEndpoint));
+  EXPECT_CALL(native_mock_, GetUEINTX())
+      .WillOnce(Return(1 << native::RWAL))
+      .WillOnce(Return(1 << native::RWAL))
+      .WillOnce(Return(0));
+  EXPECT_CALL(native_mock_, SetUEDATX(_))
+      .Times(16)
+      .WillRepeatedly(Invoke([&](uint8_t value) { data.push_back(value); }));
+  EXPECT_CALL(native_mock_, SetUEINTX(_)).Times(2);
+  usb_controller_->HandleGeneralInterrupt();
+  EXPECT_EQ(data, (std::vector<uint8_t>{0, 0, 4, 0, 0, 0, 0, 0,  //
+                                        0, 0, 0, 0, 0, 0, 0, 0}));
+  EXPECT_EQ(QueuedReportCount(), 2);
+}
+
+TEST_F(UsbImplTest, StartOfFrameInterruptIsEnabledWhileReportsAreQueued) {
+  Configure();
+  EXPECT_CALL(native_mock_, SetUDIEN(kStartOfFrameEnabled)).Times(2);
+  EXPECT_TRUE(usb_controller_->SendKeypress(4, 0));
+  DrainReports();
+
+  // The interrupt stays enabled until the host has read the last report.
+  EXPECT_CALL(native_mock_, SetUDIEN(kStartOfFrameDisabled)).Times(0);
+  SendStartOfFrameWithoutReport(1);
+  EXPECT_CALL(native_mock_, SetUDIEN(kStartOfFrameDisabled)).Times(1);
+  SendStartOfFrameWithoutReport(0);
+}
+
+TEST_F(UsbImplTest, RecordsLatencyWhenReportsAreQueuedAndRead) {
+  Configure();
+  EXPECT_CALL(latency_telemetry_mock_,
+              RecordStage(LatencyTelemetry::Stage::REPORT_QUEUED))
+      .Times(2);
+  EXPECT_TRUE(usb_controller_->SendKeypress(4, 0));
+  DrainReports();
+
+  // The report is only acknowledged once the host has read every bank.
+  EXPECT_CALL(latency_telemetry_mock_,
+              RecordStage(LatencyTelemetry::Stage::REPORT_ACKED))
+      .Times(0);
+  SendStartOfFrameWithoutReport(1);
+  EXPECT_CALL(latency_telemetry_mock_,
+              RecordStage(LatencyTelemetry::Stage::REPORT_ACKED))
+      .Times(1);
+  SendStartOfFrameWithoutReport(0);
+}
+
+TEST_F(UsbImplTest, IdleTimerDoesNotRunWhileReportIsPending) {
+  Configure();
+  SetIdleConfig(1);
+  EXPECT_TRUE(usb_controller_->SendKeypress(4, 0));
+
+  // The endpoint isn't ready, so neither the queued report nor an idle report
+  // can be sent.
+  usb_controller_->UpdateIdleTimer();
+  EXPECT_CALL(native_mock_, GetUDINT()).WillOnce(Return(1 << native::SOFI));
+  EXPECT_CALL(native_mock_, SetUDINT(0));
+  EXPECT_CALL(native_mock_, GetUDMFN()).WillOnce(Return(0));
+  EXPECT_CALL(native_mock_, SetUENUM(descriptor::kKeyboardEndpoint));
+  EXPECT_CALL(native_mock_, GetUEINTX()).WillOnce(Return(0));
+  usb_controller_->HandleGeneralInterrupt();
+
+  // Once it is, only the queued reports are sent, in order.
+  EXPECT_EQ(DrainReports(), (std::vector<Report>{{0, 0, 4, 0, 0, 0, 0, 0},
+                                                 {0, 0, 0, 0, 0, 0, 0, 0}}));
+  SendStartOfFrameWithoutReport(0);
+}
+
+TEST_F(UsbImplTest, IdleReportWaitsUntilReportsAreRead) {
+  Configure();
+  SetIdleConfig(1);
+  EXPECT_TRUE(usb_controller_->SendKeypress(4, 0));
+  DrainReports();
+
+  // The host hasn't read the last report yet, so the idle timer doesn't run.
+  usb_controller_->UpdateIdleTimer();
+  SendStartOfFrameWithoutReport(1);
+  SendStartOfFrameWithoutReport(0);
+
+  // Once it has, the idle report repeats the last report.
+  usb_controller_->UpdateIdleTimer();
+  EXPECT_EQ(SendStartOfFrame(), (Report{0, 0, 0, 0, 0, 0, 0, 0}));
+}
+
+TEST_F(UsbImplTest, IdleReportIsSentWhenIdleTimerExpires) {
+  Configure();
+  // The idle rate is in units of 4ms, and the timer advances by 5ms, so the
+  // report is due on the third update.
+  SetIdleConfig(3);
+  EXPECT_CALL(native_mock_, SetUDIEN(kStartOfFrameEnabled)).Times(0);
+  usb_controller_->UpdateIdleTimer();
+  usb_controller_->UpdateIdleTimer();
+  EXPECT_CALL(native_mock_, SetUDIEN(kStartOfFrameEnabled)).Times(1);
+  usb_controller_->UpdateIdleTimer();
+  EXPECT_EQ(SendStartOfFrame(), (Report{0, 0, 0, 0, 0, 0, 0, 0}));
+
+  // The interrupt is disabled again once the idle report has been read.
+  EXPECT_CALL(native_mock_, SetUDIEN(kStartOfFrameDisabled)).Times(1);
+  SendStartOfFrameWithoutReport(0);
+}
+
+TEST_F(UsbImplTest, IdleTimerDoesNotRunWhenIdleReportsAreDisabled) {
+  Configure();
+  SetIdleConfig(0);
+  EXPECT_CALL(native_mock_, SetUDIEN(_)).Times(0);
+  for (int i = 0; i < 100; ++i) {
+    usb_controller_->UpdateIdleTimer();
+  }
+}
+
+TEST_F(UsbImplTest, KeySequenceSleepsUntilQueueHasSpace) {
+  Configure();
+  for (uint8_t i = 0; i < 4; ++i) {
+    EXPECT_TRUE(usb_controller_->TypeKey(4 + i, 0));
+    EXPECT_TRUE(usb_controller_->EndKeySequence());
+  }
+  ASSERT_EQ(QueuedReportCount(), 8);
+
+  // A frame passes each time the CPU sleeps, which makes space for one more
+  // report.
+  std::vector<Report> reports;
+  EXPECT_CALL(native_mock_, EnableCpuSleep()).Times(2);
+  EXPECT_CALL(native_mock_, EnableInterrupts()).Times(2);
+  EXPECT_CALL(native_mock_, DisableCpuSleep()).Times(2);
+  EXPECT_CALL(native_mock_, SleepCpu()).Times(2).WillRepeatedly(Invoke([&]() {
+    reports.push_back(SendStartOfFrame());
+  }));
+  EXPECT_TRUE(usb_controller_->TypeKey(8, 0));
+  EXPECT_TRUE(usb_controller_->EndKeySequence());
+  EXPECT_EQ(reports, (std::vector<Report>{{0, 0, 4, 0, 0, 0, 0, 0},
+                                          {0, 0, 0, 0, 0, 0, 0, 0}}));
+  EXPECT_EQ(QueuedReportCount(), 8);
+}
+
+TEST_F(UsbImplTest, KeySequenceFailsWhenQueueDoesNotDrain) {
+  Configure();
+  for (uint8_t i = 0; i < 4; ++i) {
+    EXPECT_TRUE(usb_controller_->TypeKey(4 + i, 0));
+    EXPECT_TRUE(usb_controller_->EndKeySequence());
+  }
+
+  // The host stops accepting reports, so frames pass without the queue
+  // draining.
+  uint8_t frame = 0;
+  EXPECT_CALL(native_mock_, GetUDFNUML()).WillRepeatedly(Invoke([&]() {
+    return frame;
+  }));
+  EXPECT_CALL(native_mock_, EnableCpuSleep()).Times(AnyNumber());
+  EXPECT_CALL(native_mock_, EnableInterrupts()).Times(AnyNumber());
+  EXPECT_CALL(native_mock_, DisableCpuSleep()).Times(AnyNumber());
+  EXPECT_CALL(native_mock_, SleepCpu()).WillRepeatedly(Invoke([&]() {
+    frame += 10;
+  }));
+  EXPECT_TRUE(usb_controller_->TypeKey(8, 0));
+  EXPECT_FALSE(usb_controller_->EndKeySequence());
+}
+
+TEST_F(UsbImplTest, KeySequencePacksKeysIntoReports) {
+  // Up to six keys are sent in each report. Every key in the second report is
+  // a new keypress, so there's no need to release the first six in between.
+  Configure();
+  for (uint8_t key = 4; key < 12; ++key) {
+    EXPECT_TRUE(usb_controller_->TypeKey(key, 0));
+  }
+  EXPECT_TRUE(usb_controller_->EndKeySequence());
+  EXPECT_EQ(DrainReports(), (std::vector<Report>{{0, 0, 4, 5, 6, 7, 8, 9},
+                                                 {0, 0, 10, 11, 0, 0, 0, 0},
+                                                 {0, 0, 0, 0, 0, 0, 0, 0}}));
+}
+
+TEST_F(UsbImplTest, KeySequenceReleasesRepeatedKey) {
+  // A key can't be pressed twice without being released in between.
+  Configure();
+  for (uint8_t key : {4, 5, 5, 6}) {
+    EXPECT_TRUE(usb_controller_->TypeKey(key, 2));
+  }
+  EXPECT_TRUE(usb_controller_->EndKeySequence());
+  EXPECT_EQ(DrainReports(), (std::vector<Report>{{2, 0, 4, 5, 0, 0, 0, 0},
+                                                 {0, 0, 0, 0, 0, 0, 0, 0},
+                                                 {2, 0, 5, 6, 0, 0, 0, 0},
+                                                 {0, 0, 0, 0, 0, 0, 0, 0}}));
+}
+
+TEST_F(UsbImplTest, KeySequenceReleasesKeyRepeatedAcrossReports) {
+  // Key 4 is still pressed when the second report would be sent, so it needs
+  // to be released first.
+  Configure();
+  for (uint8_t key : {4, 5, 6, 7, 8, 9, 10, 4}) {
+    EXPECT_TRUE(usb_controller_->TypeKey(key, 0));
+  }
+  EXPECT_TRUE(usb_controller_->EndKeySequence());
+  EXPECT_EQ(DrainReports(), (std::vector<Report>{{0, 0, 4, 5, 6, 7, 8, 9},
+                                                 {0, 0, 10, 0, 0, 0, 0, 0},
+                                                 {0, 0, 4, 0, 0, 0, 0, 0},
+                                                 {0, 0, 0, 0, 0, 0, 0, 0}}));
+}
+
+TEST_F(UsbImplTest, KeySequenceReleasesKeysWhenModifiersChange) {
+  Configure();
+  EXPECT_TRUE(usb_controller_->TypeKey(4, 2));
+  EXPECT_TRUE(usb_controller_->TypeKey(5, 0));
+  EXPECT_TRUE(usb_controller_->TypeKey(6, 0));
+  EXPECT_TRUE(usb_controller_->EndKeySequence());
+  EXPECT_EQ(DrainReports(), (std::vector<Report>{{2, 0, 4, 0, 0, 0, 0, 0},
+                                                 {0, 0, 0, 0, 0, 0, 0, 0},
+                                                 {0, 0, 5, 6, 0, 0, 0, 0},
+                                                 {0, 0, 0, 0, 0, 0, 0, 0}}));
+}
+
+TEST_F(UsbImplTest, ReportProtocolSendsKeyBitmap) {
+  Configure(hid::kReportProtocol);
+  EXPECT_TRUE(usb_controller_->SendKeypress(9, 2));
+  EXPECT_EQ(DrainReports(),
+            (std::vector<Report>{{2, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+                                 {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}}));
+}
+
+TEST_F(UsbImplTest, ReportProtocolPacksMoreThanSixKeys) {
+  Configure(hid::kReportProtocol);
+  for (uint8_t key = 4; key < 12; ++key) {
+    EXPECT_TRUE(usb_controller_->TypeKey(key, 0));
+  }
+  EXPECT_TRUE(usb_controller_->EndKeySequence());
+  EXPECT_EQ(
+      DrainReports(),
+      (std::vector<Report>{{0, 0xF0, 0x0F, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+                           {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}}));
+}
+
+TEST_F(UsbImplTest, ReportProtocolStartsNewReportForDescendingKey) {
+  // Hosts read the bitmap in key code order, so a key that's lower than the
+  // previous key has to be sent in the next report.
+  Configure(hid::kReportProtocol);
+  for (uint8_t key : {5, 6, 4}) {
+    EXPECT_TRUE(usb_controller_->TypeKey(key, 0));
+  }
+  EXPECT_TRUE(usb_controller_->EndKeySequence());
+  EXPECT_EQ(DrainReports(),
+            (std::vector<Report>{{0, 0x60, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+                                 {0, 0x10, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+                                 {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}}));
+}
+
+TEST_F(UsbImplTest, SuspendFreezesUsbClock) {
+  EXPECT_FALSE(usb_controller_->IsSuspended());
+  Suspend();
+  EXPECT_TRUE(usb_controller_->IsSuspended());
+
+  // Nothing but the wakeup interrupt is handled while suspended.
+  EXPECT_CALL(native_mock_, GetUDINT())
+      .WillOnce(Return((1 << native::SUSPI) | (1 << native::SOFI)));
+  EXPECT_CALL(native_mock_, SetUDINT(0));
+  usb_controller_->HandleGeneralInterrupt();
+  EXPECT_TRUE(usb_controller_->IsSuspended());
+}
+
+TEST_F(UsbImplTest, WakeupRestartsUsbClock) {
+  Suspend();
+
+  EXPECT_CALL(native_mock_, GetUDINT()).WillOnce(Return(1 << native::WAKEUPI));
+  EXPECT_CALL(native_mock_, SetUDINT(0));
+  ExpectUsbClockStart();
+  EXPECT_CALL(native_mock_, SetUDINT(static_cast<uint8_t>(
+                                ~(1 << native::WAKEUPI))));
+  EXPECT_CALL(native_mock_, SetUDIEN(kStartOfFrameDisabled));
+  usb_controller_->HandleGeneralInterrupt();
+  EXPECT_FALSE(usb_controller_->IsSuspended());
+}
+
+TEST_F(UsbImplTest, WakeupResumesSendingQueuedReports) {
+  Configure();
+  EXPECT_TRUE(usb_controller_->SendKeypress(4, 0));
+  Suspend();
+
+  EXPECT_CALL(native_mock_, GetUDINT()).WillOnce(Return(1 << native::WAKEUPI));
+  EXPECT_CALL(native_mock_, SetUDINT(0));
+  ExpectUsbClockStart();
+  EXPECT_CALL(native_mock_, SetUDINT(static_cast<uint8_t>(
+                                ~(1 << native::WAKEUPI))));
+  EXPECT_CALL(native_mock_, SetUDIEN(kStartOfFrameEnabled));
+  usb_controller_->HandleGeneralInterrupt();
+  EXPECT_EQ(DrainReports().size(), 2);
+}
+
+TEST_F(UsbImplTest, RemoteWakeupFailsWhenNotSuspended) {
+  SetRemoteWakeupEnabled(true);
+  EXPECT_CALL(native_mock_, GetSREG()).WillOnce(Return(0));
+  EXPECT_CALL(native_mock_, DisableInterrupts());
+  EXPECT_CALL(native_mock_, SetSREG(0));
+  EXPECT_FALSE(usb_controller_->RequestRemoteWakeup());
+}
+
+TEST_F(UsbImplTest, RemoteWakeupFailsWhenNotEnabledByHost) {
+  Suspend();
+  EXPECT_CALL(native_mock_, GetSREG()).WillOnce(Return(0));
+  EXPECT_CALL(native_mock_, DisableInterrupts());
+  EXPECT_CALL(native_mock_, SetSREG(0));
+  EXPECT_FALSE(usb_controller_->RequestRemoteWakeup());
+}
+
+TEST_F(UsbImplTest, RemoteWakeupSignalsResumeOnce) {
+  SetRemoteWakeupEnabled(true);
+  Suspend();
+  EXPECT_CALL(native_mock_, GetSREG()).Times(2).WillRepeatedly(Return(0));
+  EXPECT_CALL(native_mock_, DisableInterrupts()).Times(2);
+  EXPECT_CALL(native_mock_, SetSREG(0)).Times(2);
+  ExpectUsbClockStart();
+  EXPECT_CALL(native_mock_, GetUDCON()).WillOnce(Return(0));
+  EXPECT_CALL(native_mock_, SetUDCON(1 << native::RMWKUP));
+  EXPECT_TRUE(usb_controller_->RequestRemoteWakeup());
+
+  // The resume signal is already being sent.
+  EXPECT_FALSE(usb_controller_->RequestRemoteWakeup());
+}
+
+TEST_F(UsbImplTest, ResetDisablesRemoteWakeup) {
+  SetRemoteWakeupEnabled(true);
+  EXPECT_CALL(native_mock_, GetUDINT()).WillOnce(Return(1 << native::EORSTI));
+  EXPECT_CALL(native_mock_, SetUDINT(0));
+  EXPECT_CALL(native_mock_, SetUENUM(0));
+  EXPECT_CALL(native_mock_, SetUECONX(_));
+  EXPECT_CALL(native_mock_, SetUECFG0X(_));
+  EXPECT_CALL(native_mock_, SetUECFG1X(_));
+  EXPECT_CALL(native_mock_, SetUEIENX(_));
+  EXPECT_CALL(native_mock_, SetUDIEN(kStartOfFrameDisabled));
+  usb_controller_->HandleGeneralInterrupt();
+  EXPECT_FALSE(RemoteWakeupEnabled());
+}
+
+TEST_F(UsbImplTest, KeySequenceFailsWhenNotConfigured) {
+  EXPECT_TRUE(usb_controller_->TypeKey(4, 0));
+  EXPECT_CALL(native_mock_, GetSREG()).WillOnce(Return(0));
+  EXPECT_CALL(native_mock_, DisableInterrupts());
+  EXPECT_CALL(native_mock_, SetSREG(0));
+  EXPECT_FALSE(usb_controller_->EndKeySequence());
+}
 }  // namespace usb
 }  // namespace threeboard
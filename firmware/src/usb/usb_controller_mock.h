@@ -12,6 +12,13 @@ class DefaultUsbControllerMock : public UsbController {
   MOCK_METHOD(bool, Setup, (), (override));
   MOCK_METHOD(bool, HasConfigured, (), (override));
   MOCK_METHOD(bool, SendKeypress, (uint8_t, uint8_t), (override));
+  MOCK_METHOD(bool, TypeKey, (uint8_t, uint8_t), (override));
+  MOCK_METHOD(bool, EndKeySequence, (), (override));
+  MOCK_METHOD(void, UpdateIdleTimer, (), (override));
+  MOCK_METHOD(bool, IsSuspended, (), (override));
+  MOCK_METHOD(bool, RequestRemoteWakeup, (), (override));
+  MOCK_METHOD(MemoryReport *, GetMemoryRequest, (), (override));
+  MOCK_METHOD(void, CompleteMemoryRequest, (bool), (override));
 };
 }  // namespace detail
 
@@ -0,0 +1,110 @@
+#include "hidraw_memory_device.h"
+
+#include <fcntl.h>
+#include <linux/hidraw.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include "absl/strings/str_cat.h"
+#include "src/usb/shared/constants.h"
+
+namespace threeboard {
+namespace sync {
+namespace {
+
+// The number of hidraw nodes that Find searches.
+constexpr int kMaxHidrawNodes = 64;
+
+// The threeboard's report descriptors are told apart by their usage page, and
+// the vendor-defined interface's starts with Usage Page (Vendor Defined
+// 0xFF00).
+constexpr uint8_t kVendorUsagePage[] = {0x06, 0x00, 0xFF};
+
+// Feature reports are prefixed with their report ID, which is 0 since the
+// vendor-defined interface doesn't use numbered reports.
+constexpr uint8_t kReportId = 0;
+constexpr size_t kBufferSize = sizeof(usb::MemoryReport) + 1;
+
+absl::Status ErrnoStatus(const std::string &message) {
+  return absl::UnavailableError(
+      absl::StrCat(message, ": ", std::strerror(errno)));
+}
+
+bool IsVendorInterface(int fd) {
+  hidraw_devinfo info;
+  if (ioctl(fd, HIDIOCGRAWINFO, &info) < 0 ||
+      (uint16_t)info.vendor != usb::kVendorId ||
+      (uint16_t)info.product != usb::kProductId) {
+    return false;
+  }
+  hidraw_report_descriptor descriptor;
+  if (ioctl(fd, HIDIOCGRDESCSIZE, &descriptor.size) < 0 ||
+      ioctl(fd, HIDIOCGRDESC, &descriptor) < 0) {
+    return false;
+  }
+  return descriptor.size >= sizeof(kVendorUsagePage) &&
+         std::memcmp(descriptor.value, kVendorUsagePage,
+                     sizeof(kVendorUsagePage)) == 0;
+}
+
+}  // namespace
+
+HidrawMemoryDevice::HidrawMemoryDevice(int fd) : fd_(fd) {}
+
+HidrawMemoryDevice::~HidrawMemoryDevice() { close(fd_); }
+
+// Static.
+absl::StatusOr<std::unique_ptr<HidrawMemoryDevice>> HidrawMemoryDevice::Open(
+    const std::string &path) {
+  int fd = open(path.c_str(), O_RDWR);
+  if (fd < 0) {
+    return ErrnoStatus(absl::StrCat("Failed to open ", path));
+  }
+  if (!IsVendorInterface(fd)) {
+    close(fd);
+    return absl::NotFoundError(
+        absl::StrCat(path, " is not the threeboard's vendor interface"));
+  }
+  return std::unique_ptr<HidrawMemoryDevice>(new HidrawMemoryDevice(fd));
+}
+
+// Static.
+absl::StatusOr<std::unique_ptr<HidrawMemoryDevice>>
+HidrawMemoryDevice::Find() {
+  for (int i = 0; i < kMaxHidrawNodes; ++i) {
+    auto device = Open(absl::StrCat("/dev/hidraw", i));
+    if (device.ok()) {
+      return device;
+    }
+  }
+  return absl::NotFoundError("No threeboard found");
+}
+
+absl::Status HidrawMemoryDevice::SendReport(const usb::MemoryReport &report) {
+  uint8_t buffer[kBufferSize] = {kReportId};
+  std::memcpy(&buffer[1], &report, sizeof(report));
+  if (ioctl(fd_, HIDIOCSFEATURE(sizeof(buffer)), buffer) < 0) {
+    return ErrnoStatus("Failed to send memory report");
+  }
+  return absl::OkStatus();
+}
+
+absl::StatusOr<usb::MemoryReport> HidrawMemoryDevice::ReceiveReport() {
+  uint8_t buffer[kBufferSize] = {kReportId};
+  int size = ioctl(fd_, HIDIOCGFEATURE(sizeof(buffer)), buffer);
+  if (size < 0) {
+    return ErrnoStatus("Failed to receive memory report");
+  }
+  if (size != sizeof(buffer)) {
+    return absl::DataLossError("Received truncated memory report");
+  }
+  usb::MemoryReport report;
+  std::memcpy(&report, &buffer[1], sizeof(report));
+  return report;
+}
+
+}  // namespace sync
+}  // namespace threeboard
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "sync/memory_device.h"
+
+namespace threeboard {
+namespace sync {
+
+// A MemoryDevice backed by a Linux hidraw device node. Each HID interface of a
+// device gets its own node, and only the vendor-defined interface accepts
+// memory reports.
+class HidrawMemoryDevice final : public MemoryDevice {
+ public:
+  ~HidrawMemoryDevice() override;
+
+  // Open the hidraw node at `path`, checking that it's the vendor-defined
+  // interface of a threeboard.
+  static absl::StatusOr<std::unique_ptr<HidrawMemoryDevice>> Open(
+      const std::string &path);
+
+  // Open the first hidraw node that is the vendor-defined interface of a
+  // threeboard.
+  static absl::StatusOr<std::unique_ptr<HidrawMemoryDevice>> Find();
+
+  absl::Status SendReport(const usb::MemoryReport &report) override;
+  absl::StatusOr<usb::MemoryReport> ReceiveReport() override;
+
+ private:
+  explicit HidrawMemoryDevice(int fd);
+
+  int fd_;
+};
+
+}  // namespace sync
+}  // namespace threeboard
@@ -0,0 +1,53 @@
+#include <iostream>
+
+#include "absl/strings/str_replace.h"
+#include "simulator/util/state_storage_impl.h"
+#include "sync/hidraw_memory_device.h"
+#include "sync/shortcut_sync.h"
+#include "third_party/cxxopts.hpp"
+#include "util/status_util.h"
+
+using namespace threeboard::sync;
+using threeboard::simulator::StateStorageImpl;
+
+absl::Status RunSync(int argc, char *argv[]) {
+  cxxopts::Options options("sync",
+                           "Upload a shortcut file to a connected threeboard");
+  // clang-format off
+  options.add_options()
+      ("f,shortcut_filename", "Path to shortcut storage file", cxxopts::value<std::string>()->default_value("~/.threeboard_sim"))
+      ("d,device", "Path to the threeboard's vendor interface hidraw node, found automatically if not set", cxxopts::value<std::string>())
+      ("h,help", "Print usage")
+  ;
+  // clang-format on
+  auto result = options.parse(argc, argv);
+  if (result.count("help")) {
+    std::cout << options.help() << std::endl;
+    return absl::OkStatus();
+  }
+
+  std::string shortcut_filename = absl::StrReplaceAll(
+      result["shortcut_filename"].as<std::string>(), {{"~", getenv("HOME")}});
+  ASSIGN_OR_RETURN(auto state_storage,
+                   StateStorageImpl::CreateFromFile(shortcut_filename));
+  ASSIGN_OR_RETURN(auto device,
+                   result.count("device")
+                       ? HidrawMemoryDevice::Open(
+                             result["device"].as<std::string>())
+                       : HidrawMemoryDevice::Find());
+
+  ShortcutSync shortcut_sync(device.get());
+  ASSIGN_OR_RETURN(int chunks_written,
+                   shortcut_sync.Upload(state_storage.get()));
+  std::cout << "Wrote " << chunks_written << " changed chunks." << std::endl;
+  return absl::OkStatus();
+}
+
+int main(int argc, char *argv[]) {
+  try {
+    DIE_IF_ERROR(RunSync(argc, argv), "Sync failed");
+  } catch (const cxxopts::OptionException &e) {
+    std::cout << "Argument error: " << e.what() << std::endl;
+    return 1;
+  }
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "src/usb/shared/protocol.h"
+
+namespace threeboard {
+namespace sync {
+
+// A connection to the vendor-defined HID interface of a threeboard, through
+// which its shortcut memory is read and written.
+class MemoryDevice {
+ public:
+  virtual ~MemoryDevice() = default;
+
+  // Send a command to the device as a feature report.
+  virtual absl::Status SendReport(const usb::MemoryReport &report) = 0;
+
+  // Read the device's feature report, which holds the most recent command and
+  // its status.
+  virtual absl::StatusOr<usb::MemoryReport> ReceiveReport() = 0;
+};
+
+}  // namespace sync
+}  // namespace threeboard
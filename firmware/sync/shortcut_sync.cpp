@@ -0,0 +1,150 @@
+#include "shortcut_sync.h"
+
+#include <thread>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+
+namespace threeboard {
+namespace sync {
+namespace {
+
+using usb::MemoryReport;
+
+// Storage devices, numbered as in usb::MemoryReport.
+constexpr uint8_t kInternalEeprom = 0;
+constexpr uint8_t kEeprom0 = 1;
+constexpr uint8_t kEeprom1 = 2;
+
+constexpr uint32_t kInternalEepromSize = 1024;
+constexpr uint32_t kExternalEepromSize = 65536;
+
+// The number of times the device is polled for the result of a command before
+// giving up. Writes to external EEPROM take the longest, at up to 5ms per page.
+constexpr int kMaxPollAttempts = 1000;
+
+// The memory of a storage device, and its copy in StateStorage. The
+// StateStorage copies of the external EEPROMs are one byte shorter than the
+// devices themselves, so the final byte of those is never synced.
+struct Region {
+  uint8_t device;
+  uint32_t device_size;
+  uint8_t *data;
+  uint32_t size;
+};
+
+std::vector<Region> GetRegions(simulator::StateStorage *state_storage) {
+  return {
+      {kInternalEeprom, kInternalEepromSize,
+       state_storage->GetInternalEepromData()->data(),
+       (uint32_t)state_storage->GetInternalEepromData()->size()},
+      {kEeprom0, kExternalEepromSize, state_storage->GetEeprom0Data()->data(),
+       (uint32_t)state_storage->GetEeprom0Data()->size()},
+      {kEeprom1, kExternalEepromSize, state_storage->GetEeprom1Data()->data(),
+       (uint32_t)state_storage->GetEeprom1Data()->size()},
+  };
+}
+
+std::string DescribeCommand(const MemoryReport &report) {
+  return absl::StrCat(
+      report.command == MemoryReport::Command::READ ? "read" : "write",
+      " of device ", report.device, " at address ", report.address);
+}
+
+}  // namespace
+
+ShortcutSync::ShortcutSync(MemoryDevice *device,
+                           std::chrono::milliseconds poll_interval)
+    : device_(device), poll_interval_(poll_interval) {}
+
+absl::StatusOr<int> ShortcutSync::Upload(
+    simulator::StateStorage *state_storage) {
+  int chunks_written = 0;
+  for (const Region &region : GetRegions(state_storage)) {
+    for (uint32_t address = 0; address < region.device_size;
+         address += usb::hid::kMemoryReportChunkSize) {
+      absl::StatusOr<MemoryChunk> current = ReadChunk(region.device, address);
+      if (!current.ok()) {
+        return current.status();
+      }
+      MemoryChunk chunk = *current;
+      for (uint32_t i = 0; i < chunk.size() && address + i < region.size;
+           ++i) {
+        chunk[i] = region.data[address + i] + 1;
+      }
+      if (chunk == *current) {
+        continue;
+      }
+      absl::Status status = WriteChunk(region.device, address, chunk);
+      if (!status.ok()) {
+        return status;
+      }
+      chunks_written++;
+    }
+  }
+  return chunks_written;
+}
+
+absl::StatusOr<MemoryChunk> ShortcutSync::ReadChunk(uint8_t device,
+                                                    uint16_t address) {
+  MemoryReport command = {};
+  command.command = MemoryReport::Command::READ;
+  command.device = device;
+  command.address = address;
+  absl::StatusOr<MemoryReport> result = RunCommand(command);
+  if (!result.ok()) {
+    return result.status();
+  }
+  MemoryChunk chunk;
+  std::copy(result->data, result->data + chunk.size(), chunk.begin());
+  return chunk;
+}
+
+absl::Status ShortcutSync::WriteChunk(uint8_t device, uint16_t address,
+                                      const MemoryChunk &chunk) {
+  MemoryReport command = {};
+  command.command = MemoryReport::Command::WRITE;
+  command.device = device;
+  command.address = address;
+  std::copy(chunk.begin(), chunk.end(), command.data);
+  return RunCommand(command).status();
+}
+
+absl::StatusOr<MemoryReport> ShortcutSync::RunCommand(
+    const MemoryReport &command) {
+  // The firmware's RETURN_IF_ERROR is visible here through the shared USB
+  // headers, so statuses are checked explicitly.
+  absl::Status status = device_->SendReport(command);
+  if (!status.ok()) {
+    return status;
+  }
+  for (int attempt = 0; attempt < kMaxPollAttempts; ++attempt) {
+    absl::StatusOr<MemoryReport> report = device_->ReceiveReport();
+    if (!report.ok()) {
+      return report.status();
+    }
+    if (report->status == MemoryReport::Status::BUSY) {
+      std::this_thread::sleep_for(poll_interval_);
+      continue;
+    }
+    // The report describes the most recent command, which is only this one if
+    // nothing else has been talking to the device.
+    if (report->command != command.command ||
+        report->device != command.device ||
+        report->address != command.address) {
+      return absl::AbortedError(absl::StrCat(
+          "Device reported a different command than the ",
+          DescribeCommand(command)));
+    }
+    if (report->status != MemoryReport::Status::COMPLETE) {
+      return absl::InternalError(
+          absl::StrCat("Device failed the ", DescribeCommand(command)));
+    }
+    return *report;
+  }
+  return absl::DeadlineExceededError(absl::StrCat(
+      "Timed out waiting for the ", DescribeCommand(command)));
+}
+
+}  // namespace sync
+}  // namespace threeboard
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "simulator/util/state_storage.h"
+#include "src/usb/shared/constants.h"
+#include "sync/memory_device.h"
+
+namespace threeboard {
+namespace sync {
+
+using MemoryChunk = std::array<uint8_t, usb::hid::kMemoryReportChunkSize>;
+
+// Uploads shortcut memory to a threeboard, from the same format that the
+// simulator stores it in (see StateStorageImpl). Memory is transferred a chunk
+// at a time, and only the chunks that differ from the device's are written,
+// since EEPROM writes are slow and wear the device.
+//
+// StateStorage holds the raw bytes of each storage device, whereas the device
+// presents them offset by -1 (so erased bytes read as 0). The conversion is
+// applied here.
+class ShortcutSync {
+ public:
+  explicit ShortcutSync(
+      MemoryDevice *device,
+      std::chrono::milliseconds poll_interval = std::chrono::milliseconds(1));
+
+  // Write the shortcut memory in `state_storage` to the device. Returns the
+  // number of chunks that were written.
+  absl::StatusOr<int> Upload(simulator::StateStorage *state_storage);
+
+  // Read or write a single chunk of memory, as seen by the device.
+  absl::StatusOr<MemoryChunk> ReadChunk(uint8_t device, uint16_t address);
+  absl::Status WriteChunk(uint8_t device, uint16_t address,
+                          const MemoryChunk &chunk);
+
+ private:
+  // Send a command to the device and wait for it to finish, returning the
+  // device's final report.
+  absl::StatusOr<usb::MemoryReport> RunCommand(
+      const usb::MemoryReport &command);
+
+  MemoryDevice *device_;
+  std::chrono::milliseconds poll_interval_;
+};
+
+}  // namespace sync
+}  // namespace threeboard
@@ -0,0 +1,145 @@
+#include "shortcut_sync.h"
+
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "integration/util/fake_state_storage.h"
+#include "util/gtest_util.h"
+
+namespace threeboard {
+namespace sync {
+namespace {
+
+using usb::MemoryReport;
+
+// Mimics the firmware's handling of memory reports, executing each command
+// against an in-memory copy of the device's storage.
+class FakeMemoryDevice : public MemoryDevice {
+ public:
+  absl::Status SendReport(const MemoryReport &report) override {
+    report_ = report;
+    busy_reports_remaining_ = busy_reports_;
+    std::vector<uint8_t> &memory = memory_[report.device];
+    if (fail_commands_) {
+      report_.status = MemoryReport::Status::FAILED;
+    } else if (report.command == MemoryReport::Command::READ) {
+      std::copy(memory.begin() + report.address,
+                memory.begin() + report.address + sizeof(report.data),
+                report_.data);
+      report_.status = MemoryReport::Status::COMPLETE;
+    } else {
+      std::copy(report.data, report.data + sizeof(report.data),
+                memory.begin() + report.address);
+      report_.status = MemoryReport::Status::COMPLETE;
+      chunks_written_++;
+    }
+    return absl::OkStatus();
+  }
+
+  absl::StatusOr<MemoryReport> ReceiveReport() override {
+    MemoryReport report = report_;
+    if (busy_reports_remaining_ > 0) {
+      busy_reports_remaining_--;
+      report.status = MemoryReport::Status::BUSY;
+    }
+    return report;
+  }
+
+  // The logical contents of internal EEPROM, EEPROM_0 and EEPROM_1, which are
+  // all erased.
+  std::vector<uint8_t> memory_[3] = {std::vector<uint8_t>(1024),
+                                     std::vector<uint8_t>(65536),
+                                     std::vector<uint8_t>(65536)};
+  int busy_reports_ = 0;
+  bool fail_commands_ = false;
+  int chunks_written_ = 0;
+
+ protected:
+  MemoryReport report_ = {};
+  int busy_reports_remaining_ = 0;
+};
+
+class ShortcutSyncTest : public ::testing::Test {
+ public:
+  ShortcutSyncTest()
+      : shortcut_sync_(&device_, std::chrono::milliseconds(0)) {}
+
+ protected:
+  FakeMemoryDevice device_;
+  integration::FakeStateStorage state_storage_;
+  ShortcutSync shortcut_sync_;
+};
+
+TEST_F(ShortcutSyncTest, UploadOfErasedStorageWritesNothing) {
+  auto chunks_written = shortcut_sync_.Upload(&state_storage_);
+  ASSERT_OK(chunks_written.status());
+  EXPECT_EQ(*chunks_written, 0);
+  EXPECT_EQ(device_.chunks_written_, 0);
+}
+
+TEST_F(ShortcutSyncTest, UploadWritesOnlyChangedChunks) {
+  // Word shortcut 0 is {4, 5, 6}, stored with the -1 offset.
+  (*state_storage_.GetInternalEepromData())[0x100] = 2;
+  (*state_storage_.GetEeprom0Data())[0] = 3;
+  (*state_storage_.GetEeprom0Data())[1] = 4;
+  (*state_storage_.GetEeprom0Data())[2] = 5;
+  (*state_storage_.GetEeprom1Data())[0x1041] = 9;
+
+  auto chunks_written = shortcut_sync_.Upload(&state_storage_);
+  ASSERT_OK(chunks_written.status());
+  EXPECT_EQ(*chunks_written, 3);
+  EXPECT_EQ(device_.memory_[0][0x100], 3);
+  EXPECT_EQ(device_.memory_[1][0], 4);
+  EXPECT_EQ(device_.memory_[1][1], 5);
+  EXPECT_EQ(device_.memory_[1][2], 6);
+  EXPECT_EQ(device_.memory_[2][0x1041], 10);
+
+  // Everything is now in sync.
+  chunks_written = shortcut_sync_.Upload(&state_storage_);
+  ASSERT_OK(chunks_written.status());
+  EXPECT_EQ(*chunks_written, 0);
+}
+
+TEST_F(ShortcutSyncTest, UploadLeavesFinalByteOfExternalEeprom) {
+  // StateStorage is one byte shorter than the external EEPROMs.
+  device_.memory_[1][65535] = 7;
+  (*state_storage_.GetEeprom0Data())[65534] = 1;
+
+  auto chunks_written = shortcut_sync_.Upload(&state_storage_);
+  ASSERT_OK(chunks_written.status());
+  EXPECT_EQ(*chunks_written, 1);
+  EXPECT_EQ(device_.memory_[1][65534], 2);
+  EXPECT_EQ(device_.memory_[1][65535], 7);
+}
+
+TEST_F(ShortcutSyncTest, ReadChunkWaitsWhileDeviceIsBusy) {
+  device_.busy_reports_ = 3;
+  device_.memory_[2][0x80] = 5;
+  auto chunk = shortcut_sync_.ReadChunk(2, 0x80);
+  ASSERT_OK(chunk.status());
+  EXPECT_EQ((*chunk)[0], 5);
+}
+
+TEST_F(ShortcutSyncTest, ReadChunkTimesOutWhileDeviceIsBusy) {
+  device_.busy_reports_ = 1000000;
+  EXPECT_EQ(shortcut_sync_.ReadChunk(0, 0).status().code(),
+            absl::StatusCode::kDeadlineExceeded);
+}
+
+TEST_F(ShortcutSyncTest, WriteChunkReportsFailedCommand) {
+  device_.fail_commands_ = true;
+  MemoryChunk chunk = {1, 2, 3};
+  absl::Status status = shortcut_sync_.WriteChunk(1, 0x40, chunk);
+  EXPECT_EQ(status.code(), absl::StatusCode::kInternal);
+  EXPECT_EQ(status.message(),
+            "Device failed the write of device 1 at address 64");
+}
+
+TEST_F(ShortcutSyncTest, UploadStopsAtFailedCommand) {
+  device_.fail_commands_ = true;
+  EXPECT_FALSE(shortcut_sync_.Upload(&state_storage_).ok());
+}
+
+}  // namespace
+}  // namespace sync
+}  // namespace threeboard
@@ -0,0 +1,33 @@
+#include "usb_host_memory_device.h"
+
+#include <cstring>
+
+namespace threeboard {
+namespace sync {
+
+UsbHostMemoryDevice::UsbHostMemoryDevice(simulator::UsbHost *usb_host)
+    : usb_host_(usb_host) {}
+
+absl::Status UsbHostMemoryDevice::SendReport(const usb::MemoryReport &report) {
+  const uint8_t *data = (const uint8_t *)&report;
+  return usb_host_->SetFeatureReport(
+      usb::descriptor::kVendorInterfaceIndex,
+      std::vector<uint8_t>(data, data + sizeof(report)));
+}
+
+absl::StatusOr<usb::MemoryReport> UsbHostMemoryDevice::ReceiveReport() {
+  absl::StatusOr<std::vector<uint8_t>> data = usb_host_->GetFeatureReport(
+      usb::descriptor::kVendorInterfaceIndex, sizeof(usb::MemoryReport));
+  if (!data.ok()) {
+    return data.status();
+  }
+  if (data->size() != sizeof(usb::MemoryReport)) {
+    return absl::DataLossError("Received truncated memory report");
+  }
+  usb::MemoryReport report;
+  std::memcpy(&report, data->data(), sizeof(report));
+  return report;
+}
+
+}  // namespace sync
+}  // namespace threeboard
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "simulator/components/usb_host.h"
+#include "sync/memory_device.h"
+
+namespace threeboard {
+namespace sync {
+
+// A MemoryDevice that talks to the simulated threeboard through the
+// simulator's USB host.
+class UsbHostMemoryDevice final : public MemoryDevice {
+ public:
+  explicit UsbHostMemoryDevice(simulator::UsbHost *usb_host);
+
+  absl::Status SendReport(const usb::MemoryReport &report) override;
+  absl::StatusOr<usb::MemoryReport> ReceiveReport() override;
+
+ private:
+  simulator::UsbHost *usb_host_;
+};
+
+}  // namespace sync
+}  // namespace threeboard